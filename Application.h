@@ -6,16 +6,36 @@
 #define VULKANDEMO_APPLICATION_H
 
 #define returnOnError(errorCode) if(errorCode != VK_SUCCESS) {return errorCode;}
-#define throwOnError(errorCode, message) if(errorCode != VK_SUCCESS) {std::cerr << message << std::endl; goto error;}
+#define throwOnError(errorCode, message) if(errorCode != VK_SUCCESS) {logError(message); goto error;}
 
 #include <GLFW/glfw3.h>
-#include <vulkan/vulkan.h>
+#include "dispatch/Dispatch.h"
 #include <vector>
+#include <atomic>
+#include <chrono>
 #include "devices/PhysicalDevice.h"
+#include "threading/SpscQueue.h"
+#include "window/WindowEvent.h"
+#include "pipeline/PipelineLibrary.h"
+#include "config/Options.h"
+#include "logging/Logger.h"
+#include "memory/MemoryBudget.h"
+#include "capture/FrameCapture.h"
+#include "sprites/SpriteBatch.h"
+#include "pipeline/CommandCache.h"
+#include "mesh/LodScene.h"
+#include "tracing/GpuTrace.h"
+#include "window/WindowViews.h"
+#include "resolution/DynamicResolution.h"
+#include "lighting/ClusteredLighting.h"
+#include "particles/ParticleSystem.h"
+#include "pacing/FramePacer.h"
+#include "metrics/Metrics.h"
 
 const int MAX_FRAMES_IN_FLIGHT = 2;
 
 typedef struct Application {
+    Options options;
     GLFWwindow *window;
 
     VkInstance instance;
@@ -26,21 +46,37 @@ typedef struct Application {
     VkDevice device;
     VkQueue graphicsQueue;
     VkQueue presentQueue;
+    MemoryTracker memory;
 
-    VkSwapchainKHR swapChain;
+    VkSwapchainKHR swapChain; // of the main window, the one that is captured
     std::vector<VkImage> swapChainImages;
     VkFormat imageFormat;
     VkExtent2D swapChainExtent;
+    VkImageUsageFlags swapChainUsage;
+    VkExtent2D sceneExtent; // the scene renders at this size, below swapChainExtent with dynamic resolution
 
     std::vector<VkImageView> swapChainImageViews;
     std::vector<VkFramebuffer> swapChainFramebuffers;
+    WindowView windowViews[MAX_WINDOW_VIEWS]; // further windows, presented together with the main window
+    uint32_t windowViewCount = 0;
 
     VkRenderPass renderPass;
+    VkRenderPass overlayRenderPass; // draws on top of the scene, compatible with renderPass
     VkPipelineLayout pipelineLayout;
-    VkPipeline graphicsPipeline;
+    VkPipeline graphicsPipeline; // owned by the pipeline library
+    PipelineLibrary pipelineLibrary;
 
     VkCommandPool commandPool;
-    std::vector<VkCommandBuffer> commandBuffers;
+    std::vector<VkCommandPool> frameCommandPools; // reset and recorded every frame, one per frame in flight
+    std::vector<VkCommandBuffer> frameCommandBuffers;
+    CommandCache commandCache; // secondary command buffers the frame command buffers execute
+    FrameCapture capture;
+    SpriteBatcher sprites;
+    LodScene lodScene;
+    GpuTracer gpuTracer;
+    DynamicResolution resolution;
+    ClusteredLighting lighting;
+    ParticleSystem particles;
 
     // Semaphores
     std::vector<VkSemaphore> imageAvailableSemaphores;
@@ -49,8 +85,26 @@ typedef struct Application {
     std::vector<VkFence> imagesInFlight;
     size_t currentFrame = 0;
 
-    bool framebufferResized = false; // manual handling of window resize event
+    // Window state shared between the main (event) thread and the render thread
+    std::atomic<bool> running{false};
+    std::atomic<bool> framebufferResized{false}; // manual handling of window resize event
+    std::atomic<int> framebufferWidth{0};
+    std::atomic<int> framebufferHeight{0};
+    SpscQueue<WindowEvent, 1024> windowEvents; // main thread produces, render thread consumes
+    FramePacer pacer; // when the render thread draws
+    Metrics metrics; // written by every thread, served by the metrics thread
+    VkResult renderResult = VK_SUCCESS; // written by the render thread before it exits
+
+    // Owned by the render thread
+    bool hasPendingInput = false;
+    std::chrono::steady_clock::time_point pendingInputTimestamp;
+    InputLatencyStats inputLatency;
+    bool firstFramePresented = false;
+    FrameStageTimes frameStages{}; // of the last drawFrame
+    PresentTimingStats presentTiming; // of the main window
+
     VkBuffer vertexBuffer;
     VkDeviceMemory vertexBufferMemory;
+    uint32_t vertexCount = 0; // in vertexBuffer, the triangle unless Options::stressShape generates more
 } Application;
 #endif //VULKANDEMO_APPLICATION_H
@@ -0,0 +1,296 @@
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include "AssetArchive.h"
+#include "Lz4.h"
+
+const uint64_t PRIME64_1 = 0x9E3779B185EBCA87ull;
+const uint64_t PRIME64_2 = 0xC2B2AE3D27D4EB4Full;
+const uint64_t PRIME64_3 = 0x165667B19E3779F9ull;
+const uint64_t PRIME64_4 = 0x85EBCA77C2B2CA63ull;
+const uint64_t PRIME64_5 = 0x27D4EB2F165667C5ull;
+
+// the archive shaders and meshes are read from first, see mountAssetArchive
+static AssetArchive mountedArchive;
+static bool archiveMounted = false;
+
+static inline uint64_t rotateLeft(uint64_t value, int bits) {
+  return (value << bits) | (value >> (64 - bits));
+}
+
+static inline uint64_t read64(const uint8_t *data) {
+  uint64_t value;
+  memcpy(&value, data, sizeof(value));
+  return value;
+}
+
+static inline uint32_t read32(const uint8_t *data) {
+  uint32_t value;
+  memcpy(&value, data, sizeof(value));
+  return value;
+}
+
+static inline uint64_t hashRound(uint64_t accumulator, uint64_t input) {
+  accumulator += input * PRIME64_2;
+  return rotateLeft(accumulator, 31) * PRIME64_1;
+}
+
+static inline uint64_t mergeRound(uint64_t accumulator, uint64_t value) {
+  accumulator ^= hashRound(0, value);
+  return accumulator * PRIME64_1 + PRIME64_4;
+}
+
+/**
+ * XXH64 of the bytes, a 64 bit hash that reads 32 bytes per round, which keeps hashing sources
+ * and verifying entries far from the cost of reading them. Assumes a little endian host.
+ *
+ * @param data
+ * @param size
+ * @param seed
+ * @return
+ */
+uint64_t hashAsset(const void *data, size_t size, uint64_t seed) {
+  const auto *bytes = static_cast<const uint8_t *>(data);
+  const uint8_t *end = bytes + size;
+  uint64_t hash;
+  if (size >= 32) {
+    uint64_t v1 = seed + PRIME64_1 + PRIME64_2;
+    uint64_t v2 = seed + PRIME64_2;
+    uint64_t v3 = seed;
+    uint64_t v4 = seed - PRIME64_1;
+    for (; end - bytes >= 32; bytes += 32) {
+      v1 = hashRound(v1, read64(bytes));
+      v2 = hashRound(v2, read64(bytes + 8));
+      v3 = hashRound(v3, read64(bytes + 16));
+      v4 = hashRound(v4, read64(bytes + 24));
+    }
+    hash = rotateLeft(v1, 1) + rotateLeft(v2, 7) + rotateLeft(v3, 12) + rotateLeft(v4, 18);
+    hash = mergeRound(hash, v1);
+    hash = mergeRound(hash, v2);
+    hash = mergeRound(hash, v3);
+    hash = mergeRound(hash, v4);
+  } else {
+    hash = seed + PRIME64_5;
+  }
+  hash += size;
+  for (; end - bytes >= 8; bytes += 8) {
+    hash ^= hashRound(0, read64(bytes));
+    hash = rotateLeft(hash, 27) * PRIME64_1 + PRIME64_4;
+  }
+  if (end - bytes >= 4) {
+    hash ^= read32(bytes) * PRIME64_1;
+    hash = rotateLeft(hash, 23) * PRIME64_2 + PRIME64_3;
+    bytes += 4;
+  }
+  for (; bytes < end; ++bytes) {
+    hash ^= *bytes * PRIME64_5;
+    hash = rotateLeft(hash, 11) * PRIME64_1;
+  }
+  hash ^= hash >> 33;
+  hash *= PRIME64_2;
+  hash ^= hash >> 29;
+  hash *= PRIME64_3;
+  hash ^= hash >> 32;
+  return hash;
+}
+
+/**
+ * The name an asset is stored under: forward slashes, relative to the cooked root. The demo
+ * refers to assets relative to the build directory, e.g. ../shaders/vert.spv, so leading ./ and
+ * ../ are dropped and that becomes shaders/vert.spv.
+ *
+ * @param path
+ * @return
+ */
+std::string normalizeAssetName(const std::string &path) {
+  std::string name = path;
+  for (char &c : name) {
+    if (c == '\\') {
+      c = '/';
+    }
+  }
+  size_t start = 0;
+  while (true) {
+    if (name.compare(start, 3, "../") == 0) {
+      start += 3;
+    } else if (name.compare(start, 2, "./") == 0) {
+      start += 2;
+    } else {
+      break;
+    }
+  }
+  return name.substr(start);
+}
+
+/**
+ * Reads a whole archive and checks that its table of contents and every entry lie within it, and
+ * that its lookup slots hold no more than its entries.
+ *
+ * @param path
+ * @param archive
+ * @return
+ */
+bool openAssetArchive(const std::string &path, AssetArchive &archive) {
+  std::ifstream file(path, std::ios::ate | std::ios::binary);
+  if (!file.is_open()) {
+    std::cerr << "Failed to open asset archive " << path << std::endl;
+    return false;
+  }
+  archive = AssetArchive{};
+  archive.data.resize(static_cast<size_t>(file.tellg()));
+  file.seekg(0);
+  file.read(reinterpret_cast<char *>(archive.data.data()), static_cast<std::streamsize>(archive.data.size()));
+  const uint64_t fileSize = archive.data.size();
+
+  bool valid = file.good() && fileSize >= sizeof(AssetArchiveHeader);
+  const auto *header = reinterpret_cast<const AssetArchiveHeader *>(archive.data.data());
+  valid = valid && memcmp(header->magic, ASSET_ARCHIVE_MAGIC, sizeof(ASSET_ARCHIVE_MAGIC)) == 0 &&
+          header->version == ASSET_ARCHIVE_VERSION;
+  valid = valid && header->slotCount > header->entryCount && (header->slotCount & (header->slotCount - 1)) == 0 &&
+          header->tableOffset % 8 == 0 && header->tableOffset <= fileSize;
+  if (valid) {
+    // each part against what is left on its own, a sum could wrap around with a huge namesSize
+    const uint64_t entriesSize = sizeof(AssetEntry) * static_cast<uint64_t>(header->entryCount);
+    const uint64_t slotsSize = sizeof(uint32_t) * static_cast<uint64_t>(header->slotCount);
+    const uint64_t remaining = fileSize - header->tableOffset;
+    valid = entriesSize <= remaining && slotsSize <= remaining - entriesSize &&
+            header->namesSize <= remaining - entriesSize - slotsSize;
+  }
+  if (valid) {
+    archive.header = header;
+    archive.entries = reinterpret_cast<const AssetEntry *>(archive.data.data() + header->tableOffset);
+    archive.slots = reinterpret_cast<const uint32_t *>(archive.entries + header->entryCount);
+    archive.names = reinterpret_cast<const char *>(archive.slots + header->slotCount);
+  }
+  for (uint32_t i = 0; valid && i < header->entryCount; ++i) {
+    const AssetEntry &entry = archive.entries[i];
+    valid = entry.offset <= header->tableOffset && entry.packedSize <= header->tableOffset - entry.offset &&
+            static_cast<uint64_t>(entry.nameOffset) + entry.nameLength <= header->namesSize &&
+            (entry.compression == ASSET_COMPRESSION_LZ4 || (entry.compression == ASSET_COMPRESSION_NONE && entry.packedSize == entry.size));
+  }
+  uint32_t filledSlots = 0;
+  for (uint32_t slot = 0; valid && slot < header->slotCount; ++slot) {
+    valid = archive.slots[slot] == ASSET_NO_ENTRY || archive.slots[slot] < header->entryCount;
+    filledSlots += archive.slots[slot] != ASSET_NO_ENTRY;
+  }
+  // leaves an empty slot, which every lookup of a name that isn't in the archive stops at
+  valid = valid && filledSlots <= header->entryCount;
+  if (!valid) {
+    std::cerr << path << " is not a valid asset archive" << std::endl;
+    archive = AssetArchive{};
+  }
+  return valid;
+}
+
+/**
+ * Looks an entry up in the slots of the archive, starting at the slot the hash of its name maps
+ * to. The slots are at most half full, so this takes a probe or two whatever the size of the
+ * archive. The names are compared as well, a file that isn't cooked may share the hash of one that is.
+ *
+ * @param archive
+ * @param path as the demo refers to the asset, see normalizeAssetName
+ * @return nullptr if there is no such entry
+ */
+const AssetEntry *findAsset(const AssetArchive &archive, const std::string &path) {
+  if (archive.header == nullptr) {
+    return nullptr;
+  }
+  const std::string name = normalizeAssetName(path);
+  const uint64_t nameHash = hashAsset(name.data(), name.size());
+  const uint32_t mask = archive.header->slotCount - 1;
+  uint32_t slot = static_cast<uint32_t>(nameHash) & mask;
+  for (uint32_t probe = 0; probe < archive.header->slotCount; ++probe, slot = (slot + 1) & mask) {
+    const uint32_t index = archive.slots[slot];
+    if (index == ASSET_NO_ENTRY) {
+      return nullptr;
+    }
+    const AssetEntry &entry = archive.entries[index];
+    if (entry.nameHash == nameHash && entry.nameLength == name.size() &&
+        memcmp(archive.names + entry.nameOffset, name.data(), name.size()) == 0) {
+      return &entry;
+    }
+  }
+  return nullptr;
+}
+
+std::string assetName(const AssetArchive &archive, const AssetEntry &entry) {
+  return std::string(archive.names + entry.nameOffset, entry.nameLength);
+}
+
+/**
+ * Decompresses an entry into memory of at least entry.size bytes, e.g. mapped staging memory.
+ * Debug builds also check it against its content hash.
+ *
+ * @param archive
+ * @param entry
+ * @param destination
+ * @return
+ */
+bool unpackAsset(const AssetArchive &archive, const AssetEntry &entry, void *destination) {
+  const uint8_t *packed = archive.data.data() + entry.offset;
+  bool valid = true;
+  if (entry.compression == ASSET_COMPRESSION_NONE) {
+    memcpy(destination, packed, entry.size);
+  } else {
+    valid = decompressLz4(packed, entry.packedSize, static_cast<uint8_t *>(destination), entry.size);
+  }
+#ifndef NDEBUG
+  valid = valid && hashAsset(destination, entry.size) == entry.contentHash;
+#endif
+  if (!valid) {
+    std::cerr << "Asset " << assetName(archive, entry) << " is corrupt" << std::endl;
+  }
+  return valid;
+}
+
+/**
+ * @param archive
+ * @param entry
+ * @param content replaced by the cooked bytes
+ * @return
+ */
+bool readAsset(const AssetArchive &archive, const AssetEntry &entry, std::vector<char> &content) {
+  content.resize(entry.size);
+  return unpackAsset(archive, entry, content.data());
+}
+
+/**
+ * Makes readMountedAsset read from the archive. Must be called before anything reads assets,
+ * the archive is not synchronized.
+ *
+ * @param path
+ * @return
+ */
+bool mountAssetArchive(const std::string &path) {
+  archiveMounted = openAssetArchive(path, mountedArchive);
+  if (archiveMounted) {
+    std::cout << "Mounted " << path << " with " << mountedArchive.header->entryCount << " assets" << std::endl;
+  }
+  return archiveMounted;
+}
+
+/**
+ * @param path as it would be opened from the build directory
+ * @return the entry of the asset in the mounted archive, nullptr if no archive is mounted or it
+ * doesn't hold the asset
+ */
+const AssetEntry *findMountedAsset(const std::string &path) {
+  return archiveMounted ? findAsset(mountedArchive, path) : nullptr;
+}
+
+bool unpackMountedAsset(const AssetEntry &entry, void *destination) {
+  return unpackAsset(mountedArchive, entry, destination);
+}
+
+/**
+ * Reads an asset from the mounted archive.
+ *
+ * @param path as it would be opened from the build directory
+ * @param content
+ * @return false if no archive is mounted, it doesn't hold the asset or its entry is corrupt, so
+ * the caller should read the loose file instead
+ */
+bool readMountedAsset(const std::string &path, std::vector<char> &content) {
+  const AssetEntry *entry = findMountedAsset(path);
+  return entry != nullptr && readAsset(mountedArchive, *entry, content);
+}
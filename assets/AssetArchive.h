@@ -0,0 +1,89 @@
+#ifndef VULKANDEMO_ASSETARCHIVE_H
+#define VULKANDEMO_ASSETARCHIVE_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+const char ASSET_ARCHIVE_MAGIC[4] = {'V', 'P', 'A', 'K'};
+const uint32_t ASSET_ARCHIVE_VERSION = 1;
+const uint32_t ASSET_NO_ENTRY = UINT32_MAX; // an empty lookup slot
+
+enum AssetCompression : uint32_t {
+    ASSET_COMPRESSION_NONE = 0, // stored, when compression doesn't pay off
+    ASSET_COMPRESSION_LZ4 = 1 // one LZ4 block
+};
+
+enum AssetType : uint32_t {
+    ASSET_RAW = 0,
+    ASSET_SHADER = 1, // SPIR-V as vkCreateShaderModule takes it
+    ASSET_MESH = 2, // a LOD file, see saveLodMesh
+    ASSET_TEXTURE = 3 // a CookedTexture header followed by its mip chain
+};
+
+/**
+ * The start of an archive. The packed entries follow it back to back, then the table of contents
+ * at tableOffset: entryCount AssetEntry, slotCount lookup slots and the names of the entries.
+ * Native endianness, like the LOD files.
+ */
+typedef struct AssetArchiveHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t entryCount;
+    uint32_t slotCount; // a power of two, at least twice the entries
+    uint64_t tableOffset; // a multiple of 8
+    uint64_t namesSize;
+} AssetArchiveHeader;
+
+typedef struct AssetEntry {
+    uint64_t nameHash; // hashAsset of the normalized name
+    uint64_t contentHash; // hashAsset of the cooked bytes
+    uint64_t sourceHash; // of the source file and the cook version, the cooker only recooks when it changes
+    uint64_t offset; // of the packed bytes, from the start of the archive
+    uint64_t packedSize;
+    uint64_t size; // cooked
+    uint32_t compression; // AssetCompression
+    uint32_t type; // AssetType
+    uint32_t nameOffset; // into the names
+    uint32_t nameLength;
+} AssetEntry;
+
+static_assert(sizeof(AssetArchiveHeader) == 32 && sizeof(AssetEntry) == 64, "The archive layout must not depend on the compiler");
+
+/**
+ * What the cooker turns images into: RGBA8 with every mip level down to 1x1, finest first, each
+ * tightly packed, so uploading it is one buffer to image copy per level.
+ */
+typedef struct CookedTexture {
+    char magic[4]; // TEX1
+    uint32_t width;
+    uint32_t height;
+    uint32_t mipLevels;
+    uint32_t format; // VK_FORMAT_R8G8B8A8_UNORM
+} CookedTexture;
+
+/**
+ * An archive read into memory as a whole. The table of contents is used where it lies: an entry
+ * is found by hashing its name into the open addressing slots, without building anything at
+ * load time. Read only once opened, so any thread may read entries.
+ */
+typedef struct AssetArchive {
+    std::vector<uint8_t> data;
+    const AssetArchiveHeader *header = nullptr;
+    const AssetEntry *entries = nullptr;
+    const uint32_t *slots = nullptr; // index of an entry or ASSET_NO_ENTRY
+    const char *names = nullptr;
+} AssetArchive;
+
+uint64_t hashAsset(const void *data, size_t size, uint64_t seed = 0);
+std::string normalizeAssetName(const std::string &path);
+bool openAssetArchive(const std::string &path, AssetArchive &archive);
+const AssetEntry *findAsset(const AssetArchive &archive, const std::string &path);
+std::string assetName(const AssetArchive &archive, const AssetEntry &entry);
+bool unpackAsset(const AssetArchive &archive, const AssetEntry &entry, void *destination);
+bool readAsset(const AssetArchive &archive, const AssetEntry &entry, std::vector<char> &content);
+bool mountAssetArchive(const std::string &path);
+const AssetEntry *findMountedAsset(const std::string &path);
+bool unpackMountedAsset(const AssetEntry &entry, void *destination);
+bool readMountedAsset(const std::string &path, std::vector<char> &content);
+#endif //VULKANDEMO_ASSETARCHIVE_H
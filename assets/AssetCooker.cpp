@@ -0,0 +1,417 @@
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <unordered_map>
+#include "AssetArchive.h"
+#include "Lz4.h"
+#include "../mesh/MeshLod.h"
+
+// part of every source hash, bump it when a cooked format changes so every asset is recooked
+const uint64_t ASSET_COOK_VERSION = 1;
+const uint32_t SPIRV_MAGIC = 0x07230203;
+const uint32_t FORMAT_R8G8B8A8_UNORM = 37; // VkFormat
+
+/**
+ * An asset of the archive being written, either cooked now or taken over from the previous
+ * archive as it was packed.
+ */
+typedef struct CookedAsset {
+    std::string name;
+    AssetEntry entry{};
+    std::vector<uint8_t> packed;
+    bool reused = false;
+} CookedAsset;
+
+static bool readFile(const std::filesystem::path &path, std::vector<char> &content) {
+  std::ifstream file(path, std::ios::ate | std::ios::binary);
+  if (!file.is_open()) {
+    std::cerr << "Failed to open " << path.string() << std::endl;
+    return false;
+  }
+  content.resize(static_cast<size_t>(file.tellg()));
+  file.seekg(0);
+  file.read(content.data(), static_cast<std::streamsize>(content.size()));
+  return file.good();
+}
+
+static bool cookShader(const std::vector<char> &source, std::vector<char> &cooked) {
+  uint32_t magic = 0;
+  if (source.size() % 4 != 0 || source.size() < sizeof(magic)) {
+    return false;
+  }
+  memcpy(&magic, source.data(), sizeof(magic));
+  cooked = source; // already what vkCreateShaderModule takes
+  return magic == SPIRV_MAGIC;
+}
+
+static bool cookMesh(const std::filesystem::path &path, std::vector<char> &cooked) {
+  LodMesh mesh;
+  if (!loadObjMesh(path.string(), mesh)) {
+    return false;
+  }
+  buildMeshLods(mesh);
+  serializeLodMesh(mesh, cooked);
+  return true;
+}
+
+/**
+ * Skips whitespace and # comments between the fields of a PPM header.
+ */
+static size_t skipPpmSpace(const std::vector<char> &source, size_t offset) {
+  while (offset < source.size()) {
+    if (source[offset] == '#') {
+      while (offset < source.size() && source[offset] != '\n') {
+        ++offset;
+      }
+    } else if (isspace(static_cast<unsigned char>(source[offset]))) {
+      ++offset;
+    } else {
+      break;
+    }
+  }
+  return offset;
+}
+
+static bool readPpmNumber(const std::vector<char> &source, size_t &offset, uint32_t &value) {
+  offset = skipPpmSpace(source, offset);
+  if (offset >= source.size() || !isdigit(static_cast<unsigned char>(source[offset]))) {
+    return false;
+  }
+  value = 0;
+  for (; offset < source.size() && isdigit(static_cast<unsigned char>(source[offset])); ++offset) {
+    value = value * 10 + (source[offset] - '0');
+  }
+  return true;
+}
+
+/**
+ * Decodes a binary PPM (P6, 8 bit) or an uncompressed true color TGA into RGBA8, top row first.
+ */
+static bool decodeImage(const std::filesystem::path &path, const std::vector<char> &source, uint32_t &width,
+                        uint32_t &height, std::vector<uint8_t> &rgba) {
+  const auto *bytes = reinterpret_cast<const uint8_t *>(source.data());
+  if (path.extension() == ".ppm") {
+    size_t offset = 2;
+    uint32_t maxValue = 0;
+    if (source.size() < 2 || source[0] != 'P' || source[1] != '6' || !readPpmNumber(source, offset, width) ||
+        !readPpmNumber(source, offset, height) || !readPpmNumber(source, offset, maxValue) || maxValue != 255) {
+      return false;
+    }
+    ++offset; // the single whitespace before the pixels
+    if (width == 0 || height == 0 || (source.size() - std::min(offset, source.size())) / 3 / width < height) {
+      return false;
+    }
+    rgba.resize(static_cast<size_t>(width) * height * 4);
+    for (size_t i = 0; i < static_cast<size_t>(width) * height; ++i) {
+      memcpy(&rgba[i * 4], bytes + offset + i * 3, 3);
+      rgba[i * 4 + 3] = 255;
+    }
+    return true;
+  }
+  // TGA: 18 byte header, image type 2 is uncompressed true color
+  if (source.size() < 18 || bytes[2] != 2 || (bytes[16] != 24 && bytes[16] != 32)) {
+    return false;
+  }
+  width = bytes[12] | bytes[13] << 8;
+  height = bytes[14] | bytes[15] << 8;
+  const uint32_t pixelSize = bytes[16] / 8;
+  const bool topFirst = (bytes[17] & 0x20) != 0;
+  const size_t offset = 18 + bytes[0] + (bytes[1] != 0 ? (bytes[5] | bytes[6] << 8) * ((bytes[7] + 7) / 8) : 0);
+  if (width == 0 || height == 0 || source.size() < offset + static_cast<size_t>(width) * height * pixelSize) {
+    return false;
+  }
+  rgba.resize(static_cast<size_t>(width) * height * 4);
+  for (uint32_t y = 0; y < height; ++y) {
+    const uint8_t *row = bytes + offset + static_cast<size_t>(topFirst ? y : height - 1 - y) * width * pixelSize;
+    for (uint32_t x = 0; x < width; ++x) {
+      const uint8_t *bgra = row + x * pixelSize;
+      uint8_t *pixel = &rgba[(static_cast<size_t>(y) * width + x) * 4];
+      pixel[0] = bgra[2];
+      pixel[1] = bgra[1];
+      pixel[2] = bgra[0];
+      pixel[3] = pixelSize == 4 ? bgra[3] : 255;
+    }
+  }
+  return true;
+}
+
+/**
+ * Decodes an image and appends its whole mip chain, each level a box filter of the previous one,
+ * so the runtime neither decodes nor blits.
+ */
+static bool cookTexture(const std::filesystem::path &path, const std::vector<char> &source, std::vector<char> &cooked) {
+  uint32_t width, height;
+  std::vector<uint8_t> level;
+  if (!decodeImage(path, source, width, height, level)) {
+    return false;
+  }
+  CookedTexture texture{{'T', 'E', 'X', '1'}, width, height, 1, FORMAT_R8G8B8A8_UNORM};
+  for (uint32_t size = std::max(width, height); size > 1; size /= 2) {
+    texture.mipLevels++;
+  }
+  const auto *header = reinterpret_cast<const char *>(&texture);
+  cooked.assign(header, header + sizeof(texture));
+  for (uint32_t mip = 0; mip < texture.mipLevels; ++mip) {
+    cooked.insert(cooked.end(), level.begin(), level.end());
+    if (mip + 1 == texture.mipLevels) {
+      break;
+    }
+    const uint32_t nextWidth = std::max(width / 2, 1u);
+    const uint32_t nextHeight = std::max(height / 2, 1u);
+    std::vector<uint8_t> next(static_cast<size_t>(nextWidth) * nextHeight * 4);
+    for (uint32_t y = 0; y < nextHeight; ++y) {
+      for (uint32_t x = 0; x < nextWidth; ++x) {
+        // the 2x2 texels below, clamped at the edge of odd sizes
+        const uint32_t x0 = std::min(x * 2, width - 1), x1 = std::min(x * 2 + 1, width - 1);
+        const uint32_t y0 = std::min(y * 2, height - 1), y1 = std::min(y * 2 + 1, height - 1);
+        for (uint32_t c = 0; c < 4; ++c) {
+          const uint32_t sum = level[(static_cast<size_t>(y0) * width + x0) * 4 + c] +
+                               level[(static_cast<size_t>(y0) * width + x1) * 4 + c] +
+                               level[(static_cast<size_t>(y1) * width + x0) * 4 + c] +
+                               level[(static_cast<size_t>(y1) * width + x1) * 4 + c];
+          next[(static_cast<size_t>(y) * nextWidth + x) * 4 + c] = static_cast<uint8_t>((sum + 2) / 4);
+        }
+      }
+    }
+    level.swap(next);
+    width = nextWidth;
+    height = nextHeight;
+  }
+  return true;
+}
+
+/**
+ * The type and archive name of a source file, nothing for files that aren't assets. Meshes and
+ * images are stored under the name of what they are cooked into.
+ */
+static bool classifySource(const std::string &relativePath, AssetType &type, std::string &name) {
+  const std::filesystem::path path(relativePath);
+  const std::string extension = path.extension().string();
+  name = relativePath;
+  if (extension == ".spv") {
+    type = ASSET_SHADER;
+  } else if (extension == ".obj") {
+    type = ASSET_MESH;
+    name = std::filesystem::path(relativePath).replace_extension(".lod").generic_string();
+  } else if (extension == ".ppm" || extension == ".tga") {
+    type = ASSET_TEXTURE;
+    name = std::filesystem::path(relativePath).replace_extension(".tex").generic_string();
+  } else {
+    return false;
+  }
+  return true;
+}
+
+/**
+ * Cooks a source and packs it with LZ4, unless that saves less than a sixteenth.
+ */
+static bool cookAsset(const std::filesystem::path &path, AssetType type, const std::vector<char> &source,
+                      CookedAsset &asset) {
+  std::vector<char> cooked;
+  bool valid;
+  switch (type) {
+    case ASSET_SHADER:
+      valid = cookShader(source, cooked);
+      break;
+    case ASSET_MESH:
+      valid = cookMesh(path, cooked);
+      break;
+    case ASSET_TEXTURE:
+      valid = cookTexture(path, source, cooked);
+      break;
+    default:
+      cooked = source;
+      valid = true;
+  }
+  if (!valid) {
+    std::cerr << "Unable to cook " << path.string() << std::endl;
+    return false;
+  }
+  asset.entry.contentHash = hashAsset(cooked.data(), cooked.size());
+  asset.entry.size = cooked.size();
+  asset.entry.type = type;
+  const auto *bytes = reinterpret_cast<const uint8_t *>(cooked.data());
+  compressLz4(bytes, cooked.size(), asset.packed);
+  if (asset.packed.size() < cooked.size() - cooked.size() / 16) {
+    asset.entry.compression = ASSET_COMPRESSION_LZ4;
+  } else {
+    asset.packed.assign(bytes, bytes + cooked.size());
+    asset.entry.compression = ASSET_COMPRESSION_NONE;
+  }
+  asset.entry.packedSize = asset.packed.size();
+  return true;
+}
+
+/**
+ * Writes the archive next to the output and renames it over the output once complete, so an
+ * interrupted cook leaves the previous archive intact.
+ */
+static bool writeArchive(const std::string &output, std::vector<CookedAsset> &assets) {
+  AssetArchiveHeader header{};
+  memcpy(header.magic, ASSET_ARCHIVE_MAGIC, sizeof(ASSET_ARCHIVE_MAGIC));
+  header.version = ASSET_ARCHIVE_VERSION;
+  header.entryCount = static_cast<uint32_t>(assets.size());
+  header.slotCount = 1;
+  while (header.slotCount < header.entryCount * 2 + 1) {
+    header.slotCount *= 2;
+  }
+
+  std::string names;
+  std::vector<AssetEntry> entries;
+  std::vector<uint32_t> slots(header.slotCount, ASSET_NO_ENTRY);
+  uint64_t offset = sizeof(AssetArchiveHeader);
+  for (auto &asset : assets) {
+    asset.entry.offset = offset;
+    asset.entry.nameOffset = static_cast<uint32_t>(names.size());
+    asset.entry.nameLength = static_cast<uint32_t>(asset.name.size());
+    names += asset.name;
+    offset += asset.packed.size();
+    uint32_t slot = static_cast<uint32_t>(asset.entry.nameHash) & (header.slotCount - 1);
+    while (slots[slot] != ASSET_NO_ENTRY) {
+      slot = (slot + 1) & (header.slotCount - 1);
+    }
+    slots[slot] = static_cast<uint32_t>(entries.size());
+    entries.push_back(asset.entry);
+  }
+  const uint64_t padding = (8 - offset % 8) % 8;
+  header.tableOffset = offset + padding;
+  header.namesSize = names.size();
+
+  const std::string temporary = output + ".tmp";
+  std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+  if (!file.is_open()) {
+    std::cerr << "Failed to create " << temporary << std::endl;
+    return false;
+  }
+  const char zeros[8] = {};
+  file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+  for (const auto &asset : assets) {
+    file.write(reinterpret_cast<const char *>(asset.packed.data()), static_cast<std::streamsize>(asset.packed.size()));
+  }
+  file.write(zeros, static_cast<std::streamsize>(padding));
+  file.write(reinterpret_cast<const char *>(entries.data()), static_cast<std::streamsize>(sizeof(AssetEntry) * entries.size()));
+  file.write(reinterpret_cast<const char *>(slots.data()), static_cast<std::streamsize>(sizeof(uint32_t) * slots.size()));
+  file.write(names.data(), static_cast<std::streamsize>(names.size()));
+  file.close();
+  if (!file) {
+    std::cerr << "Failed to write " << temporary << std::endl;
+    return false;
+  }
+  std::error_code error;
+  std::filesystem::rename(temporary, output, error);
+  if (error) {
+    std::cerr << "Failed to replace " << output << ": " << error.message() << std::endl;
+    return false;
+  }
+  return true;
+}
+
+/**
+ * Cooks every shader, mesh and image below the given directories of the root into one archive.
+ * An asset whose source hashes to the same as in the previous archive is copied over packed as
+ * it was instead of being cooked again.
+ *
+ * Usage: AssetCooker OUTPUT ROOT [DIRECTORY...]
+ * e.g. AssetCooker assets.pak .. shaders meshes textures, after which --assets assets.pak reads
+ * ../shaders/vert.spv from the archive.
+ */
+int main(int argc, char **argv) {
+  if (argc < 3) {
+    std::cout << "Usage: " << argv[0] << " OUTPUT ROOT [DIRECTORY...]" << std::endl
+              << "  cooks the shaders (.spv), meshes (.obj) and images (.ppm, .tga) below the directories of ROOT," << std::endl
+              << "  all of ROOT by default, into the archive OUTPUT, recooking only what changed since it was written" << std::endl;
+    return 1;
+  }
+  auto start = std::chrono::steady_clock::now();
+  const std::string output = argv[1];
+  const std::filesystem::path root = argv[2];
+  std::vector<std::filesystem::path> directories;
+  for (int i = 3; i < argc; ++i) {
+    directories.push_back(root / argv[i]);
+  }
+  if (directories.empty()) {
+    directories.push_back(root);
+  }
+
+  AssetArchive previous;
+  std::unordered_map<uint64_t, const AssetEntry *> previousEntries;
+  if (std::filesystem::exists(output) && openAssetArchive(output, previous)) {
+    for (uint32_t i = 0; i < previous.header->entryCount; ++i) {
+      previousEntries[previous.entries[i].nameHash] = &previous.entries[i];
+    }
+  }
+
+  std::vector<std::pair<std::string, AssetType>> sources; // path relative to the root
+  for (const auto &directory : directories) {
+    std::error_code error;
+    for (std::filesystem::recursive_directory_iterator it(directory, error), end; !error && it != end; it.increment(error)) {
+      AssetType type;
+      std::string name;
+      const std::string relativePath = std::filesystem::relative(it->path(), root).generic_string();
+      if (it->is_regular_file() && classifySource(relativePath, type, name)) {
+        sources.emplace_back(relativePath, type);
+      }
+    }
+    if (error) {
+      std::cerr << "Failed to list " << directory.string() << ": " << error.message() << std::endl;
+      return 1;
+    }
+  }
+  std::sort(sources.begin(), sources.end()); // the same sources give the same archive
+
+  std::vector<CookedAsset> assets;
+  std::unordered_map<uint64_t, std::string> namesByHash;
+  uint64_t cookedSize = 0, packedSize = 0;
+  uint32_t reused = 0;
+  for (const auto &source : sources) {
+    CookedAsset asset;
+    AssetType type;
+    classifySource(source.first, type, asset.name);
+    asset.entry.nameHash = hashAsset(asset.name.data(), asset.name.size());
+    auto duplicate = namesByHash.emplace(asset.entry.nameHash, source.first);
+    if (!duplicate.second) {
+      // the archive looks names up by their hash, so two different names with the same one can't be told apart either
+      std::cerr << source.first << " and " << duplicate.first->second << " cook into names with the same hash" << std::endl;
+      return 1;
+    }
+    std::vector<char> content;
+    if (!readFile(root / source.first, content)) {
+      return 1;
+    }
+    asset.entry.sourceHash = hashAsset(content.data(), content.size(), ASSET_COOK_VERSION);
+
+    auto old = previousEntries.find(asset.entry.nameHash);
+    if (old != previousEntries.end() && old->second->sourceHash == asset.entry.sourceHash) {
+      asset.entry = *old->second;
+      const uint8_t *packed = previous.data.data() + asset.entry.offset;
+      asset.packed.assign(packed, packed + asset.entry.packedSize);
+      asset.reused = true;
+      reused++;
+    } else if (!cookAsset(root / source.first, type, content, asset)) {
+      return 1;
+    }
+    cookedSize += asset.entry.size;
+    packedSize += asset.entry.packedSize;
+    assets.push_back(std::move(asset));
+  }
+
+  if (!writeArchive(output, assets)) {
+    return 1;
+  }
+  std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+  for (const auto &asset : assets) {
+    if (!asset.reused) {
+      std::cout << "  cooked " << asset.name << ": " << asset.entry.size << " bytes, " << asset.entry.packedSize
+                << (asset.entry.compression == ASSET_COMPRESSION_LZ4 ? " with LZ4" : " stored") << std::endl;
+    }
+  }
+  std::cout << std::fixed << std::setprecision(1) << output << ": " << assets.size() << " assets, "
+            << assets.size() - reused << " cooked, " << reused << " unchanged, " << cookedSize / 1024.0 << " KiB packed into "
+            << packedSize / 1024.0 << " KiB in " << elapsed.count() << " ms" << std::endl;
+  return 0;
+}
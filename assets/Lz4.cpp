@@ -0,0 +1,149 @@
+#include <cstring>
+#include "Lz4.h"
+
+// https://github.com/lz4/lz4/blob/dev/doc/lz4_Block_format.md
+const size_t LZ4_MIN_MATCH = 4;
+const size_t LZ4_LAST_LITERALS = 5; // the block always ends with that many literals
+const size_t LZ4_MATCH_LIMIT = 12; // the last match starts at least that far from the end
+const size_t LZ4_MAX_OFFSET = 65535;
+const uint32_t LZ4_HASH_BITS = 16;
+
+static inline uint32_t read32(const uint8_t *data) {
+  uint32_t value;
+  memcpy(&value, data, sizeof(value));
+  return value;
+}
+
+static void writeLength(size_t length, std::vector<uint8_t> &output) {
+  for (; length >= 255; length -= 255) {
+    output.push_back(255);
+  }
+  output.push_back(static_cast<uint8_t>(length));
+}
+
+/**
+ * Appends a sequence: the literals since the last match, then the match unless matchLength is 0,
+ * which ends the block.
+ */
+static void writeSequence(const uint8_t *literals, size_t literalLength, size_t offset, size_t matchLength,
+                          std::vector<uint8_t> &output) {
+  const size_t matchCode = matchLength > 0 ? matchLength - LZ4_MIN_MATCH : 0;
+  output.push_back(static_cast<uint8_t>((literalLength < 15 ? literalLength : 15) << 4 | (matchCode < 15 ? matchCode : 15)));
+  if (literalLength >= 15) {
+    writeLength(literalLength - 15, output);
+  }
+  output.insert(output.end(), literals, literals + literalLength);
+  if (matchLength == 0) {
+    return;
+  }
+  output.push_back(static_cast<uint8_t>(offset & 0xFF));
+  output.push_back(static_cast<uint8_t>(offset >> 8));
+  if (matchCode >= 15) {
+    writeLength(matchCode - 15, output);
+  }
+}
+
+/**
+ * Compresses the input into a single LZ4 block, readable by LZ4_decompress_safe. Greedy matching
+ * through a hash table of the last position of every 4 byte sequence, which is fast and good
+ * enough for data that is cooked once and read many times.
+ *
+ * @param input
+ * @param size
+ * @param output replaced by the block
+ */
+void compressLz4(const uint8_t *input, size_t size, std::vector<uint8_t> &output) {
+  output.clear();
+  output.reserve(size + size / 255 + 16);
+  std::vector<uint32_t> table(size_t(1) << LZ4_HASH_BITS, 0); // position + 1 of the last sequence with the hash
+  size_t anchor = 0;
+  if (size > LZ4_MATCH_LIMIT) {
+    const size_t matchStartLimit = size - LZ4_MATCH_LIMIT;
+    const size_t matchEndLimit = size - LZ4_LAST_LITERALS;
+    size_t position = 0;
+    while (position < matchStartLimit) {
+      const uint32_t sequence = read32(input + position);
+      const uint32_t hash = (sequence * 2654435761u) >> (32 - LZ4_HASH_BITS);
+      const size_t candidate = table[hash];
+      table[hash] = static_cast<uint32_t>(position + 1);
+      if (candidate == 0 || position - (candidate - 1) > LZ4_MAX_OFFSET || read32(input + candidate - 1) != sequence) {
+        ++position;
+        continue;
+      }
+      const size_t match = candidate - 1;
+      size_t length = LZ4_MIN_MATCH;
+      while (position + length < matchEndLimit && input[match + length] == input[position + length]) {
+        ++length;
+      }
+      writeSequence(input + anchor, position - anchor, position - match, length, output);
+      position += length;
+      anchor = position;
+    }
+  }
+  writeSequence(input + anchor, size - anchor, 0, 0, output);
+}
+
+static bool readLength(const uint8_t *input, size_t packedSize, size_t &position, size_t &length) {
+  uint8_t byte;
+  do {
+    if (position >= packedSize) {
+      return false;
+    }
+    byte = input[position++];
+    length += byte;
+  } while (byte == 255);
+  return true;
+}
+
+/**
+ * Decompresses an LZ4 block of known decompressed size. Never reads or writes out of bounds,
+ * whatever the input.
+ *
+ * @param input
+ * @param packedSize
+ * @param output
+ * @param size of the decompressed data
+ * @return false if the block is corrupt or doesn't decompress to exactly size bytes
+ */
+bool decompressLz4(const uint8_t *input, size_t packedSize, uint8_t *output, size_t size) {
+  size_t in = 0, out = 0;
+  while (in < packedSize) {
+    const uint8_t token = input[in++];
+    size_t literalLength = token >> 4;
+    if (literalLength == 15 && !readLength(input, packedSize, in, literalLength)) {
+      return false;
+    }
+    if (literalLength > packedSize - in || literalLength > size - out) {
+      return false;
+    }
+    memcpy(output + out, input + in, literalLength);
+    in += literalLength;
+    out += literalLength;
+    if (in == packedSize) {
+      break; // the last sequence has no match
+    }
+    if (packedSize - in < 2) {
+      return false;
+    }
+    const size_t offset = input[in] | static_cast<size_t>(input[in + 1]) << 8;
+    in += 2;
+    size_t matchLength = token & 15;
+    if (matchLength == 15 && !readLength(input, packedSize, in, matchLength)) {
+      return false;
+    }
+    matchLength += LZ4_MIN_MATCH;
+    if (offset == 0 || offset > out || matchLength > size - out) {
+      return false;
+    }
+    const uint8_t *match = output + out - offset;
+    if (offset >= matchLength) {
+      memcpy(output + out, match, matchLength);
+    } else {
+      for (size_t i = 0; i < matchLength; ++i) { // overlapping, repeats the last offset bytes
+        output[out + i] = match[i];
+      }
+    }
+    out += matchLength;
+  }
+  return out == size;
+}
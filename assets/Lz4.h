@@ -0,0 +1,10 @@
+#ifndef VULKANDEMO_LZ4_H
+#define VULKANDEMO_LZ4_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+void compressLz4(const uint8_t *input, size_t size, std::vector<uint8_t> &output);
+bool decompressLz4(const uint8_t *input, size_t packedSize, uint8_t *output, size_t size);
+#endif //VULKANDEMO_LZ4_H
@@ -0,0 +1,114 @@
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <algorithm>
+#include "DispatchBenchmark.h"
+#include "../validation/validation.h"
+
+const uint32_t COMMANDS_PER_BUFFER = 100000; // keeps the command buffer memory bounded, the pool is reset in between
+const uint32_t BENCHMARK_ROUNDS = 3;
+
+/**
+ * Records the given number of vkCmdSetViewport calls through the given entry point and returns the
+ * elapsed CPU time in milliseconds. Nothing is submitted, only the recording cost is measured.
+ * Dynamic state commands are valid outside a render pass so no render target is needed.
+ *
+ * @param app
+ * @param commandPool
+ * @param commandBuffer
+ * @param setViewport
+ * @param commandCount
+ * @param milliseconds
+ * @return
+ */
+static VkResult timeRecording(Application &app, VkCommandPool commandPool, VkCommandBuffer commandBuffer,
+                              PFN_vkCmdSetViewport setViewport, uint64_t commandCount, double &milliseconds) {
+  VkCommandBufferBeginInfo beginInfo{};
+  beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+  beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+  VkViewport viewport{0.0f, 0.0f, (float) app.swapChainExtent.width, (float) app.swapChainExtent.height, 0.0f, 1.0f};
+
+  auto start = std::chrono::steady_clock::now();
+  for (uint64_t recorded = 0; recorded < commandCount; recorded += COMMANDS_PER_BUFFER) {
+    VkResult errorCode = vkBeginCommandBuffer(commandBuffer, &beginInfo);
+    returnOnError(errorCode)
+    uint64_t count = std::min<uint64_t>(COMMANDS_PER_BUFFER, commandCount - recorded);
+    for (uint64_t i = 0; i < count; ++i) {
+      viewport.x = static_cast<float>(i & 1); // keep the driver from skipping redundant state
+      setViewport(commandBuffer, 0, 1, &viewport);
+    }
+    errorCode = vkEndCommandBuffer(commandBuffer);
+    returnOnError(errorCode)
+    errorCode = vkResetCommandPool(app.device, commandPool, 0);
+    returnOnError(errorCode)
+  }
+  std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+  milliseconds = elapsed.count();
+  return VK_SUCCESS;
+}
+
+/**
+ * Compares recording through the loader trampoline, which is what vkGetInstanceProcAddr returns
+ * for device level commands and what the static vulkan-1.lib import used to call, against the
+ * pointer from vkGetDeviceProcAddr used by the dispatch table.
+ *
+ * @param app
+ * @return
+ */
+VkResult runDispatchBenchmark(Application &app) {
+  auto trampoline = reinterpret_cast<PFN_vkCmdSetViewport>(vkGetInstanceProcAddr(app.instance, "vkCmdSetViewport"));
+  if (trampoline == nullptr) {
+    std::cerr << "Unable to load the loader trampoline for vkCmdSetViewport" << std::endl;
+    return VK_ERROR_INITIALIZATION_FAILED;
+  }
+  if (enableValidationLayers) {
+    std::cout << "Validation layers are enabled, both entry points go through them so the difference will be small"
+              << std::endl;
+  }
+
+  // own pool so resetting it doesn't touch the command buffers of the render loop
+  VkCommandPool commandPool = VK_NULL_HANDLE;
+  VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+  VkCommandPoolCreateInfo poolInfo{};
+  poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+  poolInfo.queueFamilyIndex = app.physicalDevice.graphicsQueueFamilyIdx;
+  poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+  VkResult errorCode = vkCreateCommandPool(app.device, &poolInfo, nullptr, &commandPool);
+  throwOnError(errorCode, "Unable to create dispatch benchmark command pool")
+
+  VkCommandBufferAllocateInfo allocInfo{};
+  allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+  allocInfo.commandPool = commandPool;
+  allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+  allocInfo.commandBufferCount = 1;
+  errorCode = vkAllocateCommandBuffers(app.device, &allocInfo, &commandBuffer);
+  throwOnError(errorCode, "Unable to allocate dispatch benchmark command buffer")
+
+  {
+    const uint64_t commandCount = static_cast<uint64_t>(app.options.dispatchBenchmarkMillions) * 1000000ull;
+    double trampolineMs = 1e30, directMs = 1e30;
+    // interleave the two so frequency scaling affects both the same way, keep the best round
+    for (uint32_t round = 0; round < BENCHMARK_ROUNDS; ++round) {
+      double milliseconds;
+      errorCode = timeRecording(app, commandPool, commandBuffer, trampoline, commandCount, milliseconds);
+      throwOnError(errorCode, "Dispatch benchmark recording failed")
+      trampolineMs = std::min(trampolineMs, milliseconds);
+      errorCode = timeRecording(app, commandPool, commandBuffer, vkCmdSetViewport, commandCount, milliseconds);
+      throwOnError(errorCode, "Dispatch benchmark recording failed")
+      directMs = std::min(directMs, milliseconds);
+    }
+
+    const double trampolineNs = trampolineMs * 1e6 / commandCount;
+    const double directNs = directMs * 1e6 / commandCount;
+    std::cout << std::fixed << std::setprecision(2);
+    std::cout << "Recording " << app.options.dispatchBenchmarkMillions << "M vkCmdSetViewport calls" << std::endl
+              << "  loader trampoline: " << trampolineMs << " ms (" << trampolineNs << " ns/call)" << std::endl
+              << "  device dispatch:   " << directMs << " ms (" << directNs << " ns/call)" << std::endl
+              << "  saving " << trampolineNs - directNs << " ns/call ("
+              << 100.0 * (trampolineMs - directMs) / trampolineMs << "%)" << std::endl;
+  }
+
+  error:
+  vkDestroyCommandPool(app.device, commandPool, nullptr); // frees the command buffer as well
+  return errorCode;
+}
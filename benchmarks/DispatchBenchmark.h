@@ -0,0 +1,7 @@
+#ifndef VULKANDEMO_DISPATCHBENCHMARK_H
+#define VULKANDEMO_DISPATCHBENCHMARK_H
+
+#include "../Application.h"
+
+VkResult runDispatchBenchmark(Application &app);
+#endif //VULKANDEMO_DISPATCHBENCHMARK_H
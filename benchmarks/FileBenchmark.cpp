@@ -0,0 +1,170 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <thread>
+#include "FileBenchmark.h"
+#include "../assets/AssetArchive.h"
+#include "../vfs/FileSystem.h"
+
+const uint32_t FILE_BENCHMARK_ROUNDS = 7; // per configuration, the median is reported
+const size_t FILE_BENCHMARK_MIN_SIZE = 1024;
+const size_t FILE_BENCHMARK_MAX_SIZE = 16 * 1024;
+const size_t FILE_BENCHMARK_ALIGNMENT = 256; // of every file in the destination, like copies out of a staging buffer
+
+typedef struct FileConfiguration {
+    const char *name;
+    FileBackend backend;
+    uint32_t threads;
+    bool batched; // all reads in one submission, otherwise one submission per read
+} FileConfiguration;
+
+typedef struct BenchmarkFile {
+    std::string path;
+    size_t size;
+    size_t offset; // in the destination
+} BenchmarkFile;
+
+/**
+ * Writes fileCount files of random sizes and contents and lays them out in the destination.
+ *
+ * @return the size of the destination, 0 if a file couldn't be written
+ */
+static size_t generateFiles(const std::filesystem::path &directory, uint32_t fileCount, std::vector<BenchmarkFile> &files,
+                            std::vector<char> &expected) {
+  std::mt19937 random(42);
+  std::uniform_int_distribution<size_t> sizes(FILE_BENCHMARK_MIN_SIZE, FILE_BENCHMARK_MAX_SIZE);
+  size_t offset = 0;
+  for (uint32_t i = 0; i < fileCount; ++i) {
+    BenchmarkFile file{(directory / ("file" + std::to_string(i) + ".bin")).string(), sizes(random), offset};
+    offset = (offset + file.size + FILE_BENCHMARK_ALIGNMENT - 1) / FILE_BENCHMARK_ALIGNMENT * FILE_BENCHMARK_ALIGNMENT;
+    files.push_back(file);
+  }
+  expected.assign(offset, 0);
+  for (const auto &file : files) {
+    for (size_t i = 0; i < file.size; ++i) {
+      expected[file.offset + i] = static_cast<char>(random());
+    }
+    std::ofstream stream(file.path, std::ios::binary);
+    stream.write(expected.data() + file.offset, static_cast<std::streamsize>(file.size));
+    if (!stream.good()) {
+      std::cerr << "Failed to write " << file.path << std::endl;
+      return 0;
+    }
+  }
+  return offset;
+}
+
+static double median(std::vector<double> &values) {
+  std::nth_element(values.begin(), values.begin() + values.size() / 2, values.end());
+  return values[values.size() / 2];
+}
+
+/**
+ * Loads every file straight into its place in the destination, which stands in for mapped
+ * staging memory, and times it until the last callback ran.
+ *
+ * @return false if a read failed or the destination doesn't hold the files
+ */
+static bool runConfiguration(const FileConfiguration &configuration, const std::vector<BenchmarkFile> &files,
+                             const std::vector<char> &expected, uint64_t totalBytes) {
+  if (configuration.backend != FILE_BACKEND_NONE) {
+    startFileSystem(configuration.backend, configuration.threads);
+    if (fileSystemBackend() != configuration.backend) {
+      stopFileSystem();
+      std::cout << "  " << std::left << std::setw(28) << configuration.name << std::right << "not available" << std::endl;
+      return true;
+    }
+  }
+  std::vector<char> destination(expected.size());
+  std::atomic<uint32_t> failed{0};
+  std::vector<double> milliseconds;
+  for (uint32_t round = 0; round < FILE_BENCHMARK_ROUNDS; ++round) {
+    std::fill(destination.begin(), destination.end(), 0);
+    std::vector<FileRead> reads(files.size());
+    for (size_t i = 0; i < files.size(); ++i) {
+      reads[i].path = files[i].path;
+      reads[i].destination = destination.data() + files[i].offset;
+      reads[i].capacity = files[i].size;
+      reads[i].callback = [&failed](FileReadResult &result) {
+        if (!result.succeeded) {
+          failed++;
+        }
+      };
+    }
+    auto start = std::chrono::steady_clock::now();
+    if (configuration.batched) {
+      submitFileReads(reads);
+    } else {
+      for (auto &read : reads) {
+        std::vector<FileRead> single(1, std::move(read));
+        submitFileReads(single);
+      }
+    }
+    waitFileReads();
+    milliseconds.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+  }
+  stopFileSystem();
+
+  const double loadMs = median(milliseconds);
+  std::cout << "  " << std::left << std::setw(28) << configuration.name << std::right
+            << std::setw(9) << std::setprecision(2) << loadMs << " ms, "
+            << std::setw(10) << std::setprecision(0) << files.size() * 1000.0 / loadMs << " files/s, "
+            << std::setw(7) << std::setprecision(1) << totalBytes / (1024.0 * 1024.0) * 1000.0 / loadMs << " MiB/s" << std::endl;
+  if (failed > 0 || hashAsset(destination.data(), destination.size()) != hashAsset(expected.data(), expected.size())) {
+    std::cerr << configuration.name << ": " << failed << " reads failed or the loaded files differ" << std::endl;
+    return false;
+  }
+  return true;
+}
+
+/**
+ * Loads fileCount small files of 1 to 16 KiB through the blocking path on the calling thread, the
+ * thread pool and io_uring, each file read straight into its place in one large buffer. The files
+ * are written right before, so they are read from the page cache: this measures the overhead per
+ * request rather than the disk. Runs on the CPU only.
+ *
+ * @param fileCount
+ * @return
+ */
+int runFileBenchmark(uint32_t fileCount) {
+  std::error_code error;
+  const std::filesystem::path directory = std::filesystem::temp_directory_path(error) / "vulkandemo_io_bench";
+  std::filesystem::remove_all(directory, error);
+  if (!std::filesystem::create_directories(directory, error)) {
+    std::cerr << "Failed to create " << directory.string() << ": " << error.message() << std::endl;
+    return 1;
+  }
+  std::vector<BenchmarkFile> files;
+  std::vector<char> expected;
+  const size_t destinationSize = generateFiles(directory, fileCount, files, expected);
+  uint64_t totalBytes = 0;
+  for (const auto &file : files) {
+    totalBytes += file.size;
+  }
+  const uint32_t threads = std::max(1u, std::thread::hardware_concurrency());
+
+  bool succeeded = destinationSize > 0;
+  if (succeeded) {
+    std::cout << std::fixed << std::setprecision(1);
+    std::cout << "Loading " << fileCount << " files, " << totalBytes / (1024.0 * 1024.0) << " MiB into a "
+              << destinationSize / (1024.0 * 1024.0) << " MiB buffer" << std::endl;
+    const std::string poolName = "thread pool, " + std::to_string(threads) + " threads";
+    const FileConfiguration configurations[] = {
+        {"blocking, calling thread", FILE_BACKEND_NONE, 1, true},
+        {poolName.c_str(), FILE_BACKEND_THREAD_POOL, threads, true},
+        {"io_uring, read per submit", FILE_BACKEND_IO_URING, 1, false},
+        {"io_uring, one batch", FILE_BACKEND_IO_URING, 1, true}
+    };
+    for (const auto &configuration : configurations) {
+      succeeded = runConfiguration(configuration, files, expected, totalBytes) && succeeded;
+    }
+  }
+  std::filesystem::remove_all(directory, error);
+  return succeeded ? 0 : 1;
+}
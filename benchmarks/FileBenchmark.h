@@ -0,0 +1,7 @@
+#ifndef VULKANDEMO_FILEBENCHMARK_H
+#define VULKANDEMO_FILEBENCHMARK_H
+
+#include <cstdint>
+
+int runFileBenchmark(uint32_t fileCount);
+#endif //VULKANDEMO_FILEBENCHMARK_H
@@ -0,0 +1,134 @@
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+#include "LightingBenchmark.h"
+#include "OffscreenTarget.h"
+#include "../buffers/Vertex.h"
+#include "../pipeline/GraphicsPipeline.h"
+
+const uint32_t LIGHT_COUNTS[] = {64, 256, 1024, 4096, 16384};
+const uint32_t ALL_LIGHTS_LIMIT = 4096; // shading every light beyond that takes seconds per frame
+const uint32_t BENCHMARK_ITERATIONS = 20;
+
+// a single triangle that covers the whole viewport
+const std::vector<Vertex> litTriangle = {
+    {{-1.0f, -1.0f}, {0.8f, 0.8f, 0.8f}},
+    {{3.0f, -1.0f}, {0.8f, 0.8f, 0.8f}},
+    {{-1.0f, 3.0f}, {0.8f, 0.8f, 0.8f}}
+};
+
+typedef struct LightingScene {
+    VkBuffer vertexBuffer = VK_NULL_HANDLE;
+    VkDeviceMemory vertexMemory = VK_NULL_HANDLE;
+    VkPipeline clusteredPipeline = VK_NULL_HANDLE; // owned by the pipeline library
+    VkPipeline allLightsPipeline = VK_NULL_HANDLE;
+} LightingScene;
+
+static VkResult createScene(Application &app, LightingScene &scene) {
+  const VkDeviceSize size = sizeof(Vertex) * litTriangle.size();
+  VkResult errorCode = createBuffer(app, size, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+                                    VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                                    MEMORY_GEOMETRY, scene.vertexBuffer, scene.vertexMemory);
+  returnOnError(errorCode)
+  void *data;
+  errorCode = vkMapMemory(app.device, scene.vertexMemory, 0, size, 0, &data);
+  returnOnError(errorCode)
+  memcpy(data, litTriangle.data(), (size_t) size);
+  vkUnmapMemory(app.device, scene.vertexMemory);
+
+  PipelineKey key = clusteredPipelineKey(app);
+  key.cullMode = VK_CULL_MODE_NONE;
+  errorCode = acquirePipeline(app, key, scene.clusteredPipeline);
+  returnOnError(errorCode)
+  key.fragmentFeatures = FragmentVariant<true, LIGHTING_ALL_LIGHTS, 1>::features;
+  return acquirePipeline(app, key, scene.allLightsPipeline);
+}
+
+/**
+ * Records the binning pass if asked to, then shades the whole target with the given pipeline if
+ * there is one, and returns the average time of a submission.
+ */
+static VkResult timeLighting(Application &app, OffscreenTarget &target, LightingScene &scene, bool binning,
+                             VkPipeline pipeline, double &milliseconds) {
+  VkResult errorCode = beginOffscreenCommands(app, target);
+  returnOnError(errorCode)
+  if (binning) {
+    recordLightBinning(app, target.commandBuffer);
+  }
+  if (pipeline != VK_NULL_HANDLE) {
+    beginOffscreenRenderPass(app, target);
+    vkCmdBindPipeline(target.commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+    bindLightSet(app, target.commandBuffer);
+    VkDeviceSize offset = 0;
+    vkCmdBindVertexBuffers(target.commandBuffer, 0, 1, &scene.vertexBuffer, &offset);
+    vkCmdDraw(target.commandBuffer, static_cast<uint32_t>(litTriangle.size()), 1, 0, 0);
+    vkCmdEndRenderPass(target.commandBuffer);
+  }
+  errorCode = vkEndCommandBuffer(target.commandBuffer);
+  returnOnError(errorCode)
+  return timeOffscreenSubmission(app, target, BENCHMARK_ITERATIONS, milliseconds);
+}
+
+static void destroyScene(Application &app, LightingScene &scene) {
+  vkDestroyBuffer(app.device, scene.vertexBuffer, nullptr);
+  freeMemory(app, scene.vertexMemory);
+}
+
+/**
+ * Shades a full screen triangle with a growing number of the demo's point lights, once with the
+ * lights binned into clusters and once looping over every light, and reports the binning pass on
+ * its own, how many lights end up in a cluster and how the shading cost grows with the lights.
+ * The grid is rebuilt by every submission, as it would be every frame.
+ *
+ * @param app
+ * @return
+ */
+VkResult runLightingBenchmark(Application &app) {
+  OffscreenTarget target{};
+  LightingScene scene{};
+  const uint32_t frame = static_cast<uint32_t>(app.currentFrame);
+  destroyClusteredLighting(app); // in case --lights created a smaller ring
+  VkResult errorCode = createClusteredLighting(app, LIGHT_COUNTS[sizeof(LIGHT_COUNTS) / sizeof(LIGHT_COUNTS[0]) - 1]);
+  throwOnError(errorCode, "Unable to create clustered lighting for the benchmark")
+  errorCode = createOffscreenTarget(app, target);
+  throwOnError(errorCode, "Unable to create lighting benchmark target")
+  errorCode = createScene(app, scene);
+  throwOnError(errorCode, "Unable to create lighting benchmark scene")
+
+  std::cout << std::fixed << std::setprecision(2);
+  std::cout << "Clustered lighting at " << app.swapChainExtent.width << "x" << app.swapChainExtent.height << ", "
+            << CLUSTER_GRID_X << "x" << CLUSTER_GRID_Y << "x" << CLUSTER_GRID_Z << " clusters of up to "
+            << MAX_LIGHTS_PER_CLUSTER << " lights" << std::endl;
+  for (uint32_t lightCount : LIGHT_COUNTS) {
+    double binningMs = 0.0, clusteredMs = 0.0, allLightsMs = 0.0;
+    writeDemoLights(app, frame, app.swapChainExtent, lightCount, 0.0f);
+    errorCode = timeLighting(app, target, scene, true, VK_NULL_HANDLE, binningMs);
+    throwOnError(errorCode, "Lighting benchmark submission failed")
+    errorCode = timeLighting(app, target, scene, true, scene.clusteredPipeline, clusteredMs);
+    throwOnError(errorCode, "Lighting benchmark submission failed")
+    if (lightCount <= ALL_LIGHTS_LIMIT) {
+      errorCode = timeLighting(app, target, scene, false, scene.allLightsPipeline, allLightsMs);
+      throwOnError(errorCode, "Lighting benchmark submission failed")
+    }
+
+    const ClusterStats stats = getClusterStats(app, frame);
+    std::cout << "  " << std::setw(6) << lightCount << " lights: binning " << std::setw(7) << binningMs
+              << " ms, binning + clustered shading " << std::setw(7) << clusteredMs << " ms";
+    if (lightCount <= ALL_LIGHTS_LIMIT) {
+      std::cout << ", every light " << std::setw(8) << allLightsMs << " ms (" << allLightsMs / clusteredMs << "x)";
+    } else {
+      std::cout << ", every light skipped";
+    }
+    std::cout << std::endl << "          lights per cluster " << stats.averageLights << " on average, "
+              << stats.averageLitClusterLights << " in lit clusters, at most " << stats.maxLights << ", "
+              << stats.emptyClusters << " clusters empty, " << stats.overflowingClusters << " over the limit" << std::endl;
+  }
+
+  error:
+  vkDeviceWaitIdle(app.device);
+  destroyScene(app, scene);
+  destroyOffscreenTarget(app, target);
+  destroyClusteredLighting(app);
+  return errorCode;
+}
@@ -0,0 +1,7 @@
+#ifndef VULKANDEMO_LIGHTINGBENCHMARK_H
+#define VULKANDEMO_LIGHTINGBENCHMARK_H
+
+#include "../Application.h"
+
+VkResult runLightingBenchmark(Application &app);
+#endif //VULKANDEMO_LIGHTINGBENCHMARK_H
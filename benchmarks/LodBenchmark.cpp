@@ -0,0 +1,57 @@
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include "LodBenchmark.h"
+#include "../mesh/MeshLod.h"
+
+const uint32_t BENCHMARK_SUBDIVISIONS = 6; // 81920 triangles at full detail
+const float BENCHMARK_ERROR_PIXELS = 1.0f;
+const float BENCHMARK_SCREEN_HEIGHT = 1080.0f;
+const float BENCHMARK_FOV_Y = 1.0471976f; // 60 degrees
+
+static void printSelection(const LodMesh &mesh, float pixelsPerUnit) {
+  const uint32_t lod = selectLod(mesh, pixelsPerUnit, BENCHMARK_ERROR_PIXELS);
+  const uint32_t triangles = mesh.lods[lod].indexCount / 3;
+  std::cout << "LOD " << lod << ", " << std::setw(6) << triangles << " triangles ("
+            << std::setw(6) << 100.0 * triangles / (mesh.lods[0].indexCount / 3) << "% of full detail), error "
+            << std::setw(5) << mesh.lods[lod].error * pixelsPerUnit << " px" << std::endl;
+}
+
+/**
+ * Times building the LOD chain of a generated asteroid and shows which LOD the selection picks
+ * at a range of on-screen sizes and camera distances, with the triangles it saves and the error
+ * it projects onto the screen. Runs on the CPU only.
+ *
+ * @return
+ */
+int runLodBenchmark() {
+  LodMesh mesh;
+  generateAsteroid(BENCHMARK_SUBDIVISIONS, mesh);
+  auto start = std::chrono::steady_clock::now();
+  buildMeshLods(mesh);
+  std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+
+  std::cout << std::fixed << std::setprecision(2);
+  std::cout << "Simplified " << mesh.positions.size() << " vertices, " << mesh.lods[0].indexCount / 3
+            << " triangles into " << mesh.lods.size() << " LODs in " << elapsed.count() << " ms" << std::endl;
+  for (size_t lod = 0; lod < mesh.lods.size(); ++lod) {
+    std::cout << "  LOD " << lod << ": " << std::setw(6) << mesh.lods[lod].indexCount / 3 << " triangles, error "
+              << std::setprecision(5) << mesh.lods[lod].error / mesh.radius << std::setprecision(2)
+              << " of the radius" << std::endl;
+  }
+
+  std::cout << "Selection by on-screen radius, " << BENCHMARK_ERROR_PIXELS << " px error budget" << std::endl;
+  for (float radiusPixels = 1024.0f; radiusPixels >= 2.0f; radiusPixels *= 0.5f) {
+    std::cout << "  " << std::setw(7) << radiusPixels << " px: ";
+    printSelection(mesh, radiusPixels / mesh.radius);
+  }
+
+  std::cout << "Selection by distance, " << BENCHMARK_SCREEN_HEIGHT << " px high screen, 60 degree field of view"
+            << std::endl;
+  for (float distance = 1.5f; distance <= 800.0f; distance *= 2.0f) {
+    std::cout << "  " << std::setw(7) << distance << " radii: ";
+    printSelection(mesh, perspectivePixelsPerUnit(distance * mesh.radius, BENCHMARK_FOV_Y, BENCHMARK_SCREEN_HEIGHT));
+  }
+  return 0;
+}
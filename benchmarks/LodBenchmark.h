@@ -0,0 +1,5 @@
+#ifndef VULKANDEMO_LODBENCHMARK_H
+#define VULKANDEMO_LODBENCHMARK_H
+
+int runLodBenchmark();
+#endif //VULKANDEMO_LODBENCHMARK_H
@@ -0,0 +1,317 @@
+#include <algorithm>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include "OcclusionBenchmark.h"
+#include "OffscreenTarget.h"
+#include "../buffers/Image.h"
+#include "../culling/OcclusionCulling.h"
+#include "../mesh/MeshLod.h"
+#include "../pipeline/Compute.h"
+#include "../pipeline/GraphicsPipeline.h"
+
+const uint32_t OBJECT_SUBDIVISIONS = 3; // 1280 triangles per object
+const uint32_t SCATTERED_OBJECTS = 16384;
+const uint32_t OCCLUDER_COLUMNS = 4;
+const uint32_t OCCLUDER_ROWS = 2;
+const uint32_t BENCHMARK_ITERATIONS = 20;
+const VkFormat DEPTH_FORMAT = VK_FORMAT_D32_SFLOAT;
+
+/**
+ * A wall of large rocks close to the camera with a crowd of small ones behind it, most of which
+ * are hidden, drawn into the offscreen target with a depth buffer.
+ */
+typedef struct OcclusionScene {
+    VkImage depthImage = VK_NULL_HANDLE;
+    VkDeviceMemory depthMemory = VK_NULL_HANDLE;
+    VkImageView depthView = VK_NULL_HANDLE;
+    VkRenderPass earlyPass = VK_NULL_HANDLE; // clears
+    VkRenderPass latePass = VK_NULL_HANDLE; // keeps what the early pass drew
+    VkFramebuffer framebuffer = VK_NULL_HANDLE;
+    VkBuffer vertexBuffer = VK_NULL_HANDLE;
+    VkDeviceMemory vertexMemory = VK_NULL_HANDLE;
+    VkBuffer indexBuffer = VK_NULL_HANDLE;
+    VkDeviceMemory indexMemory = VK_NULL_HANDLE;
+    uint32_t indexCount = 0;
+    VkPipeline pipeline = VK_NULL_HANDLE;
+    std::vector<ObjectInstance> objects;
+} OcclusionScene;
+
+/**
+ * The occluders come first, so the early phase of the very first frame, which has no depth
+ * pyramid to test against yet, at least draws them.
+ */
+static void placeObjects(OcclusionScene &scene) {
+  for (uint32_t row = 0; row < OCCLUDER_ROWS; ++row) {
+    for (uint32_t column = 0; column < OCCLUDER_COLUMNS; ++column) {
+      const float x = (column + 0.5f) / OCCLUDER_COLUMNS * 2.0f - 1.0f;
+      const float y = (row + 0.5f) / OCCLUDER_ROWS * 2.0f - 1.0f;
+      scene.objects.push_back({glm::vec4(x, y, 0.62f, 0.05f)});
+    }
+  }
+  uint32_t state = 7;
+  for (uint32_t i = 0; i < SCATTERED_OBJECTS; ++i) {
+    const float x = randomUnit(state) * 2.0f - 1.0f, y = randomUnit(state) * 2.0f - 1.0f;
+    const float radius = 0.01f + 0.03f * randomUnit(state);
+    scene.objects.push_back({glm::vec4(x, y, radius, 0.2f + 0.75f * randomUnit(state))});
+  }
+}
+
+static VkResult uploadMesh(Application &app, OcclusionScene &scene) {
+  LodMesh mesh;
+  generateAsteroid(OBJECT_SUBDIVISIONS, mesh);
+  const glm::vec3 light = glm::normalize(glm::vec3(-0.4f, -0.5f, -0.77f));
+  std::vector<Vertex> meshVertices(mesh.positions.size());
+  for (size_t i = 0; i < meshVertices.size(); ++i) {
+    const glm::vec3 position = mesh.positions[i] * (1.0f / mesh.radius); // the instances' bounds assume a radius of 1
+    const float shade = 0.15f + 0.85f * std::max(glm::dot(mesh.normals[i], light), 0.0f);
+    meshVertices[i] = {{position.x, position.y}, glm::vec3(0.6f, 0.55f, 0.5f) * shade};
+  }
+  scene.indexCount = static_cast<uint32_t>(mesh.indices.size());
+
+  const VkDeviceSize vertexSize = sizeof(Vertex) * meshVertices.size();
+  VkResult errorCode = createBuffer(app, vertexSize, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+                                    VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                                    MEMORY_GEOMETRY, scene.vertexBuffer, scene.vertexMemory);
+  returnOnError(errorCode)
+  void *data;
+  errorCode = vkMapMemory(app.device, scene.vertexMemory, 0, vertexSize, 0, &data);
+  returnOnError(errorCode)
+  memcpy(data, meshVertices.data(), (size_t) vertexSize);
+  vkUnmapMemory(app.device, scene.vertexMemory);
+
+  const VkDeviceSize indexSize = sizeof(uint32_t) * mesh.indices.size();
+  errorCode = createBuffer(app, indexSize, VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
+                           VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                           MEMORY_GEOMETRY, scene.indexBuffer, scene.indexMemory);
+  returnOnError(errorCode)
+  errorCode = vkMapMemory(app.device, scene.indexMemory, 0, indexSize, 0, &data);
+  returnOnError(errorCode)
+  memcpy(data, mesh.indices.data(), (size_t) indexSize);
+  vkUnmapMemory(app.device, scene.indexMemory);
+  return VK_SUCCESS;
+}
+
+/**
+ * Both passes leave the depth buffer read only for the depth pyramid. The late pass loads what
+ * the early pass drew and only adds the objects the late culling phase found.
+ */
+static VkResult createScenePass(Application &app, VkAttachmentLoadOp loadOp, VkRenderPass &renderPass) {
+  const bool load = loadOp == VK_ATTACHMENT_LOAD_OP_LOAD;
+  VkAttachmentDescription attachments[2]{};
+  attachments[0].format = app.imageFormat;
+  attachments[0].samples = VK_SAMPLE_COUNT_1_BIT;
+  attachments[0].loadOp = loadOp;
+  attachments[0].storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+  attachments[0].stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+  attachments[0].stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+  attachments[0].initialLayout = load ? VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL : VK_IMAGE_LAYOUT_UNDEFINED;
+  attachments[0].finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+  attachments[1] = attachments[0];
+  attachments[1].format = DEPTH_FORMAT;
+  attachments[1].initialLayout = load ? VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL : VK_IMAGE_LAYOUT_UNDEFINED;
+  attachments[1].finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+  VkAttachmentReference colorAttachmentRef{0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL};
+  VkAttachmentReference depthAttachmentRef{1, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL};
+  VkSubpassDescription subpass{};
+  subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+  subpass.colorAttachmentCount = 1;
+  subpass.pColorAttachments = &colorAttachmentRef;
+  subpass.pDepthStencilAttachment = &depthAttachmentRef;
+
+  VkSubpassDependency dependencies[2]{};
+  // the depth pyramid of the previous pass or frame is done reading the depth buffer
+  dependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
+  dependencies[0].dstSubpass = 0;
+  dependencies[0].srcStageMask = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+  dependencies[0].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+  dependencies[0].dstStageMask = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT |
+                                 VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+  dependencies[0].dstAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT |
+                                  VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+  // and the depth pyramid built afterwards reads what this pass wrote
+  dependencies[1].srcSubpass = 0;
+  dependencies[1].dstSubpass = VK_SUBPASS_EXTERNAL;
+  dependencies[1].srcStageMask = VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+  dependencies[1].srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+  dependencies[1].dstStageMask = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+  dependencies[1].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+
+  VkRenderPassCreateInfo renderPassInfo{};
+  renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+  renderPassInfo.attachmentCount = 2;
+  renderPassInfo.pAttachments = attachments;
+  renderPassInfo.subpassCount = 1;
+  renderPassInfo.pSubpasses = &subpass;
+  renderPassInfo.dependencyCount = 2;
+  renderPassInfo.pDependencies = dependencies;
+  return vkCreateRenderPass(app.device, &renderPassInfo, nullptr, &renderPass);
+}
+
+static VkResult createScene(Application &app, OffscreenTarget &target, OcclusionScene &scene) {
+  placeObjects(scene);
+  VkResult errorCode = uploadMesh(app, scene);
+  returnOnError(errorCode)
+  errorCode = createImage(app, app.swapChainExtent.width, app.swapChainExtent.height, DEPTH_FORMAT,
+                          VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, MEMORY_ATTACHMENTS,
+                          scene.depthImage, scene.depthMemory);
+  returnOnError(errorCode)
+  errorCode = createImageView(app, scene.depthImage, DEPTH_FORMAT, VK_IMAGE_ASPECT_DEPTH_BIT, scene.depthView);
+  returnOnError(errorCode)
+  errorCode = createScenePass(app, VK_ATTACHMENT_LOAD_OP_CLEAR, scene.earlyPass);
+  returnOnError(errorCode)
+  errorCode = createScenePass(app, VK_ATTACHMENT_LOAD_OP_LOAD, scene.latePass);
+  returnOnError(errorCode)
+
+  VkImageView attachments[] = {target.imageView, scene.depthView};
+  VkFramebufferCreateInfo framebufferInfo{};
+  framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+  framebufferInfo.renderPass = scene.earlyPass; // compatible with the late pass
+  framebufferInfo.attachmentCount = 2;
+  framebufferInfo.pAttachments = attachments;
+  framebufferInfo.width = app.swapChainExtent.width;
+  framebufferInfo.height = app.swapChainExtent.height;
+  framebufferInfo.layers = 1;
+  errorCode = vkCreateFramebuffer(app.device, &framebufferInfo, nullptr, &scene.framebuffer);
+  returnOnError(errorCode)
+
+  PipelineKey key = defaultPipelineKey(app);
+  key.vertexShader = "../shaders/vert_instanced.spv";
+  key.vertexLayout = VERTEX_LAYOUT_POS2_COLOR3_INSTANCED;
+  key.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE; // z is dropped like in the LOD demo
+  key.depthTestEnable = VK_TRUE;
+  key.depthWriteEnable = VK_TRUE;
+  key.depthFormat = DEPTH_FORMAT;
+  return acquirePipeline(app, key, scene.pipeline);
+}
+
+static void beginScenePass(Application &app, OffscreenTarget &target, OcclusionScene &scene, VkRenderPass renderPass) {
+  VkClearValue clearValues[2]{};
+  clearValues[0].color = {{0.0f, 0.0f, 0.0f, 1.0f}};
+  clearValues[1].depthStencil = {1.0f, 0};
+  VkRenderPassBeginInfo renderPassInfo{};
+  renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+  renderPassInfo.renderPass = renderPass;
+  renderPassInfo.framebuffer = scene.framebuffer;
+  renderPassInfo.renderArea = {{0, 0}, app.swapChainExtent};
+  renderPassInfo.clearValueCount = 2;
+  renderPassInfo.pClearValues = clearValues;
+  vkCmdBeginRenderPass(target.commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+
+  VkViewport viewport{0.0f, 0.0f, (float) app.swapChainExtent.width, (float) app.swapChainExtent.height, 0.0f, 1.0f};
+  VkRect2D scissor{{0, 0}, app.swapChainExtent};
+  vkCmdSetViewport(target.commandBuffer, 0, 1, &viewport);
+  vkCmdSetScissor(target.commandBuffer, 0, 1, &scissor);
+  vkCmdBindPipeline(target.commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, scene.pipeline);
+  // keeps the rocks round whatever the aspect ratio
+  MeshTransform transform{glm::vec2(0.0f), glm::vec2((float) app.swapChainExtent.height / app.swapChainExtent.width, 1.0f)};
+  vkCmdPushConstants(target.commandBuffer, app.pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, sizeof(FragmentFeatures),
+                     sizeof(MeshTransform), &transform);
+  VkDeviceSize offset = 0;
+  vkCmdBindVertexBuffers(target.commandBuffer, 0, 1, &scene.vertexBuffer, &offset);
+  vkCmdBindIndexBuffer(target.commandBuffer, scene.indexBuffer, 0, VK_INDEX_TYPE_UINT32);
+}
+
+/**
+ * Every object, hidden or not, in one instanced draw.
+ */
+static VkResult recordWithoutCulling(Application &app, OffscreenTarget &target, OcclusionScene &scene,
+                                     OcclusionCuller &culler) {
+  VkResult errorCode = beginOffscreenCommands(app, target);
+  returnOnError(errorCode)
+  beginScenePass(app, target, scene, scene.earlyPass);
+  VkDeviceSize offset = 0;
+  vkCmdBindVertexBuffers(target.commandBuffer, 1, 1, &culler.objectBuffer, &offset);
+  vkCmdDrawIndexed(target.commandBuffer, scene.indexCount, static_cast<uint32_t>(scene.objects.size()), 0, 0, 0);
+  vkCmdEndRenderPass(target.commandBuffer);
+  return vkEndCommandBuffer(target.commandBuffer);
+}
+
+/**
+ * A frame of two phase occlusion culling: early cull, draw, depth pyramid, late cull, draw.
+ */
+static VkResult recordWithCulling(Application &app, OffscreenTarget &target, OcclusionScene &scene,
+                                  OcclusionCuller &culler) {
+  VkResult errorCode = beginOffscreenCommands(app, target);
+  returnOnError(errorCode)
+  recordOcclusionCull(app, culler, target.commandBuffer, CULL_PHASE_EARLY);
+  beginScenePass(app, target, scene, scene.earlyPass);
+  recordOcclusionDraw(app, culler, target.commandBuffer, CULL_PHASE_EARLY);
+  vkCmdEndRenderPass(target.commandBuffer);
+  recordDepthPyramid(app, culler, target.commandBuffer);
+  recordOcclusionCull(app, culler, target.commandBuffer, CULL_PHASE_LATE);
+  beginScenePass(app, target, scene, scene.latePass);
+  recordOcclusionDraw(app, culler, target.commandBuffer, CULL_PHASE_LATE);
+  vkCmdEndRenderPass(target.commandBuffer);
+  return vkEndCommandBuffer(target.commandBuffer);
+}
+
+static void destroyScene(Application &app, OcclusionScene &scene) {
+  vkDestroyFramebuffer(app.device, scene.framebuffer, nullptr);
+  vkDestroyRenderPass(app.device, scene.latePass, nullptr);
+  vkDestroyRenderPass(app.device, scene.earlyPass, nullptr);
+  vkDestroyImageView(app.device, scene.depthView, nullptr);
+  vkDestroyImage(app.device, scene.depthImage, nullptr);
+  freeMemory(app, scene.depthMemory);
+  vkDestroyBuffer(app.device, scene.indexBuffer, nullptr);
+  freeMemory(app, scene.indexMemory);
+  vkDestroyBuffer(app.device, scene.vertexBuffer, nullptr);
+  freeMemory(app, scene.vertexMemory);
+}
+
+/**
+ * Draws an occlusion heavy scene with and without hierarchical-Z occlusion culling and reports
+ * how many objects the culling rejects and what it saves per frame, culling and depth pyramid
+ * included. Every submission is a frame, so the early phase tests against the pyramid the
+ * submission before left behind.
+ *
+ * @param app
+ * @return
+ */
+VkResult runOcclusionBenchmark(Application &app) {
+  OffscreenTarget target{};
+  OcclusionScene scene{};
+  OcclusionCuller culler{};
+  double unculledMs = 0.0, culledMs = 0.0;
+  OcclusionStats stats{};
+  VkResult errorCode = createOffscreenTarget(app, target);
+  throwOnError(errorCode, "Unable to create occlusion benchmark target")
+  errorCode = createScene(app, target, scene);
+  throwOnError(errorCode, "Unable to create occlusion benchmark scene")
+  errorCode = createOcclusionCuller(app, scene.depthView, app.swapChainExtent, scene.objects, scene.indexCount, 0, culler);
+  throwOnError(errorCode, "Unable to create occlusion culler")
+
+  errorCode = recordWithoutCulling(app, target, scene, culler);
+  throwOnError(errorCode, "Failed to record the occlusion benchmark without culling")
+  errorCode = timeOffscreenSubmission(app, target, BENCHMARK_ITERATIONS, unculledMs);
+  throwOnError(errorCode, "Occlusion benchmark submission failed")
+  errorCode = recordWithCulling(app, target, scene, culler);
+  throwOnError(errorCode, "Failed to record the occlusion benchmark with culling")
+  errorCode = timeOffscreenSubmission(app, target, BENCHMARK_ITERATIONS, culledMs);
+  throwOnError(errorCode, "Occlusion benchmark submission failed")
+
+  stats = getOcclusionStats(culler);
+  {
+    const uint32_t drawn = stats.drawn[CULL_PHASE_EARLY] + stats.drawn[CULL_PHASE_LATE];
+    const uint32_t triangles = scene.indexCount / 3;
+    std::cout << std::fixed << std::setprecision(2);
+    std::cout << "Occlusion culling, " << stats.objects << " objects of " << triangles << " triangles at "
+              << app.swapChainExtent.width << "x" << app.swapChainExtent.height << ", depth pyramid of "
+              << culler.levelViews.size() << " levels" << std::endl;
+    std::cout << "  without culling: " << std::setw(8) << unculledMs << " ms, " << stats.objects << " objects, "
+              << static_cast<uint64_t>(stats.objects) * triangles << " triangles" << std::endl;
+    std::cout << "  two phase HZB:   " << std::setw(8) << culledMs << " ms, " << drawn << " objects ("
+              << stats.drawn[CULL_PHASE_EARLY] << " early, " << stats.drawn[CULL_PHASE_LATE] << " late), "
+              << static_cast<uint64_t>(drawn) * triangles << " triangles" << std::endl;
+    std::cout << "  occluded: " << 100.0 * (stats.objects - drawn) / stats.objects << "% of the objects, net win "
+              << unculledMs - culledMs << " ms per frame (" << 100.0 * (unculledMs - culledMs) / unculledMs << "%)"
+              << std::endl;
+  }
+
+  error:
+  vkDeviceWaitIdle(app.device);
+  destroyOcclusionCuller(app, culler);
+  destroyScene(app, scene);
+  destroyOffscreenTarget(app, target);
+  return errorCode;
+}
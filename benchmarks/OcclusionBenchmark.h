@@ -0,0 +1,7 @@
+#ifndef VULKANDEMO_OCCLUSIONBENCHMARK_H
+#define VULKANDEMO_OCCLUSIONBENCHMARK_H
+
+#include "../Application.h"
+
+VkResult runOcclusionBenchmark(Application &app);
+#endif //VULKANDEMO_OCCLUSIONBENCHMARK_H
@@ -0,0 +1,151 @@
+#include <chrono>
+#include "OffscreenTarget.h"
+#include "../buffers/Image.h"
+
+/**
+ * Creates the offscreen image and a render pass compatible with the main one (same format and
+ * sample count) so the pipelines from the library can be used as they are.
+ *
+ * @param app
+ * @param target
+ * @return
+ */
+VkResult createOffscreenTarget(Application &app, OffscreenTarget &target) {
+  VkResult errorCode = createImage(app, app.swapChainExtent.width, app.swapChainExtent.height, app.imageFormat,
+                                   VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT, MEMORY_ATTACHMENTS, target.image, target.imageMemory);
+  returnOnError(errorCode)
+  errorCode = createImageView(app, target.image, app.imageFormat, VK_IMAGE_ASPECT_COLOR_BIT, target.imageView);
+  returnOnError(errorCode)
+
+  VkAttachmentDescription colorAttachment{};
+  colorAttachment.format = app.imageFormat;
+  colorAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
+  colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+  colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+  colorAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+  colorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+  colorAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+  colorAttachment.finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+  VkAttachmentReference colorAttachmentRef{0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL};
+  VkSubpassDescription subpass{};
+  subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+  subpass.colorAttachmentCount = 1;
+  subpass.pColorAttachments = &colorAttachmentRef;
+  VkRenderPassCreateInfo renderPassInfo{};
+  renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+  renderPassInfo.attachmentCount = 1;
+  renderPassInfo.pAttachments = &colorAttachment;
+  renderPassInfo.subpassCount = 1;
+  renderPassInfo.pSubpasses = &subpass;
+  errorCode = vkCreateRenderPass(app.device, &renderPassInfo, nullptr, &target.renderPass);
+  returnOnError(errorCode)
+
+  VkFramebufferCreateInfo framebufferInfo{};
+  framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+  framebufferInfo.renderPass = target.renderPass;
+  framebufferInfo.attachmentCount = 1;
+  framebufferInfo.pAttachments = &target.imageView;
+  framebufferInfo.width = app.swapChainExtent.width;
+  framebufferInfo.height = app.swapChainExtent.height;
+  framebufferInfo.layers = 1;
+  errorCode = vkCreateFramebuffer(app.device, &framebufferInfo, nullptr, &target.framebuffer);
+  returnOnError(errorCode)
+
+  // the shared pool doesn't allow resetting single command buffers, and benchmarks record theirs many times
+  VkCommandPoolCreateInfo poolInfo{};
+  poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+  poolInfo.queueFamilyIndex = app.physicalDevice.graphicsQueueFamilyIdx;
+  poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+  errorCode = vkCreateCommandPool(app.device, &poolInfo, nullptr, &target.commandPool);
+  returnOnError(errorCode)
+
+  VkCommandBufferAllocateInfo allocInfo{};
+  allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+  allocInfo.commandPool = target.commandPool;
+  allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+  allocInfo.commandBufferCount = 1;
+  return vkAllocateCommandBuffers(app.device, &allocInfo, &target.commandBuffer);
+}
+
+/**
+ * Resets the pool of the target and begins recording its command buffer. Anything recorded before
+ * must have finished executing, which timeOffscreenSubmission and the benchmarks' own submissions
+ * wait for.
+ *
+ * @param app
+ * @param target
+ * @param flags
+ * @return
+ */
+VkResult beginOffscreenCommands(Application &app, OffscreenTarget &target, VkCommandBufferUsageFlags flags) {
+  VkResult errorCode = vkResetCommandPool(app.device, target.commandPool, 0);
+  returnOnError(errorCode)
+  VkCommandBufferBeginInfo beginInfo{};
+  beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+  beginInfo.flags = flags;
+  return vkBeginCommandBuffer(target.commandBuffer, &beginInfo);
+}
+
+/**
+ * Begins the render pass on the target, clearing it, and sets the dynamic viewport and scissor.
+ * The command buffer must be recording.
+ *
+ * @param app
+ * @param target
+ */
+void beginOffscreenRenderPass(Application &app, OffscreenTarget &target) {
+  VkClearValue clearColor = {0.0f, 0.0f, 0.0f, 1.0f};
+  VkRenderPassBeginInfo renderPassInfo{};
+  renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+  renderPassInfo.renderPass = target.renderPass;
+  renderPassInfo.framebuffer = target.framebuffer;
+  renderPassInfo.renderArea = {{0, 0}, app.swapChainExtent};
+  renderPassInfo.clearValueCount = 1;
+  renderPassInfo.pClearValues = &clearColor;
+  vkCmdBeginRenderPass(target.commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+  VkViewport viewport{0.0f, 0.0f, (float) app.swapChainExtent.width, (float) app.swapChainExtent.height, 0.0f, 1.0f};
+  VkRect2D scissor{{0, 0}, app.swapChainExtent};
+  vkCmdSetViewport(target.commandBuffer, 0, 1, &viewport);
+  vkCmdSetScissor(target.commandBuffer, 0, 1, &scissor);
+}
+
+/**
+ * Submits the recorded command buffer of the target once to warm up, then the given number of
+ * times, and returns the average GPU round trip in milliseconds.
+ *
+ * @param app
+ * @param target
+ * @param iterations
+ * @param milliseconds
+ * @return
+ */
+VkResult timeOffscreenSubmission(Application &app, OffscreenTarget &target, uint32_t iterations, double &milliseconds) {
+  VkSubmitInfo submitInfo{};
+  submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+  submitInfo.commandBufferCount = 1;
+  submitInfo.pCommandBuffers = &target.commandBuffer;
+
+  // one warm up submission so shader compilation in the driver doesn't end up in the numbers
+  VkResult errorCode = vkQueueSubmit(app.graphicsQueue, 1, &submitInfo, VK_NULL_HANDLE);
+  returnOnError(errorCode)
+  vkQueueWaitIdle(app.graphicsQueue);
+
+  auto start = std::chrono::steady_clock::now();
+  for (uint32_t i = 0; i < iterations; ++i) {
+    errorCode = vkQueueSubmit(app.graphicsQueue, 1, &submitInfo, VK_NULL_HANDLE);
+    returnOnError(errorCode)
+    vkQueueWaitIdle(app.graphicsQueue);
+  }
+  std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+  milliseconds = elapsed.count() / iterations;
+  return VK_SUCCESS;
+}
+
+void destroyOffscreenTarget(Application &app, OffscreenTarget &target) {
+  vkDestroyCommandPool(app.device, target.commandPool, nullptr); // frees the command buffer as well
+  vkDestroyFramebuffer(app.device, target.framebuffer, nullptr);
+  vkDestroyRenderPass(app.device, target.renderPass, nullptr);
+  vkDestroyImageView(app.device, target.imageView, nullptr);
+  vkDestroyImage(app.device, target.image, nullptr);
+  freeMemory(app, target.imageMemory);
+}
@@ -0,0 +1,25 @@
+#ifndef VULKANDEMO_OFFSCREENTARGET_H
+#define VULKANDEMO_OFFSCREENTARGET_H
+
+#include "../Application.h"
+
+/**
+ * Color target for the GPU benchmarks. We can't render into swapchain images we haven't acquired,
+ * so benchmarks draw into an offscreen image of the same format and extent instead.
+ */
+typedef struct OffscreenTarget {
+    VkImage image = VK_NULL_HANDLE;
+    VkDeviceMemory imageMemory = VK_NULL_HANDLE;
+    VkImageView imageView = VK_NULL_HANDLE;
+    VkRenderPass renderPass = VK_NULL_HANDLE;
+    VkFramebuffer framebuffer = VK_NULL_HANDLE;
+    VkCommandPool commandPool = VK_NULL_HANDLE; // own pool, reset before every recording of commandBuffer
+    VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+} OffscreenTarget;
+
+VkResult createOffscreenTarget(Application &app, OffscreenTarget &target);
+VkResult beginOffscreenCommands(Application &app, OffscreenTarget &target, VkCommandBufferUsageFlags flags = 0);
+void beginOffscreenRenderPass(Application &app, OffscreenTarget &target);
+VkResult timeOffscreenSubmission(Application &app, OffscreenTarget &target, uint32_t iterations, double &milliseconds);
+void destroyOffscreenTarget(Application &app, OffscreenTarget &target);
+#endif //VULKANDEMO_OFFSCREENTARGET_H
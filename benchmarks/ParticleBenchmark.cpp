@@ -0,0 +1,145 @@
+#include <iomanip>
+#include <iostream>
+#include "ParticleBenchmark.h"
+#include "OffscreenTarget.h"
+#include "../buffers/Vertex.h"
+#include "../pipeline/GraphicsPipeline.h"
+
+const uint32_t PARTICLE_COUNTS[] = {100000, 500000, 1000000, 4000000};
+const uint32_t STEPS_PER_SUBMISSION = 10; // even, so every submission starts from the buffer the last one wrote
+const uint32_t BENCHMARK_ITERATIONS = 20;
+const float STEP_SECONDS = 1.0f / 60.0f;
+
+static_assert(STEPS_PER_SUBMISSION % 2 == 0, "A submission must end in the buffer it starts from");
+
+/**
+ * Records STEPS_PER_SUBMISSION steps that keep the system about full, each followed by a draw of
+ * the particles into the target if there is a pipeline, and returns the average time of a step.
+ */
+static VkResult timeSteps(Application &app, OffscreenTarget &target, ParticleSystem &system, VkPipeline pipeline,
+                          double &milliseconds) {
+  VkResult errorCode = beginOffscreenCommands(app, target);
+  returnOnError(errorCode)
+  system.deltaTime = STEP_SECONDS;
+  system.emitCount = static_cast<uint32_t>(system.capacity * STEP_SECONDS / PARTICLE_MEAN_LIFE);
+  system.pipeline = pipeline;
+  for (uint32_t step = 0; step < STEPS_PER_SUBMISSION; ++step) {
+    system.destination = (step + 1) % 2;
+    recordParticleStep(app, system, target.commandBuffer);
+    if (pipeline != VK_NULL_HANDLE) {
+      beginOffscreenRenderPass(app, target);
+      recordParticleDraw(app, system, target.commandBuffer);
+      vkCmdEndRenderPass(target.commandBuffer);
+    }
+  }
+  errorCode = vkEndCommandBuffer(target.commandBuffer);
+  returnOnError(errorCode)
+  errorCode = timeOffscreenSubmission(app, target, BENCHMARK_ITERATIONS, milliseconds);
+  milliseconds /= STEPS_PER_SUBMISSION;
+  return errorCode;
+}
+
+/**
+ * Starts from no particles and emits the whole capacity into buffer 0.
+ */
+static VkResult fillParticles(Application &app, OffscreenTarget &target, ParticleSystem &system) {
+  VkResult errorCode = beginOffscreenCommands(app, target);
+  returnOnError(errorCode)
+  system.countersReset = false; // recorded into this command buffer, so every submission of it starts over
+  system.destination = 0;
+  system.deltaTime = STEP_SECONDS;
+  system.emitCount = system.capacity;
+  recordParticleStep(app, system, target.commandBuffer);
+  errorCode = vkEndCommandBuffer(target.commandBuffer);
+  returnOnError(errorCode)
+  double milliseconds;
+  return timeOffscreenSubmission(app, target, 1, milliseconds);
+}
+
+/**
+ * Copies the counters back to count the particles in buffer 0. Only the benchmark does this, the
+ * demo never waits for the GPU to learn how many particles there are.
+ */
+static VkResult readAliveParticles(Application &app, OffscreenTarget &target, ParticleSystem &system, uint32_t &alive) {
+  VkBuffer readbackBuffer = VK_NULL_HANDLE;
+  VkDeviceMemory readbackMemory = VK_NULL_HANDLE;
+  VkResult errorCode = createBuffer(app, sizeof(ParticleCounters), VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                                    VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                                    MEMORY_GEOMETRY, readbackBuffer, readbackMemory);
+  if (errorCode == VK_SUCCESS) {
+    errorCode = beginOffscreenCommands(app, target);
+  }
+  if (errorCode == VK_SUCCESS) {
+    VkBufferCopy region{0, 0, sizeof(ParticleCounters)};
+    vkCmdCopyBuffer(target.commandBuffer, system.counterBuffer, readbackBuffer, 1, &region);
+    vkEndCommandBuffer(target.commandBuffer);
+    VkSubmitInfo submitInfo{};
+    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submitInfo.commandBufferCount = 1;
+    submitInfo.pCommandBuffers = &target.commandBuffer;
+    errorCode = vkQueueSubmit(app.graphicsQueue, 1, &submitInfo, VK_NULL_HANDLE);
+  }
+  void *data;
+  if (errorCode == VK_SUCCESS) {
+    vkQueueWaitIdle(app.graphicsQueue);
+    errorCode = vkMapMemory(app.device, readbackMemory, 0, sizeof(ParticleCounters), 0, &data);
+  }
+  if (errorCode == VK_SUCCESS) {
+    alive = static_cast<const ParticleCounters *>(data)->draws[0].instanceCount;
+  }
+  vkDestroyBuffer(app.device, readbackBuffer, nullptr);
+  freeMemory(app, readbackMemory); // unmaps it
+  return errorCode;
+}
+
+/**
+ * Simulates growing numbers of particles, kept about full by the emission, with the compute passes
+ * alone and followed by an indirect draw of every particle, and reports the time of a step and how
+ * many particles it simulates per millisecond. Every submission holds several steps so the wait
+ * for the queue doesn't dominate.
+ *
+ * @param app
+ * @return
+ */
+VkResult runParticleBenchmark(Application &app) {
+  OffscreenTarget target{};
+  ParticleSystem system{};
+  VkPipeline pipeline = VK_NULL_HANDLE; // owned by the pipeline library
+  VkResult errorCode = createOffscreenTarget(app, target);
+  throwOnError(errorCode, "Unable to create particle benchmark target")
+  errorCode = acquirePipeline(app, particlePipelineKey(app), pipeline);
+  throwOnError(errorCode, "Unable to create particle benchmark pipeline")
+
+  std::cout << std::fixed << std::setprecision(2);
+  std::cout << "GPU particles at " << app.swapChainExtent.width << "x" << app.swapChainExtent.height << ", "
+            << STEPS_PER_SUBMISSION << " steps of " << STEP_SECONDS * 1000.0f << " ms per submission" << std::endl;
+  for (uint32_t capacity : PARTICLE_COUNTS) {
+    errorCode = createParticleSystem(app, capacity, system);
+    throwOnError(errorCode, "Unable to create particle system for the benchmark")
+    errorCode = fillParticles(app, target, system);
+    throwOnError(errorCode, "Particle benchmark submission failed")
+
+    double simulateMs = 0.0, drawMs = 0.0;
+    uint32_t alive = 0;
+    errorCode = timeSteps(app, target, system, VK_NULL_HANDLE, simulateMs);
+    throwOnError(errorCode, "Particle benchmark submission failed")
+    errorCode = readAliveParticles(app, target, system, alive);
+    throwOnError(errorCode, "Unable to read the particle counters back")
+    errorCode = timeSteps(app, target, system, pipeline, drawMs);
+    throwOnError(errorCode, "Particle benchmark submission failed")
+
+    std::cout << "  " << std::setw(8) << system.capacity << " capacity, " << std::setw(8) << alive << " alive: step "
+              << std::setw(7) << simulateMs << " ms, " << std::setw(10) << std::setprecision(0) << alive / simulateMs
+              << " particles/ms simulated, step + draw " << std::setw(7) << std::setprecision(2) << drawMs << " ms, "
+              << std::setw(10) << std::setprecision(0) << alive / drawMs << " particles/ms"
+              << std::setprecision(2) << std::endl;
+    vkDeviceWaitIdle(app.device);
+    destroyParticleSystem(app, system);
+  }
+
+  error:
+  vkDeviceWaitIdle(app.device);
+  destroyParticleSystem(app, system);
+  destroyOffscreenTarget(app, target);
+  return errorCode;
+}
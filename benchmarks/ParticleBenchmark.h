@@ -0,0 +1,7 @@
+#ifndef VULKANDEMO_PARTICLEBENCHMARK_H
+#define VULKANDEMO_PARTICLEBENCHMARK_H
+
+#include "../Application.h"
+
+VkResult runParticleBenchmark(Application &app);
+#endif //VULKANDEMO_PARTICLEBENCHMARK_H
@@ -0,0 +1,128 @@
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <thread>
+#include "SceneGraphBenchmark.h"
+#include "../scene/SceneGraph.h"
+
+const uint32_t SCENE_BENCHMARK_UPDATES = 20; // per scenario, the median is reported
+const uint32_t SCENE_BENCHMARK_MAX_DEPTH = 24;
+
+typedef struct SceneScenario {
+    const char *name;
+    uint32_t changedEvery; // every Nth node gets a new local transform before each update, 0 for none
+} SceneScenario;
+
+typedef struct SceneConfiguration {
+    const char *name;
+    bool simd;
+    uint32_t threads;
+} SceneConfiguration;
+
+/**
+ * Builds a random hierarchy below one root, depth first. Each node is either a child of the
+ * previous node or of one of its closest ancestors, which keeps the depth wandering between
+ * one and SCENE_BENCHMARK_MAX_DEPTH like in a scene of nested objects.
+ */
+static void generateHierarchy(uint32_t nodeCount, SceneGraph &graph) {
+  std::mt19937 random(42);
+  std::uniform_real_distribution<float> offset(-1.0f, 1.0f);
+  std::vector<uint32_t> path;
+  path.push_back(addSceneNode(graph, SCENE_NO_PARENT, glm::vec3(0.0f), glm::quat(1.0f, 0.0f, 0.0f, 0.0f), glm::vec3(1.0f)));
+  for (uint32_t i = 1; i < nodeCount; ++i) {
+    uint32_t pops = random() % 3;
+    if (path.size() >= SCENE_BENCHMARK_MAX_DEPTH) {
+      pops += 4;
+    }
+    pops = std::min(pops, static_cast<uint32_t>(path.size() - 1)); // the root stays
+    path.resize(path.size() - pops);
+    const glm::vec3 translation(offset(random), offset(random), offset(random));
+    const glm::quat rotation = glm::normalize(glm::quat(1.0f, offset(random) * 0.2f, offset(random) * 0.2f, offset(random) * 0.2f));
+    path.push_back(addSceneNode(graph, path.back(), translation, rotation, glm::vec3(0.98f)));
+  }
+}
+
+static double median(std::vector<double> &values) {
+  std::nth_element(values.begin(), values.begin() + values.size() / 2, values.end());
+  return values[values.size() / 2];
+}
+
+/**
+ * Changes the local transform of every changedEvery-th node, then times the update alone.
+ */
+static void runScenario(SceneGraph &graph, const SceneScenario &scenario, const SceneConfiguration &configuration) {
+  graph.simd = configuration.simd;
+  startSceneWorkers(graph, configuration.threads);
+  const auto nodeCount = static_cast<uint32_t>(graph.parents.size());
+  std::vector<double> milliseconds;
+  uint64_t updated = 0;
+  for (uint32_t round = 0; round < SCENE_BENCHMARK_UPDATES; ++round) {
+    if (scenario.changedEvery > 0) {
+      // a different subset each round, so a change is spread over the whole hierarchy
+      for (uint32_t node = round % scenario.changedEvery; node < nodeCount; node += scenario.changedEvery) {
+        setLocalTransform(graph, node, graph.translations[node], graph.rotations[node], graph.scales[node]);
+      }
+    }
+    auto start = std::chrono::steady_clock::now();
+    updated = updateSceneGraph(graph);
+    milliseconds.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+  }
+  stopSceneWorkers(graph);
+
+  const double updateMs = median(milliseconds);
+  std::cout << "  " << std::left << std::setw(20) << scenario.name << std::setw(20) << configuration.name << std::right
+            << std::setw(9) << std::setprecision(3) << updateMs << " ms, "
+            << std::setw(9) << std::setprecision(1) << 1000.0 / updateMs << " updates/s, "
+            << std::setw(8) << updated << " matrices recomputed";
+  if (updated > 0) {
+    std::cout << ", " << std::setw(6) << std::setprecision(2) << updateMs * 1.0e6 / static_cast<double>(updated) << " ns each";
+  }
+  std::cout << std::endl;
+}
+
+/**
+ * Updates the world matrices of a generated hierarchy with everything, a few or no nodes
+ * changed, on one thread with the scalar glm multiply, one thread with SSE and all hardware
+ * threads with SSE. Runs on the CPU only.
+ *
+ * @param nodeCount
+ * @return
+ */
+int runSceneGraphBenchmark(uint32_t nodeCount) {
+  SceneGraph graph;
+  auto start = std::chrono::steady_clock::now();
+  generateHierarchy(nodeCount, graph);
+  if (!buildSceneSegments(graph)) {
+    std::cerr << "The generated hierarchy is not depth first" << std::endl;
+    return 1;
+  }
+  std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+  const uint32_t threads = std::max(1u, std::thread::hardware_concurrency());
+
+  std::cout << std::fixed << std::setprecision(2);
+  std::cout << "Built " << nodeCount << " nodes in " << elapsed.count() << " ms: " << graph.topNodes.size()
+            << " top nodes, " << graph.segmentBegin.size() << " segments of up to " << SCENE_SEGMENT_NODES
+            << " nodes" << std::endl;
+  const SceneScenario scenarios[] = {
+      {"all changed", 1},
+      {"1% changed", 100},
+      {"0.01% changed", 10000},
+      {"nothing changed", 0}
+  };
+  const std::string threadName = std::to_string(threads) + " threads SSE";
+  const SceneConfiguration configurations[] = {
+      {"1 thread scalar", false, 1},
+      {"1 thread SSE", true, 1},
+      {threadName.c_str(), true, threads}
+  };
+  const size_t configurationCount = threads > 1 ? 3 : 2;
+  for (const auto &scenario : scenarios) {
+    for (size_t i = 0; i < configurationCount; ++i) {
+      runScenario(graph, scenario, configurations[i]);
+    }
+  }
+  return 0;
+}
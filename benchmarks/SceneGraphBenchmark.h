@@ -0,0 +1,7 @@
+#ifndef VULKANDEMO_SCENEGRAPHBENCHMARK_H
+#define VULKANDEMO_SCENEGRAPHBENCHMARK_H
+
+#include <cstdint>
+
+int runSceneGraphBenchmark(uint32_t nodeCount);
+#endif //VULKANDEMO_SCENEGRAPHBENCHMARK_H
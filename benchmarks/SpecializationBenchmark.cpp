@@ -0,0 +1,142 @@
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <cstdio>
+#include <vector>
+#include "SpecializationBenchmark.h"
+#include "../pipeline/GraphicsPipeline.h"
+#include "../buffers/Vertex.h"
+#include "OffscreenTarget.h"
+
+const uint32_t OVERDRAW_LAYERS = 32; // full screen triangles drawn on top of each other per submission
+const uint32_t BENCHMARK_ITERATIONS = 20;
+
+// a single triangle that covers the whole viewport
+const std::vector<Vertex> fullScreenTriangle = {
+    {{-1.0f, -1.0f}, {1.0f, 0.0f, 0.0f}},
+    {{3.0f, -1.0f}, {0.0f, 1.0f, 0.0f}},
+    {{-1.0f, 3.0f}, {0.0f, 0.0f, 1.0f}}
+};
+
+typedef struct BenchmarkTarget {
+    OffscreenTarget offscreen;
+    VkBuffer vertexBuffer = VK_NULL_HANDLE;
+    VkDeviceMemory vertexBufferMemory = VK_NULL_HANDLE;
+} BenchmarkTarget;
+
+static VkResult createBenchmarkTarget(Application &app, BenchmarkTarget &target) {
+  VkResult errorCode = createOffscreenTarget(app, target.offscreen);
+  returnOnError(errorCode)
+
+  VkDeviceSize size = sizeof(Vertex) * fullScreenTriangle.size();
+  errorCode = createBuffer(app, size, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+                           VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                           MEMORY_GEOMETRY, target.vertexBuffer, target.vertexBufferMemory);
+  returnOnError(errorCode)
+  void *data;
+  vkMapMemory(app.device, target.vertexBufferMemory, 0, size, 0, &data);
+  memcpy(data, fullScreenTriangle.data(), (size_t) size);
+  vkUnmapMemory(app.device, target.vertexBufferMemory);
+  return VK_SUCCESS;
+}
+
+static void destroyBenchmarkTarget(Application &app, BenchmarkTarget &target) {
+  vkDestroyBuffer(app.device, target.vertexBuffer, nullptr);
+  freeMemory(app, target.vertexBufferMemory);
+  destroyOffscreenTarget(app, target.offscreen);
+}
+
+/**
+ * Records OVERDRAW_LAYERS full screen draws with the variant's pipeline, submits them
+ * BENCHMARK_ITERATIONS times and returns the average GPU round trip in milliseconds.
+ *
+ * @param app
+ * @param target
+ * @param features
+ * @param milliseconds
+ * @return
+ */
+static VkResult timeVariant(Application &app, BenchmarkTarget &target, const FragmentFeatures &features, double &milliseconds) {
+  PipelineKey key = defaultPipelineKey(app);
+  key.fragmentFeatures = features;
+  key.cullMode = VK_CULL_MODE_NONE;
+  VkPipeline pipeline;
+  VkResult errorCode = acquirePipeline(app, key, pipeline);
+  returnOnError(errorCode)
+
+  VkCommandBuffer commandBuffer = target.offscreen.commandBuffer;
+  errorCode = beginOffscreenCommands(app, target.offscreen); // resets the previous variant's recording
+  returnOnError(errorCode)
+
+  beginOffscreenRenderPass(app, target.offscreen);
+  vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+  vkCmdPushConstants(commandBuffer, app.pipelineLayout, VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(FragmentFeatures), &features);
+  VkDeviceSize offset = 0;
+  vkCmdBindVertexBuffers(commandBuffer, 0, 1, &target.vertexBuffer, &offset);
+  for (uint32_t layer = 0; layer < OVERDRAW_LAYERS; ++layer) {
+    vkCmdDraw(commandBuffer, static_cast<uint32_t>(fullScreenTriangle.size()), 1, 0, 0);
+  }
+  vkCmdEndRenderPass(commandBuffer);
+  errorCode = vkEndCommandBuffer(commandBuffer);
+  returnOnError(errorCode)
+  return timeOffscreenSubmission(app, target.offscreen, BENCHMARK_ITERATIONS, milliseconds);
+}
+
+static const char *describeFeatures(const FragmentFeatures &features) {
+  static char description[64];
+  snprintf(description, sizeof(description), "color=%u lighting=%u samples=%u",
+           features.useVertexColor, features.lightingModel, features.sampleCount);
+  return description;
+}
+
+/**
+ * Measures fragment throughput of each specialized fragment shader variant against the
+ * uber-shader evaluating the same features through runtime branches on push constants.
+ *
+ * @param app
+ * @return
+ */
+VkResult runSpecializationBenchmark(Application &app) {
+  const std::vector<FragmentFeatures> variants = {
+      FragmentVariant<true, LIGHTING_UNLIT, 1>::features,
+      FragmentVariant<true, LIGHTING_POINT_LIGHTS, 1>::features,
+      FragmentVariant<true, LIGHTING_POINT_LIGHTS, 4>::features,
+      FragmentVariant<false, LIGHTING_POINT_LIGHTS, 8>::features
+  };
+
+  BenchmarkTarget target{};
+  VkResult errorCode = createBenchmarkTarget(app, target);
+  if (errorCode != VK_SUCCESS) {
+    std::cerr << "Unable to create specialization benchmark resources" << std::endl;
+    destroyBenchmarkTarget(app, target);
+    return errorCode;
+  }
+
+  const double pixels = (double) app.swapChainExtent.width * app.swapChainExtent.height * OVERDRAW_LAYERS;
+  std::cout << "Fragment throughput at " << app.swapChainExtent.width << "x" << app.swapChainExtent.height
+            << " with " << OVERDRAW_LAYERS << "x overdraw" << std::endl;
+  std::cout << std::fixed << std::setprecision(2);
+  for (const auto &features : variants) {
+    FragmentFeatures uber = features;
+    uber.uberShader = VK_TRUE;
+    double specializedMs = 0.0, uberMs = 0.0;
+    errorCode = timeVariant(app, target, features, specializedMs);
+    if (errorCode != VK_SUCCESS) {
+      break;
+    }
+    errorCode = timeVariant(app, target, uber, uberMs);
+    if (errorCode != VK_SUCCESS) {
+      break;
+    }
+    std::cout << "  " << describeFeatures(features)
+              << ": specialized " << specializedMs << " ms (" << pixels / specializedMs / 1000.0 << " MPix/s)"
+              << ", uber " << uberMs << " ms (" << pixels / uberMs / 1000.0 << " MPix/s)"
+              << ", speedup " << uberMs / specializedMs << "x" << std::endl;
+  }
+  if (errorCode != VK_SUCCESS) {
+    std::cerr << "Specialization benchmark failed" << std::endl;
+  }
+  vkDeviceWaitIdle(app.device);
+  destroyBenchmarkTarget(app, target);
+  return errorCode;
+}
@@ -0,0 +1,7 @@
+#ifndef VULKANDEMO_SPECIALIZATIONBENCHMARK_H
+#define VULKANDEMO_SPECIALIZATIONBENCHMARK_H
+
+#include "../Application.h"
+
+VkResult runSpecializationBenchmark(Application &app);
+#endif //VULKANDEMO_SPECIALIZATIONBENCHMARK_H
@@ -0,0 +1,136 @@
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <algorithm>
+#include "SpriteBenchmark.h"
+#include "../pipeline/GraphicsPipeline.h"
+
+const uint32_t SPRITE_BENCHMARK_FRAMES = 200;
+
+typedef struct SpriteScenario {
+    const char *name;
+    uint32_t spritesPerPipeline; // sprites drawn before switching to the next pipeline
+} SpriteScenario;
+
+/**
+ * Batches a full partition of sprites and records it, SPRITE_BENCHMARK_FRAMES times. Nothing is
+ * submitted, so this measures the CPU side only: writing vertices into the mapped ring and
+ * recording the draws.
+ *
+ * @param app
+ * @param commandPool
+ * @param commandBuffer
+ * @param pipelines
+ * @param scenario
+ * @return
+ */
+static VkResult runScenario(Application &app, VkCommandPool commandPool, VkCommandBuffer commandBuffer,
+                            const std::vector<VkPipeline> &pipelines, const SpriteScenario &scenario) {
+  VkCommandBufferBeginInfo beginInfo{};
+  beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+  beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+  const float width = static_cast<float>(app.swapChainExtent.width);
+  const float height = static_cast<float>(app.swapChainExtent.height);
+  std::chrono::duration<double, std::milli> batching{0}, recording{0};
+  size_t draws = 0;
+
+  for (uint32_t frame = 0; frame < SPRITE_BENCHMARK_FRAMES; ++frame) {
+    auto start = std::chrono::steady_clock::now();
+    beginSprites(app);
+    for (uint32_t i = 0; i < MAX_SPRITES_PER_FRAME; ++i) {
+      Sprite sprite;
+      sprite.position = glm::vec2(static_cast<float>(i % 997) / 997.0f * width, static_cast<float>(i % 991) / 991.0f * height);
+      sprite.size = glm::vec2(8.0f);
+      sprite.color = glm::vec3(static_cast<float>(frame & 1), 0.5f, 1.0f);
+      drawSprite(app, pipelines[(i / scenario.spritesPerPipeline) % pipelines.size()], sprite);
+    }
+    auto batched = std::chrono::steady_clock::now();
+
+    VkResult errorCode = vkBeginCommandBuffer(commandBuffer, &beginInfo);
+    returnOnError(errorCode)
+    VkRenderPassBeginInfo renderPassInfo{};
+    renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+    renderPassInfo.renderPass = app.overlayRenderPass;
+    renderPassInfo.framebuffer = app.swapChainFramebuffers[0];
+    renderPassInfo.renderArea = {{0, 0}, app.swapChainExtent};
+    vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+    recordSprites(app, commandBuffer);
+    vkCmdEndRenderPass(commandBuffer);
+    errorCode = vkEndCommandBuffer(commandBuffer);
+    returnOnError(errorCode)
+    auto recorded = std::chrono::steady_clock::now();
+    errorCode = vkResetCommandPool(app.device, commandPool, 0);
+    returnOnError(errorCode)
+
+    batching += batched - start;
+    recording += recorded - batched;
+    draws = app.sprites.draws.size();
+  }
+
+  const double sprites = static_cast<double>(MAX_SPRITES_PER_FRAME) * SPRITE_BENCHMARK_FRAMES;
+  std::cout << "  " << std::left << std::setw(24) << scenario.name << std::right
+            << std::setw(6) << draws << " draws/frame, "
+            << std::setw(10) << sprites / batching.count() << " sprites/ms batched, "
+            << std::setw(10) << sprites / recording.count() << " sprites/ms recorded, "
+            << std::setw(10) << sprites / (batching + recording).count() << " sprites/ms total" << std::endl;
+  return VK_SUCCESS;
+}
+
+/**
+ * Measures the sprite batcher with the pipeline changing at different rates, from a single
+ * pipeline for the whole frame, which collapses into one draw, to a change every few sprites.
+ *
+ * @param app
+ * @return
+ */
+VkResult runSpriteBenchmark(Application &app) {
+  std::vector<VkPipeline> pipelines;
+  PipelineKey opaque = spritePipelineKey(app);
+  opaque.blendEnable = VK_FALSE;
+  for (const auto &key : {spritePipelineKey(app), opaque}) {
+    VkPipeline pipeline;
+    VkResult errorCode = acquirePipeline(app, key, pipeline);
+    if (errorCode != VK_SUCCESS) {
+      std::cerr << "Unable to create sprite benchmark pipelines" << std::endl;
+      return errorCode;
+    }
+    pipelines.push_back(pipeline);
+  }
+
+  VkCommandPool commandPool = VK_NULL_HANDLE;
+  VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+  VkCommandPoolCreateInfo poolInfo{};
+  poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+  poolInfo.queueFamilyIndex = app.physicalDevice.graphicsQueueFamilyIdx;
+  poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+  VkResult errorCode = vkCreateCommandPool(app.device, &poolInfo, nullptr, &commandPool);
+  throwOnError(errorCode, "Unable to create sprite benchmark command pool")
+
+  VkCommandBufferAllocateInfo allocInfo{};
+  allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+  allocInfo.commandPool = commandPool;
+  allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+  allocInfo.commandBufferCount = 1;
+  errorCode = vkAllocateCommandBuffers(app.device, &allocInfo, &commandBuffer);
+  throwOnError(errorCode, "Unable to allocate sprite benchmark command buffer")
+
+  {
+    const SpriteScenario scenarios[] = {
+        {"single pipeline", MAX_SPRITES_PER_FRAME},
+        {"switch every 4096", 4096},
+        {"switch every 64", 64},
+        {"switch every sprite", 1}
+    };
+    std::cout << std::fixed << std::setprecision(0);
+    std::cout << MAX_SPRITES_PER_FRAME << " sprites per frame, " << SPRITE_BENCHMARK_FRAMES << " frames" << std::endl;
+    for (const auto &scenario : scenarios) {
+      errorCode = runScenario(app, commandPool, commandBuffer, pipelines, scenario);
+      throwOnError(errorCode, "Sprite benchmark recording failed")
+    }
+  }
+
+  error:
+  beginSprites(app); // leave nothing behind for the render loop
+  vkDestroyCommandPool(app.device, commandPool, nullptr); // frees the command buffer as well
+  return errorCode;
+}
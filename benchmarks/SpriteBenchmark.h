@@ -0,0 +1,7 @@
+#ifndef VULKANDEMO_SPRITEBENCHMARK_H
+#define VULKANDEMO_SPRITEBENCHMARK_H
+
+#include "../Application.h"
+
+VkResult runSpriteBenchmark(Application &app);
+#endif //VULKANDEMO_SPRITEBENCHMARK_H
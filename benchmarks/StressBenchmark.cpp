@@ -0,0 +1,166 @@
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+#include "StressBenchmark.h"
+#include "OffscreenTarget.h"
+#include "../buffers/Vertex.h"
+#include "../mesh/StressGeometry.h"
+#include "../pipeline/GraphicsPipeline.h"
+
+// vertices per step, 1, 2 and 5 times the powers of ten from 1K up to MAX_STRESS_VERTICES
+const uint32_t STRESS_STEPS[] = {1000, 2000, 5000, 10000, 20000, 50000, 100000, 200000, 500000, 1000000, 2000000, 5000000,
+                                 10000000, 20000000, 50000000, MAX_STRESS_VERTICES};
+const uint32_t STRESS_ITERATIONS = 10; // submissions timed per step
+const uint32_t STRESS_LARGE_ITERATIONS = 3; // from STRESS_LARGE_VERTICES on, frames take long there
+const uint32_t STRESS_LARGE_VERTICES = 10000000;
+
+typedef struct StressSample {
+    uint32_t vertices = 0;
+    double generateMs = 0.0;
+    double uploadMs = 0.0; // createVertexBuffer, from allocating the buffer to the last byte copied
+    double frameMs = 0.0;
+} StressSample;
+
+/**
+ * Generates the geometry of one step, uploads it through createVertexBuffer like the scene's and
+ * times drawing all of it once per submission with the scene's pipeline.
+ *
+ * @param app
+ * @param target
+ * @param pipeline
+ * @param key
+ * @param vertexCount requested, the sample holds how many were generated
+ * @param sample
+ * @return
+ */
+static VkResult measureStep(Application &app, OffscreenTarget &target, VkPipeline pipeline, const PipelineKey &key,
+                            uint32_t vertexCount, StressSample &sample) {
+  VkBuffer vertexBuffer = VK_NULL_HANDLE;
+  VkDeviceMemory vertexBufferMemory = VK_NULL_HANDLE;
+  VkResult errorCode = VK_SUCCESS;
+  {
+    std::vector<Vertex> vertices;
+    auto start = std::chrono::steady_clock::now();
+    if (!generateStressGeometry(app.options.stressShape, vertexCount, vertices)) {
+      return VK_ERROR_OUT_OF_HOST_MEMORY;
+    }
+    auto generated = std::chrono::steady_clock::now();
+    errorCode = createVertexBuffer(app, vertices.data(), vertices.size(), vertexBuffer, vertexBufferMemory);
+    auto uploaded = std::chrono::steady_clock::now();
+    sample.vertices = static_cast<uint32_t>(vertices.size());
+    sample.generateMs = std::chrono::duration<double, std::milli>(generated - start).count();
+    sample.uploadMs = std::chrono::duration<double, std::milli>(uploaded - generated).count();
+  }
+  throwOnError(errorCode, "Unable to upload stress geometry")
+  {
+    // the reset also drops the previous step's recording, which still references its destroyed vertex buffer
+    errorCode = beginOffscreenCommands(app, target);
+    throwOnError(errorCode, "Failed to begin recording stress benchmark")
+    beginOffscreenRenderPass(app, target);
+    vkCmdBindPipeline(target.commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+    vkCmdPushConstants(target.commandBuffer, app.pipelineLayout, VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(FragmentFeatures),
+                       &key.fragmentFeatures);
+    VkDeviceSize offset = 0;
+    vkCmdBindVertexBuffers(target.commandBuffer, 0, 1, &vertexBuffer, &offset);
+    vkCmdDraw(target.commandBuffer, sample.vertices, 1, 0, 0);
+    vkCmdEndRenderPass(target.commandBuffer);
+    errorCode = vkEndCommandBuffer(target.commandBuffer);
+    throwOnError(errorCode, "Failed to end recording stress benchmark")
+
+    const uint32_t iterations = sample.vertices >= STRESS_LARGE_VERTICES ? STRESS_LARGE_ITERATIONS : STRESS_ITERATIONS;
+    errorCode = timeOffscreenSubmission(app, target, iterations, sample.frameMs);
+    throwOnError(errorCode, "Stress benchmark submission failed")
+  }
+
+  error:
+  vkDestroyBuffer(app.device, vertexBuffer, nullptr);
+  freeMemory(app, vertexBufferMemory);
+  return errorCode;
+}
+
+static void writeScalingCurve(const std::string &path, StressShape shape, const std::vector<StressSample> &samples) {
+  std::ofstream file(path);
+  if (!file) {
+    std::cerr << "Unable to write " << path << std::endl;
+    return;
+  }
+  file << "shape,vertices,triangles,bytes,generate_ms,upload_ms,upload_gb_per_s,frame_ms,vertices_per_s,primitives_per_s" << std::endl;
+  for (const auto &sample : samples) {
+    const double bytes = static_cast<double>(sample.vertices) * sizeof(Vertex);
+    file << stressShapeName(shape) << ',' << sample.vertices << ',' << sample.vertices / 3 << ',' << bytes << ','
+         << sample.generateMs << ',' << sample.uploadMs << ',' << bytes / sample.uploadMs / 1e6 << ',' << sample.frameMs << ','
+         << sample.vertices / sample.frameMs * 1000.0 << ',' << sample.vertices / 3 / sample.frameMs * 1000.0 << std::endl;
+  }
+  std::cout << "Scaling curve written to " << path << std::endl;
+}
+
+/**
+ * Draws generated geometry of Options::stressShape, a grid unless given, with more and more
+ * vertices from 1K up to 100M until a frame takes longer than Options::stressFrameMs, or the
+ * vertices no longer fit into memory. Every step prints and writes vertex and primitive
+ * throughput and the upload bandwidth of createVertexBuffer into Options::stressCsvFile.
+ *
+ * The vertices stay in the host visible memory createVertexBuffer allocates, so on a discrete GPU
+ * large steps fetch them over the bus, like the scene would.
+ *
+ * @param app
+ * @return
+ */
+VkResult runStressBenchmark(Application &app) {
+  if (app.options.stressShape == STRESS_NONE) {
+    app.options.stressShape = STRESS_GRID;
+  }
+  const StressShape shape = app.options.stressShape;
+  PipelineKey key = defaultPipelineKey(app); // the scene's pipeline
+  VkPipeline pipeline;
+  VkResult errorCode = acquirePipeline(app, key, pipeline);
+  returnOnError(errorCode)
+  OffscreenTarget target{};
+  errorCode = createOffscreenTarget(app, target);
+  if (errorCode != VK_SUCCESS) {
+    std::cerr << "Unable to create stress benchmark resources" << std::endl;
+    destroyOffscreenTarget(app, target);
+    return errorCode;
+  }
+
+  std::cout << "Stress geometry: " << stressShapeName(shape) << ", " << app.swapChainExtent.width << "x"
+            << app.swapChainExtent.height << ", until a frame takes " << app.options.stressFrameMs << " ms" << std::endl;
+  std::cout << std::fixed;
+  std::vector<StressSample> samples;
+  const char *stopReason = "reached the largest step";
+  for (uint32_t step : STRESS_STEPS) {
+    StressSample sample;
+    errorCode = measureStep(app, target, pipeline, key, step, sample);
+    if (errorCode == VK_ERROR_OUT_OF_HOST_MEMORY || errorCode == VK_ERROR_OUT_OF_DEVICE_MEMORY) {
+      stopReason = "ran out of memory";
+      errorCode = VK_SUCCESS; // a limit like the frame time
+      break;
+    } else if (errorCode != VK_SUCCESS) {
+      break;
+    }
+    samples.push_back(sample);
+    const double bytes = static_cast<double>(sample.vertices) * sizeof(Vertex);
+    std::cout << "  " << std::setw(10) << sample.vertices << " vertices: "
+              << std::setprecision(3) << std::setw(9) << sample.frameMs << " ms/frame, "
+              << std::setprecision(1) << std::setw(8) << sample.vertices / sample.frameMs / 1000.0 << " Mvertices/s, "
+              << std::setw(8) << sample.vertices / 3 / sample.frameMs / 1000.0 << " Mtriangles/s, upload "
+              << std::setw(8) << bytes / (1024.0 * 1024.0) << " MiB at " << std::setprecision(2)
+              << std::setw(6) << bytes / sample.uploadMs / 1e6 << " GB/s, generated in " << std::setprecision(1)
+              << sample.generateMs << " ms" << std::endl;
+    if (sample.frameMs > app.options.stressFrameMs) {
+      stopReason = "crossed the frame time";
+      break;
+    }
+  }
+  vkDeviceWaitIdle(app.device);
+  destroyOffscreenTarget(app, target);
+  if (errorCode != VK_SUCCESS) {
+    std::cerr << "Stress benchmark failed" << std::endl;
+    return errorCode;
+  }
+  std::cout << "Stopped after " << samples.size() << " steps, " << stopReason << std::endl;
+  writeScalingCurve(app.options.stressCsvFile, shape, samples);
+  return VK_SUCCESS;
+}
@@ -0,0 +1,7 @@
+#ifndef VULKANDEMO_STRESSBENCHMARK_H
+#define VULKANDEMO_STRESSBENCHMARK_H
+
+#include "../Application.h"
+
+VkResult runStressBenchmark(Application &app);
+#endif //VULKANDEMO_STRESSBENCHMARK_H
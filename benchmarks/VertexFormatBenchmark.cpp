@@ -0,0 +1,194 @@
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include "VertexFormatBenchmark.h"
+#include "OffscreenTarget.h"
+#include "../pipeline/Compute.h"
+#include "../pipeline/GraphicsPipeline.h"
+#include "../buffers/Vertex.h"
+
+const uint32_t BENCHMARK_TRIANGLES = 1u << 20;
+const uint32_t DRAWS_PER_SUBMISSION = 8;
+const uint32_t BENCHMARK_ITERATIONS = 10;
+const float TRIANGLE_SIZE = 1.0f / 4096.0f; // well below a pixel, so rasterization costs next to nothing
+
+static void makeVertex(const glm::vec2 &pos, const glm::vec3 &color, const glm::vec3 &normal, Vertex &vertex) {
+  vertex = {pos, color};
+}
+
+static void makeVertex(const glm::vec2 &pos, const glm::vec3 &color, const glm::vec3 &normal, HalfVertex &vertex) {
+  vertex = {packHalf2(pos), packUnorm4(color)};
+}
+
+static void makeVertex(const glm::vec2 &pos, const glm::vec3 &color, const glm::vec3 &normal, OctahedralVertex &vertex) {
+  vertex = {packHalf2(pos), packUnorm4(color), encodeOctahedral(normal)};
+}
+
+/**
+ * Scatters BENCHMARK_TRIANGLES tiny triangles over the viewport. Every vertex is fetched exactly
+ * once per draw, so the draw time is dominated by vertex fetch and the vertex shader.
+ */
+template<typename V>
+static std::vector<V> generateVertices() {
+  std::vector<V> vertices(BENCHMARK_TRIANGLES * 3);
+  uint32_t state = 1;
+  for (uint32_t triangle = 0; triangle < BENCHMARK_TRIANGLES; ++triangle) {
+    const glm::vec2 center(randomUnit(state) * 2.0f - 1.0f, randomUnit(state) * 2.0f - 1.0f);
+    const glm::vec3 color(randomUnit(state), randomUnit(state), randomUnit(state));
+    const glm::vec3 normal(randomUnit(state) * 2.0f - 1.0f, randomUnit(state) * 2.0f - 1.0f, randomUnit(state) * 2.0f - 1.0f);
+    makeVertex(center, color, normal, vertices[triangle * 3]);
+    makeVertex(glm::vec2(center.x + TRIANGLE_SIZE, center.y), color, normal, vertices[triangle * 3 + 1]);
+    makeVertex(glm::vec2(center.x, center.y + TRIANGLE_SIZE), color, normal, vertices[triangle * 3 + 2]);
+  }
+  return vertices;
+}
+
+/**
+ * Uploads the vertices into device local memory through a staging buffer, so the benchmark
+ * measures fetching from video memory and not over the bus.
+ *
+ * @param app
+ * @param target
+ * @param data
+ * @param size
+ * @param buffer
+ * @param memory
+ * @return
+ */
+static VkResult uploadVertices(Application &app, OffscreenTarget &target, const void *data, VkDeviceSize size,
+                               VkBuffer &buffer, VkDeviceMemory &memory) {
+  VkBuffer stagingBuffer = VK_NULL_HANDLE;
+  VkDeviceMemory stagingMemory = VK_NULL_HANDLE;
+  VkResult errorCode = createBuffer(app, size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                                    VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                                    MEMORY_STAGING, stagingBuffer, stagingMemory);
+  throwOnError(errorCode, "Unable to create vertex staging buffer")
+  {
+    void *mapped;
+    errorCode = vkMapMemory(app.device, stagingMemory, 0, size, 0, &mapped);
+    throwOnError(errorCode, "Unable to map vertex staging buffer")
+    memcpy(mapped, data, (size_t) size);
+    vkUnmapMemory(app.device, stagingMemory);
+  }
+  errorCode = createBuffer(app, size, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                           VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, MEMORY_GEOMETRY, buffer, memory);
+  throwOnError(errorCode, "Unable to create device local vertex buffer")
+  {
+    errorCode = beginOffscreenCommands(app, target, VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
+    throwOnError(errorCode, "Failed to begin recording vertex upload")
+    VkBufferCopy region{0, 0, size};
+    vkCmdCopyBuffer(target.commandBuffer, stagingBuffer, buffer, 1, &region);
+    errorCode = vkEndCommandBuffer(target.commandBuffer);
+    throwOnError(errorCode, "Failed to end recording vertex upload")
+    VkSubmitInfo submitInfo{};
+    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submitInfo.commandBufferCount = 1;
+    submitInfo.pCommandBuffers = &target.commandBuffer;
+    errorCode = vkQueueSubmit(app.graphicsQueue, 1, &submitInfo, VK_NULL_HANDLE);
+    throwOnError(errorCode, "Failed to submit vertex upload")
+    vkQueueWaitIdle(app.graphicsQueue);
+  }
+
+  error:
+  vkDestroyBuffer(app.device, stagingBuffer, nullptr);
+  freeMemory(app, stagingMemory);
+  return errorCode;
+}
+
+/**
+ * Draws the generated triangles of one vertex format DRAWS_PER_SUBMISSION times per submission
+ * and prints the vertex throughput and the vertex buffer bandwidth it amounts to.
+ *
+ * @param app
+ * @param target
+ * @param name
+ * @param vertexShader
+ * @return
+ */
+template<typename V>
+static VkResult timeVertexFormat(Application &app, OffscreenTarget &target, const char *name, const char *vertexShader) {
+  PipelineKey key = defaultPipelineKey(app);
+  key.vertexShader = vertexShader;
+  key.vertexLayout = VertexTraits<V>::layout;
+  key.cullMode = VK_CULL_MODE_NONE;
+  VkPipeline pipeline;
+  VkResult errorCode = acquirePipeline(app, key, pipeline);
+  returnOnError(errorCode)
+
+  const std::vector<V> vertices = generateVertices<V>();
+  const VkDeviceSize size = sizeof(V) * vertices.size();
+  VkBuffer vertexBuffer = VK_NULL_HANDLE;
+  VkDeviceMemory vertexBufferMemory = VK_NULL_HANDLE;
+  errorCode = uploadVertices(app, target, vertices.data(), size, vertexBuffer, vertexBufferMemory);
+  throwOnError(errorCode, "Unable to upload benchmark vertices")
+
+  {
+    errorCode = beginOffscreenCommands(app, target);
+    throwOnError(errorCode, "Failed to begin recording vertex format benchmark")
+    beginOffscreenRenderPass(app, target);
+    vkCmdBindPipeline(target.commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+    vkCmdPushConstants(target.commandBuffer, app.pipelineLayout, VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(FragmentFeatures),
+                       &key.fragmentFeatures);
+    VkDeviceSize offset = 0;
+    vkCmdBindVertexBuffers(target.commandBuffer, 0, 1, &vertexBuffer, &offset);
+    for (uint32_t draw = 0; draw < DRAWS_PER_SUBMISSION; ++draw) {
+      vkCmdDraw(target.commandBuffer, static_cast<uint32_t>(vertices.size()), 1, 0, 0);
+    }
+    vkCmdEndRenderPass(target.commandBuffer);
+    errorCode = vkEndCommandBuffer(target.commandBuffer);
+    throwOnError(errorCode, "Failed to end recording vertex format benchmark")
+
+    double milliseconds = 0.0;
+    errorCode = timeOffscreenSubmission(app, target, BENCHMARK_ITERATIONS, milliseconds);
+    throwOnError(errorCode, "Vertex format benchmark submission failed")
+
+    const double fetched = static_cast<double>(vertices.size()) * DRAWS_PER_SUBMISSION;
+    std::cout << "  " << std::left << std::setw(34) << name << std::right
+              << std::setw(3) << sizeof(V) << " B/vertex, "
+              << std::setw(6) << size / (1024.0 * 1024.0) << " MiB, "
+              << std::setw(7) << milliseconds << " ms, "
+              << std::setw(8) << fetched / milliseconds / 1000.0 << " Mvertices/s, "
+              << std::setw(7) << fetched * sizeof(V) / milliseconds / 1e6 << " GB/s" << std::endl;
+  }
+
+  error:
+  vkDestroyBuffer(app.device, vertexBuffer, nullptr);
+  freeMemory(app, vertexBufferMemory);
+  return errorCode;
+}
+
+/**
+ * Measures vertex throughput and vertex buffer bandwidth for each vertex format. The full float
+ * layout and the quantized ones draw the same triangles, so the difference comes from the bytes
+ * fetched per vertex and the conversion the fetch hardware does for free.
+ *
+ * @param app
+ * @return
+ */
+VkResult runVertexFormatBenchmark(Application &app) {
+  OffscreenTarget target{};
+  VkResult errorCode = createOffscreenTarget(app, target);
+  if (errorCode != VK_SUCCESS) {
+    std::cerr << "Unable to create vertex format benchmark resources" << std::endl;
+    destroyOffscreenTarget(app, target);
+    return errorCode;
+  }
+
+  std::cout << "Vertex throughput, " << BENCHMARK_TRIANGLES * 3 << " vertices drawn " << DRAWS_PER_SUBMISSION
+            << " times per submission" << std::endl;
+  std::cout << std::fixed << std::setprecision(2);
+  errorCode = timeVertexFormat<Vertex>(app, target, "float2 position, float3 color", "../shaders/vert.spv");
+  if (errorCode == VK_SUCCESS) {
+    errorCode = timeVertexFormat<HalfVertex>(app, target, "half2 position, unorm8x4 color", "../shaders/vert.spv");
+  }
+  if (errorCode == VK_SUCCESS) {
+    errorCode = timeVertexFormat<OctahedralVertex>(app, target, "half2, unorm8x4, octahedral normal",
+                                                   "../shaders/vert_octahedral.spv");
+  }
+  if (errorCode != VK_SUCCESS) {
+    std::cerr << "Vertex format benchmark failed" << std::endl;
+  }
+  vkDeviceWaitIdle(app.device);
+  destroyOffscreenTarget(app, target);
+  return errorCode;
+}
@@ -0,0 +1,7 @@
+#ifndef VULKANDEMO_VERTEXFORMATBENCHMARK_H
+#define VULKANDEMO_VERTEXFORMATBENCHMARK_H
+
+#include "../Application.h"
+
+VkResult runVertexFormatBenchmark(Application &app);
+#endif //VULKANDEMO_VERTEXFORMATBENCHMARK_H
@@ -0,0 +1,86 @@
+#include <iostream>
+#include "Image.h"
+#include "Vertex.h"
+
+/**
+ * Creates a 2D, optimally tiled image and binds it to freshly allocated device local memory.
+ *
+ * @param app
+ * @param width
+ * @param height
+ * @param format
+ * @param usage
+ * @param category
+ * @param image
+ * @param imageMemory
+ * @param mipLevels
+ * @return
+ */
+VkResult createImage(Application &app, uint32_t width, uint32_t height, VkFormat format, VkImageUsageFlags usage,
+                     MemoryCategory category, VkImage &image, VkDeviceMemory &imageMemory, uint32_t mipLevels) {
+  TRACE_ZONE("createImage");
+  VkImageCreateInfo imageInfo{};
+  imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+  imageInfo.imageType = VK_IMAGE_TYPE_2D;
+  imageInfo.extent = {width, height, 1};
+  imageInfo.mipLevels = mipLevels;
+  imageInfo.arrayLayers = 1;
+  imageInfo.format = format;
+  imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+  imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+  imageInfo.usage = usage;
+  imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+  imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+  VkResult errorCode = vkCreateImage(app.device, &imageInfo, nullptr, &image);
+  throwOnError(errorCode, "Unable to create image")
+
+  VkMemoryRequirements memRequirements;
+  vkGetImageMemoryRequirements(app.device, image, &memRequirements);
+
+  errorCode = allocateMemory(app, memRequirements, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, category, imageMemory);
+  throwOnError(errorCode, "Unable to allocate image memory")
+
+  errorCode = vkBindImageMemory(app.device, image, imageMemory, 0);
+  throwOnError(errorCode, "Unable to bind image memory")
+
+  error:
+  return errorCode;
+}
+
+/**
+ * Creates a view of a range of mip levels of the image, the first one by default, with identity swizzling.
+ *
+ * @param app
+ * @param image
+ * @param format
+ * @param aspectMask
+ * @param imageView
+ * @param baseMipLevel
+ * @param levelCount
+ * @return
+ */
+VkResult createImageView(Application &app, VkImage image, VkFormat format, VkImageAspectFlags aspectMask, VkImageView &imageView,
+                         uint32_t baseMipLevel, uint32_t levelCount) {
+  TRACE_ZONE("createImageView");
+  VkImageViewCreateInfo createInfo{};
+  createInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+  createInfo.image = image;
+  createInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+  createInfo.format = format;
+  createInfo.components.r = VK_COMPONENT_SWIZZLE_IDENTITY;
+  createInfo.components.g = VK_COMPONENT_SWIZZLE_IDENTITY;
+  createInfo.components.b = VK_COMPONENT_SWIZZLE_IDENTITY;
+  createInfo.components.a = VK_COMPONENT_SWIZZLE_IDENTITY;
+  createInfo.subresourceRange.aspectMask = aspectMask;
+  createInfo.subresourceRange.baseMipLevel = baseMipLevel;
+  createInfo.subresourceRange.levelCount = levelCount;
+  createInfo.subresourceRange.baseArrayLayer = 0;
+  createInfo.subresourceRange.layerCount = 1;
+
+  VkResult errorCode = vkCreateImageView(app.device, &createInfo, nullptr, &imageView);
+  if (errorCode != VK_SUCCESS) {
+    std::cerr << "Unable to create image view" << std::endl;
+  }
+  return errorCode;
+}
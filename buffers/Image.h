@@ -0,0 +1,11 @@
+#ifndef VULKANDEMO_IMAGE_H
+#define VULKANDEMO_IMAGE_H
+
+#include <vulkan/vulkan.h>
+#include "../Application.h"
+
+VkResult createImage(Application &app, uint32_t width, uint32_t height, VkFormat format, VkImageUsageFlags usage,
+                     MemoryCategory category, VkImage &image, VkDeviceMemory &imageMemory, uint32_t mipLevels = 1);
+VkResult createImageView(Application &app, VkImage image, VkFormat format, VkImageAspectFlags aspectMask, VkImageView &imageView,
+                         uint32_t baseMipLevel = 0, uint32_t levelCount = 1);
+#endif //VULKANDEMO_IMAGE_H
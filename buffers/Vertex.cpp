@@ -5,117 +5,152 @@
 #include "Vertex.h"
 #include "vulkan/vulkan.h"
 #include "../Application.h"
+#include "../mesh/StressGeometry.h"
 #include <array>
 #include <iostream>
 
-/**
- * Creates the basic description of the Vertex object that will be used by the vertex buffer.
- * Essentially defines the stride and the fact that each stride represents a vertex not an instance of a vertex.
- *
- * @return
- */
-VkVertexInputBindingDescription getBindingDescription() {
-  VkVertexInputBindingDescription bindingDescription{};
-  bindingDescription.binding = 0;
-  bindingDescription.stride = sizeof(Vertex);
-  bindingDescription.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
-  return bindingDescription;
+template<typename V>
+static VertexInputDescription describeVertex() {
+  constexpr auto attributes = vertexAttributeDescriptions<V>();
+  return {{vertexBindingDescription<V>()}, {attributes.begin(), attributes.end()}};
 }
 
 /**
- * Creates an array with descriptions for each attribute of the vertex.
- * The first attribute is the vertex position.
- * The second attribute is the vertex color.
- *
- * @return
+ * Vertices from binding 0 and instances from binding 1, whose attributes follow the vertex ones.
  */
-std::array<VkVertexInputAttributeDescription, 2> getAttributeDescriptions() {
-  std::array<VkVertexInputAttributeDescription, 2> attributeDescriptions{};
-  // vertex position attribute
-  attributeDescriptions[0].binding = 0;
-  attributeDescriptions[0].location = 0;
-  attributeDescriptions[0].format = VK_FORMAT_R32G32_SFLOAT;
-  attributeDescriptions[0].offset = offsetof(Vertex, pos);
-
-  // vertex color attribute
-  attributeDescriptions[1].binding = 0;
-  attributeDescriptions[1].location = 1;
-  attributeDescriptions[1].format = VK_FORMAT_R32G32B32_SFLOAT;
-  attributeDescriptions[1].offset = offsetof(Vertex, color);
-  return attributeDescriptions;
+template<typename V, typename I>
+static VertexInputDescription describeInstancedVertex() {
+  VertexInputDescription description = describeVertex<V>();
+  VkVertexInputBindingDescription instanceBinding = vertexBindingDescription<I>(1);
+  instanceBinding.inputRate = VK_VERTEX_INPUT_RATE_INSTANCE;
+  description.bindings.push_back(instanceBinding);
+  const uint32_t firstLocation = static_cast<uint32_t>(description.attributes.size());
+  for (auto attribute : vertexAttributeDescriptions<I>(1)) {
+    attribute.location += firstLocation;
+    description.attributes.push_back(attribute);
+  }
+  return description;
 }
 
 /**
- * Based on the required memory properties, we find the matching GPU memory representation
- * that can satisfy the requirements. We query all available GPU memory types and select
- * not only the appropriate type but one that has properties we need such as the ability
- * to write directly to it from the CPU side.
+ * Creates the binding and attribute descriptions the pipeline builder needs for a vertex layout.
+ * They are generated at compile time from the vertex struct, see VertexTraits.
+ * Each vertex is one stride of the buffer, instanced layouts add a second binding per instance.
  *
- * @param app
- * @param typeFilter
- * @param properties
- * @param errorCode
+ * @param layout
  * @return
  */
-uint32_t findMemoryType(Application &app, uint32_t typeFilter, VkMemoryPropertyFlags properties, VkResult &errorCode) {
-  VkPhysicalDeviceMemoryProperties memProperties;
-  vkGetPhysicalDeviceMemoryProperties(app.physicalDevice.device, &memProperties);
-  for (uint32_t i = 0; i < memProperties.memoryTypeCount; i++) {
-    if ((typeFilter & (1 << i)) &&
-        memProperties.memoryTypes[i].propertyFlags & properties) {
-      return i;
-    }
+VertexInputDescription describeVertexLayout(VertexLayout layout) {
+  switch (layout) {
+    case VERTEX_LAYOUT_HALF2_UNORM4:
+      return describeVertex<HalfVertex>();
+    case VERTEX_LAYOUT_HALF2_UNORM4_OCT16:
+      return describeVertex<OctahedralVertex>();
+    case VERTEX_LAYOUT_POS2_COLOR3_INSTANCED:
+      return describeInstancedVertex<Vertex, ObjectInstance>();
+    case VERTEX_LAYOUT_POS2_COLOR3_PARTICLES:
+      return describeInstancedVertex<Vertex, Particle>();
+    case VERTEX_LAYOUT_POS2_COLOR3:
+    default:
+      return describeVertex<Vertex>();
   }
-  std::cerr << "Unable to find suitable memory type" << std::endl;
-  errorCode = VK_ERROR_MEMORY_MAP_FAILED;
-  return -1;
+}
+
+uint32_t vertexLayoutStride(VertexLayout layout) {
+  return describeVertexLayout(layout).bindings[0].stride;
 }
 
 /**
- * Creates a vertex buffer.
- * First decide how large the buffer will be based on the Vertex struct size and their amount.
- * Create the buffer.
+ * Creates a buffer and binds it to freshly allocated memory.
  * Buffer creation does not allocate memory. We need to query the memory requirements for such a buffer.
  * Find a GPU memory type that matches our requirements.
  * Allocate memory from it.
- * Bind allocated memory to vertex buffer object.
+ * Bind allocated memory to the buffer object.
  *
  * @param app
+ * @param size
+ * @param usage
+ * @param properties
+ * @param category
+ * @param buffer
+ * @param bufferMemory
  * @return
  */
-VkResult createVertexBuffer(Application &app) {
+VkResult createBuffer(Application &app, VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties,
+                      MemoryCategory category, VkBuffer &buffer, VkDeviceMemory &bufferMemory) {
+  TRACE_ZONE("createBuffer");
   VkBufferCreateInfo bufferInfo{};
   bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
-  bufferInfo.size = sizeof(vertices[0]) * vertices.size();
-  bufferInfo.usage = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT;
+  bufferInfo.size = size;
+  bufferInfo.usage = usage;
   bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-  VkResult errorCode = vkCreateBuffer(app.device, &bufferInfo, nullptr, &app.vertexBuffer);
-  throwOnError(errorCode, "Unable to create vertex buffer")
+  VkResult errorCode = vkCreateBuffer(app.device, &bufferInfo, nullptr, &buffer);
+  throwOnError(errorCode, "Unable to create buffer")
   VkMemoryRequirements memRequirements;
-  vkGetBufferMemoryRequirements(app.device, app.vertexBuffer, &memRequirements);
+  vkGetBufferMemoryRequirements(app.device, buffer, &memRequirements);
 
-  VkMemoryAllocateInfo allocInfo{};
-  allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-  allocInfo.allocationSize = memRequirements.size;
-  allocInfo.memoryTypeIndex = findMemoryType(app, memRequirements.memoryTypeBits,
-                                             VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, errorCode);
-  errorCode = vkAllocateMemory(app.device, &allocInfo, nullptr, &app.vertexBufferMemory);
-  throwOnError(errorCode, "Unable to allocate vertex buffer memory")
+  errorCode = allocateMemory(app, memRequirements, properties, category, bufferMemory);
+  throwOnError(errorCode, "Unable to allocate buffer memory")
 
-  // the offset is used if the buffer memory is larger than the vertex buffer size
-  // and the beginning of the vertex buffer is not at the start (offset 0).
+  // the offset is used if the buffer memory is larger than the buffer size
+  // and the beginning of the buffer is not at the start (offset 0).
   // If the offset is non-zero, then it is required to be divisible by memRequirements.alignment.
-  errorCode = vkBindBufferMemory(app.device, app.vertexBuffer, app.vertexBufferMemory, 0);
-  throwOnError(errorCode, "Unable to bind buffer memory to vertex buffer")
+  errorCode = vkBindBufferMemory(app.device, buffer, bufferMemory, 0);
+  throwOnError(errorCode, "Unable to bind buffer memory")
+
+  error:
+  return errorCode;
+}
 
+/**
+ * Creates a vertex buffer.
+ * First decide how large the buffer will be based on the Vertex struct size and their amount.
+ * Create the buffer in host visible memory and copy the vertices into it.
+ *
+ * @param app
+ * @param source
+ * @param count
+ * @param buffer
+ * @param bufferMemory
+ * @return
+ */
+VkResult createVertexBuffer(Application &app, const Vertex *source, size_t count, VkBuffer &buffer, VkDeviceMemory &bufferMemory) {
+  TRACE_ZONE("createVertexBuffer");
+  VkDeviceSize size = sizeof(Vertex) * count;
   void *data;
-  vkMapMemory(app.device, app.vertexBufferMemory, 0, bufferInfo.size, 0, &data);
-  memcpy(data, vertices.data(), (size_t) bufferInfo.size);
+  VkResult errorCode = createBuffer(app, size, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+                                    VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                                    MEMORY_GEOMETRY, buffer, bufferMemory);
+  throwOnError(errorCode, "Unable to create vertex buffer")
+
+  errorCode = vkMapMemory(app.device, bufferMemory, 0, size, 0, &data);
+  throwOnError(errorCode, "Unable to map vertex buffer")
+  memcpy(data, source, (size_t) size);
   // it is possible that the copied memory is not directly visible to the buffer side
   // this is solved by using GPU memory with the HOST_COHERENT property
-  vkUnmapMemory(app.device, app.vertexBufferMemory);
+  vkUnmapMemory(app.device, bufferMemory);
   // the Vulkan spec declares that the copied memory will be visible to the GPU as of the ntext call to vkQueueSubmit
 
   error:
   return errorCode;
 }
+
+/**
+ * Creates the vertex buffer of the scene, the triangle or the stress geometry of the options.
+ *
+ * @param app
+ * @return
+ */
+VkResult createVertexBuffer(Application &app) {
+  if (app.options.stressShape == STRESS_NONE) {
+    app.vertexCount = static_cast<uint32_t>(vertices.size());
+    return createVertexBuffer(app, vertices.data(), vertices.size(), app.vertexBuffer, app.vertexBufferMemory);
+  }
+  std::vector<Vertex> generated;
+  if (!generateStressGeometry(app.options.stressShape, app.options.stressVertices, generated)) {
+    return VK_ERROR_OUT_OF_HOST_MEMORY;
+  }
+  logInfo("Drawing {} vertices of generated {} geometry", generated.size(), stressShapeName(app.options.stressShape));
+  app.vertexCount = static_cast<uint32_t>(generated.size());
+  return createVertexBuffer(app, generated.data(), generated.size(), app.vertexBuffer, app.vertexBufferMemory);
+}
@@ -10,20 +10,107 @@
 #include <array>
 #include "vulkan/vulkan.h"
 #include "../Application.h"
+#include "VertexLayout.h"
 
 struct Vertex {
     glm::vec2 pos;
     glm::vec3 color;
 };
 
+template<> struct VertexTraits<Vertex> {
+    static constexpr VertexLayout layout = VERTEX_LAYOUT_POS2_COLOR3;
+    static constexpr std::array<VertexAttribute, 2> attributes = {
+        VERTEX_ATTRIBUTE(Vertex, pos, 0),
+        VERTEX_ATTRIBUTE(Vertex, color, 1)
+    };
+};
+
+/**
+ * Vertex quantized to 8 bytes. Half floats keep about 3 decimal digits, enough for positions in
+ * normalized device or object space, and 8 bit colors are what the swapchain stores anyway.
+ */
+typedef struct HalfVertex {
+    Half2 pos;
+    Unorm4 color;
+} HalfVertex;
+
+template<> struct VertexTraits<HalfVertex> {
+    static constexpr VertexLayout layout = VERTEX_LAYOUT_HALF2_UNORM4;
+    static constexpr std::array<VertexAttribute, 2> attributes = {
+        VERTEX_ATTRIBUTE(HalfVertex, pos, 0),
+        VERTEX_ATTRIBUTE(HalfVertex, color, 1)
+    };
+};
+
+/**
+ * HalfVertex with a normal, 12 bytes instead of the 32 of a float vec3 normal on top of Vertex.
+ */
+typedef struct OctahedralVertex {
+    Half2 pos;
+    Unorm4 color;
+    OctahedralNormal normal;
+} OctahedralVertex;
+
+template<> struct VertexTraits<OctahedralVertex> {
+    static constexpr VertexLayout layout = VERTEX_LAYOUT_HALF2_UNORM4_OCT16;
+    static constexpr std::array<VertexAttribute, 3> attributes = {
+        VERTEX_ATTRIBUTE(OctahedralVertex, pos, 0),
+        VERTEX_ATTRIBUTE(OctahedralVertex, color, 1),
+        VERTEX_ATTRIBUTE(OctahedralVertex, normal, 2)
+    };
+};
+
+/**
+ * Per instance data of VERTEX_LAYOUT_POS2_COLOR3_INSTANCED: where an instance of a mesh with a
+ * bounding radius of 1 is drawn. It doubles as the bounds the occlusion culling shader tests.
+ */
+typedef struct ObjectInstance {
+    glm::vec4 bounds; // center in normalized device coordinates, radius in half viewport heights, depth
+} ObjectInstance;
+
+template<> struct VertexTraits<ObjectInstance> {
+    static constexpr VertexLayout layout = VERTEX_LAYOUT_POS2_COLOR3_INSTANCED;
+    static constexpr std::array<VertexAttribute, 1> attributes = {
+        VERTEX_ATTRIBUTE(ObjectInstance, bounds, 0)
+    };
+};
+
+/**
+ * Per instance data of VERTEX_LAYOUT_POS2_COLOR3_PARTICLES, written by the particle compute
+ * shaders and drawn as a quad per particle.
+ */
+typedef struct Particle {
+    glm::vec4 positionVelocity; // position and velocity in normalized device coordinates (per second)
+    glm::vec4 colorLife; // rgb and the seconds left to live
+} Particle;
+
+template<> struct VertexTraits<Particle> {
+    static constexpr VertexLayout layout = VERTEX_LAYOUT_POS2_COLOR3_PARTICLES;
+    static constexpr std::array<VertexAttribute, 2> attributes = {
+        VERTEX_ATTRIBUTE(Particle, positionVelocity, 0),
+        VERTEX_ATTRIBUTE(Particle, colorLife, 1)
+    };
+};
+
+static_assert(sizeof(Vertex) == 20 && sizeof(HalfVertex) == 8 && sizeof(OctahedralVertex) == 12,
+              "Vertex sizes changed, update the vertex format benchmark");
+
+typedef struct VertexInputDescription {
+    std::vector<VkVertexInputBindingDescription> bindings;
+    std::vector<VkVertexInputAttributeDescription> attributes;
+} VertexInputDescription;
+
 const std::vector<Vertex> vertices = {
     {{0.0f, -0.5f}, {1.0f, 0.0f, 0.0f}},
     {{0.5f, 0.5f}, {0.0f, 1.0f, 0.0f}},
     {{-0.5f, 0.5f}, {0.0f, 0.0f, 1.0f}}
 };
 
-VkVertexInputBindingDescription getBindingDescription();
-std::array<VkVertexInputAttributeDescription, 2> getAttributeDescriptions();
+VertexInputDescription describeVertexLayout(VertexLayout layout);
+uint32_t vertexLayoutStride(VertexLayout layout);
+VkResult createBuffer(Application &app, VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties,
+                      MemoryCategory category, VkBuffer &buffer, VkDeviceMemory &bufferMemory);
+VkResult createVertexBuffer(Application &app, const Vertex *source, size_t count, VkBuffer &buffer, VkDeviceMemory &bufferMemory);
 VkResult createVertexBuffer(Application &app);
 
 #endif //VULKANDEMO_VERTEX_H
@@ -0,0 +1,86 @@
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+#include "VertexLayout.h"
+
+/**
+ * Converts a float to a half float, rounding to nearest even. Values too large for a half become
+ * infinity and values too small become half subnormals or zero.
+ *
+ * @param value
+ * @return
+ */
+uint16_t packHalf(float value) {
+  uint32_t bits;
+  memcpy(&bits, &value, sizeof(bits));
+  const uint16_t sign = static_cast<uint16_t>((bits >> 16) & 0x8000u);
+  const int32_t exponent = static_cast<int32_t>((bits >> 23) & 0xffu) - 127 + 15;
+  uint32_t mantissa = bits & 0x7fffffu;
+
+  if (((bits >> 23) & 0xffu) == 0xffu) { // infinity or NaN, keep NaNs quiet
+    return static_cast<uint16_t>(sign | 0x7c00u | (mantissa != 0 ? 0x200u : 0));
+  }
+  if (exponent >= 31) {
+    return static_cast<uint16_t>(sign | 0x7c00u);
+  }
+  if (exponent <= 0) {
+    if (exponent < -10) {
+      return sign;
+    }
+    mantissa |= 0x800000u; // implicit leading one, then shift into the subnormal range
+    const uint32_t shift = static_cast<uint32_t>(14 - exponent);
+    uint32_t half = mantissa >> shift;
+    const uint32_t remainder = mantissa & ((1u << shift) - 1);
+    const uint32_t halfway = 1u << (shift - 1);
+    if (remainder > halfway || (remainder == halfway && (half & 1))) {
+      ++half;
+    }
+    return static_cast<uint16_t>(sign | half);
+  }
+  uint32_t half = (static_cast<uint32_t>(exponent) << 10) | (mantissa >> 13);
+  const uint32_t remainder = mantissa & 0x1fffu;
+  if (remainder > 0x1000u || (remainder == 0x1000u && (half & 1))) {
+    ++half; // may carry into the exponent, which rounds up to the next power of two or infinity
+  }
+  return static_cast<uint16_t>(sign | half);
+}
+
+Half2 packHalf2(const glm::vec2 &value) {
+  return {packHalf(value.x), packHalf(value.y)};
+}
+
+static uint8_t packUnorm8(float value) {
+  return static_cast<uint8_t>(std::lround(std::min(std::max(value, 0.0f), 1.0f) * 255.0f));
+}
+
+Unorm4 packUnorm4(const glm::vec3 &color, float alpha) {
+  return {packUnorm8(color.x), packUnorm8(color.y), packUnorm8(color.z), packUnorm8(alpha)};
+}
+
+static int16_t packSnorm16(float value) {
+  return static_cast<int16_t>(std::lround(std::min(std::max(value, -1.0f), 1.0f) * 32767.0f));
+}
+
+/**
+ * Projects a unit vector onto the octahedron |x| + |y| + |z| = 1 and folds the lower half over
+ * the diagonals, so two components describe it. The error is far below 1/32767 radians, the
+ * vertex shader undoes the folding and renormalizes.
+ *
+ * @param normal
+ * @return
+ */
+OctahedralNormal encodeOctahedral(const glm::vec3 &normal) {
+  const float length = std::abs(normal.x) + std::abs(normal.y) + std::abs(normal.z);
+  if (length == 0.0f) {
+    return {0, 0};
+  }
+  float x = normal.x / length;
+  float y = normal.y / length;
+  if (normal.z < 0.0f) {
+    const float foldedX = (1.0f - std::abs(y)) * (x >= 0.0f ? 1.0f : -1.0f);
+    const float foldedY = (1.0f - std::abs(x)) * (y >= 0.0f ? 1.0f : -1.0f);
+    x = foldedX;
+    y = foldedY;
+  }
+  return {packSnorm16(x), packSnorm16(y)};
+}
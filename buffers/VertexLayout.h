@@ -0,0 +1,117 @@
+#ifndef VULKANDEMO_VERTEXLAYOUT_H
+#define VULKANDEMO_VERTEXLAYOUT_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include "glm/glm.hpp"
+#include "../dispatch/Dispatch.h"
+
+// Quantized vertex components. Each one is stored exactly as the GPU reads it.
+
+typedef struct Half2 {
+    uint16_t x, y; // IEEE 754 half floats
+} Half2;
+
+typedef struct Unorm4 {
+    uint8_t r, g, b, a; // [0, 1] in 1/255 steps
+} Unorm4;
+
+typedef struct OctahedralNormal {
+    int16_t x, y; // unit vector projected on an octahedron and unfolded onto [-1, 1]^2
+} OctahedralNormal;
+
+uint16_t packHalf(float value);
+Half2 packHalf2(const glm::vec2 &value);
+Unorm4 packUnorm4(const glm::vec3 &color, float alpha = 1.0f);
+OctahedralNormal encodeOctahedral(const glm::vec3 &normal);
+
+/**
+ * The VkFormat the GPU reads a vertex component type with.
+ */
+template<typename T>
+struct VertexFormat;
+
+template<> struct VertexFormat<glm::vec2> { static constexpr VkFormat format = VK_FORMAT_R32G32_SFLOAT; };
+template<> struct VertexFormat<glm::vec3> { static constexpr VkFormat format = VK_FORMAT_R32G32B32_SFLOAT; };
+template<> struct VertexFormat<glm::vec4> { static constexpr VkFormat format = VK_FORMAT_R32G32B32A32_SFLOAT; };
+template<> struct VertexFormat<Half2> { static constexpr VkFormat format = VK_FORMAT_R16G16_SFLOAT; };
+template<> struct VertexFormat<Unorm4> { static constexpr VkFormat format = VK_FORMAT_R8G8B8A8_UNORM; };
+template<> struct VertexFormat<OctahedralNormal> { static constexpr VkFormat format = VK_FORMAT_R16G16_SNORM; };
+
+constexpr uint32_t vertexFormatSize(VkFormat format) {
+  switch (format) {
+    case VK_FORMAT_R8G8B8A8_UNORM:
+    case VK_FORMAT_R16G16_SNORM:
+    case VK_FORMAT_R16G16_SFLOAT:
+      return 4;
+    case VK_FORMAT_R32G32_SFLOAT:
+      return 8;
+    case VK_FORMAT_R32G32B32_SFLOAT:
+      return 12;
+    case VK_FORMAT_R32G32B32A32_SFLOAT:
+      return 16;
+    default:
+      return 0;
+  }
+}
+
+typedef struct VertexAttribute {
+    uint32_t location;
+    VkFormat format;
+    uint32_t offset;
+    uint32_t size; // of the struct member
+} VertexAttribute;
+
+/**
+ * Describes a member of a vertex struct. The format follows from the member's type, so it can't
+ * drift from the struct definition.
+ */
+#define VERTEX_ATTRIBUTE(vertex, member, location) \
+    VertexAttribute{location, VertexFormat<decltype(vertex::member)>::format, \
+                    static_cast<uint32_t>(offsetof(vertex, member)), static_cast<uint32_t>(sizeof(vertex::member))}
+
+/**
+ * Specialized for every vertex struct next to its definition with its VertexLayout and its
+ * VertexAttribute array, one entry per member in declaration order.
+ */
+template<typename V>
+struct VertexTraits;
+
+/**
+ * A vertex struct is usable as is if every attribute is read with a format of exactly its member's
+ * size, attributes are 4 byte aligned, in order, don't overlap, and leave no padding, so the
+ * stride is the data the GPU fetches and nothing else. Locations are the attribute indices.
+ */
+template<typename V>
+constexpr bool isPackedVertex() {
+  const auto &attributes = VertexTraits<V>::attributes;
+  uint32_t end = 0;
+  for (size_t i = 0; i < attributes.size(); ++i) {
+    if (attributes[i].location != i || vertexFormatSize(attributes[i].format) != attributes[i].size ||
+        attributes[i].offset != end || attributes[i].offset % 4 != 0) {
+      return false;
+    }
+    end = attributes[i].offset + attributes[i].size;
+  }
+  return end == sizeof(V);
+}
+
+template<typename V>
+constexpr VkVertexInputBindingDescription vertexBindingDescription(uint32_t binding = 0) {
+  static_assert(isPackedVertex<V>(), "Vertex attributes don't match the vertex struct");
+  return VkVertexInputBindingDescription{binding, static_cast<uint32_t>(sizeof(V)), VK_VERTEX_INPUT_RATE_VERTEX};
+}
+
+template<typename V>
+constexpr std::array<VkVertexInputAttributeDescription, std::tuple_size<decltype(VertexTraits<V>::attributes)>::value>
+vertexAttributeDescriptions(uint32_t binding = 0) {
+  static_assert(isPackedVertex<V>(), "Vertex attributes don't match the vertex struct");
+  std::array<VkVertexInputAttributeDescription, std::tuple_size<decltype(VertexTraits<V>::attributes)>::value> descriptions{};
+  for (size_t i = 0; i < descriptions.size(); ++i) {
+    const VertexAttribute &attribute = VertexTraits<V>::attributes[i];
+    descriptions[i] = {attribute.location, binding, attribute.format, attribute.offset};
+  }
+  return descriptions;
+}
+#endif //VULKANDEMO_VERTEXLAYOUT_H
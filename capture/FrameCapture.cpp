@@ -0,0 +1,443 @@
+#include <algorithm>
+#include <filesystem>
+#include <string>
+#include <vector>
+#include "FrameCapture.h"
+#include "PngEncoder.h"
+#include "../Application.h"
+#include "../buffers/Vertex.h"
+
+static const char *CAPTURE_DIRECTORY = "capture";
+
+/**
+ * The writer reads every byte of every captured frame, so prefer cached memory for the readback
+ * buffers. Every implementation has a host visible and coherent type to fall back to.
+ */
+static VkMemoryPropertyFlags readbackMemoryProperties(const Application &app) {
+  const VkMemoryPropertyFlags cached = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_CACHED_BIT;
+  for (uint32_t i = 0; i < app.memory.properties.memoryTypeCount; ++i) {
+    if ((app.memory.properties.memoryTypes[i].propertyFlags & cached) == cached) {
+      return cached;
+    }
+  }
+  return VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+}
+
+static VkResult createCaptureSlots(Application &app) {
+  const VkDeviceSize size = static_cast<VkDeviceSize>(app.swapChainExtent.width) * app.swapChainExtent.height * 4;
+  const VkMemoryPropertyFlags properties = readbackMemoryProperties(app);
+  for (auto &slot : app.capture.slots) {
+    VkResult errorCode = createBuffer(app, size, VK_BUFFER_USAGE_TRANSFER_DST_BIT, properties, MEMORY_STAGING,
+                                      slot.buffer, slot.memory);
+    returnOnError(errorCode)
+    void *data;
+    errorCode = vkMapMemory(app.device, slot.memory, 0, VK_WHOLE_SIZE, 0, &data);
+    returnOnError(errorCode)
+    slot.mapped = static_cast<const uint8_t *>(data);
+    slot.width = app.swapChainExtent.width;
+    slot.height = app.swapChainExtent.height;
+    slot.state = CAPTURE_SLOT_FREE;
+  }
+  return VK_SUCCESS;
+}
+
+static void destroyCaptureSlots(Application &app) {
+  for (auto &slot : app.capture.slots) {
+    if (slot.mapped != nullptr) {
+      vkUnmapMemory(app.device, slot.memory);
+      slot.mapped = nullptr;
+    }
+    vkDestroyBuffer(app.device, slot.buffer, nullptr);
+    freeMemory(app, slot.memory);
+    slot.buffer = VK_NULL_HANDLE;
+    slot.memory = VK_NULL_HANDLE;
+  }
+}
+
+/**
+ * Eviction callback: frees the buffers of free readback slots in the heap until bytesNeeded are
+ * freed or only CAPTURE_MIN_SLOTS are left. The ring keeps capturing with fewer slots, dropping
+ * the frames that find the next one busy. Evicted slots come back with the next resize.
+ */
+static void evictCaptureSlots(Application &app, uint32_t heapIndex, VkDeviceSize bytesNeeded) {
+  FrameCapture &capture = app.capture;
+  std::unique_lock<std::mutex> lock(capture.slotMutex, std::try_to_lock);
+  if (!lock.owns_lock() || !capture.enabled) {
+    return; // the slots are being replaced, possibly by the allocation that asks for room
+  }
+  uint32_t liveSlots = 0;
+  for (const auto &slot : capture.slots) {
+    liveSlots += slot.state.load(std::memory_order_acquire) != CAPTURE_SLOT_EVICTED;
+  }
+  VkDeviceSize freed = 0;
+  for (auto &slot : capture.slots) {
+    if (liveSlots <= CAPTURE_MIN_SLOTS || freed >= bytesNeeded) {
+      break;
+    }
+    int expected = CAPTURE_SLOT_FREE;
+    if (allocationHeap(app, slot.memory) != heapIndex ||
+        !slot.state.compare_exchange_strong(expected, CAPTURE_SLOT_EVICTED, std::memory_order_acq_rel)) {
+      continue; // the render thread or the writer owns it, or it lives in another heap
+    }
+    vkUnmapMemory(app.device, slot.memory);
+    vkDestroyBuffer(app.device, slot.buffer, nullptr);
+    freeMemory(app, slot.memory);
+    slot.mapped = nullptr;
+    slot.buffer = VK_NULL_HANDLE;
+    slot.memory = VK_NULL_HANDLE;
+    freed += static_cast<VkDeviceSize>(slot.width) * slot.height * 4;
+    liveSlots--;
+  }
+  if (freed > 0) {
+    logInfo("Frame capture evicted {} MB of readback slots, {} left", freed / (1024.0 * 1024.0), liveSlots);
+  }
+}
+
+static void convertToRgb(const FrameCapture &capture, const CaptureSlot &slot, std::vector<uint8_t> &rgb) {
+  const size_t pixelCount = static_cast<size_t>(slot.width) * slot.height;
+  const uint8_t *source = slot.mapped;
+  const int red = capture.swapRedBlue ? 2 : 0;
+  for (size_t i = 0; i < pixelCount; ++i, source += 4) {
+    rgb[i * 3] = source[red];
+    rgb[i * 3 + 1] = source[1];
+    rgb[i * 3 + 2] = source[2 - red];
+  }
+}
+
+/**
+ * Converts and writes one captured frame, then hands the slot back to the render thread.
+ * Runs on the writer thread.
+ */
+static void writeSlot(Application &app, CaptureSlot &slot, std::vector<uint8_t> &rgb, std::vector<uint8_t> &png) {
+  FrameCapture &capture = app.capture;
+  auto start = std::chrono::steady_clock::now();
+  const size_t pixelCount = static_cast<size_t>(slot.width) * slot.height;
+
+  // no-op on coherent memory, required on cached memory that isn't
+  VkMappedMemoryRange range{};
+  range.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
+  range.memory = slot.memory;
+  range.offset = 0;
+  range.size = VK_WHOLE_SIZE;
+  vkInvalidateMappedMemoryRanges(app.device, 1, &range);
+
+  size_t written = 0;
+  if (app.options.captureFormat == CAPTURE_RAW) {
+    // one stream per resolution so that every file can be fed to a video encoder as is
+    if (capture.rawFile == nullptr || capture.rawWidth != slot.width || capture.rawHeight != slot.height) {
+      if (capture.rawFile != nullptr) {
+        fclose(capture.rawFile);
+      }
+      std::string path = std::string(CAPTURE_DIRECTORY) + "/frames_" + std::to_string(slot.width) + "x" +
+                         std::to_string(slot.height) + ".raw";
+      capture.rawFile = fopen(path.c_str(), "wb");
+      capture.rawWidth = slot.width;
+      capture.rawHeight = slot.height;
+      logInfo("Streaming {} frames to {}", capture.swapRedBlue ? "bgra" : "rgba", path);
+    }
+    if (capture.rawFile != nullptr) {
+      written = fwrite(slot.mapped, 1, pixelCount * 4, capture.rawFile);
+    }
+  } else if (app.options.captureFormat == CAPTURE_MEMORY) {
+    std::lock_guard<std::mutex> lock(capture.mutex);
+    capture.latestFrame.resize(pixelCount * 3);
+    convertToRgb(capture, slot, capture.latestFrame);
+    capture.latestWidth = slot.width;
+    capture.latestHeight = slot.height;
+    written = capture.latestFrame.size();
+  } else {
+    rgb.resize(pixelCount * 3);
+    convertToRgb(capture, slot, rgb);
+    encodePng(rgb.data(), slot.width, slot.height, png);
+    char path[64];
+    snprintf(path, sizeof(path), "%s/frame_%06llu.png", CAPTURE_DIRECTORY, static_cast<unsigned long long>(slot.sequence));
+    FILE *file = fopen(path, "wb");
+    if (file != nullptr) {
+      written = fwrite(png.data(), 1, png.size(), file);
+      fclose(file);
+    }
+  }
+  if (written == 0) {
+    logError("Unable to write captured frame {}", slot.sequence);
+  }
+
+  std::chrono::duration<double, std::micro> elapsed = std::chrono::steady_clock::now() - start;
+  capture.busyMicros += static_cast<uint64_t>(elapsed.count());
+  capture.bytesWritten += written;
+  capture.writtenFrames++;
+  slot.state.store(CAPTURE_SLOT_FREE, std::memory_order_release);
+}
+
+static void captureWriter(Application *app) {
+  FrameCapture &capture = app->capture;
+  std::vector<uint8_t> rgb, png;
+  uint32_t slotIndex;
+  while (true) {
+    if (capture.completed.pop(slotIndex)) {
+      writeSlot(*app, capture.slots[slotIndex], rgb, png);
+      continue;
+    }
+    if (capture.stopping.load()) {
+      break; // the queue was drained above
+    }
+    // the timeout covers a notification that arrives between the empty check and the wait
+    std::unique_lock<std::mutex> lock(capture.mutex);
+    capture.wakeUp.wait_for(lock, std::chrono::milliseconds(5),
+                            [&capture] { return !capture.completed.empty() || capture.stopping.load(); });
+  }
+  if (capture.rawFile != nullptr) {
+    fclose(capture.rawFile);
+    capture.rawFile = nullptr;
+  }
+}
+
+/**
+ * Sets up the readback ring and the writer thread if capturing was requested on the command line.
+ * Requires the swapchain, since the readback buffers are sized for its images.
+ *
+ * @param app
+ * @return
+ */
+VkResult createFrameCapture(Application &app) {
+  TRACE_ZONE("createFrameCapture");
+  FrameCapture &capture = app.capture;
+  if (app.options.captureFormat == CAPTURE_NONE) {
+    return VK_SUCCESS;
+  }
+  if (!(app.swapChainUsage & VK_IMAGE_USAGE_TRANSFER_SRC_BIT)) {
+    logWarning("Swapchain images can't be copied from on this surface, frame capture disabled");
+    return VK_SUCCESS;
+  }
+  switch (app.imageFormat) {
+    case VK_FORMAT_B8G8R8A8_UNORM:
+    case VK_FORMAT_B8G8R8A8_SRGB:
+      capture.swapRedBlue = true;
+      break;
+    case VK_FORMAT_R8G8B8A8_UNORM:
+    case VK_FORMAT_R8G8B8A8_SRGB:
+      capture.swapRedBlue = false;
+      break;
+    default:
+      logWarning("Frame capture doesn't support swapchain format {}, frame capture disabled", app.imageFormat);
+      return VK_SUCCESS;
+  }
+  std::error_code error;
+  if (app.options.captureFormat != CAPTURE_MEMORY) {
+    std::filesystem::create_directories(CAPTURE_DIRECTORY, error);
+  }
+  if (error) {
+    logError("Unable to create the capture directory {}", CAPTURE_DIRECTORY);
+    return VK_ERROR_INITIALIZATION_FAILED;
+  }
+
+  // a slot can only be read back once the fence of its frame has been waited on
+  capture.delay = std::min(std::max(app.options.captureDelay, static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT)), CAPTURE_RING_SIZE - 1);
+  VkResult errorCode;
+  {
+    std::lock_guard<std::mutex> lock(capture.slotMutex);
+    errorCode = createCaptureSlots(app);
+    capture.enabled = errorCode == VK_SUCCESS;
+  }
+  returnOnError(errorCode)
+  addEvictionCallback(app, evictCaptureSlots);
+  capture.startTime = std::chrono::steady_clock::now();
+  capture.writer = std::thread(captureWriter, &app);
+  if (app.options.captureFormat == CAPTURE_MEMORY) {
+    logInfo("Keeping the latest frame in memory with a readback delay of {} frames", capture.delay);
+  } else {
+    logInfo("Capturing frames as {} into {}/ with a readback delay of {} frames",
+            app.options.captureFormat == CAPTURE_RAW ? "raw" : "png", CAPTURE_DIRECTORY, capture.delay);
+  }
+  return VK_SUCCESS;
+}
+
+/**
+ * Hands the slot to the writer thread. Slots are handed over oldest first so that the raw stream
+ * stays in order.
+ */
+static bool handOverCompletedSlots(FrameCapture &capture, bool all) {
+  bool handed = false;
+  for (uint32_t k = 0; k < CAPTURE_RING_SIZE; ++k) {
+    uint32_t index = (capture.nextSlot + k) % CAPTURE_RING_SIZE;
+    CaptureSlot &slot = capture.slots[index];
+    if (slot.state.load(std::memory_order_acquire) != CAPTURE_SLOT_IN_FLIGHT) {
+      continue;
+    }
+    if (!all && capture.frameCounter - slot.frameIndex < capture.delay) {
+      break; // later slots were recorded even more recently
+    }
+    slot.state.store(CAPTURE_SLOT_WRITING, std::memory_order_relaxed);
+    capture.completed.push(index); // never full, it has a place for every slot
+    handed = true;
+  }
+  return handed;
+}
+
+/**
+ * Called on the render thread once per frame, right after waiting for the frame's fence.
+ *
+ * @param app
+ */
+void pollFrameCapture(Application &app) {
+  FrameCapture &capture = app.capture;
+  if (!capture.enabled) {
+    return;
+  }
+  capture.frameCounter++;
+  if (handOverCompletedSlots(capture, false)) {
+    capture.wakeUp.notify_one();
+  }
+}
+
+/**
+ * Records the copy of the presented image into the next readback slot. The image is rendered
+ * in the render pass of the command buffer submitted right before this one, and left in the
+ * present layout. If the next slot is still being written the frame is dropped.
+ *
+ * @param app
+ * @param commandBuffer
+ * @param imageIndex
+ */
+void recordFrameCapture(Application &app, VkCommandBuffer commandBuffer, uint32_t imageIndex) {
+  FrameCapture &capture = app.capture;
+  if (!capture.enabled) {
+    return;
+  }
+  uint32_t index = capture.nextSlot;
+  for (uint32_t k = 1; k < CAPTURE_RING_SIZE && capture.slots[index].state.load() == CAPTURE_SLOT_EVICTED; ++k) {
+    index = (capture.nextSlot + k) % CAPTURE_RING_SIZE;
+  }
+  CaptureSlot &slot = capture.slots[index];
+  // claimed before its buffer is touched, eviction only takes free slots
+  int expected = CAPTURE_SLOT_FREE;
+  if (!slot.state.compare_exchange_strong(expected, CAPTURE_SLOT_IN_FLIGHT, std::memory_order_acquire)) {
+    capture.droppedFrames++;
+    return;
+  }
+
+  VkImageMemoryBarrier toTransfer{};
+  toTransfer.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+  toTransfer.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+  toTransfer.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+  toTransfer.oldLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+  toTransfer.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+  toTransfer.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  toTransfer.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  toTransfer.image = app.swapChainImages[imageIndex];
+  toTransfer.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
+  vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+                       0, nullptr, 0, nullptr, 1, &toTransfer);
+
+  VkBufferImageCopy region{};
+  region.bufferOffset = 0;
+  region.bufferRowLength = 0; // tightly packed
+  region.bufferImageHeight = 0;
+  region.imageSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1};
+  region.imageOffset = {0, 0, 0};
+  region.imageExtent = {slot.width, slot.height, 1};
+  vkCmdCopyImageToBuffer(commandBuffer, app.swapChainImages[imageIndex], VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                         slot.buffer, 1, &region);
+
+  VkImageMemoryBarrier toPresent = toTransfer;
+  toPresent.srcAccessMask = 0;
+  toPresent.dstAccessMask = 0;
+  toPresent.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+  toPresent.newLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+  VkBufferMemoryBarrier toHost{};
+  toHost.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+  toHost.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+  toHost.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+  toHost.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  toHost.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  toHost.buffer = slot.buffer;
+  toHost.offset = 0;
+  toHost.size = VK_WHOLE_SIZE;
+  vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                       VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT | VK_PIPELINE_STAGE_HOST_BIT, 0,
+                       0, nullptr, 1, &toHost, 1, &toPresent);
+
+  slot.frameIndex = capture.frameCounter;
+  slot.sequence = capture.nextSequence++;
+  capture.nextSlot = (index + 1) % CAPTURE_RING_SIZE;
+}
+
+/**
+ * Writes out everything still in flight and waits for the writer. Only called with the device idle,
+ * so every recorded copy has completed.
+ */
+static void flushFrameCapture(Application &app) {
+  FrameCapture &capture = app.capture;
+  handOverCompletedSlots(capture, true);
+  capture.wakeUp.notify_one();
+  for (const auto &slot : capture.slots) {
+    int state;
+    while ((state = slot.state.load(std::memory_order_acquire)) == CAPTURE_SLOT_IN_FLIGHT || state == CAPTURE_SLOT_WRITING) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+  }
+}
+
+/**
+ * Recreates the readback buffers for the new swapchain extent. Must be called with the device idle
+ * after the swapchain has been recreated.
+ *
+ * @param app
+ * @return
+ */
+VkResult resizeFrameCapture(Application &app) {
+  if (!app.capture.enabled) {
+    return VK_SUCCESS;
+  }
+  flushFrameCapture(app);
+  std::lock_guard<std::mutex> lock(app.capture.slotMutex);
+  destroyCaptureSlots(app);
+  return createCaptureSlots(app);
+}
+
+/**
+ * Copies the latest frame captured with CAPTURE_MEMORY. Only called with the device idle, it
+ * reads back everything still in flight first.
+ *
+ * @param app
+ * @param rgb
+ * @param width
+ * @param height
+ * @return false if no frame has been captured
+ */
+bool readLatestCapture(Application &app, std::vector<uint8_t> &rgb, uint32_t &width, uint32_t &height) {
+  FrameCapture &capture = app.capture;
+  if (!capture.enabled) {
+    return false;
+  }
+  flushFrameCapture(app);
+  std::lock_guard<std::mutex> lock(capture.mutex);
+  rgb = capture.latestFrame;
+  width = capture.latestWidth;
+  height = capture.latestHeight;
+  return !rgb.empty();
+}
+
+void destroyFrameCapture(Application &app) {
+  FrameCapture &capture = app.capture;
+  if (!capture.enabled) {
+    return;
+  }
+  flushFrameCapture(app);
+  capture.stopping = true;
+  capture.wakeUp.notify_one();
+  capture.writer.join();
+  {
+    std::lock_guard<std::mutex> lock(capture.slotMutex);
+    destroyCaptureSlots(app);
+    capture.enabled = false;
+  }
+
+  std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - capture.startTime;
+  const double megabytes = capture.bytesWritten / (1024.0 * 1024.0);
+  const double busySeconds = capture.busyMicros / 1e6;
+  const uint64_t frames = capture.writtenFrames;
+  logInfo("Frame capture: {} frames written, {} dropped, {} MB in {} s ({} frames/s)", frames, capture.droppedFrames,
+          megabytes, elapsed.count(), frames / elapsed.count());
+  logInfo("Frame capture writer: {} MB/s while busy, {} ms per frame", busySeconds > 0.0 ? megabytes / busySeconds : 0.0,
+          frames > 0 ? busySeconds * 1000.0 / frames : 0.0);
+}
@@ -0,0 +1,77 @@
+#ifndef VULKANDEMO_FRAMECAPTURE_H
+#define VULKANDEMO_FRAMECAPTURE_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "../dispatch/Dispatch.h"
+#include "../threading/SpscQueue.h"
+
+struct Application;
+
+const uint32_t CAPTURE_RING_SIZE = 8;
+const uint32_t CAPTURE_MIN_SLOTS = 2; // eviction keeps this many, frames that find no free slot are dropped
+
+enum CaptureSlotState {
+    CAPTURE_SLOT_FREE,
+    CAPTURE_SLOT_IN_FLIGHT, // the copy has been recorded, the GPU may not have executed it yet
+    CAPTURE_SLOT_WRITING, // owned by the writer thread until it sets the slot free again
+    CAPTURE_SLOT_EVICTED // its buffer was freed to make room in its heap, until the next resize
+};
+
+typedef struct CaptureSlot {
+    VkBuffer buffer = VK_NULL_HANDLE;
+    VkDeviceMemory memory = VK_NULL_HANDLE;
+    const uint8_t *mapped = nullptr; // persistently mapped
+    uint32_t width = 0;
+    uint32_t height = 0;
+    uint64_t frameIndex = 0; // frame the copy was recorded in
+    uint64_t sequence = 0; // number of the captured frame, used for the file name
+    std::atomic<int> state{CAPTURE_SLOT_FREE};
+} CaptureSlot;
+
+/**
+ * Copies presented images into a ring of host visible buffers and writes them out on a worker thread.
+ * A slot is only read back once the frame that filled it is known to be complete, which is
+ * Options::captureDelay frames later, so the render thread never waits for the GPU or the disk.
+ */
+typedef struct FrameCapture {
+    bool enabled = false;
+    bool swapRedBlue = false; // BGRA swapchain formats
+    uint32_t delay = 0;
+    CaptureSlot slots[CAPTURE_RING_SIZE];
+    uint32_t nextSlot = 0;
+    uint64_t frameCounter = 0;
+    uint64_t nextSequence = 0;
+    uint64_t droppedFrames = 0; // the next slot was still busy
+    SpscQueue<uint32_t, CAPTURE_RING_SIZE> completed; // render thread hands slots to the writer
+    std::thread writer;
+    std::mutex mutex;
+    std::mutex slotMutex; // held while the slots are replaced or evicted
+    std::condition_variable wakeUp;
+    std::atomic<bool> stopping{false};
+
+    // writer thread state
+    FILE *rawFile = nullptr;
+    uint32_t rawWidth = 0;
+    uint32_t rawHeight = 0;
+    std::atomic<uint64_t> writtenFrames{0};
+    std::atomic<uint64_t> bytesWritten{0};
+    std::atomic<uint64_t> busyMicros{0}; // conversion, compression and file writes
+    std::chrono::steady_clock::time_point startTime;
+    std::vector<uint8_t> latestFrame; // CAPTURE_MEMORY, tightly packed RGB, guarded by the mutex
+    uint32_t latestWidth = 0;
+    uint32_t latestHeight = 0;
+} FrameCapture;
+
+VkResult createFrameCapture(Application &app);
+void pollFrameCapture(Application &app);
+void recordFrameCapture(Application &app, VkCommandBuffer commandBuffer, uint32_t imageIndex);
+VkResult resizeFrameCapture(Application &app);
+bool readLatestCapture(Application &app, std::vector<uint8_t> &rgb, uint32_t &width, uint32_t &height);
+void destroyFrameCapture(Application &app);
+#endif //VULKANDEMO_FRAMECAPTURE_H
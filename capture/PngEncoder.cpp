@@ -0,0 +1,228 @@
+#include <algorithm>
+#include <cstring>
+#include "PngEncoder.h"
+
+// Minimal PNG writer: 8 bit RGB, Sub row filter and a single deflate block with the fixed Huffman
+// codes. Rendered frames are mostly flat colors and gradients, which the LZ77 pass alone compresses well.
+
+const uint32_t DEFLATE_WINDOW = 32768;
+const uint32_t HASH_BITS = 15;
+const uint32_t MAX_CHAIN = 16;
+const uint32_t MIN_MATCH = 3;
+const uint32_t MAX_MATCH = 258;
+
+static const uint16_t lengthBase[29] = {3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83,
+                                        99, 115, 131, 163, 195, 227, 258};
+static const uint8_t lengthExtra[29] = {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+static const uint16_t distanceBase[30] = {1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769,
+                                          1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577};
+static const uint8_t distanceExtra[30] = {0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11,
+                                          12, 12, 13, 13};
+
+typedef struct BitWriter {
+    std::vector<uint8_t> &out;
+    uint32_t bits = 0;
+    uint32_t count = 0;
+
+    // deflate packs values starting at the least significant bit
+    void write(uint32_t value, uint32_t length) {
+      bits |= value << count;
+      count += length;
+      while (count >= 8) {
+        out.push_back(static_cast<uint8_t>(bits));
+        bits >>= 8;
+        count -= 8;
+      }
+    }
+
+    // ...except Huffman codes, which go most significant bit first
+    void writeCode(uint32_t code, uint32_t length) {
+      uint32_t reversed = 0;
+      for (uint32_t i = 0; i < length; ++i) {
+        reversed = (reversed << 1) | ((code >> i) & 1);
+      }
+      write(reversed, length);
+    }
+
+    void flush() {
+      if (count > 0) {
+        out.push_back(static_cast<uint8_t>(bits));
+      }
+      bits = 0;
+      count = 0;
+    }
+} BitWriter;
+
+static void writeLiteralLength(BitWriter &writer, uint32_t symbol) {
+  if (symbol < 144) {
+    writer.writeCode(0x30 + symbol, 8);
+  } else if (symbol < 256) {
+    writer.writeCode(0x190 + symbol - 144, 9);
+  } else if (symbol < 280) {
+    writer.writeCode(symbol - 256, 7);
+  } else {
+    writer.writeCode(0xC0 + symbol - 280, 8);
+  }
+}
+
+static void writeMatch(BitWriter &writer, uint32_t length, uint32_t distance) {
+  uint32_t lengthCode = 28;
+  while (lengthBase[lengthCode] > length) {
+    --lengthCode;
+  }
+  writeLiteralLength(writer, 257 + lengthCode);
+  writer.write(length - lengthBase[lengthCode], lengthExtra[lengthCode]);
+  uint32_t distanceCode = 29;
+  while (distanceBase[distanceCode] > distance) {
+    --distanceCode;
+  }
+  writer.writeCode(distanceCode, 5);
+  writer.write(distance - distanceBase[distanceCode], distanceExtra[distanceCode]);
+}
+
+static uint32_t hash3(const uint8_t *data) {
+  return ((data[0] << 16 | data[1] << 8 | data[2]) * 2654435761u) >> (32 - HASH_BITS);
+}
+
+/**
+ * Greedy LZ77 over a hash chain limited to MAX_CHAIN candidates, emitted as one fixed Huffman block
+ * inside a zlib stream.
+ */
+static void deflate(const std::vector<uint8_t> &data, std::vector<uint8_t> &out) {
+  out.push_back(0x78); // zlib header: deflate with a 32K window, no dictionary, fastest
+  out.push_back(0x01);
+  BitWriter writer{out};
+  writer.write(1, 1); // final block
+  writer.write(1, 2); // fixed Huffman codes
+
+  std::vector<int32_t> head(1u << HASH_BITS, -1);
+  std::vector<int32_t> previous(DEFLATE_WINDOW, -1);
+  const size_t size = data.size();
+  auto insert = [&](size_t position) {
+    if (position + MIN_MATCH <= size) {
+      uint32_t hash = hash3(&data[position]);
+      previous[position & (DEFLATE_WINDOW - 1)] = head[hash];
+      head[hash] = static_cast<int32_t>(position);
+    }
+  };
+
+  size_t i = 0;
+  while (i < size) {
+    uint32_t bestLength = 0, bestDistance = 0;
+    if (i + MIN_MATCH <= size) {
+      const uint32_t maxLength = static_cast<uint32_t>(std::min<size_t>(MAX_MATCH, size - i));
+      int32_t candidate = head[hash3(&data[i])];
+      for (uint32_t chain = 0; candidate >= 0 && i - candidate <= DEFLATE_WINDOW && chain < MAX_CHAIN; ++chain) {
+        uint32_t length = 0;
+        while (length < maxLength && data[candidate + length] == data[i + length]) {
+          ++length;
+        }
+        if (length > bestLength) {
+          bestLength = length;
+          bestDistance = static_cast<uint32_t>(i - candidate);
+          if (length == maxLength) {
+            break;
+          }
+        }
+        candidate = previous[candidate & (DEFLATE_WINDOW - 1)];
+      }
+    }
+    if (bestLength >= MIN_MATCH) {
+      writeMatch(writer, bestLength, bestDistance);
+      for (uint32_t k = 0; k < bestLength; ++k) {
+        insert(i + k);
+      }
+      i += bestLength;
+    } else {
+      writeLiteralLength(writer, data[i]);
+      insert(i);
+      ++i;
+    }
+  }
+  writeLiteralLength(writer, 256); // end of block
+  writer.flush();
+
+  uint32_t a = 1, b = 0; // Adler-32 of the uncompressed data
+  for (size_t k = 0; k < size; ++k) {
+    a = (a + data[k]) % 65521;
+    b = (b + a) % 65521;
+  }
+  uint32_t adler = (b << 16) | a;
+  for (int shift = 24; shift >= 0; shift -= 8) {
+    out.push_back(static_cast<uint8_t>(adler >> shift));
+  }
+}
+
+static uint32_t crc32(const uint8_t *data, size_t size) {
+  static uint32_t table[256];
+  static bool initialized = [] {
+    for (uint32_t n = 0; n < 256; ++n) {
+      uint32_t c = n;
+      for (int k = 0; k < 8; ++k) {
+        c = c & 1 ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+      }
+      table[n] = c;
+    }
+    return true;
+  }();
+  (void) initialized;
+  uint32_t crc = 0xFFFFFFFFu;
+  for (size_t i = 0; i < size; ++i) {
+    crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+  }
+  return crc ^ 0xFFFFFFFFu;
+}
+
+static void writeUint32(std::vector<uint8_t> &out, uint32_t value) {
+  for (int shift = 24; shift >= 0; shift -= 8) {
+    out.push_back(static_cast<uint8_t>(value >> shift));
+  }
+}
+
+static void writeChunk(std::vector<uint8_t> &png, const char *type, const std::vector<uint8_t> &data) {
+  writeUint32(png, static_cast<uint32_t>(data.size()));
+  size_t start = png.size();
+  png.insert(png.end(), type, type + 4);
+  png.insert(png.end(), data.begin(), data.end());
+  writeUint32(png, crc32(&png[start], png.size() - start));
+}
+
+/**
+ * Encodes tightly packed 8 bit RGB pixels into a PNG file in memory.
+ *
+ * @param rgb
+ * @param width
+ * @param height
+ * @param png
+ */
+void encodePng(const uint8_t *rgb, uint32_t width, uint32_t height, std::vector<uint8_t> &png) {
+  const size_t stride = static_cast<size_t>(width) * 3;
+  std::vector<uint8_t> filtered;
+  filtered.reserve((stride + 1) * height);
+  for (uint32_t y = 0; y < height; ++y) {
+    const uint8_t *row = rgb + y * stride;
+    filtered.push_back(1); // Sub filter, each byte minus the same channel of the pixel to its left
+    for (size_t x = 0; x < stride; ++x) {
+      filtered.push_back(static_cast<uint8_t>(row[x] - (x >= 3 ? row[x - 3] : 0)));
+    }
+  }
+
+  static const uint8_t signature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+  png.assign(signature, signature + 8);
+
+  std::vector<uint8_t> header;
+  writeUint32(header, width);
+  writeUint32(header, height);
+  header.push_back(8); // bit depth
+  header.push_back(2); // truecolor
+  header.push_back(0); // deflate
+  header.push_back(0); // adaptive filtering
+  header.push_back(0); // no interlace
+  writeChunk(png, "IHDR", header);
+
+  std::vector<uint8_t> compressed;
+  compressed.reserve(filtered.size() / 4);
+  deflate(filtered, compressed);
+  writeChunk(png, "IDAT", compressed);
+  writeChunk(png, "IEND", {});
+}
@@ -0,0 +1,8 @@
+#ifndef VULKANDEMO_PNGENCODER_H
+#define VULKANDEMO_PNGENCODER_H
+
+#include <cstdint>
+#include <vector>
+
+void encodePng(const uint8_t *rgb, uint32_t width, uint32_t height, std::vector<uint8_t> &png);
+#endif //VULKANDEMO_PNGENCODER_H
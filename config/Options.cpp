@@ -0,0 +1,208 @@
+#include <iostream>
+#include <cstring>
+#include <cstdlib>
+#include <cctype>
+#include <cstdint>
+#include <algorithm>
+#include "Options.h"
+
+static void printUsage(const char *executable) {
+  std::cout << "Usage: " << executable << " [options]" << std::endl
+            << "  --bench-specialization   benchmark specialized fragment shader variants against the uber-shader" << std::endl
+            << "  --bench-dispatch [N]     benchmark recording N million commands through the loader and the dispatch table" << std::endl
+            << "  --bench-sprites          benchmark batching and recording sprites" << std::endl
+            << "  --bench-vertex-formats   benchmark vertex throughput of the float and quantized vertex layouts" << std::endl
+            << "  --bench-occlusion        benchmark two phase hierarchical-Z occlusion culling on an occluded scene" << std::endl
+            << "  --bench-lights           benchmark clustered light binning and shading against shading every light" << std::endl
+            << "  --bench-particles        benchmark simulating and drawing GPU particles for growing particle counts" << std::endl
+            << "  --bench-lod              benchmark LOD generation and selection" << std::endl
+            << "  --bench-scene-graph [N]  benchmark world matrix updates of a transform hierarchy of N nodes (default 1M)" << std::endl
+            << "  --bench-stress           draw more and more generated geometry until a frame takes the stress frame time" << std::endl
+            << "  --stress-frame-ms MS     frame time the stress benchmark stops at (default 16.7)" << std::endl
+            << "  --stress-csv FILE        scaling curve of the stress benchmark (default stress_scaling.csv)" << std::endl
+            << "  --bench-io [N]           benchmark loading N small files concurrently (default 4096)" << std::endl
+            << "  --build-lod IN OUT       simplify the OBJ mesh IN into the LOD file OUT and exit" << std::endl
+            << "  --stress grid|terrain|soup draw generated geometry instead of the triangle" << std::endl
+            << "  --stress-vertices N      vertices of the generated geometry (default 1M)" << std::endl
+            << "  --sprites N              draw N animated sprites on top of the scene" << std::endl
+            << "  --lights N               shade the scene with N animated point lights binned into clusters" << std::endl
+            << "  --particles N            draw a fountain of up to N particles simulated in compute shaders" << std::endl
+            << "  --lod-demo               draw a grid of meshes with screen space LOD selection (scroll to zoom)" << std::endl
+            << "  --lod-error PX           largest projected LOD error in pixels (default 1)" << std::endl
+            << "  --mesh FILE              LOD file for the LOD demo instead of the generated asteroid" << std::endl
+            << "  --dynamic-resolution MS  scale the scene resolution to keep the GPU frame time below MS milliseconds" << std::endl
+            << "  --min-resolution-scale S lowest scale of the scene resolution per axis (default 0.5)" << std::endl
+            << "  --resolution-history F   write every resolution change into the CSV file F" << std::endl
+            << "  --windows N              show the scene in N windows that share the device and present together" << std::endl
+            << "  --on-demand              only draw a frame after input, a resize or a change, unless something animates" << std::endl
+            << "  --max-fps N              cap the frame rate at N frames per second" << std::endl
+            << "  --capture png|raw        write every presented frame into ./capture" << std::endl
+            << "  --capture-delay N        frames to wait before reading a captured frame back (default 3)" << std::endl
+            << "  --assets FILE            read shaders and meshes from the archive FILE written by AssetCooker" << std::endl
+            << "  --metrics PORT|unix:P    serve Prometheus metrics on 127.0.0.1:PORT or the Unix domain socket P" << std::endl
+            << "  --trace FILE             write a chrome://tracing / Perfetto timeline of the run into FILE" << std::endl
+            << "  --serial-init            initialize one step after the other instead of overlapping them" << std::endl
+            << "  --single-thread          poll events and draw on the main thread, to compare input latency" << std::endl
+            << "  --list-extensions        print the supported instance extensions" << std::endl
+            << "  --software               accept a software Vulkan implementation, e.g. lavapipe through VK_ICD_FILENAMES" << std::endl
+            << "  --regression NAME        render the scenario given by the other options headless, compare it against" << std::endl
+            << "                           its golden image and baseline metrics and exit with 1 on a regression" << std::endl
+            << "  --regression-dir DIR     directory of golden/ and baselines/ (default ../regression)" << std::endl
+            << "  --regression-update      store the result as the new golden image and baseline" << std::endl
+            << "  --regression-threshold P percent a CPU stage may get slower than the baseline (default 15)" << std::endl
+            << "  --regression-tolerance P percent of pixels that may differ from the golden image (default 0.1)" << std::endl
+            << "  --help                   print this message" << std::endl;
+}
+
+/**
+ * Parses a count of at least the given minimum. Values above UINT32_MAX are clamped instead of
+ * wrapping when narrowed into the option.
+ *
+ * @param text
+ * @param minimum
+ * @return
+ */
+static uint32_t parseCount(const char *text, unsigned long minimum) {
+  unsigned long count = std::max(minimum, strtoul(text, nullptr, 10));
+  return static_cast<uint32_t>(std::min<unsigned long>(count, UINT32_MAX));
+}
+
+/**
+ * Parses the command line into the options struct.
+ *
+ * @param argc
+ * @param argv
+ * @param options
+ * @return false if the application should exit, e.g. on an unknown option
+ */
+bool parseOptions(int argc, char **argv, Options &options) {
+  for (int i = 1; i < argc; ++i) {
+    if (strcmp(argv[i], "--bench-specialization") == 0) {
+      options.benchSpecialization = true;
+    } else if (strcmp(argv[i], "--bench-dispatch") == 0) {
+      options.benchDispatch = true;
+      if (i + 1 < argc && isdigit(static_cast<unsigned char>(argv[i + 1][0]))) {
+        options.dispatchBenchmarkMillions = parseCount(argv[++i], 1);
+      }
+    } else if (strcmp(argv[i], "--bench-sprites") == 0) {
+      options.benchSprites = true;
+    } else if (strcmp(argv[i], "--bench-vertex-formats") == 0) {
+      options.benchVertexFormats = true;
+    } else if (strcmp(argv[i], "--bench-occlusion") == 0) {
+      options.benchOcclusion = true;
+    } else if (strcmp(argv[i], "--bench-lights") == 0) {
+      options.benchLights = true;
+    } else if (strcmp(argv[i], "--bench-particles") == 0) {
+      options.benchParticles = true;
+    } else if (strcmp(argv[i], "--bench-lod") == 0) {
+      options.benchLod = true;
+    } else if (strcmp(argv[i], "--bench-scene-graph") == 0) {
+      options.benchSceneGraph = true;
+      if (i + 1 < argc && isdigit(static_cast<unsigned char>(argv[i + 1][0]))) {
+        options.sceneGraphNodes = parseCount(argv[++i], 1);
+      }
+    } else if (strcmp(argv[i], "--bench-stress") == 0) {
+      options.benchStress = true;
+    } else if (strcmp(argv[i], "--stress-frame-ms") == 0 && i + 1 < argc) {
+      options.stressFrameMs = std::max(0.1f, strtof(argv[++i], nullptr));
+    } else if (strcmp(argv[i], "--stress-csv") == 0 && i + 1 < argc) {
+      options.stressCsvFile = argv[++i];
+    } else if (strcmp(argv[i], "--stress") == 0 && i + 1 < argc) {
+      ++i;
+      if (strcmp(argv[i], "grid") == 0) {
+        options.stressShape = STRESS_GRID;
+      } else if (strcmp(argv[i], "terrain") == 0) {
+        options.stressShape = STRESS_TERRAIN;
+      } else if (strcmp(argv[i], "soup") == 0) {
+        options.stressShape = STRESS_SOUP;
+      } else {
+        std::cerr << "Unknown stress shape " << argv[i] << ", expected grid, terrain or soup" << std::endl;
+        return false;
+      }
+    } else if (strcmp(argv[i], "--stress-vertices") == 0 && i + 1 < argc) {
+      options.stressVertices = std::max(3ul, std::min(strtoul(argv[++i], nullptr, 10), 100000000ul));
+    } else if (strcmp(argv[i], "--bench-io") == 0) {
+      options.benchIo = true;
+      if (i + 1 < argc && isdigit(static_cast<unsigned char>(argv[i + 1][0]))) {
+        options.ioBenchmarkFiles = parseCount(argv[++i], 1);
+      }
+    } else if (strcmp(argv[i], "--build-lod") == 0 && i + 2 < argc) {
+      options.buildLodInput = argv[++i];
+      options.buildLodOutput = argv[++i];
+    } else if (strcmp(argv[i], "--lod-demo") == 0) {
+      options.lodDemo = true;
+    } else if (strcmp(argv[i], "--lod-error") == 0 && i + 1 < argc) {
+      options.lodErrorPixels = std::max(0.01f, strtof(argv[++i], nullptr));
+    } else if (strcmp(argv[i], "--mesh") == 0 && i + 1 < argc) {
+      options.meshFile = argv[++i];
+      options.lodDemo = true;
+    } else if (strcmp(argv[i], "--sprites") == 0 && i + 1 < argc) {
+      options.demoSprites = static_cast<uint32_t>(strtoul(argv[++i], nullptr, 10));
+    } else if (strcmp(argv[i], "--lights") == 0 && i + 1 < argc) {
+      options.lightCount = static_cast<uint32_t>(strtoul(argv[++i], nullptr, 10));
+    } else if (strcmp(argv[i], "--particles") == 0 && i + 1 < argc) {
+      options.particleCount = static_cast<uint32_t>(strtoul(argv[++i], nullptr, 10));
+    } else if (strcmp(argv[i], "--dynamic-resolution") == 0 && i + 1 < argc) {
+      options.dynamicResolutionMs = std::max(0.0f, strtof(argv[++i], nullptr));
+    } else if (strcmp(argv[i], "--min-resolution-scale") == 0 && i + 1 < argc) {
+      options.minResolutionScale = std::min(std::max(0.1f, strtof(argv[++i], nullptr)), 1.0f);
+    } else if (strcmp(argv[i], "--resolution-history") == 0 && i + 1 < argc) {
+      options.resolutionHistoryFile = argv[++i];
+    } else if (strcmp(argv[i], "--windows") == 0 && i + 1 < argc) {
+      options.windowCount = parseCount(argv[++i], 1);
+    } else if (strcmp(argv[i], "--on-demand") == 0) {
+      options.onDemand = true;
+    } else if (strcmp(argv[i], "--max-fps") == 0 && i + 1 < argc) {
+      options.maxFps = std::max(0.0f, strtof(argv[++i], nullptr));
+    } else if (strcmp(argv[i], "--capture") == 0 && i + 1 < argc) {
+      ++i;
+      if (strcmp(argv[i], "png") == 0) {
+        options.captureFormat = CAPTURE_PNG;
+      } else if (strcmp(argv[i], "raw") == 0) {
+        options.captureFormat = CAPTURE_RAW;
+      } else {
+        std::cerr << "Unknown capture format " << argv[i] << std::endl;
+        printUsage(argv[0]);
+        return false;
+      }
+    } else if (strcmp(argv[i], "--capture-delay") == 0 && i + 1 < argc) {
+      options.captureDelay = static_cast<uint32_t>(strtoul(argv[++i], nullptr, 10));
+    } else if (strcmp(argv[i], "--assets") == 0 && i + 1 < argc) {
+      options.assetArchive = argv[++i];
+    } else if (strcmp(argv[i], "--metrics") == 0 && i + 1 < argc) {
+      options.metricsEndpoint = argv[++i];
+    } else if (strcmp(argv[i], "--trace") == 0 && i + 1 < argc) {
+      options.traceFile = argv[++i];
+    } else if (strcmp(argv[i], "--serial-init") == 0) {
+      options.serialInit = true;
+    } else if (strcmp(argv[i], "--single-thread") == 0) {
+      options.singleThread = true;
+    } else if (strcmp(argv[i], "--list-extensions") == 0) {
+      options.listExtensions = true;
+    } else if (strcmp(argv[i], "--software") == 0) {
+      options.allowSoftwareDevice = true;
+    } else if (strcmp(argv[i], "--regression") == 0 && i + 1 < argc) {
+      options.regressionScenario = argv[++i];
+      options.allowSoftwareDevice = true; // the suite is meant to run on lavapipe
+    } else if (strcmp(argv[i], "--regression-dir") == 0 && i + 1 < argc) {
+      options.regressionDirectory = argv[++i];
+    } else if (strcmp(argv[i], "--regression-update") == 0) {
+      options.regressionUpdate = true;
+    } else if (strcmp(argv[i], "--regression-threshold") == 0 && i + 1 < argc) {
+      options.regressionThreshold = std::max(0.0f, strtof(argv[++i], nullptr));
+    } else if (strcmp(argv[i], "--regression-tolerance") == 0 && i + 1 < argc) {
+      options.regressionTolerance = std::max(0.0f, strtof(argv[++i], nullptr));
+    } else if (strcmp(argv[i], "--help") == 0) {
+      printUsage(argv[0]);
+      return false;
+    } else {
+      std::cerr << "Unknown option " << argv[i] << std::endl;
+      printUsage(argv[0]);
+      return false;
+    }
+  }
+  if (!options.regressionScenario.empty()) {
+    options.captureFormat = CAPTURE_MEMORY; // the regression suite reads the presented frames back
+  }
+  return true;
+}
@@ -0,0 +1,74 @@
+#ifndef VULKANDEMO_OPTIONS_H
+#define VULKANDEMO_OPTIONS_H
+
+#include <cstdint>
+#include <string>
+
+enum CaptureFormat {
+    CAPTURE_NONE,
+    CAPTURE_RAW, // every frame appended to one uncompressed stream per resolution
+    CAPTURE_PNG, // one file per frame
+    CAPTURE_MEMORY // only the latest frame, kept in memory for the regression suite
+};
+
+enum StressShape {
+    STRESS_NONE,
+    STRESS_GRID, // a regular grid of quads covering the viewport
+    STRESS_TERRAIN, // a noise heightfield seen from above the horizon
+    STRESS_SOUP // randomly placed and rotated triangles, overlapping a few times
+};
+
+/**
+ * Command line options. Everything defaults to the normal interactive demo.
+ */
+typedef struct Options {
+    bool benchSpecialization = false; // compare specialized fragment shaders against the uber-shader and exit
+    bool benchDispatch = false; // compare command recording through the loader trampoline and the dispatch table and exit
+    uint32_t dispatchBenchmarkMillions = 10; // commands recorded per entry point and round
+    bool benchSprites = false; // measure how many sprites per millisecond the batcher writes and records and exit
+    bool benchVertexFormats = false; // compare vertex throughput of the full float and the quantized vertex layouts and exit
+    bool benchOcclusion = false; // draw an occlusion heavy scene with and without hierarchical-Z culling and exit
+    bool benchLights = false; // compare clustered shading against looping over every light for growing light counts and exit
+    bool benchParticles = false; // measure how many particles per millisecond the compute passes simulate and exit
+    bool benchLod = false; // build LODs of a generated mesh, sweep the selection over screen sizes and exit
+    bool benchSceneGraph = false; // update the world matrices of a generated transform hierarchy and exit
+    uint32_t sceneGraphNodes = 1000000; // nodes of the benchmark hierarchy
+    bool benchStress = false; // draw more and more generated vertices until a frame takes stressFrameMs and exit
+    float stressFrameMs = 16.7f;
+    std::string stressCsvFile = "stress_scaling.csv"; // the scaling curve of the stress benchmark
+    bool benchIo = false; // load many small files through the file system backends and exit
+    uint32_t ioBenchmarkFiles = 4096;
+    StressShape stressShape = STRESS_NONE; // generated geometry drawn instead of the triangle, also the shape the stress benchmark sweeps
+    uint32_t stressVertices = 1000000;
+    uint32_t demoSprites = 0; // sprites drawn on top of the scene every frame
+    uint32_t lightCount = 0; // animated point lights the scene is shaded with through clustered forward lighting
+    uint32_t particleCount = 0; // capacity of the GPU particle fountain drawn over the scene, 0 for none
+    bool lodDemo = false; // draw a grid of simplified meshes whose LOD follows their size on screen
+    float lodErrorPixels = 1.0f; // largest projected simplification error a LOD may have
+    std::string meshFile; // LOD file drawn by the LOD demo instead of the generated asteroid
+    std::string buildLodInput; // OBJ file to simplify into buildLodOutput before anything else runs
+    std::string buildLodOutput;
+    float dynamicResolutionMs = 0.0f; // GPU frame time the scene resolution adapts to, 0 renders at the window resolution
+    float minResolutionScale = 0.5f; // of the window resolution per axis
+    std::string resolutionHistoryFile; // CSV of every resolution change, written on exit
+    uint32_t windowCount = 1; // windows showing the scene, all rendered in one submission and presented together
+    bool onDemand = false; // the render thread sleeps until input, a resize or a change, unless the scene animates
+    float maxFps = 0.0f; // frame rate cap, 0 for none
+    CaptureFormat captureFormat = CAPTURE_NONE;
+    uint32_t captureDelay = 3; // frames between copying a presented image and reading it back
+    std::string assetArchive; // cooked archive shaders and meshes are read from before falling back to loose files
+    std::string metricsEndpoint; // port on 127.0.0.1 or unix:PATH Prometheus metrics are served on, empty for none
+    std::string traceFile; // chrome://tracing / Perfetto JSON timeline of the CPU and GPU zones, written on exit
+    bool serialInit = false; // run every initialization step on the main thread one after the other
+    bool singleThread = false; // poll events and draw on the main thread, as before the render thread, to compare latency
+    bool listExtensions = false; // print every instance extension the loader supports
+    bool allowSoftwareDevice = false; // accept a CPU implementation like lavapipe when there is no discrete GPU
+    std::string regressionScenario; // render this scenario, compare it against its golden image and baseline and exit
+    std::string regressionDirectory = "../regression"; // golden/<scenario>.ppm and baselines/<scenario>.txt
+    bool regressionUpdate = false; // store the rendered image and metrics as the new golden image and baseline
+    float regressionThreshold = 15.0f; // percent a CPU stage may get slower than its baseline
+    float regressionTolerance = 0.1f; // percent of pixels that may differ visibly from the golden image
+} Options;
+
+bool parseOptions(int argc, char **argv, Options &options);
+#endif //VULKANDEMO_OPTIONS_H
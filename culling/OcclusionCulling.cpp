@@ -0,0 +1,441 @@
+#include <cstring>
+#include "OcclusionCulling.h"
+#include "../buffers/Image.h"
+#include "../pipeline/Compute.h"
+#include "../pipeline/GraphicsPipeline.h"
+
+const uint32_t REDUCE_GROUP_SIZE = 8; // local_size of hzb_reduce.comp in both dimensions
+const uint32_t CULL_GROUP_SIZE = 64; // local_size_x of occlusion_cull.comp
+
+typedef struct ReduceConstants {
+    int32_t sourceSize[2];
+    int32_t destinationSize[2];
+} ReduceConstants;
+
+typedef struct CullConstants {
+    uint32_t objectCount;
+    uint32_t phase;
+    int32_t levelCount;
+    uint32_t padding;
+    float viewportSize[2];
+} CullConstants;
+
+/**
+ * A pipeline layout with the set layout and push constants of pushConstantSize, and the pipeline.
+ */
+static VkResult createCullingPipeline(Application &app, const std::string &shaderFile, VkDescriptorSetLayout setLayout,
+                                      uint32_t pushConstantSize, VkPipelineLayout &layout, VkPipeline &pipeline) {
+  VkPushConstantRange pushConstantRange{VK_SHADER_STAGE_COMPUTE_BIT, 0, pushConstantSize};
+  VkPipelineLayoutCreateInfo layoutInfo{};
+  layoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+  layoutInfo.setLayoutCount = 1;
+  layoutInfo.pSetLayouts = &setLayout;
+  layoutInfo.pushConstantRangeCount = 1;
+  layoutInfo.pPushConstantRanges = &pushConstantRange;
+  VkResult errorCode = vkCreatePipelineLayout(app.device, &layoutInfo, nullptr, &layout);
+  returnOnError(errorCode)
+  return createComputePipeline(app, shaderFile, layout, pipeline);
+}
+
+static VkResult createDescriptorSetLayout(Application &app, const std::vector<VkDescriptorType> &types,
+                                          VkDescriptorSetLayout &setLayout) {
+  std::vector<VkDescriptorSetLayoutBinding> bindings(types.size());
+  for (uint32_t i = 0; i < types.size(); ++i) {
+    bindings[i] = {i, types[i], 1, VK_SHADER_STAGE_COMPUTE_BIT, nullptr};
+  }
+  VkDescriptorSetLayoutCreateInfo layoutInfo{};
+  layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+  layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+  layoutInfo.pBindings = bindings.data();
+  return vkCreateDescriptorSetLayout(app.device, &layoutInfo, nullptr, &setLayout);
+}
+
+/**
+ * Creates the pyramid, halving each level rounding up down to 1x1, its views and the sampler the
+ * shaders fetch texels through. Level 0 is half the viewport, a texel of level N covers
+ * 2^(N+1) pixels in each dimension.
+ */
+static VkResult createDepthPyramid(Application &app, OcclusionCuller &culler) {
+  VkExtent2D extent{divideRoundingUp(culler.viewport.width, 2), divideRoundingUp(culler.viewport.height, 2)};
+  culler.levelExtents.push_back(extent);
+  while (extent.width > 1 || extent.height > 1) {
+    extent = {divideRoundingUp(extent.width, 2), divideRoundingUp(extent.height, 2)};
+    culler.levelExtents.push_back(extent);
+  }
+  const uint32_t levelCount = static_cast<uint32_t>(culler.levelExtents.size());
+  VkResult errorCode = createImage(app, culler.levelExtents[0].width, culler.levelExtents[0].height, DEPTH_PYRAMID_FORMAT,
+                                   VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT,
+                                   MEMORY_ATTACHMENTS, culler.pyramid, culler.pyramidMemory, levelCount);
+  returnOnError(errorCode)
+  errorCode = createImageView(app, culler.pyramid, DEPTH_PYRAMID_FORMAT, VK_IMAGE_ASPECT_COLOR_BIT, culler.pyramidView, 0,
+                              levelCount);
+  returnOnError(errorCode)
+  culler.levelViews.resize(levelCount, VK_NULL_HANDLE);
+  for (uint32_t level = 0; level < levelCount; ++level) {
+    errorCode = createImageView(app, culler.pyramid, DEPTH_PYRAMID_FORMAT, VK_IMAGE_ASPECT_COLOR_BIT,
+                                culler.levelViews[level], level, 1);
+    returnOnError(errorCode)
+  }
+
+  VkSamplerCreateInfo samplerInfo{};
+  samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+  samplerInfo.magFilter = VK_FILTER_NEAREST;
+  samplerInfo.minFilter = VK_FILTER_NEAREST;
+  samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+  samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+  samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+  samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+  samplerInfo.maxLod = static_cast<float>(levelCount);
+  return vkCreateSampler(app.device, &samplerInfo, nullptr, &culler.sampler);
+}
+
+static VkResult createCullBuffers(Application &app, OcclusionCuller &culler, const std::vector<ObjectInstance> &objects) {
+  const VkDeviceSize objectSize = sizeof(ObjectInstance) * objects.size();
+  VkResult errorCode = createBuffer(app, objectSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+                                    VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                                    MEMORY_GEOMETRY, culler.objectBuffer, culler.objectMemory);
+  returnOnError(errorCode)
+  void *data;
+  errorCode = vkMapMemory(app.device, culler.objectMemory, 0, objectSize, 0, &data);
+  returnOnError(errorCode)
+  memcpy(data, objects.data(), (size_t) objectSize);
+  vkUnmapMemory(app.device, culler.objectMemory);
+
+  errorCode = createBuffer(app, sizeof(uint32_t) * objects.size(), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                           VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, MEMORY_GEOMETRY, culler.visibilityBuffer, culler.visibilityMemory);
+  returnOnError(errorCode)
+  errorCode = createBuffer(app, objectSize * CULL_PHASE_COUNT, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+                           VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, MEMORY_GEOMETRY, culler.instanceBuffer, culler.instanceMemory);
+  returnOnError(errorCode)
+
+  // host visible so the instance counts can be read back once the frame is done
+  const VkDeviceSize drawSize = sizeof(VkDrawIndexedIndirectCommand) * CULL_PHASE_COUNT;
+  errorCode = createBuffer(app, drawSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT |
+                                          VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                           VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                           MEMORY_GEOMETRY, culler.drawBuffer, culler.drawMemory);
+  returnOnError(errorCode)
+  errorCode = vkMapMemory(app.device, culler.drawMemory, 0, drawSize, 0, &data);
+  returnOnError(errorCode)
+  culler.draws = static_cast<VkDrawIndexedIndirectCommand *>(data);
+  memset(culler.draws, 0, (size_t) drawSize);
+  return VK_SUCCESS;
+}
+
+static VkResult createCullDescriptors(Application &app, OcclusionCuller &culler, VkImageView depthView) {
+  const uint32_t levelCount = static_cast<uint32_t>(culler.levelViews.size());
+  VkDescriptorPoolSize poolSizes[] = {
+      {VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, levelCount + 1},
+      {VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, levelCount},
+      {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 4}
+  };
+  VkDescriptorPoolCreateInfo poolInfo{};
+  poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+  poolInfo.maxSets = levelCount + 1;
+  poolInfo.poolSizeCount = 3;
+  poolInfo.pPoolSizes = poolSizes;
+  VkResult errorCode = vkCreateDescriptorPool(app.device, &poolInfo, nullptr, &culler.descriptorPool);
+  returnOnError(errorCode)
+
+  std::vector<VkDescriptorSetLayout> setLayouts(levelCount, culler.reduceSetLayout);
+  setLayouts.push_back(culler.cullSetLayout);
+  std::vector<VkDescriptorSet> sets(setLayouts.size());
+  VkDescriptorSetAllocateInfo allocInfo{};
+  allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+  allocInfo.descriptorPool = culler.descriptorPool;
+  allocInfo.descriptorSetCount = static_cast<uint32_t>(setLayouts.size());
+  allocInfo.pSetLayouts = setLayouts.data();
+  errorCode = vkAllocateDescriptorSets(app.device, &allocInfo, sets.data());
+  returnOnError(errorCode)
+  culler.reduceSets.assign(sets.begin(), sets.begin() + levelCount);
+  culler.cullSet = sets.back();
+
+  // level N reads level N - 1, level 0 reads the depth buffer, which the depth pass leaves read only
+  std::vector<VkDescriptorImageInfo> imageInfos;
+  imageInfos.reserve(levelCount * 2 + 1);
+  std::vector<VkWriteDescriptorSet> writes;
+  for (uint32_t level = 0; level < levelCount; ++level) {
+    imageInfos.push_back({culler.sampler, level == 0 ? depthView : culler.levelViews[level - 1],
+                          level == 0 ? VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL : VK_IMAGE_LAYOUT_GENERAL});
+    imageInfos.push_back({VK_NULL_HANDLE, culler.levelViews[level], VK_IMAGE_LAYOUT_GENERAL});
+    VkWriteDescriptorSet write{};
+    write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    write.dstSet = culler.reduceSets[level];
+    write.descriptorCount = 1;
+    write.dstBinding = 0;
+    write.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    write.pImageInfo = &imageInfos[imageInfos.size() - 2];
+    writes.push_back(write);
+    write.dstBinding = 1;
+    write.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+    write.pImageInfo = &imageInfos.back();
+    writes.push_back(write);
+  }
+
+  const VkDescriptorBufferInfo bufferInfos[] = {
+      {culler.objectBuffer, 0, VK_WHOLE_SIZE},
+      {culler.visibilityBuffer, 0, VK_WHOLE_SIZE},
+      {culler.drawBuffer, 0, VK_WHOLE_SIZE},
+      {culler.instanceBuffer, 0, VK_WHOLE_SIZE}
+  };
+  for (uint32_t binding = 0; binding < 4; ++binding) {
+    VkWriteDescriptorSet write{};
+    write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    write.dstSet = culler.cullSet;
+    write.dstBinding = binding;
+    write.descriptorCount = 1;
+    write.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    write.pBufferInfo = &bufferInfos[binding];
+    writes.push_back(write);
+  }
+  imageInfos.push_back({culler.sampler, culler.pyramidView, VK_IMAGE_LAYOUT_GENERAL});
+  VkWriteDescriptorSet write{};
+  write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+  write.dstSet = culler.cullSet;
+  write.dstBinding = 4;
+  write.descriptorCount = 1;
+  write.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+  write.pImageInfo = &imageInfos.back();
+  writes.push_back(write);
+
+  vkUpdateDescriptorSets(app.device, static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
+  return VK_SUCCESS;
+}
+
+/**
+ * Moves the pyramid to the general layout it stays in and fills it with the far plane, so the
+ * first frame's early phase, which has no previous frame, finds nothing occluded.
+ */
+static VkResult clearDepthPyramid(Application &app, OcclusionCuller &culler) {
+  VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+  VkCommandBufferAllocateInfo allocInfo{};
+  allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+  allocInfo.commandPool = app.commandPool;
+  allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+  allocInfo.commandBufferCount = 1;
+  VkResult errorCode = vkAllocateCommandBuffers(app.device, &allocInfo, &commandBuffer);
+  returnOnError(errorCode)
+
+  {
+    VkCommandBufferBeginInfo beginInfo{};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    errorCode = vkBeginCommandBuffer(commandBuffer, &beginInfo);
+    throwOnError(errorCode, "Failed to begin recording depth pyramid initialization")
+    VkImageSubresourceRange levels{VK_IMAGE_ASPECT_COLOR_BIT, 0, static_cast<uint32_t>(culler.levelViews.size()), 0, 1};
+    VkImageMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    barrier.srcAccessMask = 0;
+    barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    barrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.image = culler.pyramid;
+    barrier.subresourceRange = levels;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+                         0, nullptr, 0, nullptr, 1, &barrier);
+    VkClearColorValue farPlane{};
+    farPlane.float32[0] = 1.0f;
+    vkCmdClearColorImage(commandBuffer, culler.pyramid, VK_IMAGE_LAYOUT_GENERAL, &farPlane, 1, &levels);
+    memoryBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT,
+                  VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+    errorCode = vkEndCommandBuffer(commandBuffer);
+    throwOnError(errorCode, "Failed to end recording depth pyramid initialization")
+
+    VkSubmitInfo submitInfo{};
+    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submitInfo.commandBufferCount = 1;
+    submitInfo.pCommandBuffers = &commandBuffer;
+    errorCode = vkQueueSubmit(app.graphicsQueue, 1, &submitInfo, VK_NULL_HANDLE);
+    throwOnError(errorCode, "Failed to submit depth pyramid initialization")
+    vkQueueWaitIdle(app.graphicsQueue);
+  }
+
+  error:
+  vkFreeCommandBuffers(app.device, app.commandPool, 1, &commandBuffer);
+  return errorCode;
+}
+
+/**
+ * Creates the depth pyramid, the buffers and the compute pipelines for culling the given objects,
+ * all instances of the mesh at indexCount indices from firstIndex, in a viewport of the given
+ * extent. The depth view is the depth attachment the objects are drawn with.
+ * On failure the culler must still be destroyed.
+ *
+ * @param app
+ * @param depthView
+ * @param viewport
+ * @param objects
+ * @param indexCount
+ * @param firstIndex
+ * @param culler
+ * @return
+ */
+VkResult createOcclusionCuller(Application &app, VkImageView depthView, VkExtent2D viewport,
+                               const std::vector<ObjectInstance> &objects, uint32_t indexCount, uint32_t firstIndex,
+                               OcclusionCuller &culler) {
+  TRACE_ZONE("createOcclusionCuller");
+  culler.objectCount = static_cast<uint32_t>(objects.size());
+  culler.viewport = viewport;
+  culler.indexCount = indexCount;
+  culler.firstIndex = firstIndex;
+  VkResult errorCode = createDepthPyramid(app, culler);
+  returnOnError(errorCode)
+  errorCode = createCullBuffers(app, culler, objects);
+  returnOnError(errorCode)
+
+  errorCode = createDescriptorSetLayout(app, {VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE},
+                                        culler.reduceSetLayout);
+  returnOnError(errorCode)
+  errorCode = createDescriptorSetLayout(app, {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                                              VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                                              VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER}, culler.cullSetLayout);
+  returnOnError(errorCode)
+  errorCode = createCullingPipeline(app, "../shaders/hzb_reduce.spv", culler.reduceSetLayout, sizeof(ReduceConstants),
+                                    culler.reduceLayout, culler.reducePipeline);
+  if (errorCode != VK_SUCCESS) {
+    logError("Unable to create depth pyramid pipeline");
+    return errorCode;
+  }
+  errorCode = createCullingPipeline(app, "../shaders/occlusion_cull.spv", culler.cullSetLayout, sizeof(CullConstants),
+                                    culler.cullLayout, culler.cullPipeline);
+  if (errorCode != VK_SUCCESS) {
+    logError("Unable to create occlusion culling pipeline");
+    return errorCode;
+  }
+  errorCode = createCullDescriptors(app, culler, depthView);
+  returnOnError(errorCode)
+  return clearDepthPyramid(app, culler);
+}
+
+/**
+ * Records one culling phase. The early phase also resets the indirect draws, so it must come
+ * first in the frame, and waits for the previous frame to be done with the buffers it rewrites.
+ * Afterwards the phase's draw can be recorded with recordOcclusionDraw.
+ *
+ * @param app
+ * @param culler
+ * @param commandBuffer
+ * @param phase
+ */
+void recordOcclusionCull(Application &app, OcclusionCuller &culler, VkCommandBuffer commandBuffer, CullPhase phase) {
+  if (phase == CULL_PHASE_EARLY) {
+    memoryBarrier(commandBuffer, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT |
+                                 VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT,
+                  VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                  VK_ACCESS_TRANSFER_WRITE_BIT | VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+    VkDrawIndexedIndirectCommand draws[CULL_PHASE_COUNT];
+    for (auto &draw : draws) {
+      draw = {culler.indexCount, 0, culler.firstIndex, 0, 0}; // the culling pass counts the instances
+    }
+    vkCmdUpdateBuffer(commandBuffer, culler.drawBuffer, 0, sizeof(draws), draws);
+    memoryBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT,
+                  VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+  }
+
+  CullConstants constants{};
+  constants.objectCount = culler.objectCount;
+  constants.phase = phase;
+  constants.levelCount = static_cast<int32_t>(culler.levelViews.size());
+  constants.viewportSize[0] = static_cast<float>(culler.viewport.width);
+  constants.viewportSize[1] = static_cast<float>(culler.viewport.height);
+  vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, culler.cullPipeline);
+  vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, culler.cullLayout, 0, 1, &culler.cullSet, 0, nullptr);
+  vkCmdPushConstants(commandBuffer, culler.cullLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(constants), &constants);
+  vkCmdDispatch(commandBuffer, divideRoundingUp(culler.objectCount, CULL_GROUP_SIZE), 1, 1);
+
+  // the host reads the instance counts back for the statistics once the frame is done
+  memoryBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT,
+                VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_HOST_BIT,
+                VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_HOST_READ_BIT);
+}
+
+/**
+ * Reduces the depth buffer into the pyramid, one dispatch per level. Must be recorded outside of
+ * the render pass that drew the depth, which must leave it in the depth read only layout and make
+ * its writes visible to the compute shader stage.
+ *
+ * @param app
+ * @param culler
+ * @param commandBuffer
+ */
+void recordDepthPyramid(Application &app, OcclusionCuller &culler, VkCommandBuffer commandBuffer) {
+  // the early phase is done reading the previous frame's pyramid
+  memoryBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0);
+  vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, culler.reducePipeline);
+  VkExtent2D source = culler.viewport;
+  for (size_t level = 0; level < culler.levelViews.size(); ++level) {
+    const VkExtent2D destination = culler.levelExtents[level];
+    ReduceConstants constants{{static_cast<int32_t>(source.width), static_cast<int32_t>(source.height)},
+                              {static_cast<int32_t>(destination.width), static_cast<int32_t>(destination.height)}};
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, culler.reduceLayout, 0, 1,
+                            &culler.reduceSets[level], 0, nullptr);
+    vkCmdPushConstants(commandBuffer, culler.reduceLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(constants), &constants);
+    vkCmdDispatch(commandBuffer, divideRoundingUp(destination.width, REDUCE_GROUP_SIZE),
+                  divideRoundingUp(destination.height, REDUCE_GROUP_SIZE), 1);
+    // the next level, or the late culling phase after the last one, reads what this one wrote
+    memoryBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT,
+                  VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT);
+    source = destination;
+  }
+}
+
+/**
+ * Draws the instances the given phase found visible with a single indexed indirect draw. The
+ * caller binds an instanced pipeline (VERTEX_LAYOUT_POS2_COLOR3_INSTANCED) and the mesh's vertex
+ * and index buffers, this binds the compacted instances to binding 1.
+ *
+ * @param app
+ * @param culler
+ * @param commandBuffer
+ * @param phase
+ */
+void recordOcclusionDraw(Application &app, OcclusionCuller &culler, VkCommandBuffer commandBuffer, CullPhase phase) {
+  // instance attributes start at firstInstance, which indirect draws can only set with drawIndirectFirstInstance
+  const VkDeviceSize instanceOffset = sizeof(ObjectInstance) * culler.objectCount * phase;
+  vkCmdBindVertexBuffers(commandBuffer, 1, 1, &culler.instanceBuffer, &instanceOffset);
+  vkCmdDrawIndexedIndirect(commandBuffer, culler.drawBuffer, sizeof(VkDrawIndexedIndirectCommand) * phase, 1,
+                           sizeof(VkDrawIndexedIndirectCommand));
+}
+
+/**
+ * How many objects each phase drew in the last frame. Only valid once that frame completed.
+ *
+ * @param culler
+ * @return
+ */
+OcclusionStats getOcclusionStats(const OcclusionCuller &culler) {
+  OcclusionStats stats{};
+  stats.objects = culler.objectCount;
+  for (uint32_t phase = 0; phase < CULL_PHASE_COUNT; ++phase) {
+    stats.drawn[phase] = culler.draws[phase].instanceCount;
+  }
+  return stats;
+}
+
+void destroyOcclusionCuller(Application &app, OcclusionCuller &culler) {
+  vkDestroyDescriptorPool(app.device, culler.descriptorPool, nullptr); // frees the sets too
+  vkDestroyPipeline(app.device, culler.cullPipeline, nullptr);
+  vkDestroyPipeline(app.device, culler.reducePipeline, nullptr);
+  vkDestroyPipelineLayout(app.device, culler.cullLayout, nullptr);
+  vkDestroyPipelineLayout(app.device, culler.reduceLayout, nullptr);
+  vkDestroyDescriptorSetLayout(app.device, culler.cullSetLayout, nullptr);
+  vkDestroyDescriptorSetLayout(app.device, culler.reduceSetLayout, nullptr);
+  vkDestroyBuffer(app.device, culler.instanceBuffer, nullptr);
+  freeMemory(app, culler.instanceMemory);
+  vkDestroyBuffer(app.device, culler.drawBuffer, nullptr);
+  freeMemory(app, culler.drawMemory); // unmaps it
+  vkDestroyBuffer(app.device, culler.visibilityBuffer, nullptr);
+  freeMemory(app, culler.visibilityMemory);
+  vkDestroyBuffer(app.device, culler.objectBuffer, nullptr);
+  freeMemory(app, culler.objectMemory);
+  vkDestroySampler(app.device, culler.sampler, nullptr);
+  for (auto levelView : culler.levelViews) {
+    vkDestroyImageView(app.device, levelView, nullptr);
+  }
+  vkDestroyImageView(app.device, culler.pyramidView, nullptr);
+  vkDestroyImage(app.device, culler.pyramid, nullptr);
+  freeMemory(app, culler.pyramidMemory);
+  culler = OcclusionCuller{};
+}
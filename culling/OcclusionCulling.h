@@ -0,0 +1,73 @@
+#ifndef VULKANDEMO_OCCLUSIONCULLING_H
+#define VULKANDEMO_OCCLUSIONCULLING_H
+
+#include <vector>
+#include "../Application.h"
+#include "../buffers/Vertex.h"
+
+const VkFormat DEPTH_PYRAMID_FORMAT = VK_FORMAT_R32_SFLOAT;
+
+enum CullPhase : uint32_t {
+    CULL_PHASE_EARLY = 0, // against the previous frame's depth pyramid
+    CULL_PHASE_LATE = 1, // the early phase's rejects against the pyramid of what the early phase drew
+    CULL_PHASE_COUNT
+};
+
+typedef struct OcclusionStats {
+    uint32_t objects;
+    uint32_t drawn[CULL_PHASE_COUNT];
+} OcclusionStats;
+
+/**
+ * Hierarchical-Z occlusion culling of instances of one mesh. A compute pass reduces the depth
+ * buffer into a pyramid of the farthest depth per texel, a compute culling pass tests the bounds
+ * of every object against it and appends the visible ones to a compacted instance list, drawn
+ * with one indirect draw per phase whose instance count the culling pass writes.
+ *
+ * A frame runs: early cull, draw, depth pyramid, late cull, draw. The pyramid is kept for the
+ * early phase of the next frame. It lacks what the late phase drew, which only makes the next
+ * early phase draw more, never less, than it has to.
+ */
+typedef struct OcclusionCuller {
+    uint32_t objectCount = 0;
+    VkExtent2D viewport{};
+    uint32_t indexCount = 0; // of the mesh every object is an instance of
+    uint32_t firstIndex = 0;
+
+    VkImage pyramid = VK_NULL_HANDLE;
+    VkDeviceMemory pyramidMemory = VK_NULL_HANDLE;
+    VkImageView pyramidView = VK_NULL_HANDLE; // all levels, read by the culling pass
+    std::vector<VkImageView> levelViews; // written by the reduction
+    std::vector<VkExtent2D> levelExtents;
+    VkSampler sampler = VK_NULL_HANDLE;
+
+    VkBuffer objectBuffer = VK_NULL_HANDLE; // ObjectInstance per object
+    VkDeviceMemory objectMemory = VK_NULL_HANDLE;
+    VkBuffer visibilityBuffer = VK_NULL_HANDLE; // whether the early phase drew the object
+    VkDeviceMemory visibilityMemory = VK_NULL_HANDLE;
+    VkBuffer drawBuffer = VK_NULL_HANDLE; // one VkDrawIndexedIndirectCommand per phase
+    VkDeviceMemory drawMemory = VK_NULL_HANDLE;
+    VkDrawIndexedIndirectCommand *draws = nullptr; // persistently mapped, for the statistics
+    VkBuffer instanceBuffer = VK_NULL_HANDLE; // compacted ObjectInstances, objectCount per phase
+    VkDeviceMemory instanceMemory = VK_NULL_HANDLE;
+
+    VkDescriptorSetLayout reduceSetLayout = VK_NULL_HANDLE;
+    VkDescriptorSetLayout cullSetLayout = VK_NULL_HANDLE;
+    VkPipelineLayout reduceLayout = VK_NULL_HANDLE;
+    VkPipelineLayout cullLayout = VK_NULL_HANDLE;
+    VkPipeline reducePipeline = VK_NULL_HANDLE;
+    VkPipeline cullPipeline = VK_NULL_HANDLE;
+    VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
+    std::vector<VkDescriptorSet> reduceSets; // one per pyramid level
+    VkDescriptorSet cullSet = VK_NULL_HANDLE;
+} OcclusionCuller;
+
+VkResult createOcclusionCuller(Application &app, VkImageView depthView, VkExtent2D viewport,
+                               const std::vector<ObjectInstance> &objects, uint32_t indexCount, uint32_t firstIndex,
+                               OcclusionCuller &culler);
+void recordOcclusionCull(Application &app, OcclusionCuller &culler, VkCommandBuffer commandBuffer, CullPhase phase);
+void recordDepthPyramid(Application &app, OcclusionCuller &culler, VkCommandBuffer commandBuffer);
+void recordOcclusionDraw(Application &app, OcclusionCuller &culler, VkCommandBuffer commandBuffer, CullPhase phase);
+OcclusionStats getOcclusionStats(const OcclusionCuller &culler);
+void destroyOcclusionCuller(Application &app, OcclusionCuller &culler);
+#endif //VULKANDEMO_OCCLUSIONCULLING_H
@@ -70,15 +70,36 @@ bool checkDeviceExtensionSupport(VkPhysicalDevice device) {
   return requiredExtensions.empty();
 }
 
+/**
+ * Check if the physical device supports an optional extension.
+ *
+ * @param device
+ * @param extensionName
+ * @return
+ */
+bool isDeviceExtensionAvailable(VkPhysicalDevice device, const char *extensionName) {
+  uint32_t extensionCount;
+  vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, nullptr);
+  std::vector<VkExtensionProperties> availableExtensions(extensionCount);
+  vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, availableExtensions.data());
+  for (const auto &extension : availableExtensions) {
+    if (strcmp(extension.extensionName, extensionName) == 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
 /**
  * Checks if the physical device is suitable for our surface.
  *
  * @param surface
  * @param device
+ * @param allowSoftware
  * @param isSuitable
  * @return
  */
-uint32_t isDeviceSuitable(VkSurfaceKHR surface, VkPhysicalDevice device, bool &isSuitable) {
+uint32_t isDeviceSuitable(VkSurfaceKHR surface, VkPhysicalDevice device, bool allowSoftware, bool &isSuitable) {
   VkPhysicalDeviceProperties deviceProperties;
   vkGetPhysicalDeviceProperties(device, &deviceProperties);
 
@@ -86,8 +107,9 @@ uint32_t isDeviceSuitable(VkSurfaceKHR surface, VkPhysicalDevice device, bool &i
   vkGetPhysicalDeviceFeatures(device, &deviceFeatures);
 
   // we don't check features nor score devices at this time
-  // we accept the dedicated GPU as a device
-  if (deviceProperties.deviceType != VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU) {
+  // we accept the dedicated GPU as a device, or a software implementation like lavapipe if asked to
+  if (deviceProperties.deviceType != VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU &&
+      !(allowSoftware && deviceProperties.deviceType == VK_PHYSICAL_DEVICE_TYPE_CPU)) {
     return 0;
   }
   bool queueFamilyFound = false;
@@ -106,9 +128,10 @@ uint32_t isDeviceSuitable(VkSurfaceKHR surface, VkPhysicalDevice device, bool &i
  *
  * @param instance
  * @param surface
+ * @param allowSoftware
  * @return
  */
-PhysicalDevice pickPhysicalDevice(VkInstance instance, VkSurfaceKHR surface) {
+PhysicalDevice pickPhysicalDevice(VkInstance instance, VkSurfaceKHR surface, bool allowSoftware) {
   PhysicalDevice physicalDevice{};
   uint32_t deviceCount = 0;
   vkEnumeratePhysicalDevices(instance, &deviceCount, nullptr);
@@ -123,7 +146,7 @@ PhysicalDevice pickPhysicalDevice(VkInstance instance, VkSurfaceKHR surface) {
   bool isSuitable = false;
   uint32_t deviceIndex = 0;
   for (const auto &device : devices) {
-    deviceIndex = isDeviceSuitable(surface, device, isSuitable);
+    deviceIndex = isDeviceSuitable(surface, device, allowSoftware, isSuitable);
     if (isSuitable) {
       physicalDevice.device = device;
       physicalDevice.graphicsQueueFamilyIdx = deviceIndex;
@@ -152,7 +175,8 @@ PhysicalDevice pickPhysicalDevice(VkInstance instance, VkSurfaceKHR surface) {
  * @return
  */
 VkResult createDevice(Application &app) {
-  const PhysicalDevice physicalDevice = pickPhysicalDevice(app.instance, app.surface);
+  TRACE_ZONE("createDevice");
+  const PhysicalDevice physicalDevice = pickPhysicalDevice(app.instance, app.surface, app.options.allowSoftwareDevice);
   if (!physicalDevice.foundDevice) {
     std::cerr << "Unable to find suitable physical device" << std::endl;
     return VK_ERROR_INITIALIZATION_FAILED;
@@ -174,8 +198,13 @@ VkResult createDevice(Application &app) {
   deviceCreateInfo.pQueueCreateInfos = &queueCreateInfo;
   deviceCreateInfo.queueCreateInfoCount = 1;
   deviceCreateInfo.pEnabledFeatures = &deviceFeatures;
-  deviceCreateInfo.enabledExtensionCount = deviceExtensions.size();
-  deviceCreateInfo.ppEnabledExtensionNames = deviceExtensions.data();
+  std::vector<const char *> enabledExtensions(deviceExtensions);
+  if (app.memory.properties2Enabled && isDeviceExtensionAvailable(physicalDevice.device, VK_EXT_MEMORY_BUDGET_EXTENSION_NAME)) {
+    enabledExtensions.push_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+    app.memory.budgetEnabled = true;
+  }
+  deviceCreateInfo.enabledExtensionCount = enabledExtensions.size();
+  deviceCreateInfo.ppEnabledExtensionNames = enabledExtensions.data();
   if (enableValidationLayers) {
     addValidationLayerSupport(deviceCreateInfo);
   } else {
@@ -186,6 +215,9 @@ VkResult createDevice(Application &app) {
     std::cerr << "Failed to create logical device" << std::endl;
     return VK_ERROR_INITIALIZATION_FAILED;
   }
+  // from here on device level calls go straight to the driver instead of through the loader
+  VkResult errorCode = loadDeviceFunctions(app.device);
+  returnOnError(errorCode)
   vkGetDeviceQueue(app.device, app.physicalDevice.graphicsQueueFamilyIdx, 0, &app.graphicsQueue);
   vkGetDeviceQueue(app.device, app.physicalDevice.presentationQueueFamilyIdx, 0, &app.presentQueue);
   return VK_SUCCESS;
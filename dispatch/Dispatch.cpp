@@ -0,0 +1,68 @@
+#include "Dispatch.h"
+#include <GLFW/glfw3.h>
+#include "../logging/Logger.h"
+
+#define VK_DEFINE_FUNCTION(name) PFN_##name name = nullptr;
+PFN_vkGetInstanceProcAddr vkGetInstanceProcAddr = nullptr;
+VK_GLOBAL_FUNCTIONS(VK_DEFINE_FUNCTION)
+VK_INSTANCE_FUNCTIONS(VK_DEFINE_FUNCTION)
+VK_OPTIONAL_INSTANCE_FUNCTIONS(VK_DEFINE_FUNCTION)
+VK_DEVICE_FUNCTIONS(VK_DEFINE_FUNCTION)
+#undef VK_DEFINE_FUNCTION
+
+template<typename T>
+static bool loadFunction(T &function, PFN_vkVoidFunction address, const char *name) {
+  function = reinterpret_cast<T>(address);
+  if (function == nullptr) {
+    logError("Unable to load Vulkan function {}", name);
+    return false;
+  }
+  return true;
+}
+
+/**
+ * Bootstraps vkGetInstanceProcAddr from the Vulkan library GLFW has already loaded, so the
+ * executable doesn't need to link against the loader. Requires glfwInit.
+ *
+ * @return
+ */
+VkResult loadGlobalFunctions() {
+  vkGetInstanceProcAddr = reinterpret_cast<PFN_vkGetInstanceProcAddr>(
+      glfwGetInstanceProcAddress(VK_NULL_HANDLE, "vkGetInstanceProcAddr"));
+  if (vkGetInstanceProcAddr == nullptr) {
+    logError("Vulkan loader not found");
+    return VK_ERROR_INITIALIZATION_FAILED;
+  }
+  bool loaded = true;
+#define VK_LOAD_FUNCTION(name) loaded &= loadFunction(name, vkGetInstanceProcAddr(VK_NULL_HANDLE, #name), #name);
+  VK_GLOBAL_FUNCTIONS(VK_LOAD_FUNCTION)
+#undef VK_LOAD_FUNCTION
+  return loaded ? VK_SUCCESS : VK_ERROR_INITIALIZATION_FAILED;
+}
+
+VkResult loadInstanceFunctions(VkInstance instance) {
+  bool loaded = true;
+#define VK_LOAD_FUNCTION(name) loaded &= loadFunction(name, vkGetInstanceProcAddr(instance, #name), #name);
+  VK_INSTANCE_FUNCTIONS(VK_LOAD_FUNCTION)
+#undef VK_LOAD_FUNCTION
+#define VK_LOAD_OPTIONAL_FUNCTION(name) name = reinterpret_cast<PFN_##name>(vkGetInstanceProcAddr(instance, #name));
+  VK_OPTIONAL_INSTANCE_FUNCTIONS(VK_LOAD_OPTIONAL_FUNCTION)
+#undef VK_LOAD_OPTIONAL_FUNCTION
+  return loaded ? VK_SUCCESS : VK_ERROR_INITIALIZATION_FAILED;
+}
+
+/**
+ * Loads the device level functions for the given device. These point directly into the driver
+ * (or the first enabled layer) and are only valid for this device, which is fine since the
+ * application only ever creates one.
+ *
+ * @param device
+ * @return
+ */
+VkResult loadDeviceFunctions(VkDevice device) {
+  bool loaded = true;
+#define VK_LOAD_FUNCTION(name) loaded &= loadFunction(name, vkGetDeviceProcAddr(device, #name), #name);
+  VK_DEVICE_FUNCTIONS(VK_LOAD_FUNCTION)
+#undef VK_LOAD_FUNCTION
+  return loaded ? VK_SUCCESS : VK_ERROR_INITIALIZATION_FAILED;
+}
@@ -0,0 +1,298 @@
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include "ClusteredLighting.h"
+#include "../Application.h"
+#include "../buffers/Vertex.h"
+#include "../pipeline/Compute.h"
+#include "../pipeline/GraphicsPipeline.h"
+
+const VkDeviceSize COUNT_PARTITION_SIZE = sizeof(uint32_t) * CLUSTER_COUNT;
+
+/**
+ * The layout of the light ring partition, the cluster counts and the cluster lists, read by the
+ * binning pass and the clustered fragment shader. Part of app.pipelineLayout whether there are
+ * lights or not, so it has to exist before the pipeline layout.
+ *
+ * @param app
+ * @return
+ */
+VkResult createLightSetLayout(Application &app) {
+  VkDescriptorSetLayoutBinding bindings[3];
+  for (uint32_t i = 0; i < 3; ++i) {
+    bindings[i] = {i, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_COMPUTE_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, nullptr};
+  }
+  VkDescriptorSetLayoutCreateInfo layoutInfo{};
+  layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+  layoutInfo.bindingCount = 3;
+  layoutInfo.pBindings = bindings;
+  VkResult errorCode = vkCreateDescriptorSetLayout(app.device, &layoutInfo, nullptr, &app.lighting.setLayout);
+  if (errorCode != VK_SUCCESS) {
+    logError("Unable to create light descriptor set layout");
+  }
+  return errorCode;
+}
+
+static VkResult createBinPipeline(Application &app, ClusteredLighting &lighting) {
+  VkPipelineLayoutCreateInfo layoutInfo{};
+  layoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+  layoutInfo.setLayoutCount = 1;
+  layoutInfo.pSetLayouts = &lighting.setLayout;
+  VkResult errorCode = vkCreatePipelineLayout(app.device, &layoutInfo, nullptr, &lighting.binLayout);
+  returnOnError(errorCode)
+  return createComputePipeline(app, "../shaders/cluster_lights.spv", lighting.binLayout, lighting.binPipeline);
+}
+
+/**
+ * One set per frame in flight, each pointing at the frame's partition of the light ring and at the
+ * shared cluster counts and lists.
+ */
+static VkResult createLightDescriptors(Application &app, ClusteredLighting &lighting) {
+  VkDescriptorPoolSize poolSize{VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 3 * MAX_FRAMES_IN_FLIGHT};
+  VkDescriptorPoolCreateInfo poolInfo{};
+  poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+  poolInfo.maxSets = MAX_FRAMES_IN_FLIGHT;
+  poolInfo.poolSizeCount = 1;
+  poolInfo.pPoolSizes = &poolSize;
+  VkResult errorCode = vkCreateDescriptorPool(app.device, &poolInfo, nullptr, &lighting.descriptorPool);
+  returnOnError(errorCode)
+
+  std::vector<VkDescriptorSetLayout> setLayouts(MAX_FRAMES_IN_FLIGHT, lighting.setLayout);
+  lighting.sets.resize(MAX_FRAMES_IN_FLIGHT, VK_NULL_HANDLE);
+  VkDescriptorSetAllocateInfo allocInfo{};
+  allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+  allocInfo.descriptorPool = lighting.descriptorPool;
+  allocInfo.descriptorSetCount = MAX_FRAMES_IN_FLIGHT;
+  allocInfo.pSetLayouts = setLayouts.data();
+  errorCode = vkAllocateDescriptorSets(app.device, &allocInfo, lighting.sets.data());
+  returnOnError(errorCode)
+
+  std::vector<VkDescriptorBufferInfo> bufferInfos;
+  bufferInfos.reserve(3 * MAX_FRAMES_IN_FLIGHT);
+  std::vector<VkWriteDescriptorSet> writes;
+  for (uint32_t frame = 0; frame < MAX_FRAMES_IN_FLIGHT; ++frame) {
+    bufferInfos.push_back({lighting.lightBuffer, lighting.partitionSize * frame, lighting.partitionSize});
+    bufferInfos.push_back({lighting.countBuffer, 0, VK_WHOLE_SIZE});
+    bufferInfos.push_back({lighting.indexBuffer, 0, VK_WHOLE_SIZE});
+    for (uint32_t binding = 0; binding < 3; ++binding) {
+      VkWriteDescriptorSet write{};
+      write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+      write.dstSet = lighting.sets[frame];
+      write.dstBinding = binding;
+      write.descriptorCount = 1;
+      write.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+      write.pBufferInfo = &bufferInfos[frame * 3 + binding];
+      writes.push_back(write);
+    }
+  }
+  vkUpdateDescriptorSets(app.device, static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
+  return VK_SUCCESS;
+}
+
+/**
+ * Creates the light ring for up to maxLights lights per frame, the cluster buffers, their readback
+ * and the binning pipeline. The ring and the readback stay mapped for the lifetime of the lighting.
+ * On failure the lighting must still be destroyed.
+ *
+ * @param app
+ * @param maxLights
+ * @return
+ */
+VkResult createClusteredLighting(Application &app, uint32_t maxLights) {
+  TRACE_ZONE("createClusteredLighting");
+  ClusteredLighting &lighting = app.lighting;
+  lighting.maxLights = maxLights;
+  VkPhysicalDeviceProperties properties;
+  vkGetPhysicalDeviceProperties(app.physicalDevice.device, &properties);
+  // every partition starts at an offset a storage buffer descriptor may use
+  const VkDeviceSize alignment = std::max<VkDeviceSize>(properties.limits.minStorageBufferOffsetAlignment, 1);
+  const VkDeviceSize lightsSize = sizeof(LightGridHeader) + sizeof(PointLight) * static_cast<VkDeviceSize>(maxLights);
+  lighting.partitionSize = (lightsSize + alignment - 1) / alignment * alignment;
+
+  VkResult errorCode = createBuffer(app, lighting.partitionSize * MAX_FRAMES_IN_FLIGHT, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                                    VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                                    MEMORY_GEOMETRY, lighting.lightBuffer, lighting.lightMemory);
+  returnOnError(errorCode)
+  void *data;
+  errorCode = vkMapMemory(app.device, lighting.lightMemory, 0, VK_WHOLE_SIZE, 0, &data);
+  returnOnError(errorCode)
+  lighting.lights = static_cast<uint8_t *>(data);
+
+  errorCode = createBuffer(app, COUNT_PARTITION_SIZE, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                           VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, MEMORY_GEOMETRY, lighting.countBuffer, lighting.countMemory);
+  returnOnError(errorCode)
+  errorCode = createBuffer(app, sizeof(uint32_t) * CLUSTER_COUNT * MAX_LIGHTS_PER_CLUSTER, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                           VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, MEMORY_GEOMETRY, lighting.indexBuffer, lighting.indexMemory);
+  returnOnError(errorCode)
+  // host visible so the statistics can be gathered once a frame is done
+  errorCode = createBuffer(app, COUNT_PARTITION_SIZE * MAX_FRAMES_IN_FLIGHT, VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                           VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                           MEMORY_GEOMETRY, lighting.readbackBuffer, lighting.readbackMemory);
+  returnOnError(errorCode)
+  errorCode = vkMapMemory(app.device, lighting.readbackMemory, 0, VK_WHOLE_SIZE, 0, &data);
+  returnOnError(errorCode)
+  lighting.readback = static_cast<const uint32_t *>(data);
+  lighting.binned.assign(MAX_FRAMES_IN_FLIGHT, 0);
+
+  errorCode = createBinPipeline(app, lighting);
+  if (errorCode != VK_SUCCESS) {
+    logError("Unable to create light binning pipeline");
+    return errorCode;
+  }
+  errorCode = createLightDescriptors(app, lighting);
+  returnOnError(errorCode)
+  lighting.enabled = true;
+  return VK_SUCCESS;
+}
+
+/**
+ * Writes the header and count animated lights into the given partition of the light ring. The
+ * lights wander around fixed spots near the scene, which lies at depth 0. Must only be called for
+ * a partition the GPU is done with, i.e. the current frame's after waiting for its fence.
+ *
+ * @param app
+ * @param partition
+ * @param viewport the size the scene is rendered at
+ * @param count clamped to the lights the ring was created for
+ * @param time in seconds
+ */
+void writeDemoLights(Application &app, uint32_t partition, VkExtent2D viewport, uint32_t count, float time) {
+  ClusteredLighting &lighting = app.lighting;
+  count = std::min(count, lighting.maxLights);
+  const float width = static_cast<float>(viewport.width), height = static_cast<float>(viewport.height);
+  uint8_t *base = lighting.lights + lighting.partitionSize * partition;
+  const LightGridHeader header{glm::vec2(width, height), height, count};
+  memcpy(base, &header, sizeof(header));
+
+  // the ring is write combined memory, so write each light once and in order
+  auto lights = reinterpret_cast<PointLight *>(base + sizeof(LightGridHeader));
+  uint32_t state = 11; // the same lights every frame, only the time moves them
+  for (uint32_t i = 0; i < count; ++i) {
+    const float x = randomUnit(state) * width, y = randomUnit(state) * height, z = randomUnit(state) * height * 0.25f;
+    const float radius = 40.0f + 60.0f * randomUnit(state);
+    const float angle = randomUnit(state) * 6.2831853f + time * (0.5f + randomUnit(state));
+    const glm::vec3 color(0.3f + 0.7f * randomUnit(state), 0.3f + 0.7f * randomUnit(state), 0.3f + 0.7f * randomUnit(state));
+    lights[i] = {glm::vec4(x + 30.0f * std::cos(angle), y + 30.0f * std::sin(angle), z, radius), glm::vec4(color, 0.6f)};
+  }
+}
+
+/**
+ * Gathers the statistics of the frame that used the current frame's partitions before, then writes
+ * this frame's lights and picks the lit pipeline, the placeholder until it compiled. Runs every
+ * frame after waiting for the frame's fence.
+ *
+ * @param app
+ * @param time in seconds
+ */
+void updateClusteredLighting(Application &app, float time) {
+  ClusteredLighting &lighting = app.lighting;
+  const auto frame = static_cast<uint32_t>(app.currentFrame);
+  if (lighting.binned[frame]) {
+    const ClusterStats stats = getClusterStats(app, frame);
+    lighting.frames++;
+    lighting.averageLightsSum += stats.averageLights;
+    lighting.maxLightsSeen = std::max(lighting.maxLightsSeen, stats.maxLights);
+    lighting.overflowingClusters += stats.overflowingClusters;
+    lighting.binned[frame] = 0;
+  }
+  lighting.pipeline = requestPipeline(app, clusteredPipelineKey(app));
+  writeDemoLights(app, frame, app.sceneExtent, app.options.lightCount, time);
+}
+
+/**
+ * Bins the lights of the current frame's partition into the cluster lists and copies the counts
+ * into the frame's readback partition. Must be recorded outside of a render pass and before
+ * anything that shades with the lists.
+ *
+ * @param app
+ * @param commandBuffer
+ */
+void recordLightBinning(Application &app, VkCommandBuffer commandBuffer) {
+  ClusteredLighting &lighting = app.lighting;
+  const auto frame = static_cast<uint32_t>(app.currentFrame);
+  // the previous frame's fragment shaders and readback copy are done with the lists it rewrites
+  memoryBarrier(commandBuffer, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+                VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0);
+  vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, lighting.binPipeline);
+  vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, lighting.binLayout, 0, 1, &lighting.sets[frame],
+                          0, nullptr);
+  vkCmdDispatch(commandBuffer, CLUSTER_COUNT, 1, 1);
+  memoryBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT,
+                VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT,
+                VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_TRANSFER_READ_BIT);
+
+  const VkBufferCopy copy{0, COUNT_PARTITION_SIZE * frame, COUNT_PARTITION_SIZE};
+  vkCmdCopyBuffer(commandBuffer, lighting.countBuffer, lighting.readbackBuffer, 1, &copy);
+  memoryBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT,
+                VK_PIPELINE_STAGE_HOST_BIT, VK_ACCESS_HOST_READ_BIT);
+  lighting.binned[frame] = 1;
+}
+
+/**
+ * Binds the current frame's light set for the pipelines of app.pipelineLayout. It stays bound
+ * across pipeline changes, so the LOD scene can use it as well.
+ *
+ * @param app
+ * @param commandBuffer
+ */
+void bindLightSet(Application &app, VkCommandBuffer commandBuffer) {
+  vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, app.pipelineLayout, 0, 1,
+                          &app.lighting.sets[app.currentFrame], 0, nullptr);
+}
+
+/**
+ * How the lights were spread over the clusters by the binning pass that wrote the given readback
+ * partition. Only valid once the frame that recorded it completed.
+ *
+ * @param app
+ * @param partition
+ * @return
+ */
+ClusterStats getClusterStats(const Application &app, uint32_t partition) {
+  const uint32_t *counts = app.lighting.readback + static_cast<size_t>(CLUSTER_COUNT) * partition;
+  ClusterStats stats{};
+  uint64_t total = 0;
+  for (uint32_t cluster = 0; cluster < CLUSTER_COUNT; ++cluster) {
+    const uint32_t count = counts[cluster];
+    total += count;
+    stats.maxLights = std::max(stats.maxLights, count);
+    stats.emptyClusters += count == 0;
+    stats.overflowingClusters += count > MAX_LIGHTS_PER_CLUSTER;
+  }
+  stats.averageLights = static_cast<double>(total) / CLUSTER_COUNT;
+  if (stats.emptyClusters < CLUSTER_COUNT) {
+    stats.averageLitClusterLights = static_cast<double>(total) / (CLUSTER_COUNT - stats.emptyClusters);
+  }
+  return stats;
+}
+
+void printClusteredLightingStats(Application &app) {
+  const ClusteredLighting &lighting = app.lighting;
+  if (lighting.frames == 0) {
+    return;
+  }
+  logInfo("Clustered lighting: {} lights in {}x{}x{} clusters over {} frames", app.options.lightCount, CLUSTER_GRID_X,
+          CLUSTER_GRID_Y, CLUSTER_GRID_Z, lighting.frames);
+  logInfo("  {} lights per cluster on average, at most {}, {} clusters over {}",
+          lighting.averageLightsSum / static_cast<double>(lighting.frames), lighting.maxLightsSeen,
+          lighting.overflowingClusters, MAX_LIGHTS_PER_CLUSTER);
+}
+
+void destroyClusteredLighting(Application &app) {
+  ClusteredLighting &lighting = app.lighting;
+  vkDestroyDescriptorPool(app.device, lighting.descriptorPool, nullptr); // frees the sets too
+  vkDestroyPipeline(app.device, lighting.binPipeline, nullptr);
+  vkDestroyPipelineLayout(app.device, lighting.binLayout, nullptr);
+  vkDestroyBuffer(app.device, lighting.readbackBuffer, nullptr);
+  freeMemory(app, lighting.readbackMemory); // unmaps it
+  vkDestroyBuffer(app.device, lighting.indexBuffer, nullptr);
+  freeMemory(app, lighting.indexMemory);
+  vkDestroyBuffer(app.device, lighting.countBuffer, nullptr);
+  freeMemory(app, lighting.countMemory);
+  vkDestroyBuffer(app.device, lighting.lightBuffer, nullptr);
+  freeMemory(app, lighting.lightMemory);
+  // app.pipelineLayout was created with the set layout, it goes with it
+  const VkDescriptorSetLayout setLayout = lighting.setLayout;
+  lighting = ClusteredLighting{};
+  lighting.setLayout = setLayout;
+}
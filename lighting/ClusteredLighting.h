@@ -0,0 +1,95 @@
+#ifndef VULKANDEMO_CLUSTEREDLIGHTING_H
+#define VULKANDEMO_CLUSTEREDLIGHTING_H
+
+#include <vector>
+#include "glm/glm.hpp"
+#include "../dispatch/Dispatch.h"
+
+struct Application;
+
+// the froxel grid, keep in sync with cluster_lights.comp and fragment_clustered.frag
+const uint32_t CLUSTER_GRID_X = 16;
+const uint32_t CLUSTER_GRID_Y = 9;
+const uint32_t CLUSTER_GRID_Z = 24; // depth slices
+const uint32_t CLUSTER_COUNT = CLUSTER_GRID_X * CLUSTER_GRID_Y * CLUSTER_GRID_Z;
+const uint32_t MAX_LIGHTS_PER_CLUSTER = 256; // further lights are counted but not shaded
+
+/**
+ * A point light as the shaders read it. The scene is lit in a box as wide and high as the
+ * viewport in pixels and as deep as it is high, a fragment lies at gl_FragCoord.z of that depth.
+ */
+typedef struct PointLight {
+    glm::vec4 positionRadius; // x and y in pixels from the top left corner, z in pixels of depth, radius in pixels
+    glm::vec4 color; // rgb and intensity
+} PointLight;
+
+/**
+ * Precedes the lights of a frame in the light ring.
+ */
+typedef struct LightGridHeader {
+    glm::vec2 viewportSize;
+    float depth; // of the lit box, in pixels
+    uint32_t lightCount;
+} LightGridHeader;
+
+static_assert(sizeof(PointLight) == 32 && sizeof(LightGridHeader) == 16, "Lights must match the std430 layout of the shaders");
+
+typedef struct ClusterStats {
+    double averageLights = 0.0; // per cluster
+    double averageLitClusterLights = 0.0; // per cluster with at least one light
+    uint32_t maxLights = 0;
+    uint32_t emptyClusters = 0;
+    uint32_t overflowingClusters = 0; // more than MAX_LIGHTS_PER_CLUSTER lights
+} ClusterStats;
+
+/**
+ * Clustered forward lighting. The view volume is split into a fixed grid of froxels, boxes of
+ * CLUSTER_GRID_X by CLUSTER_GRID_Y tiles of the viewport and CLUSTER_GRID_Z slices of depth,
+ * whatever the resolution. Every frame a compute pass writes the list of lights whose sphere
+ * touches each cluster, and fragment_clustered.frag only loops over the list of its cluster.
+ *
+ * The lights of a frame are written by the CPU into its partition of a persistently mapped ring,
+ * like the sprites. The cluster lists are shared by the frames in flight, the binning pass waits
+ * for the previous frame's fragment shaders before rewriting them.
+ */
+typedef struct ClusteredLighting {
+    bool enabled = false; // the buffers exist, the scene is lit by Options::lightCount animated lights
+    uint32_t maxLights = 0; // per frame
+    VkDescriptorSetLayout setLayout = VK_NULL_HANDLE; // set 0 of app.pipelineLayout, always created and outlives the rest
+
+    VkBuffer lightBuffer = VK_NULL_HANDLE; // MAX_FRAMES_IN_FLIGHT partitions of a header and maxLights lights
+    VkDeviceMemory lightMemory = VK_NULL_HANDLE;
+    uint8_t *lights = nullptr; // persistently mapped
+    VkDeviceSize partitionSize = 0;
+    VkBuffer countBuffer = VK_NULL_HANDLE; // lights per cluster
+    VkDeviceMemory countMemory = VK_NULL_HANDLE;
+    VkBuffer indexBuffer = VK_NULL_HANDLE; // MAX_LIGHTS_PER_CLUSTER light indices per cluster
+    VkDeviceMemory indexMemory = VK_NULL_HANDLE;
+    VkBuffer readbackBuffer = VK_NULL_HANDLE; // copies of the counts, one partition per frame in flight
+    VkDeviceMemory readbackMemory = VK_NULL_HANDLE;
+    const uint32_t *readback = nullptr; // persistently mapped
+    std::vector<uint8_t> binned; // per frame in flight, whether its readback partition holds counts
+
+    VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
+    std::vector<VkDescriptorSet> sets; // one per frame in flight, differing in the light partition
+    VkPipelineLayout binLayout = VK_NULL_HANDLE;
+    VkPipeline binPipeline = VK_NULL_HANDLE;
+    VkPipeline pipeline = VK_NULL_HANDLE; // the lit scene pipeline, owned by the pipeline library
+
+    // statistics of the frames that completed
+    uint64_t frames = 0;
+    double averageLightsSum = 0.0;
+    uint32_t maxLightsSeen = 0;
+    uint64_t overflowingClusters = 0;
+} ClusteredLighting;
+
+VkResult createLightSetLayout(Application &app);
+VkResult createClusteredLighting(Application &app, uint32_t maxLights);
+void writeDemoLights(Application &app, uint32_t partition, VkExtent2D viewport, uint32_t count, float time);
+void updateClusteredLighting(Application &app, float time);
+void recordLightBinning(Application &app, VkCommandBuffer commandBuffer);
+void bindLightSet(Application &app, VkCommandBuffer commandBuffer);
+ClusterStats getClusterStats(const Application &app, uint32_t partition);
+void printClusteredLightingStats(Application &app);
+void destroyClusteredLighting(Application &app);
+#endif //VULKANDEMO_CLUSTEREDLIGHTING_H
@@ -0,0 +1,291 @@
+#include <chrono>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <thread>
+#include "Logger.h"
+#include "../threading/SpscQueue.h"
+
+const uint32_t LOG_MAX_THREADS = 64;
+const uint32_t LOG_RATE_SLOTS = 256; // power of two
+const uint32_t LOG_RATE_LIMIT = 5; // messages per key and second before they are suppressed
+
+typedef SpscQueue<LogRecord, 512> LogRing;
+
+std::atomic<LogLevel> logMinLevel{LogLevel::Info};
+
+// one ring per slot, a slot is claimed lock-free by a logging thread and released when the thread
+// exits, so short-lived workers reuse rings. Rings live as long as the process, the writer may be
+// draining one while its slot changes hands, which is fine for a single-producer queue
+static std::atomic<LogRing *> rings[LOG_MAX_THREADS];
+static std::atomic<bool> ringClaimed[LOG_MAX_THREADS];
+static std::atomic<uint32_t> ringCount{0}; // slots that ever had a ring
+
+typedef struct ThreadRing {
+    LogRing *ring = nullptr;
+    uint32_t slot = 0;
+
+    ~ThreadRing() {
+      if (ring != nullptr) {
+        ringClaimed[slot].store(false, std::memory_order_release); // publishes our pushes to the next owner
+      }
+    }
+} ThreadRing;
+
+static thread_local ThreadRing threadRing;
+
+static std::atomic<bool> writerRunning{false};
+static std::thread writer;
+static std::atomic<uint64_t> droppedRecords{0};
+static std::mutex fallbackMutex; // serializes writes when no writer thread is running
+
+// joins the writer if the process exits while it runs, a joinable std::thread would terminate it
+static struct LoggerShutdown {
+    ~LoggerShutdown() { stopLogger(); }
+} loggerShutdown;
+
+static const auto logStart = std::chrono::steady_clock::now();
+
+typedef struct RateSlot {
+    std::atomic<int32_t> key{0};
+    std::atomic<uint32_t> window{0};
+    std::atomic<uint32_t> count{0};
+    std::atomic<uint32_t> suppressed{0};
+} RateSlot;
+
+static RateSlot rateSlots[LOG_RATE_SLOTS];
+
+uint64_t logTimestamp() {
+  return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now() - logStart).count());
+}
+
+static const char *levelName(LogLevel level) {
+  switch (level) {
+    case LogLevel::Debug:
+      return "DEBUG";
+    case LogLevel::Info:
+      return "INFO ";
+    case LogLevel::Warning:
+      return "WARN ";
+    default:
+      return "ERROR";
+  }
+}
+
+/**
+ * Turns the binary record into a line of text. Runs on the writer thread.
+ *
+ * @param record
+ * @param line
+ */
+static void formatRecord(const LogRecord &record, std::string &line) {
+  char buffer[64];
+  snprintf(buffer, sizeof(buffer), "[%12.6f] %s ", record.timestampNs / 1e9, levelName(record.level));
+  line.append(buffer);
+
+  uint32_t argIndex = 0;
+  for (const char *c = record.format; *c != '\0'; ++c) {
+    if (c[0] != '{' || c[1] != '}' || argIndex >= record.argCount) {
+      line.push_back(*c);
+      continue;
+    }
+    uint64_t value = record.args[argIndex];
+    switch (record.argTypes[argIndex]) {
+      case LogArgType::Int:
+        snprintf(buffer, sizeof(buffer), "%lld", static_cast<long long>(value));
+        line.append(buffer);
+        break;
+      case LogArgType::UInt:
+        snprintf(buffer, sizeof(buffer), "%llu", static_cast<unsigned long long>(value));
+        line.append(buffer);
+        break;
+      case LogArgType::Double: {
+        double converted;
+        memcpy(&converted, &value, sizeof(double));
+        snprintf(buffer, sizeof(buffer), "%g", converted);
+        line.append(buffer);
+        break;
+      }
+      case LogArgType::String:
+        if (value < record.payloadSize) {
+          line.append(record.payload + value);
+        }
+        break;
+      case LogArgType::SpilledString:
+        line.append(reinterpret_cast<const char *>(value));
+        break;
+      case LogArgType::Pointer:
+        snprintf(buffer, sizeof(buffer), "0x%llx", static_cast<unsigned long long>(value));
+        line.append(buffer);
+        break;
+    }
+    ++argIndex;
+    ++c; // skip the closing brace
+  }
+  line.push_back('\n');
+}
+
+static void freeSpilledStrings(const LogRecord &record) {
+  for (uint32_t i = 0; i < record.argCount; ++i) {
+    if (record.argTypes[i] == LogArgType::SpilledString) {
+      delete[] reinterpret_cast<char *>(record.args[i]);
+    }
+  }
+}
+
+static void writeRecord(const LogRecord &record, std::string &line) {
+  line.clear();
+  formatRecord(record, line);
+  fwrite(line.data(), 1, line.size(), record.level >= LogLevel::Warning ? stderr : stdout);
+  freeSpilledStrings(record);
+}
+
+/**
+ * Writes out everything that is currently queued in the per-thread rings.
+ *
+ * @param line scratch buffer reused between records
+ * @return the number of records written
+ */
+static size_t drainRings(std::string &line) {
+  size_t written = 0;
+  LogRecord record;
+  uint32_t count = ringCount.load(std::memory_order_acquire);
+  for (uint32_t i = 0; i < count; ++i) {
+    LogRing *ring = rings[i].load(std::memory_order_acquire);
+    if (ring == nullptr) {
+      continue; // registration in progress
+    }
+    while (ring->pop(record)) {
+      writeRecord(record, line);
+      ++written;
+    }
+  }
+  if (written > 0) {
+    fflush(stdout);
+    fflush(stderr);
+  }
+  return written;
+}
+
+static void writerLoop() {
+  std::string line;
+  line.reserve(512);
+  while (true) {
+    bool running = writerRunning.load(std::memory_order_acquire);
+    size_t written = drainRings(line);
+    if (!running) {
+      break; // the drain above saw everything submitted before stopLogger
+    }
+    if (written == 0) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+  }
+}
+
+/**
+ * Returns the ring of the calling thread, claiming a free slot on first use.
+ *
+ * @return nullptr if all LOG_MAX_THREADS slots belong to running threads
+ */
+static LogRing *threadLogRing() {
+  if (threadRing.ring != nullptr) {
+    return threadRing.ring;
+  }
+  for (uint32_t slot = 0; slot < LOG_MAX_THREADS; ++slot) {
+    bool claimed = false;
+    if (ringClaimed[slot].load(std::memory_order_relaxed) ||
+        !ringClaimed[slot].compare_exchange_strong(claimed, true, std::memory_order_acquire)) {
+      continue;
+    }
+    LogRing *ring = rings[slot].load(std::memory_order_relaxed);
+    if (ring == nullptr) {
+      ring = new LogRing();
+      rings[slot].store(ring, std::memory_order_release);
+      uint32_t count = ringCount.load(std::memory_order_relaxed);
+      while (count < slot + 1 && !ringCount.compare_exchange_weak(count, slot + 1, std::memory_order_release)) {}
+    }
+    threadRing.ring = ring;
+    threadRing.slot = slot;
+    return ring;
+  }
+  return nullptr;
+}
+
+static void writeSynchronously(LogRecord &record) {
+  std::lock_guard<std::mutex> lock(fallbackMutex);
+  std::string line;
+  writeRecord(record, line);
+  fflush(record.level >= LogLevel::Warning ? stderr : stdout);
+}
+
+/**
+ * Hands the record over to the writer thread. Never blocks: if the ring of the calling
+ * thread is full the record is dropped and counted. Before the logger is started, after it
+ * has been stopped, or while more than LOG_MAX_THREADS threads log at once, records are
+ * written synchronously instead.
+ *
+ * @param record
+ */
+void submitLogRecord(LogRecord &record) {
+  LogRing *ring = writerRunning.load(std::memory_order_acquire) ? threadLogRing() : nullptr;
+  if (ring == nullptr) {
+    writeSynchronously(record);
+    return;
+  }
+  if (!ring->push(record)) {
+    freeSpilledStrings(record);
+    droppedRecords.fetch_add(1, std::memory_order_relaxed);
+  }
+}
+
+/**
+ * Allows at most LOG_RATE_LIMIT messages per key and second. When a new second starts after
+ * messages were suppressed, the number of suppressed messages is logged once.
+ * Different keys may share a slot, in which case they share the budget as well.
+ *
+ * @param key
+ * @return true if the message should be logged
+ */
+bool logRateLimit(int32_t key) {
+  RateSlot &slot = rateSlots[static_cast<uint32_t>(key) * 2654435761u & (LOG_RATE_SLOTS - 1)];
+  uint32_t now = static_cast<uint32_t>(logTimestamp() / 1000000000ull);
+  uint32_t window = slot.window.load(std::memory_order_relaxed);
+  if (window != now && slot.window.compare_exchange_strong(window, now)) {
+    slot.count.store(0, std::memory_order_relaxed);
+    uint32_t suppressed = slot.suppressed.exchange(0);
+    if (suppressed > 0) {
+      logWarning("Suppressed {} repeated messages with id {}", suppressed, slot.key.load());
+    }
+  }
+  slot.key.store(key, std::memory_order_relaxed);
+  if (slot.count.fetch_add(1, std::memory_order_relaxed) < LOG_RATE_LIMIT) {
+    return true;
+  }
+  slot.suppressed.fetch_add(1, std::memory_order_relaxed);
+  return false;
+}
+
+void startLogger() {
+  if (writerRunning.exchange(true)) {
+    return;
+  }
+  writer = std::thread(writerLoop);
+}
+
+/**
+ * Stops the writer thread after it has written everything that was queued.
+ * Must be called after all other logging threads are done.
+ */
+void stopLogger() {
+  if (!writerRunning.exchange(false)) {
+    return;
+  }
+  writer.join();
+  std::string line;
+  drainRings(line); // in case a thread raced with the final drain of the writer
+  uint64_t dropped = droppedRecords.exchange(0);
+  if (dropped > 0) {
+    logWarning("Logger dropped {} records because a ring buffer was full", dropped);
+  }
+}
@@ -0,0 +1,137 @@
+#ifndef VULKANDEMO_LOGGER_H
+#define VULKANDEMO_LOGGER_H
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <type_traits>
+
+enum class LogLevel : uint8_t {
+    Debug = 0,
+    Info = 1,
+    Warning = 2,
+    Error = 3
+};
+
+const uint32_t LOG_MAX_ARGS = 8;
+const uint32_t LOG_PAYLOAD_SIZE = 192;
+
+enum class LogArgType : uint8_t {
+    Int,
+    UInt,
+    Double,
+    String, // the value is the offset of the copied string in the record payload
+    SpilledString, // the value points to a heap copy of a string too long for the payload, freed by the writer
+    Pointer
+};
+
+/**
+ * A log statement in binary form. The call site only copies the format pointer and the raw
+ * argument values into the record, formatting happens later on the writer thread.
+ * The format string must therefore outlive the logger, i.e. be a string literal.
+ */
+typedef struct LogRecord {
+    uint64_t timestampNs;
+    const char *format;
+    LogLevel level;
+    uint8_t argCount;
+    uint16_t payloadSize;
+    LogArgType argTypes[LOG_MAX_ARGS];
+    uint64_t args[LOG_MAX_ARGS];
+    char payload[LOG_PAYLOAD_SIZE]; // copies of string arguments
+} LogRecord;
+
+extern std::atomic<LogLevel> logMinLevel;
+
+void startLogger();
+void stopLogger();
+void submitLogRecord(LogRecord &record);
+uint64_t logTimestamp();
+bool logRateLimit(int32_t key);
+
+inline void encodeLogArg(LogRecord &record, const char *value) {
+  uint32_t index = record.argCount++;
+  record.argTypes[index] = LogArgType::String;
+  const char *text = value ? value : "";
+  size_t length = strlen(text);
+  if (length >= LOG_PAYLOAD_SIZE - record.payloadSize) {
+    // rare, e.g. validation messages, so an allocation is cheaper than larger records for everyone
+    char *copy = new char[length + 1];
+    memcpy(copy, text, length + 1);
+    record.argTypes[index] = LogArgType::SpilledString;
+    record.args[index] = reinterpret_cast<uintptr_t>(copy);
+    return;
+  }
+  record.args[index] = record.payloadSize;
+  memcpy(record.payload + record.payloadSize, text, length);
+  record.payload[record.payloadSize + length] = '\0';
+  record.payloadSize += static_cast<uint16_t>(length + 1);
+}
+
+inline void encodeLogArg(LogRecord &record, char *value) {
+  encodeLogArg(record, const_cast<const char *>(value));
+}
+
+inline void encodeLogArg(LogRecord &record, const std::string &value) {
+  encodeLogArg(record, value.c_str());
+}
+
+template<typename T>
+inline void encodeLogArg(LogRecord &record, const T &value) {
+  uint32_t index = record.argCount++;
+  if constexpr (std::is_floating_point<T>::value) {
+    record.argTypes[index] = LogArgType::Double;
+    double converted = static_cast<double>(value);
+    memcpy(&record.args[index], &converted, sizeof(double));
+  } else if constexpr (std::is_pointer<T>::value) {
+    record.argTypes[index] = LogArgType::Pointer;
+    record.args[index] = reinterpret_cast<uintptr_t>(value);
+  } else if constexpr (std::is_enum<T>::value || std::is_signed<T>::value) {
+    record.argTypes[index] = LogArgType::Int;
+    record.args[index] = static_cast<uint64_t>(static_cast<int64_t>(value));
+  } else {
+    static_assert(std::is_integral<T>::value, "Unsupported log argument type");
+    record.argTypes[index] = LogArgType::UInt;
+    record.args[index] = static_cast<uint64_t>(value);
+  }
+}
+
+/**
+ * Logs a message with {} placeholders for the arguments. Filtered out statements cost a relaxed
+ * load, the rest a copy of the arguments into the calling thread's ring buffer.
+ *
+ * @tparam Args
+ * @param level
+ * @param format
+ * @param args
+ */
+template<typename... Args>
+inline void logMessage(LogLevel level, const char *format, const Args &... args) {
+  static_assert(sizeof...(Args) <= LOG_MAX_ARGS, "Too many log arguments");
+  if (level < logMinLevel.load(std::memory_order_relaxed)) {
+    return;
+  }
+  LogRecord record;
+  record.timestampNs = logTimestamp();
+  record.format = format;
+  record.level = level;
+  record.argCount = 0;
+  record.payloadSize = 0;
+  (encodeLogArg(record, args), ...);
+  submitLogRecord(record);
+}
+
+template<typename... Args>
+inline void logDebug(const char *format, const Args &... args) { logMessage(LogLevel::Debug, format, args...); }
+
+template<typename... Args>
+inline void logInfo(const char *format, const Args &... args) { logMessage(LogLevel::Info, format, args...); }
+
+template<typename... Args>
+inline void logWarning(const char *format, const Args &... args) { logMessage(LogLevel::Warning, format, args...); }
+
+template<typename... Args>
+inline void logError(const char *format, const Args &... args) { logMessage(LogLevel::Error, format, args...); }
+
+#endif //VULKANDEMO_LOGGER_H
@@ -9,39 +9,65 @@
 #include "pipeline/GraphicsPipeline.h"
 #include "pipeline/Commands.h"
 #include "buffers/Vertex.h"
+#include "window/WindowEvents.h"
+#include "benchmarks/SpecializationBenchmark.h"
+#include "benchmarks/DispatchBenchmark.h"
+#include "benchmarks/SpriteBenchmark.h"
+#include "benchmarks/VertexFormatBenchmark.h"
+#include "benchmarks/LodBenchmark.h"
+#include "benchmarks/OcclusionBenchmark.h"
+#include "benchmarks/LightingBenchmark.h"
+#include "benchmarks/ParticleBenchmark.h"
+#include "benchmarks/SceneGraphBenchmark.h"
+#include "benchmarks/FileBenchmark.h"
+#include "benchmarks/StressBenchmark.h"
+#include "tracing/Trace.h"
+#include "regression/Regression.h"
+#include "assets/AssetArchive.h"
+#include <algorithm>
 #include <vector>
 #include <iostream>
+#include <thread>
+#include <future>
 
 const uint32_t WIDTH = 800;
 const uint32_t HEIGHT = 600;
 
 Application app{};
 
-void log_printSupportedExtensions(uint32_t glfwExtensionCount, const char **glfwExtensions) {
-  uint32_t extensionCount = 0;
-  vkEnumerateInstanceExtensionProperties(nullptr, &extensionCount, nullptr);
-  std::vector<VkExtensionProperties> extensions(extensionCount);
-  vkEnumerateInstanceExtensionProperties(nullptr, &extensionCount, extensions.data());
+void log_printSupportedExtensions(const std::vector<VkExtensionProperties> &extensions, uint32_t glfwExtensionCount, const char **glfwExtensions) {
   std::cout << "Supported Vulkan extensions:" << std::endl;
   for (const auto &extension : extensions) {
     std::cout << '\t' << extension.extensionName;
-    const char *glfwExtension = *glfwExtensions;
     for (size_t count = 0; count < glfwExtensionCount; ++count) {
-      if (strcmp(extension.extensionName, glfwExtension) == 0) {
-        std::cout << " - GLFW" << std::endl;
-        goto cnt;
+      if (strcmp(extension.extensionName, glfwExtensions[count]) == 0) {
+        std::cout << " - GLFW";
+        break;
       }
     }
     std::cout << std::endl;
-    cnt:;
   }
 }
 
+/**
+ * Collects the instance extensions GLFW needs for the surface plus the optional ones we use.
+ * The supported extensions are enumerated once and only printed with --list-extensions,
+ * since writing them to the console showed up in the startup trace.
+ *
+ * @return
+ */
 std::vector<const char *> getRequiredExtensions() {
   uint32_t glfwExtensionCount = 0;
   const char **glfwExtensions;
   glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
-  log_printSupportedExtensions(glfwExtensionCount, glfwExtensions);
+
+  uint32_t extensionCount = 0;
+  vkEnumerateInstanceExtensionProperties(nullptr, &extensionCount, nullptr);
+  std::vector<VkExtensionProperties> availableExtensions(extensionCount);
+  vkEnumerateInstanceExtensionProperties(nullptr, &extensionCount, availableExtensions.data());
+  if (app.options.listExtensions) {
+    log_printSupportedExtensions(availableExtensions, glfwExtensionCount, glfwExtensions);
+  }
 
   std::vector<const char *> extensions(glfwExtensions, glfwExtensions + glfwExtensionCount);
 
@@ -49,10 +75,28 @@ std::vector<const char *> getRequiredExtensions() {
     extensions.push_back(VK_EXT_DEBUG_UTILS_EXTENSION_NAME);
   }
 
+  // needed to query VK_EXT_memory_budget, the memory tracker falls back to estimates without it
+  for (const auto &extension : availableExtensions) {
+    if (strcmp(extension.extensionName, VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME) == 0) {
+      extensions.push_back(VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME);
+      app.memory.properties2Enabled = true;
+    }
+  }
+
   return extensions;
 }
 
+/**
+ * Loads the Vulkan loader and creates the instance. Only needs glfwInit, not the window,
+ * so it runs on another thread while the main thread creates the window.
+ *
+ * @return
+ */
 VkResult createInstance() {
+  TRACE_ZONE("createInstance");
+  VkResult errorCode = loadGlobalFunctions();
+  returnOnError(errorCode)
+
   // Optional configuration struct. Provides some useful information to the
   // Vulkan driver (e.g. specific graphics engine).
   VkApplicationInfo appInfo{};
@@ -82,10 +126,13 @@ VkResult createInstance() {
     createInfo.pNext = nullptr;
   }
 
-  return vkCreateInstance(&createInfo, nullptr, &app.instance);
+  errorCode = vkCreateInstance(&createInfo, nullptr, &app.instance);
+  returnOnError(errorCode)
+  return loadInstanceFunctions(app.instance);
 }
 
 VkResult createSurface() {
+  TRACE_ZONE("createSurface");
   if (glfwCreateWindowSurface(app.instance, app.window, nullptr, &app.surface) != VK_SUCCESS) {
     std::cerr << "Failed to create window surface" << std::endl;
     return VK_ERROR_SURFACE_LOST_KHR;
@@ -94,6 +141,7 @@ VkResult createSurface() {
 }
 
 VkResult createSyncObjects(Application &app) {
+  TRACE_ZONE("createSyncObjects");
   app.imageAvailableSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
   app.renderFinishedSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
   app.inFlightFences.resize(MAX_FRAMES_IN_FLIGHT);
@@ -130,9 +178,7 @@ void cleanupSwapChain() {
   for (const auto &framebuffer : app.swapChainFramebuffers) {
     vkDestroyFramebuffer(app.device, framebuffer, nullptr);
   }
-  vkFreeCommandBuffers(app.device, app.commandPool, static_cast<uint32_t>(app.commandBuffers.size()), app.commandBuffers.data());
-  vkDestroyPipeline(app.device, app.graphicsPipeline, nullptr);
-  vkDestroyPipelineLayout(app.device, app.pipelineLayout, nullptr);
+  vkDestroyRenderPass(app.device, app.overlayRenderPass, nullptr);
   vkDestroyRenderPass(app.device, app.renderPass, nullptr);
   for (auto imageView : app.swapChainImageViews) {
     vkDestroyImageView(app.device, imageView, nullptr);
@@ -149,16 +195,24 @@ void cleanupSwapChain() {
  * @return
  */
 VkResult recreateSwapChain() {
-  // handles window minimization
-  int width = 0, height = 0;
-  glfwGetFramebufferSize(app.window, &width, &height);
-  while(width == 0 || height == 0) {
-    glfwGetFramebufferSize(app.window, &width, &height);
-    glfwWaitEvents();
+  TRACE_ZONE("recreateSwapChain");
+  // handles window minimization. This runs on the render thread so waiting here
+  // no longer stalls event processing, which keeps happening on the main thread.
+  while (app.framebufferWidth.load() == 0 || app.framebufferHeight.load() == 0) {
+    if (!app.running.load()) {
+      return VK_SUCCESS;
+    }
+    if (app.options.singleThread) {
+      glfwWaitEvents(); // nobody else processes them
+    } else {
+      std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+    processWindowEvents(app);
   }
 
   vkDeviceWaitIdle(app.device);
-  std::cout << "Cleaning up current swapchain" << std::endl;
+  waitPipelineLibraryIdle(app); // pipeline workers use the render pass we are about to destroy
+  logInfo("Cleaning up current swapchain");
   cleanupSwapChain();
   VkResult errorCode;
   errorCode = createSwapChain(app); // rebuild swapchain
@@ -167,71 +221,231 @@ VkResult recreateSwapChain() {
   returnOnError(errorCode)
   errorCode = createRenderPass(app); // rebuild render pass since it depends on the format of the swapchain images
   returnOnError(errorCode)
-  errorCode = createGraphicsPipeline(app); // could possibly avoid this by using dynamic state for viewports and scissor rectangles
+  errorCode = createOverlayRenderPass(app);
+  returnOnError(errorCode)
+  errorCode = createGraphicsPipeline(app); // library hit unless the format changed since viewport and scissor are dynamic
   returnOnError(errorCode)
   errorCode = createFramebuffers(app); // rebuild framebuffers since all the above has changed
   returnOnError(errorCode)
-  errorCode = createCommandBuffers(app); // and same for command buffers (not for command pool!)
+  errorCode = recreateWindowViews(app); // their framebuffers use the render pass too
   returnOnError(errorCode)
-  std::cout << "Swapchain successfully recreated" << std::endl;
-}
-
-void framebufferResizeCallback(GLFWwindow *window, int width, int height) {
-  auto app = reinterpret_cast<Application*>(glfwGetWindowUserPointer(window));
-  app->framebufferResized = true;
+  errorCode = resizeDynamicResolution(app); // the offscreen scene image matches the swapchain
+  returnOnError(errorCode)
+  invalidateCommandCache(app); // cached command buffers reference the destroyed render passes and pipelines
+  errorCode = resizeFrameCapture(app); // readback buffers match the swapchain extent
+  returnOnError(errorCode)
+  app.metrics.swapchainRecreations++;
+  logInfo("Swapchain successfully recreated");
+  return VK_SUCCESS;
 }
 
+/**
+ * Creates the window. GLFW requires this on the main thread after glfwInit.
+ */
 void initWindow() {
-  glfwInit();
+  TRACE_ZONE("initWindow");
   glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
+  if (!app.options.regressionScenario.empty()) {
+    glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE); // still needs a display server, e.g. Xvfb on CI machines
+  }
 //  glfwWindowHint(GLFW_RESIZABLE, GLFW_FALSE); // make window resizable since it is handled correctly
   app.window = glfwCreateWindow(WIDTH, HEIGHT, "JK!", nullptr, nullptr);
-  glfwSetWindowUserPointer(app.window, &app);
-  glfwSetFramebufferSizeCallback(app.window, framebufferResizeCallback);
+  registerWindowCallbacks(app);
+  createViewWindows(app, WIDTH, HEIGHT);
 }
 
-VkResult initVulkan() {
-  VkResult errorCode = createInstance();
+/**
+ * Compiles the default pipeline and queues the variants we expect to need. Reads the shader
+ * files and only depends on the swapchain format, not the swapchain itself.
+ *
+ * @return
+ */
+VkResult createPipelines() {
+  TRACE_ZONE("compile pipelines");
+  VkResult errorCode = createGraphicsPipeline(app);
   returnOnError(errorCode)
+  precompileGraphicsPipelines(app);
+  return VK_SUCCESS;
+}
+
+VkResult loadAssets() {
+  TRACE_ZONE("load assets");
+  return loadLodScene(app);
+}
+
+/**
+ * Initializes the window and Vulkan. Steps that don't depend on each other overlap:
+ * the instance is created while the main thread creates the window, and shader reads,
+ * pipeline compilation and mesh loading run while the main thread sets up the swapchain
+ * and uploads buffers. With --serial-init every step runs on the main thread instead,
+ * to compare the time to first frame.
+ *
+ * @return
+ */
+VkResult initVulkan() {
+  const std::launch launch = app.options.serialInit ? std::launch::deferred : std::launch::async;
+  VkResult errorCode;
+  std::future<VkResult> pipelines;
+  std::future<VkResult> assets;
+  {
+    TRACE_ZONE("init glfw");
+    glfwInit(); // everything below needs it, the instance for the loader GLFW found
+  }
+  {
+    std::future<VkResult> instance = std::async(launch, createInstance);
+    initWindow();
+    errorCode = instance.get();
+    returnOnError(errorCode)
+  }
 
   if (enableValidationLayers) {
     setupDebugMessenger(app.instance, &app.debugMessenger);
   }
   errorCode = createSurface();
   returnOnError(errorCode)
-  errorCode = createDevice(app);
-  returnOnError(errorCode)
-  errorCode = createSwapChain(app);
-  returnOnError(errorCode)
-  errorCode = createImageViews(app);
-  returnOnError(errorCode)
-  errorCode = createRenderPass(app);
-  returnOnError(errorCode)
-  errorCode = createGraphicsPipeline(app);
-  returnOnError(errorCode)
-  errorCode = createFramebuffers(app);
-  returnOnError(errorCode)
-  errorCode = createCommandPool(app);
-  returnOnError(errorCode)
-  errorCode = createVertexBuffer(app);
-  returnOnError(errorCode)
-  errorCode = createCommandBuffers(app);
-  returnOnError(errorCode)
-  errorCode = createSyncObjects(app);
-  returnOnError(errorCode)
+  {
+    TRACE_ZONE("create device");
+    errorCode = createDevice(app);
+    returnOnError(errorCode)
+    initMemoryTracker(app);
+  }
+  {
+    TRACE_ZONE("create render passes");
+    app.imageFormat = querySwapChainFormat(app); // all the render passes and pipelines need from the swapchain
+    errorCode = createRenderPass(app);
+    returnOnError(errorCode)
+    errorCode = createOverlayRenderPass(app);
+    returnOnError(errorCode)
+    errorCode = createLightSetLayout(app); // part of the pipeline layout
+    returnOnError(errorCode)
+    errorCode = createPipelineLayout(app);
+    returnOnError(errorCode)
+    errorCode = createPipelineLibrary(app);
+    returnOnError(errorCode)
+  }
+  // the futures are waited for even on an early return, in their destructors
+  pipelines = std::async(launch, createPipelines);
+  assets = std::async(launch, loadAssets);
+  {
+    TRACE_ZONE("create swapchain");
+    errorCode = createSwapChain(app);
+    returnOnError(errorCode)
+    errorCode = createImageViews(app);
+    returnOnError(errorCode)
+    errorCode = createFramebuffers(app);
+    returnOnError(errorCode)
+    errorCode = createWindowViews(app);
+    returnOnError(errorCode)
+    errorCode = createDynamicResolution(app);
+    returnOnError(errorCode)
+  }
+  {
+    TRACE_ZONE("upload buffers");
+    errorCode = createCommandPool(app);
+    returnOnError(errorCode)
+    errorCode = createGpuTracer(app);
+    returnOnError(errorCode)
+    errorCode = createVertexBuffer(app);
+    returnOnError(errorCode)
+    errorCode = createFrameCommandBuffers(app);
+    returnOnError(errorCode)
+    if (app.options.lightCount > 0) {
+      errorCode = createClusteredLighting(app, app.options.lightCount);
+      returnOnError(errorCode)
+    }
+    if (app.options.particleCount > 0) {
+      errorCode = createParticleSystem(app, app.options.particleCount, app.particles);
+      returnOnError(errorCode)
+    }
+    errorCode = createFrameCapture(app);
+    returnOnError(errorCode)
+    errorCode = createSyncObjects(app);
+    returnOnError(errorCode)
+  }
+  {
+    TRACE_ZONE("wait for assets");
+    errorCode = assets.get();
+    returnOnError(errorCode)
+  }
+  {
+    TRACE_ZONE("upload meshes");
+    errorCode = createLodScene(app);
+    returnOnError(errorCode)
+  }
+  {
+    TRACE_ZONE("wait for pipelines");
+    errorCode = pipelines.get(); // the sprites and the command cache need the placeholder pipeline
+    returnOnError(errorCode)
+  }
+  {
+    TRACE_ZONE("create command cache");
+    errorCode = createSpriteBatcher(app);
+    returnOnError(errorCode)
+    errorCode = createCommandCache(app);
+    returnOnError(errorCode)
+  }
   return VK_SUCCESS;
 }
 
+/**
+ * Prints the time from process start until the first frame was handed to the presentation engine.
+ */
+void reportFirstFrame() {
+  app.firstFramePresented = true;
+  traceInstant("first frame presented");
+  std::cout << "Time to first frame: " << static_cast<double>(traceMicros()) / 1000.0 << " ms"
+            << (app.options.serialInit ? " (serial init)" : "") << std::endl;
+}
+
+/**
+ * Stores the time since the previous stage of the frame ended as the time of the given stage.
+ *
+ * @param stage
+ * @param stageStart end of the previous stage, set to now
+ */
+static void endFrameStage(FrameStage stage, std::chrono::steady_clock::time_point &stageStart) {
+  auto now = std::chrono::steady_clock::now();
+  app.frameStages.milliseconds[stage] = std::chrono::duration<double, std::milli>(now - stageStart).count();
+  stageStart = now;
+}
+
 VkResult drawFrame() {
-  vkWaitForFences(app.device, 1, &app.inFlightFences[app.currentFrame], VK_TRUE, UINT64_MAX);
-  uint32_t imageIndex; // refers to the index of the acquired swap chain image from the swapChainImages. We use that index to pick the correct command buffer
+  TRACE_ZONE("drawFrame");
+  auto stageStart = std::chrono::steady_clock::now();
+  {
+    TRACE_ZONE("wait for frame fence");
+    vkWaitForFences(app.device, 1, &app.inFlightFences[app.currentFrame], VK_TRUE, UINT64_MAX);
+  }
+  endFrameStage(FRAME_STAGE_WAIT, stageStart);
+  collectGpuZones(app); // the timestamps of the frame that used this fence before are available
+  updateDynamicResolution(app); // and its GPU frame time
+  {
+    TRACE_ZONE("update frame resources");
+    pollFrameCapture(app); // the frame that used this fence before is complete, its capture can be read back
+    beginSprites(app); // and its sprite partition can be written again
+    if (app.options.demoSprites > 0) {
+      drawDemoSprites(app, app.options.demoSprites, static_cast<float>(glfwGetTime()));
+    }
+    if (app.lighting.enabled) {
+      updateClusteredLighting(app, static_cast<float>(glfwGetTime())); // and its light partition
+    }
+    if (app.particles.enabled) {
+      updateDemoParticles(app, glfwGetTime());
+    }
+  }
+  endFrameStage(FRAME_STAGE_UPDATE, stageStart);
+  uint32_t imageIndex; // refers to the index of the acquired swap chain image from the swapChainImages. We use that index to pick the correct framebuffer
 
   // vkAcquire does not seem to guarantee that it will provide a swapchain image that is not in use. We have to manually synchronize on the images
   // as well using the inFlightFences (which are used for synchronizing all resources for each frame, guaranteeing they are used only on one frame
   // at a time)
-  VkResult errorCode = vkAcquireNextImageKHR(app.device, app.swapChain, UINT64_MAX, app.imageAvailableSemaphores[app.currentFrame], VK_NULL_HANDLE, &imageIndex);
+  VkResult errorCode;
+  {
+    TRACE_ZONE("vkAcquireNextImageKHR");
+    errorCode = vkAcquireNextImageKHR(app.device, app.swapChain, UINT64_MAX, app.imageAvailableSemaphores[app.currentFrame], VK_NULL_HANDLE, &imageIndex);
+  }
   if(errorCode == VK_ERROR_OUT_OF_DATE_KHR) {
-    std::cout << "Swapchain out of date, recreating" << std::endl;
+    logInfo("Swapchain out of date, recreating");
     errorCode = recreateSwapChain();
     return errorCode; // return early to try next draw call with recreated chain
   } else if (errorCode != VK_SUCCESS && errorCode != VK_SUBOPTIMAL_KHR) {
@@ -240,21 +454,36 @@ VkResult drawFrame() {
 
   // it is possible that we've been assigned an images from the swapchain that is still 'in-flight' and we must wait for it to become available
   if(app.imagesInFlight[imageIndex] != VK_NULL_HANDLE) {
+    TRACE_ZONE("wait for image fence");
     vkWaitForFences(app.device, 1, &app.imagesInFlight[imageIndex], VK_TRUE, UINT64_MAX);
   }
   app.imagesInFlight[imageIndex] = app.inFlightFences[app.currentFrame];
+  errorCode = acquireWindowViews(app);
+  returnOnError(errorCode)
+  endFrameStage(FRAME_STAGE_ACQUIRE, stageStart);
+
+  errorCode = recordFrameCommandBuffer(app, imageIndex);
+  returnOnError(errorCode)
+  endFrameStage(FRAME_STAGE_RECORD, stageStart);
+
+  // the main window comes first, followed by the window views that acquired an image, all rendered
+  // by one submission and presented by one vkQueuePresentKHR
+  VkSemaphore waitSemaphores[1 + MAX_WINDOW_VIEWS] = {app.imageAvailableSemaphores[app.currentFrame]};
+  VkSwapchainKHR swapChains[1 + MAX_WINDOW_VIEWS] = {app.swapChain};
+  uint32_t imageIndices[1 + MAX_WINDOW_VIEWS] = {imageIndex};
+  VkResult presentResults[1 + MAX_WINDOW_VIEWS] = {};
+  const uint32_t swapChainCount = 1 + gatherWindowViewPresents(app, waitSemaphores + 1, swapChains + 1, imageIndices + 1);
 
   VkSubmitInfo submitInfo{}; // command buffer submission info
   submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
   // the waitSemaphores array and waitStages array are matched 1-1. The Xth indexed semaphore will be used at the Xth indexed stage
-  VkSemaphore waitSemaphores[] = {app.imageAvailableSemaphores[app.currentFrame]};
-  VkPipelineStageFlags waitStages[] = {
-      VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT}; // does this mean the semaphore will be signaled once we exit the frag-shader?
-  submitInfo.waitSemaphoreCount = 1;
+  VkPipelineStageFlags waitStages[1 + MAX_WINDOW_VIEWS];
+  std::fill(waitStages, waitStages + swapChainCount, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT);
+  submitInfo.waitSemaphoreCount = swapChainCount;
   submitInfo.pWaitSemaphores = waitSemaphores;
   submitInfo.pWaitDstStageMask = waitStages;
   submitInfo.commandBufferCount = 1;
-  submitInfo.pCommandBuffers = &app.commandBuffers[imageIndex];
+  submitInfo.pCommandBuffers = &app.frameCommandBuffers[app.currentFrame];
 
   // specify which semaphores to signal once the command buffer has finished execution
   VkSemaphore signalSemaphores[] = {app.renderFinishedSemaphores[app.currentFrame]};
@@ -263,25 +492,44 @@ VkResult drawFrame() {
 
   vkResetFences(app.device, 1, &app.inFlightFences[app.currentFrame]);
   // both a signal semaphore (render finished) and fences are used for synchronization on the queue operations
-  errorCode = vkQueueSubmit(app.graphicsQueue, 1, &submitInfo, app.inFlightFences[app.currentFrame]);
+  {
+    TRACE_ZONE("vkQueueSubmit");
+    errorCode = vkQueueSubmit(app.graphicsQueue, 1, &submitInfo, app.inFlightFences[app.currentFrame]);
+  }
   throwOnError(errorCode, "Failed to submit draw command buffer")
+  endFrameStage(FRAME_STAGE_SUBMIT, stageStart);
 
   VkPresentInfoKHR presentInfo{};
   presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
   presentInfo.waitSemaphoreCount = 1;
   presentInfo.pWaitSemaphores = signalSemaphores;
-  VkSwapchainKHR swapChains[] = {app.swapChain};
-  presentInfo.swapchainCount = 1;
+  presentInfo.swapchainCount = swapChainCount;
   presentInfo.pSwapchains = swapChains;
-  presentInfo.pImageIndices = &imageIndex;
-  presentInfo.pResults = nullptr; // optional
-
-  errorCode = vkQueuePresentKHR(app.presentQueue, &presentInfo);
-  if(errorCode == VK_ERROR_OUT_OF_DATE_KHR || errorCode == VK_SUBOPTIMAL_KHR || app.framebufferResized) {
-    std::cout << "Framebuffer resized, recreating swapchain" << std::endl;
-    app.framebufferResized = false; // manually check because it is not guaranteed that all platforms will respond with the appropriate error code
-    recreateSwapChain(); // recreate but don't return early since the frame has been presented
-    errorCode = VK_SUCCESS;
+  presentInfo.pImageIndices = imageIndices;
+  presentInfo.pResults = presentResults; // one per swapchain, the return value is the worst of them
+
+  {
+    TRACE_ZONE("vkQueuePresentKHR");
+    errorCode = vkQueuePresentKHR(app.presentQueue, &presentInfo);
+  }
+  endFrameStage(FRAME_STAGE_PRESENT, stageStart);
+  recordFrameMetrics(app);
+  if (errorCode == VK_SUCCESS || errorCode == VK_SUBOPTIMAL_KHR || errorCode == VK_ERROR_OUT_OF_DATE_KHR) {
+    finishWindowViewPresents(app, presentResults + 1);
+    errorCode = presentResults[0]; // a view being out of date must not recreate the main swapchain
+  }
+  if (errorCode == VK_SUCCESS || errorCode == VK_SUBOPTIMAL_KHR) {
+    recordPresentLatency(app);
+    recordPresentTiming(app.presentTiming);
+    if (!app.firstFramePresented) {
+      reportFirstFrame();
+    }
+  }
+  // manually check the resize flag because it is not guaranteed that all platforms will respond with the appropriate error code
+  if(app.framebufferResized.exchange(false) || errorCode == VK_ERROR_OUT_OF_DATE_KHR || errorCode == VK_SUBOPTIMAL_KHR) {
+    logInfo("Framebuffer resized, recreating swapchain");
+    errorCode = recreateSwapChain(); // recreate but don't return early since the frame has been presented
+    returnOnError(errorCode)
   } else if (errorCode != VK_SUCCESS) {
     throwOnError(errorCode, "Queue present failed")
   }
@@ -291,10 +539,41 @@ VkResult drawFrame() {
   return errorCode;
 }
 
-int mainLoop() {
+/**
+ * Body of the render thread. It owns all Vulkan submission after initialization,
+ * so the main thread never touches the device while this is running.
+ */
+void renderLoop() {
+  nameTraceThread("render");
+  VkResult errorCode = VK_SUCCESS;
+  while (app.running.load()) {
+    waitForFrame(app);
+    processWindowEvents(app);
+    errorCode = drawFrame();
+    if (errorCode != VK_SUCCESS) {
+      break;
+    }
+  }
+  vkDeviceWaitIdle(app.device);
+  vkQueueWaitIdle(app.presentQueue);
+  app.renderResult = errorCode;
+  app.running = false;
+  glfwPostEmptyEvent(); // wake up the main thread in case we stopped because of an error
+}
+
+/**
+ * The loop from before the render thread, polling events and drawing in turn on the main thread.
+ * Kept for --single-thread, to measure the input-to-present latency the render thread is compared
+ * against.
+ *
+ * @return
+ */
+static VkResult singleThreadLoop() {
   VkResult errorCode = VK_SUCCESS;
-  while (!glfwWindowShouldClose(app.window)) {
+  while (!glfwWindowShouldClose(app.window) && !viewWindowsShouldClose(app)) {
     glfwPollEvents();
+    waitForFrame(app);
+    processWindowEvents(app);
     errorCode = drawFrame();
     if (errorCode != VK_SUCCESS) {
       break;
@@ -305,15 +584,65 @@ int mainLoop() {
   return errorCode;
 }
 
+/**
+ * The main thread only processes window events and forwards them to the render thread.
+ * It blocks in glfwWaitEvents so moving or resizing the window no longer freezes rendering.
+ *
+ * @return
+ */
+int mainLoop() {
+  if (app.options.singleThread && app.options.onDemand) {
+    logWarning("--on-demand needs the render thread, drawing continuously with --single-thread");
+    app.options.onDemand = false; // waiting for a redraw would stop event polling as well
+  }
+  app.running = true;
+  startFramePacer(app);
+  if (app.options.singleThread) {
+    app.renderResult = singleThreadLoop();
+    app.running = false;
+  } else {
+    std::thread renderThread(renderLoop);
+    while (app.running.load() && !glfwWindowShouldClose(app.window) && !viewWindowsShouldClose(app)) {
+      glfwWaitEvents();
+    }
+    app.running = false;
+    requestRedraw(app); // the render thread may be waiting for a reason to draw
+    renderThread.join();
+  }
+  printFramePacing(app);
+  printInputLatency(app);
+  printPresentTiming(app);
+  return app.renderResult;
+}
+
 /**
  * Vulkan resource cleanup. The operation order MATTERS.
  *
  * @return
  */
 int cleanup() {
+  printPipelineLibraryStats(app);
+  destroyPipelineLibrary(app);
   cleanupSwapChain();
+  destroyWindowViews(app);
+  printResolutionHistory(app);
+  destroyDynamicResolution(app);
+  destroyFrameCapture(app);
+  destroyFrameCommandBuffers(app);
+  printCommandCacheStats(app);
+  destroyCommandCache(app);
+  destroySpriteBatcher(app);
+  printClusteredLightingStats(app);
+  destroyClusteredLighting(app);
+  destroyParticleSystem(app, app.particles);
+  printLodSceneStats(app);
+  destroyLodScene(app);
+  destroyGpuTracer(app);
+  printMemoryReport(app);
+  vkDestroyPipelineLayout(app.device, app.pipelineLayout, nullptr);
+  vkDestroyDescriptorSetLayout(app.device, app.lighting.setLayout, nullptr);
   vkDestroyBuffer(app.device, app.vertexBuffer, nullptr);
-  vkFreeMemory(app.device, app.vertexBufferMemory, nullptr);
+  freeMemory(app, app.vertexBufferMemory);
   for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i) {
     vkDestroySemaphore(app.device, app.renderFinishedSemaphores[i], nullptr);
     vkDestroySemaphore(app.device, app.imageAvailableSemaphores[i], nullptr);
@@ -329,21 +658,80 @@ int cleanup() {
   vkDestroyInstance(app.instance, nullptr);
   glfwDestroyWindow(app.window);
   glfwTerminate();
+  if (!app.options.traceFile.empty()) {
+    writeChromeTrace(app.options.traceFile);
+  }
   return 0;
 }
 
-int runApplication() {
-  initWindow();
+static int runVulkan() {
   int errorCode = initVulkan();
   returnOnError(errorCode)
-  errorCode = mainLoop();
-  returnOnError(errorCode)
+  bool regressionPassed = true;
+  if (!app.options.metricsEndpoint.empty() && !startMetricsServer(app, app.options.metricsEndpoint)) {
+    errorCode = VK_ERROR_INITIALIZATION_FAILED;
+  } else if (!app.options.regressionScenario.empty()) {
+    errorCode = runRegressionScenario(app, drawFrame, regressionPassed);
+  } else if (app.options.benchSpecialization) {
+    errorCode = runSpecializationBenchmark(app);
+  } else if (app.options.benchDispatch) {
+    errorCode = runDispatchBenchmark(app);
+  } else if (app.options.benchSprites) {
+    errorCode = runSpriteBenchmark(app);
+  } else if (app.options.benchVertexFormats) {
+    errorCode = runVertexFormatBenchmark(app);
+  } else if (app.options.benchOcclusion) {
+    errorCode = runOcclusionBenchmark(app);
+  } else if (app.options.benchLights) {
+    errorCode = runLightingBenchmark(app);
+  } else if (app.options.benchParticles) {
+    errorCode = runParticleBenchmark(app);
+  } else if (app.options.benchStress) {
+    errorCode = runStressBenchmark(app);
+  } else {
+    errorCode = mainLoop();
+  }
+  stopMetricsServer(app);
+  if (errorCode != VK_SUCCESS) {
+    vkDeviceWaitIdle(app.device); // a failed frame or benchmark may have left work in flight
+    cleanup();
+    return errorCode;
+  }
   errorCode = cleanup();
   returnOnError(errorCode)
 
+  return regressionPassed ? errorCode : 1;
+}
+
+int runApplication() {
+  startLogger();
+  int errorCode = runVulkan();
+  stopLogger(); // on every path, the records queued before an error explain it
   return errorCode;
 }
 
-int main() {
+int main(int argc, char **argv) {
+  nameTraceThread("main");
+  if (!parseOptions(argc, argv, app.options)) {
+    return 1;
+  }
+  if (!app.options.traceFile.empty()) {
+    startTracing();
+  }
+  if (!app.options.assetArchive.empty() && !mountAssetArchive(app.options.assetArchive)) {
+    return 1;
+  }
+  if (!app.options.buildLodInput.empty()) {
+    return buildLodFile(app.options.buildLodInput, app.options.buildLodOutput);
+  }
+  if (app.options.benchLod) {
+    return runLodBenchmark(); // CPU only, needs neither a window nor a device
+  }
+  if (app.options.benchSceneGraph) {
+    return runSceneGraphBenchmark(app.options.sceneGraphNodes); // CPU only as well
+  }
+  if (app.options.benchIo) {
+    return runFileBenchmark(app.options.ioBenchmarkFiles);
+  }
   return runApplication();
 }
@@ -0,0 +1,254 @@
+#include <algorithm>
+#include "MemoryBudget.h"
+#include "../Application.h"
+
+const double MEMORY_WARNING_RATIO = 0.9; // warn once a heap uses this much of its budget
+const double FALLBACK_BUDGET_RATIO = 0.8; // without VK_EXT_memory_budget assume we can use this much of a heap
+
+static const char *categoryNames[MEMORY_CATEGORY_COUNT] = {"geometry", "textures", "staging", "attachments"};
+
+static double toMegabytes(VkDeviceSize bytes) {
+  return bytes / (1024.0 * 1024.0);
+}
+
+/**
+ * The driver reported usage lags behind our own bookkeeping between refreshes while our
+ * bookkeeping misses memory allocated by the driver itself, so take whichever is larger.
+ */
+static VkDeviceSize heapUsage(const MemoryHeapStats &heap) {
+  return std::max(heap.used, heap.processUsage);
+}
+
+static void refreshBudgetLocked(Application &app) {
+  MemoryTracker &tracker = app.memory;
+  if (tracker.budgetEnabled) {
+    VkPhysicalDeviceMemoryBudgetPropertiesEXT budget{};
+    budget.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT;
+    VkPhysicalDeviceMemoryProperties2 properties{};
+    properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2;
+    properties.pNext = &budget;
+    vkGetPhysicalDeviceMemoryProperties2KHR(app.physicalDevice.device, &properties);
+    for (uint32_t i = 0; i < tracker.properties.memoryHeapCount; ++i) {
+      tracker.heaps[i].budget = budget.heapBudget[i];
+      tracker.heaps[i].processUsage = budget.heapUsage[i];
+      publishHeapMetrics(app, i);
+    }
+  } else {
+    for (uint32_t i = 0; i < tracker.properties.memoryHeapCount; ++i) {
+      tracker.heaps[i].budget = static_cast<VkDeviceSize>(tracker.properties.memoryHeaps[i].size * FALLBACK_BUDGET_RATIO);
+      tracker.heaps[i].processUsage = tracker.heaps[i].used;
+      publishHeapMetrics(app, i);
+    }
+  }
+}
+
+/**
+ * Queries the memory heaps of the physical device. Must be called right after the device is created,
+ * before anything is allocated.
+ *
+ * @param app
+ */
+void initMemoryTracker(Application &app) {
+  std::lock_guard<std::mutex> lock(app.memory.mutex);
+  vkGetPhysicalDeviceMemoryProperties(app.physicalDevice.device, &app.memory.properties);
+  refreshBudgetLocked(app);
+  logInfo("Memory budget tracking {}", app.memory.budgetEnabled ? "uses VK_EXT_memory_budget" : "estimates budgets from the heap sizes");
+}
+
+/**
+ * Re-reads the budgets and the process usage from the driver. They change as other applications
+ * allocate memory, so this runs on every allocation and report.
+ *
+ * @param app
+ */
+void refreshMemoryBudget(Application &app) {
+  std::lock_guard<std::mutex> lock(app.memory.mutex);
+  refreshBudgetLocked(app);
+}
+
+/**
+ * Based on the required memory properties, we find the matching GPU memory representation
+ * that can satisfy the requirements. Memory types are ordered by preference, so the first type
+ * with all the properties we need wins, unless its heap can't fit the allocation within budget
+ * while a later matching type in another heap can.
+ *
+ * @param app
+ * @param typeFilter
+ * @param properties
+ * @param size
+ * @param errorCode
+ * @return
+ */
+uint32_t findMemoryType(Application &app, uint32_t typeFilter, VkMemoryPropertyFlags properties, VkDeviceSize size,
+                        VkResult &errorCode) {
+  MemoryTracker &tracker = app.memory;
+  std::lock_guard<std::mutex> lock(tracker.mutex);
+  uint32_t fallback = UINT32_MAX;
+  for (uint32_t i = 0; i < tracker.properties.memoryTypeCount; i++) {
+    const VkMemoryType &type = tracker.properties.memoryTypes[i];
+    if (!(typeFilter & (1u << i)) || (type.propertyFlags & properties) != properties) {
+      continue;
+    }
+    const MemoryHeapStats &heap = tracker.heaps[type.heapIndex];
+    if (heapUsage(heap) + size <= heap.budget) {
+      return i;
+    }
+    if (fallback == UINT32_MAX) {
+      fallback = i; // over budget, but still better than failing
+    }
+  }
+  if (fallback != UINT32_MAX) {
+    return fallback;
+  }
+  logError("Unable to find suitable memory type");
+  errorCode = VK_ERROR_MEMORY_MAP_FAILED;
+  return fallback;
+}
+
+/**
+ * Runs the eviction callbacks without holding the tracker lock, since they are expected to free memory.
+ *
+ * @param app
+ * @param heapIndex
+ * @param bytesNeeded
+ */
+static void requestEviction(Application &app, uint32_t heapIndex, VkDeviceSize bytesNeeded) {
+  std::vector<EvictionCallback> callbacks;
+  {
+    std::lock_guard<std::mutex> lock(app.memory.mutex);
+    callbacks = app.memory.evictionCallbacks;
+    app.memory.evictionRequests++;
+  }
+  logWarning("Memory heap {} needs {} MB more than its budget allows, requesting eviction", heapIndex, toMegabytes(bytesNeeded));
+  for (auto &callback : callbacks) {
+    callback(app, heapIndex, bytesNeeded);
+  }
+  refreshMemoryBudget(app);
+}
+
+static void trackAllocation(Application &app, VkDeviceMemory memory, const MemoryAllocation &allocation) {
+  MemoryTracker &tracker = app.memory;
+  std::lock_guard<std::mutex> lock(tracker.mutex);
+  tracker.allocations.emplace(memory, allocation);
+  MemoryHeapStats &heap = tracker.heaps[allocation.heapIndex];
+  heap.used += allocation.size;
+  heap.peak = std::max(heap.peak, heap.used);
+  heap.categoryUsed[allocation.category] += allocation.size;
+  heap.allocationCount++;
+  publishHeapMetrics(app, allocation.heapIndex);
+  if (!heap.warned && heapUsage(heap) >= heap.budget * MEMORY_WARNING_RATIO) {
+    heap.warned = true;
+    logWarning("Memory heap {} is at {} MB of its {} MB budget", allocation.heapIndex, toMegabytes(heapUsage(heap)),
+               toMegabytes(heap.budget));
+  }
+}
+
+/**
+ * Allocates device memory and accounts it to the given category. If the allocation would go over the
+ * budget of its heap, or the driver runs out of memory, the eviction callbacks get a chance to make room.
+ * Memory allocated here must be released with freeMemory.
+ *
+ * @param app
+ * @param requirements
+ * @param properties
+ * @param category
+ * @param memory
+ * @return
+ */
+VkResult allocateMemory(Application &app, const VkMemoryRequirements &requirements, VkMemoryPropertyFlags properties,
+                        MemoryCategory category, VkDeviceMemory &memory) {
+  VkResult errorCode = VK_SUCCESS;
+  refreshMemoryBudget(app);
+  uint32_t typeIndex = findMemoryType(app, requirements.memoryTypeBits, properties, requirements.size, errorCode);
+  returnOnError(errorCode)
+  uint32_t heapIndex = app.memory.properties.memoryTypes[typeIndex].heapIndex;
+
+  VkDeviceSize projected;
+  VkDeviceSize budget;
+  {
+    std::lock_guard<std::mutex> lock(app.memory.mutex);
+    projected = heapUsage(app.memory.heaps[heapIndex]) + requirements.size;
+    budget = app.memory.heaps[heapIndex].budget;
+  }
+  if (projected > budget) {
+    requestEviction(app, heapIndex, projected - budget);
+  }
+
+  VkMemoryAllocateInfo allocInfo{};
+  allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+  allocInfo.allocationSize = requirements.size;
+  allocInfo.memoryTypeIndex = typeIndex;
+  errorCode = vkAllocateMemory(app.device, &allocInfo, nullptr, &memory);
+  if (errorCode == VK_ERROR_OUT_OF_DEVICE_MEMORY) {
+    requestEviction(app, heapIndex, requirements.size);
+    errorCode = vkAllocateMemory(app.device, &allocInfo, nullptr, &memory);
+  }
+  returnOnError(errorCode)
+  trackAllocation(app, memory, {requirements.size, heapIndex, category});
+  return VK_SUCCESS;
+}
+
+void freeMemory(Application &app, VkDeviceMemory memory) {
+  if (memory == VK_NULL_HANDLE) {
+    return;
+  }
+  {
+    MemoryTracker &tracker = app.memory;
+    std::lock_guard<std::mutex> lock(tracker.mutex);
+    auto it = tracker.allocations.find(memory);
+    if (it != tracker.allocations.end()) {
+      MemoryHeapStats &heap = tracker.heaps[it->second.heapIndex];
+      heap.used -= it->second.size;
+      heap.categoryUsed[it->second.category] -= it->second.size;
+      heap.allocationCount--;
+      publishHeapMetrics(app, it->second.heapIndex);
+      if (heapUsage(heap) < heap.budget * MEMORY_WARNING_RATIO) {
+        heap.warned = false;
+      }
+      tracker.allocations.erase(it);
+    }
+  }
+  vkFreeMemory(app.device, memory, nullptr);
+}
+
+void addEvictionCallback(Application &app, EvictionCallback callback) {
+  std::lock_guard<std::mutex> lock(app.memory.mutex);
+  app.memory.evictionCallbacks.push_back(std::move(callback));
+}
+
+/**
+ * @param app
+ * @param memory
+ * @return the heap the memory was allocated from, UINT32_MAX if it wasn't allocated through allocateMemory
+ */
+uint32_t allocationHeap(Application &app, VkDeviceMemory memory) {
+  std::lock_guard<std::mutex> lock(app.memory.mutex);
+  auto it = app.memory.allocations.find(memory);
+  return it != app.memory.allocations.end() ? it->second.heapIndex : UINT32_MAX;
+}
+
+/**
+ * Logs a snapshot of the live, peak and budgeted memory of every heap, split by category.
+ *
+ * @param app
+ */
+void printMemoryReport(Application &app) {
+  MemoryTracker &tracker = app.memory;
+  std::lock_guard<std::mutex> lock(tracker.mutex);
+  refreshBudgetLocked(app);
+  logInfo("Memory report ({}), {} eviction requests",
+          tracker.budgetEnabled ? "VK_EXT_memory_budget" : "estimated budgets", tracker.evictionRequests);
+  for (uint32_t i = 0; i < tracker.properties.memoryHeapCount; ++i) {
+    const MemoryHeapStats &heap = tracker.heaps[i];
+    bool deviceLocal = tracker.properties.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT;
+    logInfo("  heap {} ({}): {} MB used in {} allocations, {} MB peak, {} MB process usage, {} MB budget of {} MB",
+            i, deviceLocal ? "device local" : "host", toMegabytes(heap.used), heap.allocationCount,
+            toMegabytes(heap.peak), toMegabytes(heap.processUsage), toMegabytes(heap.budget),
+            toMegabytes(tracker.properties.memoryHeaps[i].size));
+    for (uint32_t category = 0; category < MEMORY_CATEGORY_COUNT; ++category) {
+      if (heap.categoryUsed[category] > 0) {
+        logInfo("    {}: {} MB", categoryNames[category], toMegabytes(heap.categoryUsed[category]));
+      }
+    }
+  }
+}
@@ -0,0 +1,63 @@
+#ifndef VULKANDEMO_MEMORYBUDGET_H
+#define VULKANDEMO_MEMORYBUDGET_H
+
+#include <functional>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+#include "../dispatch/Dispatch.h"
+
+struct Application;
+
+enum MemoryCategory {
+    MEMORY_GEOMETRY,
+    MEMORY_TEXTURES,
+    MEMORY_STAGING,
+    MEMORY_ATTACHMENTS,
+    MEMORY_CATEGORY_COUNT
+};
+
+/**
+ * Called when an allocation would push a heap over its budget, or failed with out of memory.
+ * The callback should free what it can spare from the given heap, e.g. cached textures.
+ */
+typedef std::function<void(Application &app, uint32_t heapIndex, VkDeviceSize bytesNeeded)> EvictionCallback;
+
+typedef struct MemoryAllocation {
+    VkDeviceSize size;
+    uint32_t heapIndex;
+    MemoryCategory category;
+} MemoryAllocation;
+
+typedef struct MemoryHeapStats {
+    VkDeviceSize budget; // from VK_EXT_memory_budget, or a fixed fraction of the heap size without it
+    VkDeviceSize processUsage; // reported by the driver, includes memory we don't allocate ourselves
+    VkDeviceSize used; // live memory allocated through allocateMemory
+    VkDeviceSize peak;
+    VkDeviceSize categoryUsed[MEMORY_CATEGORY_COUNT];
+    uint32_t allocationCount;
+    bool warned; // the heap is above MEMORY_WARNING_RATIO of its budget and we said so
+} MemoryHeapStats;
+
+typedef struct MemoryTracker {
+    bool properties2Enabled = false; // VK_KHR_get_physical_device_properties2 is enabled on the instance
+    bool budgetEnabled = false; // VK_EXT_memory_budget is enabled on the device
+    VkPhysicalDeviceMemoryProperties properties{};
+    MemoryHeapStats heaps[VK_MAX_MEMORY_HEAPS]{};
+    std::unordered_map<VkDeviceMemory, MemoryAllocation> allocations;
+    std::vector<EvictionCallback> evictionCallbacks;
+    uint64_t evictionRequests = 0;
+    std::mutex mutex; // allocations happen on the main, render and worker threads
+} MemoryTracker;
+
+void initMemoryTracker(Application &app);
+void refreshMemoryBudget(Application &app);
+uint32_t findMemoryType(Application &app, uint32_t typeFilter, VkMemoryPropertyFlags properties, VkDeviceSize size,
+                        VkResult &errorCode);
+VkResult allocateMemory(Application &app, const VkMemoryRequirements &requirements, VkMemoryPropertyFlags properties,
+                        MemoryCategory category, VkDeviceMemory &memory);
+void freeMemory(Application &app, VkDeviceMemory memory);
+void addEvictionCallback(Application &app, EvictionCallback callback);
+uint32_t allocationHeap(Application &app, VkDeviceMemory memory);
+void printMemoryReport(Application &app);
+#endif //VULKANDEMO_MEMORYBUDGET_H
@@ -0,0 +1,201 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include "LodScene.h"
+#include "../Application.h"
+#include "../buffers/Vertex.h"
+#include "../pipeline/GraphicsPipeline.h"
+
+const uint32_t ASTEROID_SUBDIVISIONS = 5; // 20480 triangles at full detail
+const uint32_t LOD_GRID_COLUMNS = 8;
+const uint32_t LOD_GRID_ROWS = 5;
+
+/**
+ * Uploads the positions, shaded with a fixed light since the scene has no lighting of its own,
+ * and the indices of all LODs into host visible buffers.
+ */
+static VkResult uploadLodMesh(Application &app, LodScene &scene) {
+  const glm::vec3 light = glm::normalize(glm::vec3(-0.4f, -0.5f, -0.77f)); // towards the viewer, from the top left
+  std::vector<Vertex> meshVertices(scene.mesh.positions.size());
+  for (size_t i = 0; i < meshVertices.size(); ++i) {
+    const float shade = 0.15f + 0.85f * std::max(glm::dot(scene.mesh.normals[i], light), 0.0f);
+    meshVertices[i] = {{scene.mesh.positions[i].x, scene.mesh.positions[i].y}, glm::vec3(0.75f, 0.62f, 0.5f) * shade};
+  }
+
+  const VkDeviceSize vertexSize = sizeof(Vertex) * meshVertices.size();
+  VkResult errorCode = createBuffer(app, vertexSize, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+                                    VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                                    MEMORY_GEOMETRY, scene.vertexBuffer, scene.vertexBufferMemory);
+  returnOnError(errorCode)
+  void *data;
+  errorCode = vkMapMemory(app.device, scene.vertexBufferMemory, 0, vertexSize, 0, &data);
+  returnOnError(errorCode)
+  memcpy(data, meshVertices.data(), (size_t) vertexSize);
+  vkUnmapMemory(app.device, scene.vertexBufferMemory);
+
+  const VkDeviceSize indexSize = sizeof(uint32_t) * scene.mesh.indices.size();
+  errorCode = createBuffer(app, indexSize, VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
+                           VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                           MEMORY_GEOMETRY, scene.indexBuffer, scene.indexBufferMemory);
+  returnOnError(errorCode)
+  errorCode = vkMapMemory(app.device, scene.indexBufferMemory, 0, indexSize, 0, &data);
+  returnOnError(errorCode)
+  memcpy(data, scene.mesh.indices.data(), (size_t) indexSize);
+  vkUnmapMemory(app.device, scene.indexBufferMemory);
+  return VK_SUCCESS;
+}
+
+/**
+ * Loads the mesh given with --mesh, or builds the LODs of a generated asteroid. Only touches the
+ * CPU side of the scene, so initialization runs it on another thread while the swapchain is set up.
+ *
+ * @param app
+ * @return
+ */
+VkResult loadLodScene(Application &app) {
+  TRACE_ZONE("loadLodScene");
+  LodScene &scene = app.lodScene;
+  if (!app.options.lodDemo || !scene.mesh.lods.empty()) {
+    return VK_SUCCESS;
+  }
+  if (!app.options.meshFile.empty()) {
+    if (!loadLodMesh(app.options.meshFile, scene.mesh)) {
+      return VK_ERROR_INITIALIZATION_FAILED;
+    }
+  } else {
+    auto start = std::chrono::steady_clock::now();
+    generateAsteroid(ASTEROID_SUBDIVISIONS, scene.mesh);
+    buildMeshLods(scene.mesh);
+    std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+    std::cout << "Built " << scene.mesh.lods.size() << " LODs of a " << scene.mesh.lods[0].indexCount / 3
+              << " triangle mesh in " << elapsed.count() << " ms" << std::endl;
+  }
+  return VK_SUCCESS;
+}
+
+/**
+ * Uploads the mesh loaded by loadLodScene, loading it first if that didn't happen yet, and lays
+ * out a grid of instances shrinking from a third of the window to a few pixels.
+ *
+ * @param app
+ * @return
+ */
+VkResult createLodScene(Application &app) {
+  TRACE_ZONE("createLodScene");
+  LodScene &scene = app.lodScene;
+  if (!app.options.lodDemo) {
+    return VK_SUCCESS;
+  }
+  VkResult errorCode = loadLodScene(app);
+  if (errorCode != VK_SUCCESS) {
+    return errorCode;
+  }
+  errorCode = uploadLodMesh(app, scene);
+  if (errorCode != VK_SUCCESS) {
+    std::cerr << "Unable to upload LOD mesh" << std::endl;
+    return errorCode;
+  }
+
+  const uint32_t count = LOD_GRID_COLUMNS * LOD_GRID_ROWS;
+  for (uint32_t i = 0; i < count; ++i) {
+    const float column = static_cast<float>(i % LOD_GRID_COLUMNS), row = static_cast<float>(i / LOD_GRID_COLUMNS);
+    LodInstance instance;
+    instance.center = glm::vec2((column + 0.5f) / LOD_GRID_COLUMNS, (row + 0.5f) / LOD_GRID_ROWS);
+    instance.radius = 0.3f * std::pow(0.86f, static_cast<float>(i)); // ~0.3% of the height for the last one
+    scene.instances.push_back(instance);
+  }
+  scene.selectedLods.resize(count, 0);
+  scene.transforms.resize(count);
+  scene.enabled = true;
+  return VK_SUCCESS;
+}
+
+void zoomLodScene(Application &app, double scrollOffset) {
+  app.lodScene.zoom = std::min(std::max(app.lodScene.zoom * static_cast<float>(std::pow(1.15, scrollOffset)), 0.05f), 20.0f);
+}
+
+/**
+ * Picks the LOD of every instance from the size it covers on the screen and accumulates how many
+ * triangles that submits against the full detail mesh. Runs every frame.
+ *
+ * @param app
+ * @return signature of the selection, which changes whenever the recorded scene would
+ */
+uint64_t selectSceneLods(Application &app) {
+  LodScene &scene = app.lodScene;
+  scene.pipeline = requestPipeline(app, lodPipelineKey(app));
+  const float width = static_cast<float>(app.sceneExtent.width);
+  const float height = static_cast<float>(app.sceneExtent.height);
+  scene.submittedTriangles = 0;
+  scene.fullDetailTriangles = 0;
+  scene.maxErrorPixels = 0.0f;
+
+  uint64_t hash = 14695981039346656037ull; // FNV-1a
+  auto mix = [&hash](uint64_t value) {
+    hash ^= value;
+    hash *= 1099511628211ull;
+  };
+  mix((uint64_t) scene.pipeline);
+  mix(static_cast<uint64_t>(app.sceneExtent.width) << 32 | app.sceneExtent.height);
+  uint32_t zoomBits;
+  memcpy(&zoomBits, &scene.zoom, sizeof(zoomBits));
+  mix(zoomBits);
+
+  for (size_t i = 0; i < scene.instances.size(); ++i) {
+    const LodInstance &instance = scene.instances[i];
+    const float pixelsPerUnit = instance.radius * scene.zoom * height / scene.mesh.radius;
+    const uint32_t lod = selectLod(scene.mesh, pixelsPerUnit, app.options.lodErrorPixels);
+    scene.selectedLods[i] = lod;
+    scene.transforms[i].offset = instance.center * 2.0f - glm::vec2(1.0f);
+    scene.transforms[i].scale = glm::vec2(pixelsPerUnit * 2.0f / width, pixelsPerUnit * 2.0f / height);
+    scene.submittedTriangles += scene.mesh.lods[lod].indexCount / 3;
+    scene.fullDetailTriangles += scene.mesh.lods[0].indexCount / 3;
+    scene.maxErrorPixels = std::max(scene.maxErrorPixels, scene.mesh.lods[lod].error * pixelsPerUnit);
+    mix(lod);
+  }
+  scene.frames++;
+  scene.totalSubmittedTriangles += scene.submittedTriangles;
+  scene.totalFullDetailTriangles += scene.fullDetailTriangles;
+  return hash;
+}
+
+/**
+ * Draws every instance with its selected LOD. Part of the scene segment of the command cache.
+ *
+ * @param app
+ * @param commandBuffer
+ */
+void recordLodScene(Application &app, VkCommandBuffer commandBuffer) {
+  LodScene &scene = app.lodScene;
+  vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, scene.pipeline);
+  VkDeviceSize offset = 0;
+  vkCmdBindVertexBuffers(commandBuffer, 0, 1, &scene.vertexBuffer, &offset);
+  vkCmdBindIndexBuffer(commandBuffer, scene.indexBuffer, 0, VK_INDEX_TYPE_UINT32);
+  for (size_t i = 0; i < scene.instances.size(); ++i) {
+    const MeshLod &lod = scene.mesh.lods[scene.selectedLods[i]];
+    vkCmdPushConstants(commandBuffer, app.pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, sizeof(FragmentFeatures),
+                       sizeof(MeshTransform), &scene.transforms[i]);
+    vkCmdDrawIndexed(commandBuffer, lod.indexCount, 1, lod.firstIndex, 0, 0);
+  }
+}
+
+void printLodSceneStats(Application &app) {
+  LodScene &scene = app.lodScene;
+  if (!scene.enabled || scene.frames == 0) {
+    return;
+  }
+  std::cout << "LOD selection: " << scene.submittedTriangles << " of " << scene.fullDetailTriangles
+            << " triangles submitted this frame, max projected error " << scene.maxErrorPixels << " px (budget "
+            << app.options.lodErrorPixels << " px), " << 100.0 * scene.totalSubmittedTriangles / scene.totalFullDetailTriangles
+            << "% of full detail over " << scene.frames << " frames" << std::endl;
+}
+
+void destroyLodScene(Application &app) {
+  LodScene &scene = app.lodScene;
+  vkDestroyBuffer(app.device, scene.vertexBuffer, nullptr);
+  freeMemory(app, scene.vertexBufferMemory);
+  vkDestroyBuffer(app.device, scene.indexBuffer, nullptr);
+  freeMemory(app, scene.indexBufferMemory);
+}
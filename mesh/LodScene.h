@@ -0,0 +1,57 @@
+#ifndef VULKANDEMO_LODSCENE_H
+#define VULKANDEMO_LODSCENE_H
+
+#include <vector>
+#include "MeshLod.h"
+#include "../dispatch/Dispatch.h"
+
+struct Application;
+
+/**
+ * Vertex stage push constants of vertex_mesh.vert, placed after the fragment stage's FragmentFeatures.
+ */
+typedef struct MeshTransform {
+    glm::vec2 offset; // normalized device coordinates
+    glm::vec2 scale; // object space to normalized device coordinates
+} MeshTransform;
+
+typedef struct LodInstance {
+    glm::vec2 center; // fraction of the window
+    float radius; // fraction of the window height at zoom 1
+} LodInstance;
+
+/**
+ * Instances of one LOD mesh drawn as part of the scene, each with the LOD whose error projected
+ * to the screen stays below Options::lodErrorPixels. Selection runs every frame, the scene is only
+ * re-recorded when the selection changes.
+ */
+typedef struct LodScene {
+    bool enabled = false;
+    LodMesh mesh;
+    VkBuffer vertexBuffer = VK_NULL_HANDLE; // shared by all LODs
+    VkDeviceMemory vertexBufferMemory = VK_NULL_HANDLE;
+    VkBuffer indexBuffer = VK_NULL_HANDLE; // the index lists of all LODs back to back
+    VkDeviceMemory indexBufferMemory = VK_NULL_HANDLE;
+    VkPipeline pipeline = VK_NULL_HANDLE;
+    std::vector<LodInstance> instances;
+    std::vector<uint32_t> selectedLods; // per instance
+    std::vector<MeshTransform> transforms; // per instance
+    float zoom = 1.0f; // mouse wheel
+
+    // triangles submitted against the worst projected error, per frame and accumulated
+    uint64_t submittedTriangles = 0;
+    uint64_t fullDetailTriangles = 0;
+    float maxErrorPixels = 0.0f;
+    uint64_t frames = 0;
+    uint64_t totalSubmittedTriangles = 0;
+    uint64_t totalFullDetailTriangles = 0;
+} LodScene;
+
+VkResult loadLodScene(Application &app);
+VkResult createLodScene(Application &app);
+void zoomLodScene(Application &app, double scrollOffset);
+uint64_t selectSceneLods(Application &app);
+void recordLodScene(Application &app, VkCommandBuffer commandBuffer);
+void printLodSceneStats(Application &app);
+void destroyLodScene(Application &app);
+#endif //VULKANDEMO_LODSCENE_H
@@ -0,0 +1,563 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <queue>
+#include <sstream>
+#include <unordered_map>
+#include <unordered_set>
+#include "MeshLod.h"
+#include "../vfs/FileSystem.h"
+
+const double BOUNDARY_WEIGHT = 10.0; // keeps open borders from shrinking away
+const double MIN_NORMAL_COSINE = 0.2; // collapses that turn a triangle further than ~78 degrees are rejected
+const char LOD_FILE_MAGIC[4] = {'L', 'O', 'D', '1'};
+
+/**
+ * Symmetric 4x4 matrix summing the squared distances to a set of planes, the upper triangle
+ * stored row by row.
+ */
+typedef struct Quadric {
+    double m[10] = {};
+
+    void addPlane(double a, double b, double c, double d, double weight) {
+      const double plane[4] = {a, b, c, d};
+      int k = 0;
+      for (int i = 0; i < 4; ++i) {
+        for (int j = i; j < 4; ++j) {
+          m[k++] += weight * plane[i] * plane[j];
+        }
+      }
+    }
+
+    void add(const Quadric &other) {
+      for (int k = 0; k < 10; ++k) {
+        m[k] += other.m[k];
+      }
+    }
+
+    double evaluate(const glm::vec3 &v) const {
+      const double x = v.x, y = v.y, z = v.z;
+      return m[0] * x * x + 2 * m[1] * x * y + 2 * m[2] * x * z + 2 * m[3] * x
+             + m[4] * y * y + 2 * m[5] * y * z + 2 * m[6] * y
+             + m[7] * z * z + 2 * m[8] * z
+             + m[9];
+    }
+} Quadric;
+
+typedef struct Collapse {
+    double cost;
+    uint32_t from; // removed, its triangles are attached to 'to'
+    uint32_t to;
+    uint32_t fromVersion;
+    uint32_t toVersion;
+
+    bool operator>(const Collapse &other) const {
+      return cost > other.cost;
+    }
+} Collapse;
+
+/**
+ * Garland-Heckbert edge collapse restricted to collapsing a vertex into a neighbour, so no new
+ * vertices are created. Collapses are taken cheapest first from a heap; entries are invalidated
+ * lazily through per vertex versions instead of being removed.
+ */
+typedef struct Simplifier {
+    const std::vector<glm::vec3> &positions;
+    std::vector<uint32_t> triangles; // current vertices of every triangle
+    std::vector<bool> triangleAlive;
+    std::vector<std::vector<uint32_t>> vertexTriangles; // may contain dead triangles
+    std::vector<Quadric> quadrics;
+    std::vector<uint32_t> versions;
+    std::vector<bool> vertexAlive;
+    std::priority_queue<Collapse, std::vector<Collapse>, std::greater<Collapse>> heap;
+    uint32_t aliveTriangles = 0;
+    double maxCost = 0.0;
+
+    Simplifier(const std::vector<glm::vec3> &positions, const std::vector<uint32_t> &indices)
+        : positions(positions), triangles(indices), triangleAlive(indices.size() / 3, true),
+          vertexTriangles(positions.size()), quadrics(positions.size()), versions(positions.size(), 0),
+          vertexAlive(positions.size(), true), aliveTriangles(static_cast<uint32_t>(indices.size() / 3)) {}
+} Simplifier;
+
+static glm::vec3 triangleNormal(const glm::vec3 &a, const glm::vec3 &b, const glm::vec3 &c) {
+  return glm::cross(b - a, c - a);
+}
+
+static void pushCollapse(Simplifier &s, uint32_t a, uint32_t b) {
+  Quadric q = s.quadrics[a];
+  q.add(s.quadrics[b]);
+  const double costAToB = q.evaluate(s.positions[b]);
+  const double costBToA = q.evaluate(s.positions[a]);
+  if (costAToB <= costBToA) {
+    s.heap.push({std::max(costAToB, 0.0), a, b, s.versions[a], s.versions[b]});
+  } else {
+    s.heap.push({std::max(costBToA, 0.0), b, a, s.versions[b], s.versions[a]});
+  }
+}
+
+static void initializeSimplifier(Simplifier &s) {
+  std::unordered_map<uint64_t, uint32_t> edgeTriangles; // directed edge -> number of triangles using it undirected
+  for (uint32_t t = 0; t < s.triangleAlive.size(); ++t) {
+    const uint32_t *v = &s.triangles[t * 3];
+    const glm::vec3 n = triangleNormal(s.positions[v[0]], s.positions[v[1]], s.positions[v[2]]);
+    const float length = glm::length(n);
+    for (int k = 0; k < 3; ++k) {
+      s.vertexTriangles[v[k]].push_back(t);
+      const uint32_t a = std::min(v[k], v[(k + 1) % 3]), b = std::max(v[k], v[(k + 1) % 3]);
+      edgeTriangles[static_cast<uint64_t>(a) << 32 | b]++;
+    }
+    if (length > 0.0f) {
+      const glm::vec3 unit = n * (1.0f / length);
+      const double d = -glm::dot(unit, s.positions[v[0]]);
+      for (int k = 0; k < 3; ++k) {
+        s.quadrics[v[k]].addPlane(unit.x, unit.y, unit.z, d, 1.0);
+      }
+    }
+  }
+
+  // a plane through every border edge, perpendicular to its triangle, pins the border in place
+  for (uint32_t t = 0; t < s.triangleAlive.size(); ++t) {
+    const uint32_t *v = &s.triangles[t * 3];
+    const glm::vec3 n = triangleNormal(s.positions[v[0]], s.positions[v[1]], s.positions[v[2]]);
+    for (int k = 0; k < 3; ++k) {
+      const uint32_t a = v[k], b = v[(k + 1) % 3];
+      if (edgeTriangles[static_cast<uint64_t>(std::min(a, b)) << 32 | std::max(a, b)] != 1) {
+        continue;
+      }
+      const glm::vec3 border = glm::cross(s.positions[b] - s.positions[a], n);
+      const float length = glm::length(border);
+      if (length > 0.0f) {
+        const glm::vec3 unit = border * (1.0f / length);
+        const double d = -glm::dot(unit, s.positions[a]);
+        s.quadrics[a].addPlane(unit.x, unit.y, unit.z, d, BOUNDARY_WEIGHT);
+        s.quadrics[b].addPlane(unit.x, unit.y, unit.z, d, BOUNDARY_WEIGHT);
+      }
+    }
+  }
+
+  for (const auto &edge : edgeTriangles) {
+    pushCollapse(s, static_cast<uint32_t>(edge.first >> 32), static_cast<uint32_t>(edge.first & 0xffffffffu));
+  }
+}
+
+/**
+ * Checks that moving 'from' onto 'to' doesn't flip or collapse any triangle that survives it.
+ */
+static bool isCollapseValid(const Simplifier &s, uint32_t from, uint32_t to) {
+  for (uint32_t t : s.vertexTriangles[from]) {
+    if (!s.triangleAlive[t]) {
+      continue;
+    }
+    const uint32_t *v = &s.triangles[t * 3];
+    if (v[0] == to || v[1] == to || v[2] == to) {
+      continue; // removed by the collapse
+    }
+    glm::vec3 corners[3] = {s.positions[v[0]], s.positions[v[1]], s.positions[v[2]]};
+    const glm::vec3 before = triangleNormal(corners[0], corners[1], corners[2]);
+    for (int k = 0; k < 3; ++k) {
+      if (v[k] == from) {
+        corners[k] = s.positions[to];
+      }
+    }
+    const glm::vec3 after = triangleNormal(corners[0], corners[1], corners[2]);
+    const double lengths = static_cast<double>(glm::length(before)) * glm::length(after);
+    if (lengths <= 0.0 || glm::dot(before, after) < MIN_NORMAL_COSINE * lengths) {
+      return false;
+    }
+  }
+  return true;
+}
+
+static void applyCollapse(Simplifier &s, const Collapse &collapse) {
+  const uint32_t from = collapse.from, to = collapse.to;
+  for (uint32_t t : s.vertexTriangles[from]) {
+    if (!s.triangleAlive[t]) {
+      continue;
+    }
+    uint32_t *v = &s.triangles[t * 3];
+    if (v[0] == to || v[1] == to || v[2] == to) {
+      s.triangleAlive[t] = false;
+      s.aliveTriangles--;
+      continue;
+    }
+    for (int k = 0; k < 3; ++k) {
+      if (v[k] == from) {
+        v[k] = to;
+      }
+    }
+    s.vertexTriangles[to].push_back(t);
+  }
+  s.vertexTriangles[from].clear();
+  s.vertexAlive[from] = false;
+  s.quadrics[to].add(s.quadrics[from]);
+  s.versions[from]++;
+  s.versions[to]++;
+  s.maxCost = std::max(s.maxCost, collapse.cost);
+
+  // drop the dead triangles and queue the edges around the merged vertex with its new quadric
+  auto &triangles = s.vertexTriangles[to];
+  triangles.erase(std::remove_if(triangles.begin(), triangles.end(), [&s](uint32_t t) { return !s.triangleAlive[t]; }),
+                  triangles.end());
+  std::unordered_set<uint32_t> neighbours;
+  for (uint32_t t : triangles) {
+    for (int k = 0; k < 3; ++k) {
+      if (s.triangles[t * 3 + k] != to) {
+        neighbours.insert(s.triangles[t * 3 + k]);
+      }
+    }
+  }
+  for (uint32_t neighbour : neighbours) {
+    pushCollapse(s, to, neighbour);
+  }
+}
+
+/**
+ * Collapses the cheapest edges until at most the target number of triangles is left.
+ *
+ * @return false if no valid collapse was left before reaching the target
+ */
+static bool simplifyTo(Simplifier &s, uint32_t targetTriangles) {
+  while (s.aliveTriangles > targetTriangles) {
+    if (s.heap.empty()) {
+      return false;
+    }
+    Collapse collapse = s.heap.top();
+    s.heap.pop();
+    if (!s.vertexAlive[collapse.from] || !s.vertexAlive[collapse.to] ||
+        s.versions[collapse.from] != collapse.fromVersion || s.versions[collapse.to] != collapse.toVersion) {
+      continue; // stale, a newer entry exists if the edge is still there
+    }
+    if (!isCollapseValid(s, collapse.from, collapse.to)) {
+      continue; // retried when a neighbour changes and pushes the edge again
+    }
+    applyCollapse(s, collapse);
+  }
+  return true;
+}
+
+static void computeNormals(LodMesh &mesh) {
+  mesh.normals.assign(mesh.positions.size(), glm::vec3(0.0f));
+  for (size_t i = 0; i + 2 < mesh.indices.size(); i += 3) {
+    const uint32_t a = mesh.indices[i], b = mesh.indices[i + 1], c = mesh.indices[i + 2];
+    const glm::vec3 n = triangleNormal(mesh.positions[a], mesh.positions[b], mesh.positions[c]); // area weighted
+    mesh.normals[a] += n;
+    mesh.normals[b] += n;
+    mesh.normals[c] += n;
+  }
+  for (auto &normal : mesh.normals) {
+    const float length = glm::length(normal);
+    normal = length > 0.0f ? normal * (1.0f / length) : glm::vec3(0.0f, 0.0f, 1.0f);
+  }
+  mesh.radius = 0.0f;
+  for (const auto &position : mesh.positions) {
+    mesh.radius = std::max(mesh.radius, glm::length(position));
+  }
+}
+
+/**
+ * Replaces the LODs of the mesh with a chain built from its full detail triangles, roughly halving
+ * the triangle count from one LOD to the next down to MIN_LOD_TRIANGLES. Each LOD records the
+ * square root of the largest quadric error collapsed so far, a bound on its distance to the
+ * original surface.
+ *
+ * @param mesh
+ */
+void buildMeshLods(LodMesh &mesh) {
+  const uint32_t fullIndexCount = mesh.lods.empty() ? static_cast<uint32_t>(mesh.indices.size()) : mesh.lods[0].indexCount;
+  mesh.indices.resize(fullIndexCount);
+  mesh.lods.clear();
+  mesh.lods.push_back({0, fullIndexCount, 0.0f});
+  if (mesh.normals.size() != mesh.positions.size()) {
+    computeNormals(mesh);
+  }
+
+  Simplifier simplifier(mesh.positions, mesh.indices);
+  initializeSimplifier(simplifier);
+  while (mesh.lods.size() < MAX_MESH_LODS && simplifier.aliveTriangles > MIN_LOD_TRIANGLES) {
+    const uint32_t previousTriangles = simplifier.aliveTriangles;
+    const bool reachedTarget = simplifyTo(simplifier, std::max(MIN_LOD_TRIANGLES, previousTriangles / 2));
+    if (simplifier.aliveTriangles > previousTriangles * 9 / 10) {
+      break; // not worth another LOD
+    }
+    MeshLod lod{static_cast<uint32_t>(mesh.indices.size()), 0, static_cast<float>(std::sqrt(simplifier.maxCost))};
+    for (uint32_t t = 0; t < simplifier.triangleAlive.size(); ++t) {
+      if (simplifier.triangleAlive[t]) {
+        mesh.indices.insert(mesh.indices.end(), &simplifier.triangles[t * 3], &simplifier.triangles[t * 3] + 3);
+      }
+    }
+    lod.indexCount = static_cast<uint32_t>(mesh.indices.size()) - lod.firstIndex;
+    mesh.lods.push_back(lod);
+    if (!reachedTarget) {
+      break;
+    }
+  }
+}
+
+/**
+ * An icosphere with its radius displaced by a few octaves of sines, a closed mesh with detail at
+ * every scale for the simplifier to remove.
+ *
+ * @param subdivisions each one quadruples the 20 triangles of the icosahedron
+ * @param mesh
+ */
+void generateAsteroid(uint32_t subdivisions, LodMesh &mesh) {
+  const float t = (1.0f + std::sqrt(5.0f)) / 2.0f;
+  mesh.positions = {
+      {-1, t, 0}, {1, t, 0}, {-1, -t, 0}, {1, -t, 0},
+      {0, -1, t}, {0, 1, t}, {0, -1, -t}, {0, 1, -t},
+      {t, 0, -1}, {t, 0, 1}, {-t, 0, -1}, {-t, 0, 1}
+  };
+  mesh.indices = {
+      0, 11, 5, 0, 5, 1, 0, 1, 7, 0, 7, 10, 0, 10, 11,
+      1, 5, 9, 5, 11, 4, 11, 10, 2, 10, 7, 6, 7, 1, 8,
+      3, 9, 4, 3, 4, 2, 3, 2, 6, 3, 6, 8, 3, 8, 9,
+      4, 9, 5, 2, 4, 11, 6, 2, 10, 8, 6, 7, 9, 8, 1
+  };
+  for (auto &position : mesh.positions) {
+    position = glm::normalize(position);
+  }
+  for (uint32_t level = 0; level < subdivisions; ++level) {
+    std::unordered_map<uint64_t, uint32_t> midpoints;
+    auto midpoint = [&mesh, &midpoints](uint32_t a, uint32_t b) {
+      const uint64_t key = static_cast<uint64_t>(std::min(a, b)) << 32 | std::max(a, b);
+      auto found = midpoints.find(key);
+      if (found != midpoints.end()) {
+        return found->second;
+      }
+      mesh.positions.push_back(glm::normalize((mesh.positions[a] + mesh.positions[b]) * 0.5f));
+      const uint32_t index = static_cast<uint32_t>(mesh.positions.size() - 1);
+      midpoints[key] = index;
+      return index;
+    };
+    std::vector<uint32_t> subdivided;
+    subdivided.reserve(mesh.indices.size() * 4);
+    for (size_t i = 0; i < mesh.indices.size(); i += 3) {
+      const uint32_t a = mesh.indices[i], b = mesh.indices[i + 1], c = mesh.indices[i + 2];
+      const uint32_t ab = midpoint(a, b), bc = midpoint(b, c), ca = midpoint(c, a);
+      const uint32_t triangles[12] = {a, ab, ca, b, bc, ab, c, ca, bc, ab, bc, ca};
+      subdivided.insert(subdivided.end(), triangles, triangles + 12);
+    }
+    mesh.indices.swap(subdivided);
+  }
+  for (auto &position : mesh.positions) {
+    float displacement = 0.0f, amplitude = 0.12f, frequency = 2.0f;
+    for (int octave = 0; octave < 4; ++octave) {
+      displacement += amplitude * std::sin(frequency * position.x + 1.3f * octave) *
+                      std::sin(frequency * position.y + 0.7f) * std::sin(frequency * position.z + 2.1f * octave);
+      amplitude *= 0.5f;
+      frequency *= 2.3f;
+    }
+    position = position * (1.0f + displacement);
+  }
+  mesh.lods.clear();
+  mesh.normals.clear();
+  computeNormals(mesh);
+}
+
+/**
+ * Reads the positions and faces of a Wavefront OBJ file. Faces with more than three corners are
+ * triangulated as fans, texture coordinates and normals are ignored.
+ *
+ * @param path
+ * @param mesh
+ * @return
+ */
+bool loadObjMesh(const std::string &path, LodMesh &mesh) {
+  std::ifstream file(path);
+  if (!file.is_open()) {
+    std::cerr << "Failed to open mesh " << path << std::endl;
+    return false;
+  }
+  mesh = LodMesh{};
+  std::string line;
+  std::vector<uint32_t> face;
+  while (std::getline(file, line)) {
+    std::istringstream tokens(line);
+    std::string type;
+    tokens >> type;
+    if (type == "v") {
+      glm::vec3 position;
+      tokens >> position.x >> position.y >> position.z;
+      mesh.positions.push_back(position);
+    } else if (type == "f") {
+      face.clear();
+      std::string corner;
+      while (tokens >> corner) {
+        long index = strtol(corner.c_str(), nullptr, 10); // "v", "v/vt", "v//vn" or "v/vt/vn"
+        index = index < 0 ? static_cast<long>(mesh.positions.size()) + index : index - 1;
+        if (index < 0 || index >= static_cast<long>(mesh.positions.size())) {
+          std::cerr << "Invalid face in " << path << ": " << line << std::endl;
+          return false;
+        }
+        face.push_back(static_cast<uint32_t>(index));
+      }
+      for (size_t k = 2; k < face.size(); ++k) {
+        mesh.indices.insert(mesh.indices.end(), {face[0], face[k - 1], face[k]});
+      }
+    }
+  }
+  computeNormals(mesh);
+  return !mesh.indices.empty();
+}
+
+template<typename T>
+static void writeArray(std::vector<char> &data, const std::vector<T> &values) {
+  const uint32_t count = static_cast<uint32_t>(values.size());
+  const auto *countBytes = reinterpret_cast<const char *>(&count);
+  const auto *valueBytes = reinterpret_cast<const char *>(values.data());
+  data.insert(data.end(), countBytes, countBytes + sizeof(count));
+  data.insert(data.end(), valueBytes, valueBytes + sizeof(T) * values.size());
+}
+
+template<typename T>
+static bool readArray(const std::vector<char> &data, size_t &offset, std::vector<T> &values) {
+  uint32_t count = 0;
+  if (data.size() - offset < sizeof(count)) {
+    return false;
+  }
+  memcpy(&count, data.data() + offset, sizeof(count));
+  offset += sizeof(count);
+  if ((data.size() - offset) / sizeof(T) < count) {
+    return false;
+  }
+  values.resize(count);
+  memcpy(values.data(), data.data() + offset, sizeof(T) * count);
+  offset += sizeof(T) * count;
+  return true;
+}
+
+/**
+ * Lays the mesh with its LOD chain out in the layout it is uploaded in, so loading it at runtime
+ * is a couple of copies. Native endianness. This is what LOD files and cooked meshes hold.
+ *
+ * @param mesh
+ * @param data replaced by the bytes
+ */
+void serializeLodMesh(const LodMesh &mesh, std::vector<char> &data) {
+  data.assign(LOD_FILE_MAGIC, LOD_FILE_MAGIC + sizeof(LOD_FILE_MAGIC));
+  const auto *radius = reinterpret_cast<const char *>(&mesh.radius);
+  data.insert(data.end(), radius, radius + sizeof(mesh.radius));
+  writeArray(data, mesh.positions);
+  writeArray(data, mesh.normals);
+  writeArray(data, mesh.indices);
+  writeArray(data, mesh.lods);
+}
+
+/**
+ * Reads what serializeLodMesh wrote, checking that every index and LOD lies within the mesh.
+ *
+ * @param data
+ * @param mesh
+ * @return
+ */
+bool parseLodMesh(const std::vector<char> &data, LodMesh &mesh) {
+  size_t offset = sizeof(LOD_FILE_MAGIC) + sizeof(mesh.radius);
+  bool valid = data.size() >= offset && memcmp(data.data(), LOD_FILE_MAGIC, sizeof(LOD_FILE_MAGIC)) == 0;
+  if (valid) {
+    memcpy(&mesh.radius, data.data() + sizeof(LOD_FILE_MAGIC), sizeof(mesh.radius));
+  }
+  valid = valid && readArray(data, offset, mesh.positions) && readArray(data, offset, mesh.normals) &&
+          readArray(data, offset, mesh.indices) && readArray(data, offset, mesh.lods) &&
+          mesh.normals.size() == mesh.positions.size() && !mesh.lods.empty();
+  for (const auto &lod : mesh.lods) {
+    valid = valid && static_cast<size_t>(lod.firstIndex) + lod.indexCount <= mesh.indices.size();
+  }
+  for (uint32_t index : mesh.indices) {
+    valid = valid && index < mesh.positions.size();
+  }
+  return valid;
+}
+
+bool saveLodMesh(const std::string &path, const LodMesh &mesh) {
+  FILE *file = fopen(path.c_str(), "wb");
+  if (file == nullptr) {
+    std::cerr << "Failed to create " << path << std::endl;
+    return false;
+  }
+  std::vector<char> data;
+  serializeLodMesh(mesh, data);
+  fwrite(data.data(), 1, data.size(), file);
+  const bool written = ferror(file) == 0;
+  fclose(file);
+  return written;
+}
+
+/**
+ * Loads a LOD file, from the mounted asset archive if it holds one cooked under that path.
+ *
+ * @param path
+ * @param mesh
+ * @return
+ */
+bool loadLodMesh(const std::string &path, LodMesh &mesh) {
+  std::vector<char> data;
+  if (!readFile(path, data)) {
+    return false;
+  }
+  const bool valid = parseLodMesh(data, mesh);
+  if (!valid) {
+    std::cerr << path << " is not a valid LOD mesh" << std::endl;
+  }
+  return valid;
+}
+
+/**
+ * How many pixels one object space unit covers at the given distance from a perspective camera.
+ *
+ * @param distance
+ * @param fovY vertical field of view in radians
+ * @param screenHeight in pixels
+ * @return
+ */
+float perspectivePixelsPerUnit(float distance, float fovY, float screenHeight) {
+  return screenHeight / (2.0f * std::max(distance, 1e-4f) * std::tan(fovY * 0.5f));
+}
+
+/**
+ * Picks the coarsest LOD whose error, projected to the screen, stays within the given number
+ * of pixels.
+ *
+ * @param mesh
+ * @param pixelsPerUnit
+ * @param maxErrorPixels
+ * @return
+ */
+uint32_t selectLod(const LodMesh &mesh, float pixelsPerUnit, float maxErrorPixels) {
+  uint32_t selected = 0;
+  for (uint32_t lod = 1; lod < mesh.lods.size(); ++lod) {
+    if (mesh.lods[lod].error * pixelsPerUnit > maxErrorPixels) {
+      break; // errors only grow along the chain
+    }
+    selected = lod;
+  }
+  return selected;
+}
+
+/**
+ * The offline half of the LOD builder: simplifies an OBJ mesh into a LOD file that --mesh loads
+ * without simplifying at startup.
+ *
+ * @param input
+ * @param output
+ * @return process exit code
+ */
+int buildLodFile(const std::string &input, const std::string &output) {
+  LodMesh mesh;
+  if (!loadObjMesh(input, mesh)) {
+    return 1;
+  }
+  auto start = std::chrono::steady_clock::now();
+  buildMeshLods(mesh);
+  std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+  std::cout << input << ": " << mesh.positions.size() << " vertices, " << mesh.lods.size() << " LODs built in "
+            << elapsed.count() << " ms" << std::endl;
+  for (size_t lod = 0; lod < mesh.lods.size(); ++lod) {
+    std::cout << "  LOD " << lod << ": " << mesh.lods[lod].indexCount / 3 << " triangles, error "
+              << mesh.lods[lod].error / mesh.radius * 100.0f << "% of the radius" << std::endl;
+  }
+  return saveLodMesh(output, mesh) ? 0 : 1;
+}
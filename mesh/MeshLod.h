@@ -0,0 +1,41 @@
+#ifndef VULKANDEMO_MESHLOD_H
+#define VULKANDEMO_MESHLOD_H
+
+#include <string>
+#include <vector>
+#include "glm/glm.hpp"
+
+const uint32_t MAX_MESH_LODS = 8;
+const uint32_t MIN_LOD_TRIANGLES = 32; // simplification stops below this
+
+typedef struct MeshLod {
+    uint32_t firstIndex;
+    uint32_t indexCount;
+    float error; // largest distance to the original surface, in object space units
+} MeshLod;
+
+/**
+ * A mesh and its chain of simplified versions, finest first. The simplifier only ever collapses a
+ * vertex into one of its neighbours, so every LOD indexes into the same vertices and all of them
+ * share one vertex buffer, with the index lists stored back to back in one index buffer.
+ */
+typedef struct LodMesh {
+    std::vector<glm::vec3> positions;
+    std::vector<glm::vec3> normals; // of the full detail mesh
+    std::vector<uint32_t> indices;
+    std::vector<MeshLod> lods;
+    float radius = 0.0f; // of the bounding sphere around the origin
+} LodMesh;
+
+void generateAsteroid(uint32_t subdivisions, LodMesh &mesh);
+bool loadObjMesh(const std::string &path, LodMesh &mesh);
+void buildMeshLods(LodMesh &mesh);
+void serializeLodMesh(const LodMesh &mesh, std::vector<char> &data);
+bool parseLodMesh(const std::vector<char> &data, LodMesh &mesh);
+bool saveLodMesh(const std::string &path, const LodMesh &mesh);
+bool loadLodMesh(const std::string &path, LodMesh &mesh);
+
+float perspectivePixelsPerUnit(float distance, float fovY, float screenHeight);
+uint32_t selectLod(const LodMesh &mesh, float pixelsPerUnit, float maxErrorPixels);
+int buildLodFile(const std::string &input, const std::string &output);
+#endif //VULKANDEMO_MESHLOD_H
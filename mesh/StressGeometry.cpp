@@ -0,0 +1,184 @@
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <new>
+#include "StressGeometry.h"
+#include "../buffers/Vertex.h"
+#include "../pipeline/Compute.h"
+
+const uint32_t TERRAIN_OCTAVES = 5;
+
+const char *stressShapeName(StressShape shape) {
+  switch (shape) {
+    case STRESS_GRID:
+      return "grid";
+    case STRESS_TERRAIN:
+      return "terrain";
+    case STRESS_SOUP:
+      return "soup";
+    default:
+      return "none";
+  }
+}
+
+static float latticeValue(int32_t x, int32_t y) {
+  uint32_t hash = static_cast<uint32_t>(x) * 374761393u + static_cast<uint32_t>(y) * 668265263u;
+  hash = (hash ^ (hash >> 13)) * 1274126177u;
+  return static_cast<float>((hash ^ (hash >> 16)) & 0xffffu) / 65535.0f;
+}
+
+/**
+ * Value noise with a smoothstep between the lattice points, summed over octaves.
+ *
+ * @return roughly within 0 to 1
+ */
+static float fractalNoise(float x, float y) {
+  float sum = 0.0f, amplitude = 0.5f;
+  for (uint32_t octave = 0; octave < TERRAIN_OCTAVES; ++octave) {
+    const float cellX = std::floor(x), cellY = std::floor(y);
+    float fx = x - cellX, fy = y - cellY;
+    fx = fx * fx * (3.0f - 2.0f * fx);
+    fy = fy * fy * (3.0f - 2.0f * fy);
+    const auto ix = static_cast<int32_t>(cellX), iy = static_cast<int32_t>(cellY);
+    const float top = latticeValue(ix, iy) + fx * (latticeValue(ix + 1, iy) - latticeValue(ix, iy));
+    const float bottom = latticeValue(ix, iy + 1) + fx * (latticeValue(ix + 1, iy + 1) - latticeValue(ix, iy + 1));
+    sum += amplitude * (top + fy * (bottom - top));
+    amplitude *= 0.5f;
+    x *= 2.0f;
+    y *= 2.0f;
+  }
+  return sum / (1.0f - amplitude * 2.0f);
+}
+
+static glm::vec3 terrainColor(float height) {
+  if (height < 0.35f) {
+    return {0.1f, 0.25f, 0.6f}; // water
+  } else if (height < 0.42f) {
+    return {0.76f, 0.7f, 0.5f}; // sand
+  } else if (height < 0.65f) {
+    return {0.2f + height * 0.2f, 0.5f, 0.15f}; // grass
+  } else if (height < 0.8f) {
+    return {0.45f, 0.4f, 0.35f}; // rock
+  }
+  return {0.95f, 0.95f, 0.97f}; // snow
+}
+
+/**
+ * Splits the vertices into rows by columns of quads, two triangles each, as square as possible.
+ */
+static void gridSize(uint32_t vertexCount, uint32_t &columns, uint32_t &rows) {
+  const uint32_t cells = std::max(1u, vertexCount / 6);
+  columns = std::max(1u, static_cast<uint32_t>(std::sqrt(static_cast<double>(cells))));
+  rows = std::max(1u, cells / columns);
+}
+
+/**
+ * Appends the two clockwise triangles of a quad given by its corners, top left first.
+ */
+static void appendQuad(Vertex *out, const Vertex &topLeft, const Vertex &topRight, const Vertex &bottomLeft,
+                       const Vertex &bottomRight) {
+  out[0] = topLeft;
+  out[1] = topRight;
+  out[2] = bottomRight;
+  out[3] = topLeft;
+  out[4] = bottomRight;
+  out[5] = bottomLeft;
+}
+
+static void generateGrid(uint32_t columns, uint32_t rows, Vertex *out) {
+  auto corner = [columns, rows](uint32_t column, uint32_t row, float shade) {
+    const float u = static_cast<float>(column) / static_cast<float>(columns);
+    const float v = static_cast<float>(row) / static_cast<float>(rows);
+    return Vertex{{u * 2.0f - 1.0f, v * 2.0f - 1.0f}, {u, v, shade}};
+  };
+  for (uint32_t row = 0; row < rows; ++row) {
+    for (uint32_t column = 0; column < columns; ++column) {
+      const float shade = (row + column) % 2 == 0 ? 0.8f : 0.3f;
+      appendQuad(out, corner(column, row, shade), corner(column + 1, row, shade), corner(column, row + 1, shade),
+                 corner(column + 1, row + 1, shade));
+      out += 6;
+    }
+  }
+}
+
+/**
+ * A heightfield seen from above, far rows near the horizon at the top, drawn back to front since
+ * the scene has no depth buffer. Rows narrow towards the horizon and heights shrink with distance.
+ * Slopes facing away from the viewer fold over and are culled like back faces.
+ */
+static void generateTerrain(uint32_t columns, uint32_t rows, Vertex *out) {
+  std::vector<Vertex> points(static_cast<size_t>(columns + 1) * (rows + 1));
+  for (uint32_t row = 0; row <= rows; ++row) {
+    const float v = static_cast<float>(row) / static_cast<float>(rows); // 0 at the horizon
+    const float nearness = 0.3f + 0.7f * v;
+    for (uint32_t column = 0; column <= columns; ++column) {
+      const float u = static_cast<float>(column) / static_cast<float>(columns);
+      const float height = fractalNoise(u * 6.0f, v * 6.0f);
+      points[static_cast<size_t>(row) * (columns + 1) + column] = {
+          {(u * 2.0f - 1.0f) * (0.5f + 0.5f * v) * 1.4f, -0.5f + v * 1.5f - height * 0.5f * nearness},
+          terrainColor(height) * (0.6f + 0.4f * v)};
+    }
+  }
+  for (uint32_t row = 0; row < rows; ++row) {
+    const Vertex *top = points.data() + static_cast<size_t>(row) * (columns + 1);
+    const Vertex *bottom = top + columns + 1;
+    for (uint32_t column = 0; column < columns; ++column) {
+      appendQuad(out, top[column], top[column + 1], bottom[column], bottom[column + 1]);
+      out += 6;
+    }
+  }
+}
+
+/**
+ * Equilateral triangles of random size and rotation, sized so they cover the viewport about
+ * twice whatever their number. A rotation keeps them clockwise.
+ */
+static void generateSoup(uint32_t triangles, Vertex *out) {
+  uint32_t state = 7;
+  const float size = 2.5f / std::sqrt(static_cast<float>(triangles));
+  const glm::vec2 corners[3] = {{0.0f, -1.0f}, {0.866f, 0.5f}, {-0.866f, 0.5f}};
+  for (uint32_t triangle = 0; triangle < triangles; ++triangle) {
+    const glm::vec2 center(randomUnit(state) * 2.0f - 1.0f, randomUnit(state) * 2.0f - 1.0f);
+    const float angle = randomUnit(state) * 6.2831853f;
+    const float scale = size * (0.5f + randomUnit(state));
+    const float c = std::cos(angle) * scale, s = std::sin(angle) * scale;
+    const glm::vec3 color(randomUnit(state), randomUnit(state), randomUnit(state));
+    for (const auto &corner : corners) {
+      *out++ = {center + glm::vec2(c * corner.x - s * corner.y, s * corner.x + c * corner.y), color};
+    }
+  }
+}
+
+/**
+ * Generates about vertexCount vertices of the shape as a triangle list of clockwise triangles in
+ * normalized device coordinates, rounded down to whole quads or triangles.
+ *
+ * @param shape
+ * @param vertexCount up to MAX_STRESS_VERTICES
+ * @param vertices
+ * @return false if the vertices don't fit into memory
+ */
+bool generateStressGeometry(StressShape shape, uint32_t vertexCount, std::vector<Vertex> &vertices) {
+  vertexCount = std::max(6u, std::min(vertexCount, MAX_STRESS_VERTICES));
+  uint32_t columns = 0, rows = 0;
+  size_t count = vertexCount / 3 * 3;
+  if (shape == STRESS_GRID || shape == STRESS_TERRAIN) {
+    gridSize(vertexCount, columns, rows);
+    count = static_cast<size_t>(columns) * rows * 6;
+  }
+  try {
+    vertices.resize(count);
+  } catch (const std::bad_alloc &) {
+    std::cerr << "Not enough memory for " << count << " " << stressShapeName(shape) << " vertices" << std::endl;
+    vertices.clear();
+    return false;
+  }
+  if (shape == STRESS_GRID) {
+    generateGrid(columns, rows, vertices.data());
+  } else if (shape == STRESS_TERRAIN) {
+    generateTerrain(columns, rows, vertices.data());
+  } else {
+    generateSoup(static_cast<uint32_t>(count / 3), vertices.data());
+  }
+  return true;
+}
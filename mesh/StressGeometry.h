@@ -0,0 +1,14 @@
+#ifndef VULKANDEMO_STRESSGEOMETRY_H
+#define VULKANDEMO_STRESSGEOMETRY_H
+
+#include <cstdint>
+#include <vector>
+#include "../config/Options.h"
+
+struct Vertex;
+
+const uint32_t MAX_STRESS_VERTICES = 100000000;
+
+const char *stressShapeName(StressShape shape);
+bool generateStressGeometry(StressShape shape, uint32_t vertexCount, std::vector<Vertex> &vertices);
+#endif //VULKANDEMO_STRESSGEOMETRY_H
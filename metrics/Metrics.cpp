@@ -0,0 +1,309 @@
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <winsock2.h>
+#include <ws2tcpip.h>
+typedef SOCKET SocketHandle;
+#define closeSocket closesocket
+#else
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+typedef int SocketHandle;
+const SocketHandle INVALID_SOCKET = -1;
+#define closeSocket close
+#endif
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <sstream>
+#include "Metrics.h"
+#include "../Application.h"
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0 // a scraper that hangs up early must not kill us with SIGPIPE where this exists
+#endif
+
+// upper bounds of the histogram buckets in seconds, around the frame times of common refresh rates
+const double METRICS_BUCKET_SECONDS[METRICS_BUCKET_COUNT - 1] = {0.001, 0.002, 0.004, 0.00694, 0.00833, 0.0167, 0.0333,
+                                                                 0.05, 0.1, 0.25, 1.0};
+const size_t METRICS_MAX_REQUEST = 8192;
+static const char *STAGE_LABELS[FRAME_STAGE_COUNT] = {"wait", "update", "acquire", "record", "submit", "present"};
+static const char *CATEGORY_LABELS[MEMORY_CATEGORY_COUNT] = {"geometry", "textures", "staging", "attachments"};
+
+static void observe(MetricsHistogram &histogram, double seconds) {
+  uint32_t bucket = 0;
+  while (bucket < METRICS_BUCKET_COUNT - 1 && seconds > METRICS_BUCKET_SECONDS[bucket]) {
+    bucket++;
+  }
+  histogram.buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+  histogram.sumNanos.fetch_add(static_cast<uint64_t>(seconds * 1.0e9), std::memory_order_relaxed);
+}
+
+/**
+ * Adds the stage times of the frame drawFrame just presented, and the GPU time of the frame
+ * dynamic resolution read back, if it read a new one. Runs on the render thread.
+ *
+ * @param app
+ */
+void recordFrameMetrics(Application &app) {
+  Metrics &metrics = app.metrics;
+  double milliseconds = 0.0;
+  for (uint32_t stage = 0; stage < FRAME_STAGE_COUNT; ++stage) {
+    milliseconds += app.frameStages.milliseconds[stage];
+    metrics.stageNanos[stage].fetch_add(static_cast<uint64_t>(app.frameStages.milliseconds[stage] * 1.0e6), std::memory_order_relaxed);
+  }
+  observe(metrics.frameTime, milliseconds * 1.0e-3);
+  if (app.resolution.enabled && app.resolution.frames != metrics.gpuSamples) {
+    metrics.gpuSamples = app.resolution.frames;
+    observe(metrics.gpuFrameTime, app.resolution.lastMs * 1.0e-3);
+  }
+}
+
+/**
+ * Copies the statistics of a heap into the metrics. Called with the memory tracker's mutex held,
+ * wherever they change.
+ *
+ * @param app
+ * @param heapIndex
+ */
+void publishHeapMetrics(Application &app, uint32_t heapIndex) {
+  const MemoryHeapStats &heap = app.memory.heaps[heapIndex];
+  Metrics &metrics = app.metrics;
+  metrics.heapUsed[heapIndex].store(heap.used, std::memory_order_relaxed);
+  metrics.heapProcessUsage[heapIndex].store(heap.processUsage, std::memory_order_relaxed);
+  metrics.heapBudget[heapIndex].store(heap.budget, std::memory_order_relaxed);
+  for (uint32_t category = 0; category < MEMORY_CATEGORY_COUNT; ++category) {
+    metrics.categoryUsed[heapIndex][category].store(heap.categoryUsed[category], std::memory_order_relaxed);
+  }
+  metrics.heapCount.store(app.memory.properties.memoryHeapCount, std::memory_order_relaxed);
+}
+
+static void writeHeader(std::ostringstream &out, const char *name, const char *type, const char *help) {
+  out << "# HELP " << name << ' ' << help << "\n# TYPE " << name << ' ' << type << '\n';
+}
+
+static void writeHistogram(std::ostringstream &out, const char *name, const char *help, const MetricsHistogram &histogram) {
+  writeHeader(out, name, "histogram", help);
+  uint64_t cumulative = 0;
+  for (uint32_t bucket = 0; bucket < METRICS_BUCKET_COUNT; ++bucket) {
+    cumulative += histogram.buckets[bucket].load(std::memory_order_relaxed);
+    out << name << "_bucket{le=\"";
+    if (bucket < METRICS_BUCKET_COUNT - 1) {
+      out << METRICS_BUCKET_SECONDS[bucket];
+    } else {
+      out << "+Inf";
+    }
+    out << "\"} " << cumulative << '\n';
+  }
+  out << name << "_sum " << static_cast<double>(histogram.sumNanos.load(std::memory_order_relaxed)) * 1.0e-9 << '\n';
+  out << name << "_count " << cumulative << '\n';
+}
+
+/**
+ * @return every metric in the Prometheus text exposition format
+ */
+static std::string renderMetrics(Application &app) {
+  const Metrics &metrics = app.metrics;
+  const PipelineLibrary &library = app.pipelineLibrary;
+  std::ostringstream out;
+  out << std::setprecision(12);
+  writeHistogram(out, "vulkandemo_frame_time_seconds", "CPU time of a frame including the waits for its fence and the present",
+                 metrics.frameTime);
+  writeHeader(out, "vulkandemo_frame_stage_seconds_total", "counter", "CPU time spent in each stage of drawing frames");
+  for (uint32_t stage = 0; stage < FRAME_STAGE_COUNT; ++stage) {
+    out << "vulkandemo_frame_stage_seconds_total{stage=\"" << STAGE_LABELS[stage] << "\"} "
+        << static_cast<double>(metrics.stageNanos[stage].load(std::memory_order_relaxed)) * 1.0e-9 << '\n';
+  }
+  writeHistogram(out, "vulkandemo_gpu_frame_time_seconds", "GPU time of the frame command buffer, measured with --dynamic-resolution",
+                 metrics.gpuFrameTime);
+  writeHeader(out, "vulkandemo_swapchain_recreations_total", "counter", "Swapchains of the main window recreated");
+  out << "vulkandemo_swapchain_recreations_total " << metrics.swapchainRecreations.load(std::memory_order_relaxed) << '\n';
+
+  writeHeader(out, "vulkandemo_pipelines_compiled_total", "counter", "Graphics pipelines compiled by the pipeline library");
+  out << "vulkandemo_pipelines_compiled_total " << library.compiled.load(std::memory_order_relaxed) << '\n';
+  writeHeader(out, "vulkandemo_pipeline_compile_seconds_total", "counter", "Time spent compiling graphics pipelines");
+  out << "vulkandemo_pipeline_compile_seconds_total " << static_cast<double>(library.compileMicros.load(std::memory_order_relaxed)) * 1.0e-6
+      << '\n';
+  writeHeader(out, "vulkandemo_pipeline_lookups_total", "counter", "Pipeline library lookups by whether the pipeline was known");
+  out << "vulkandemo_pipeline_lookups_total{result=\"hit\"} " << library.hits.load(std::memory_order_relaxed) << '\n';
+  out << "vulkandemo_pipeline_lookups_total{result=\"miss\"} " << library.misses.load(std::memory_order_relaxed) << '\n';
+
+  const uint32_t heapCount = metrics.heapCount.load(std::memory_order_relaxed);
+  writeHeader(out, "vulkandemo_memory_heap_used_bytes", "gauge", "Device memory allocated by the application per heap");
+  for (uint32_t heap = 0; heap < heapCount; ++heap) {
+    out << "vulkandemo_memory_heap_used_bytes{heap=\"" << heap << "\"} " << metrics.heapUsed[heap].load(std::memory_order_relaxed) << '\n';
+  }
+  writeHeader(out, "vulkandemo_memory_heap_process_usage_bytes", "gauge", "Device memory used by the process per heap, as the driver reports it");
+  for (uint32_t heap = 0; heap < heapCount; ++heap) {
+    out << "vulkandemo_memory_heap_process_usage_bytes{heap=\"" << heap << "\"} "
+        << metrics.heapProcessUsage[heap].load(std::memory_order_relaxed) << '\n';
+  }
+  writeHeader(out, "vulkandemo_memory_heap_budget_bytes", "gauge", "Device memory budget per heap");
+  for (uint32_t heap = 0; heap < heapCount; ++heap) {
+    out << "vulkandemo_memory_heap_budget_bytes{heap=\"" << heap << "\"} " << metrics.heapBudget[heap].load(std::memory_order_relaxed) << '\n';
+  }
+  writeHeader(out, "vulkandemo_memory_used_bytes", "gauge", "Device memory allocated by the application per heap and category");
+  for (uint32_t heap = 0; heap < heapCount; ++heap) {
+    for (uint32_t category = 0; category < MEMORY_CATEGORY_COUNT; ++category) {
+      out << "vulkandemo_memory_used_bytes{heap=\"" << heap << "\",category=\"" << CATEGORY_LABELS[category] << "\"} "
+          << metrics.categoryUsed[heap][category].load(std::memory_order_relaxed) << '\n';
+    }
+  }
+  writeHeader(out, "vulkandemo_metrics_scrapes_total", "counter", "Requests for the metrics, including this one");
+  out << "vulkandemo_metrics_scrapes_total " << metrics.scrapes.load(std::memory_order_relaxed) << '\n';
+  return out.str();
+}
+
+static void sendAll(SocketHandle client, const std::string &data) {
+  size_t sent = 0;
+  while (sent < data.size()) {
+    const auto result = send(client, data.data() + sent, static_cast<int>(data.size() - sent), MSG_NOSIGNAL);
+    if (result <= 0) {
+      return;
+    }
+    sent += static_cast<size_t>(result);
+  }
+}
+
+/**
+ * Reads one HTTP request and answers GET /metrics, closing the connection after the response.
+ * A client that sends nothing is given up on after a second.
+ */
+static void serveClient(Application &app, SocketHandle client) {
+#ifdef _WIN32
+  DWORD timeout = 1000;
+#else
+  timeval timeout{1, 0};
+#endif
+  setsockopt(client, SOL_SOCKET, SO_RCVTIMEO, reinterpret_cast<const char *>(&timeout), sizeof(timeout));
+  std::string request;
+  char buffer[1024];
+  while (request.find("\r\n\r\n") == std::string::npos && request.size() < METRICS_MAX_REQUEST) {
+    const auto received = recv(client, buffer, sizeof(buffer), 0);
+    if (received <= 0) {
+      return;
+    }
+    request.append(buffer, static_cast<size_t>(received));
+  }
+
+  std::string status = "404 Not Found";
+  std::string contentType = "text/plain; charset=utf-8";
+  std::string body = "Not found, the metrics are at /metrics\n";
+  if (request.compare(0, 4, "GET ") != 0) {
+    status = "405 Method Not Allowed";
+    body = "Only GET is supported\n";
+  } else if (request.compare(4, 9, "/metrics ") == 0 || request.compare(4, 9, "/metrics?") == 0 || request.compare(4, 2, "/ ") == 0) {
+    app.metrics.scrapes.fetch_add(1, std::memory_order_relaxed);
+    status = "200 OK";
+    contentType = "text/plain; version=0.0.4; charset=utf-8";
+    body = renderMetrics(app);
+  }
+  sendAll(client, "HTTP/1.1 " + status + "\r\nContent-Type: " + contentType + "\r\nContent-Length: " + std::to_string(body.size()) +
+                  "\r\nConnection: close\r\n\r\n" + body);
+}
+
+/**
+ * Body of the metrics thread. Wakes up a few times a second to notice it should stop, requests
+ * are answered one after the other.
+ */
+static void serveMetrics(Application *app, SocketHandle listener, std::string socketPath) {
+  nameTraceThread("metrics");
+  while (!app->metrics.stopping.load()) {
+    fd_set readable;
+    FD_ZERO(&readable);
+    FD_SET(listener, &readable);
+    timeval timeout{0, 200000};
+    if (select(static_cast<int>(listener) + 1, &readable, nullptr, nullptr, &timeout) <= 0) {
+      continue;
+    }
+    SocketHandle client = accept(listener, nullptr, nullptr);
+    if (client == INVALID_SOCKET) {
+      continue;
+    }
+    serveClient(*app, client);
+    closeSocket(client);
+  }
+  closeSocket(listener);
+#ifndef _WIN32
+  if (!socketPath.empty()) {
+    unlink(socketPath.c_str());
+  }
+#endif
+}
+
+/**
+ * Binds the endpoint and starts the thread serving the metrics over HTTP. The endpoint is a port
+ * on the loopback interface, or unix:PATH for a Unix domain socket where the platform has them:
+ *   curl http://127.0.0.1:9464/metrics
+ *   curl --unix-socket PATH http://localhost/metrics
+ *
+ * @param app
+ * @param endpoint
+ * @return false if the endpoint can't be bound
+ */
+bool startMetricsServer(Application &app, const std::string &endpoint) {
+#ifdef _WIN32
+  WSADATA data;
+  if (WSAStartup(MAKEWORD(2, 2), &data) != 0) {
+    logError("Unable to initialize Winsock for the metrics endpoint");
+    return false;
+  }
+#endif
+  std::string socketPath;
+  SocketHandle listener = INVALID_SOCKET;
+  bool bound = false;
+  if (endpoint.compare(0, 5, "unix:") == 0) {
+#ifndef _WIN32
+    socketPath = endpoint.substr(5);
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    if (!socketPath.empty() && socketPath.size() < sizeof(address.sun_path)) {
+      strncpy(address.sun_path, socketPath.c_str(), sizeof(address.sun_path) - 1);
+      unlink(socketPath.c_str()); // left behind by a previous run that didn't exit cleanly
+      listener = socket(AF_UNIX, SOCK_STREAM, 0);
+      bound = listener != INVALID_SOCKET && bind(listener, reinterpret_cast<sockaddr *>(&address), sizeof(address)) == 0;
+    }
+#endif
+  } else {
+    const unsigned long port = strtoul(endpoint.c_str(), nullptr, 10);
+    sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_port = htons(static_cast<uint16_t>(port));
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK); // local scrapers only
+    listener = socket(AF_INET, SOCK_STREAM, 0);
+    if (listener != INVALID_SOCKET && port > 0 && port <= 65535) {
+      int reuse = 1;
+      setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, reinterpret_cast<const char *>(&reuse), sizeof(reuse));
+      bound = bind(listener, reinterpret_cast<sockaddr *>(&address), sizeof(address)) == 0;
+    }
+  }
+  if (!bound || listen(listener, 16) != 0) {
+    logError("Unable to serve metrics on {}", endpoint);
+    if (listener != INVALID_SOCKET) {
+      closeSocket(listener);
+    }
+#ifdef _WIN32
+    WSACleanup();
+#endif
+    return false;
+  }
+  app.metrics.stopping = false;
+  app.metrics.server = std::thread(serveMetrics, &app, listener, socketPath);
+  logInfo("Serving metrics on {}", socketPath.empty() ? "http://127.0.0.1:" + endpoint + "/metrics" : socketPath);
+  return true;
+}
+
+void stopMetricsServer(Application &app) {
+  if (!app.metrics.server.joinable()) {
+    return;
+  }
+  app.metrics.stopping = true;
+  app.metrics.server.join();
+#ifdef _WIN32
+  WSACleanup();
+#endif
+}
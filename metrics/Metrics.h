@@ -0,0 +1,51 @@
+#ifndef VULKANDEMO_METRICS_H
+#define VULKANDEMO_METRICS_H
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <thread>
+#include "../dispatch/Dispatch.h"
+#include "../memory/MemoryBudget.h"
+#include "../tracing/Trace.h"
+
+struct Application;
+
+const uint32_t METRICS_BUCKET_COUNT = 12; // the bounds of METRICS_BUCKET_SECONDS and +Inf
+
+/**
+ * A Prometheus histogram with one writer. The scrape reads the atomics one after the other, so
+ * the sum may be a frame ahead of the buckets, which Prometheus tolerates.
+ */
+typedef struct MetricsHistogram {
+    std::atomic<uint64_t> buckets[METRICS_BUCKET_COUNT]{}; // not cumulative, the scrape sums them up into the count
+    std::atomic<uint64_t> sumNanos{0};
+} MetricsHistogram;
+
+/**
+ * Counters and gauges of the running application, written where things happen and served by a
+ * background thread in the Prometheus text format. Every value is an atomic updated with relaxed
+ * stores, so writing them costs next to nothing and a scrape never takes a lock drawFrame needs.
+ */
+typedef struct Metrics {
+    MetricsHistogram frameTime; // CPU time of drawFrame, including the waits for the fence and the present
+    MetricsHistogram gpuFrameTime; // of the frame command buffer, measured with dynamic resolution only
+    std::atomic<uint64_t> stageNanos[FRAME_STAGE_COUNT]{};
+    std::atomic<uint64_t> swapchainRecreations{0};
+    std::atomic<uint32_t> heapCount{0};
+    std::atomic<uint64_t> heapUsed[VK_MAX_MEMORY_HEAPS]{}; // allocated through allocateMemory
+    std::atomic<uint64_t> heapProcessUsage[VK_MAX_MEMORY_HEAPS]{}; // reported by the driver
+    std::atomic<uint64_t> heapBudget[VK_MAX_MEMORY_HEAPS]{};
+    std::atomic<uint64_t> categoryUsed[VK_MAX_MEMORY_HEAPS][MEMORY_CATEGORY_COUNT]{};
+    uint64_t gpuSamples = 0; // frames of dynamic resolution already recorded, render thread
+
+    std::thread server;
+    std::atomic<bool> stopping{false};
+    std::atomic<uint64_t> scrapes{0};
+} Metrics;
+
+void recordFrameMetrics(Application &app);
+void publishHeapMetrics(Application &app, uint32_t heapIndex);
+bool startMetricsServer(Application &app, const std::string &endpoint);
+void stopMetricsServer(Application &app);
+#endif //VULKANDEMO_METRICS_H
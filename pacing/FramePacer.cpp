@@ -0,0 +1,170 @@
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <sys/resource.h>
+#endif
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+#include <thread>
+#include "FramePacer.h"
+#include "../Application.h"
+#include "../tracing/Trace.h"
+
+const std::chrono::duration<double> MIN_SPIN_MARGIN(0.0002);
+
+/**
+ * @return user and kernel time of every thread of the process so far
+ */
+static double processCpuSeconds() {
+#ifdef _WIN32
+  FILETIME creation, exit, kernel, user;
+  if (!GetProcessTimes(GetCurrentProcess(), &creation, &exit, &kernel, &user)) {
+    return 0.0;
+  }
+  auto seconds = [](const FILETIME &time) {
+    return static_cast<double>(static_cast<uint64_t>(time.dwHighDateTime) << 32 | time.dwLowDateTime) * 1.0e-7; // 100 ns ticks
+  };
+  return seconds(kernel) + seconds(user);
+#else
+  rusage usage{};
+  if (getrusage(RUSAGE_SELF, &usage) != 0) {
+    return 0.0;
+  }
+  return static_cast<double>(usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) +
+         static_cast<double>(usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) * 1.0e-6;
+#endif
+}
+
+/**
+ * @return whether the scene changes every frame without anyone asking for it
+ */
+static bool sceneAnimates(const Application &app) {
+  return app.options.demoSprites > 0 || app.lighting.enabled || app.particles.enabled ||
+         app.capture.enabled; // captures are only read back by the frames after them
+}
+
+/**
+ * Waits for the deadline of the cap, sleeping while the sleep is sure to wake up in time and
+ * spinning the rest. The deadline then moves on by one interval, so a frame that started a
+ * little late doesn't delay the ones after it, unless the frame is more than an interval behind,
+ * e.g. after idling.
+ *
+ * @param pacer
+ */
+static void limitFrameRate(FramePacer &pacer) {
+  if (pacer.frameInterval.count() <= 0.0) {
+    return;
+  }
+  typedef std::chrono::steady_clock Clock;
+  const auto interval = std::chrono::duration_cast<Clock::duration>(pacer.frameInterval);
+  auto now = Clock::now();
+  if (now < pacer.nextFrame) {
+    TRACE_ZONE("frame rate cap");
+    pacer.cappedFrames++;
+    const auto sleepUntil = pacer.nextFrame - std::chrono::duration_cast<Clock::duration>(pacer.spinMargin);
+    if (now < sleepUntil) {
+      std::this_thread::sleep_until(sleepUntil);
+      const auto woke = Clock::now();
+      const std::chrono::duration<double> overshoot = woke - sleepUntil;
+      // a sleep that wakes up later than the margin allows grows it right away, it shrinks slowly
+      pacer.spinMargin = std::min(std::max({overshoot * 1.5, pacer.spinMargin * 0.99, MIN_SPIN_MARGIN}), pacer.frameInterval);
+      pacer.sleepSeconds += std::chrono::duration<double>(woke - now).count();
+      now = woke;
+    }
+    const auto spinStart = now;
+    while (now < pacer.nextFrame) {
+      std::this_thread::yield();
+      now = Clock::now();
+    }
+    pacer.spinSeconds += std::chrono::duration<double>(now - spinStart).count();
+    const double late = std::chrono::duration<double>(now - pacer.nextFrame).count();
+    pacer.lateSeconds += late;
+    pacer.maxLateSeconds = std::max(pacer.maxLateSeconds, late);
+  }
+  pacer.nextFrame = now - pacer.nextFrame < interval ? pacer.nextFrame + interval : now + interval;
+}
+
+/**
+ * Takes the mode and cap from the options and starts the statistics. Runs on the main thread,
+ * before the render thread starts.
+ *
+ * @param app
+ */
+void startFramePacer(Application &app) {
+  FramePacer &pacer = app.pacer;
+  pacer.onDemand = app.options.onDemand;
+  pacer.frameInterval = std::chrono::duration<double>(app.options.maxFps > 0.0f ? 1.0 / app.options.maxFps : 0.0);
+  GLFWmonitor *monitor = glfwGetPrimaryMonitor();
+  const GLFWvidmode *mode = monitor != nullptr ? glfwGetVideoMode(monitor) : nullptr;
+  if (mode != nullptr && mode->refreshRate > 0) {
+    pacer.refreshInterval = std::chrono::duration<double>(1.0 / mode->refreshRate);
+  }
+  pacer.startTime = std::chrono::steady_clock::now();
+  pacer.nextFrame = pacer.startTime;
+  pacer.startCpuSeconds = processCpuSeconds();
+}
+
+/**
+ * Asks the render thread for another frame. Safe to call from any thread.
+ *
+ * @param app
+ */
+void requestRedraw(Application &app) {
+  {
+    std::lock_guard<std::mutex> lock(app.pacer.mutex);
+    app.pacer.dirty = true;
+  }
+  app.pacer.redraw.notify_one();
+}
+
+/**
+ * Called by the render thread before every frame. Returns right away, after the cap, unless
+ * rendering on demand with nothing asking for a frame, then it sleeps until something does or
+ * the application stops running.
+ *
+ * @param app
+ */
+void waitForFrame(Application &app) {
+  FramePacer &pacer = app.pacer;
+  if (pacer.onDemand) {
+    std::unique_lock<std::mutex> lock(pacer.mutex);
+    if (!pacer.dirty && !sceneAnimates(app) && app.running.load()) {
+      TRACE_ZONE("idle");
+      const auto start = std::chrono::steady_clock::now();
+      pacer.redraw.wait(lock, [&app] { return app.pacer.dirty || !app.running.load(); });
+      pacer.idleSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+      pacer.wakeups++;
+    }
+    pacer.dirty = false; // a change while the frame is drawn asks for the next one
+  }
+  limitFrameRate(pacer);
+  pacer.frames++;
+}
+
+void printFramePacing(Application &app) {
+  const FramePacer &pacer = app.pacer;
+  const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - pacer.startTime).count();
+  if (seconds <= 0.0) {
+    return;
+  }
+  const double cpuSeconds = processCpuSeconds() - pacer.startCpuSeconds;
+  std::cout << std::fixed << std::setprecision(1) << "Frame pacing: " << (pacer.onDemand ? "on demand" : "continuous")
+            << ", " << pacer.frames << " frames in " << seconds << " s (" << static_cast<double>(pacer.frames) / seconds
+            << " fps), the process used " << 100.0 * cpuSeconds / seconds << "% of a core" << std::endl;
+  if (pacer.onDemand) {
+    std::cout << "  idle " << 100.0 * pacer.idleSeconds / seconds << "% of the time, "
+              << static_cast<uint64_t>(pacer.idleSeconds / pacer.refreshInterval.count()) << " refreshes of the monitor without a frame, "
+              << pacer.wakeups << " wakeups" << std::endl;
+  }
+  if (pacer.cappedFrames > 0) {
+    const double frames = static_cast<double>(pacer.cappedFrames);
+    std::cout << std::setprecision(2) << "  capped at " << 1.0 / pacer.frameInterval.count() << " fps: " << pacer.cappedFrames
+              << " frames waited, on average " << 1000.0 * pacer.sleepSeconds / frames << " ms asleep and "
+              << 1000.0 * pacer.spinSeconds / frames << " ms spinning, late by " << 1.0e6 * pacer.lateSeconds / frames
+              << " us (max " << 1.0e6 * pacer.maxLateSeconds << " us), spin margin " << 1000.0 * pacer.spinMargin.count()
+              << " ms" << std::endl;
+  }
+}
@@ -0,0 +1,48 @@
+#ifndef VULKANDEMO_FRAMEPACER_H
+#define VULKANDEMO_FRAMEPACER_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+
+struct Application;
+
+/**
+ * Decides when the render thread draws. On demand, it sleeps until something asks for a redraw:
+ * window input, a resize or exposure, a pipeline that finished compiling, or the end of the
+ * application. A scene that animates, e.g. with sprites, lights or particles, is drawn every
+ * frame regardless. With a frame rate cap, a frame starts no earlier than one interval after the
+ * previous one: the thread sleeps until shortly before and spins the rest, the margin following
+ * how late the sleeps of this system wake up.
+ */
+typedef struct FramePacer {
+    bool onDemand = false;
+    std::chrono::duration<double> frameInterval{0.0}; // of the cap, 0 for none
+    std::chrono::duration<double> refreshInterval{1.0 / 60.0}; // of the primary monitor, idle frames are counted in it
+    std::chrono::duration<double> spinMargin{0.002}; // before the deadline, adapts to how late sleeps wake up
+    std::chrono::steady_clock::time_point nextFrame; // earliest start of the next frame with a cap
+
+    std::mutex mutex;
+    std::condition_variable redraw;
+    bool dirty = true; // guarded by the mutex, the first frame is always drawn
+
+    // statistics, render thread
+    std::chrono::steady_clock::time_point startTime;
+    double startCpuSeconds = 0.0; // of the process
+    uint64_t frames = 0;
+    uint64_t wakeups = 0; // ends of idle waits
+    double idleSeconds = 0.0;
+    uint64_t cappedFrames = 0; // that had to wait for the cap
+    double sleepSeconds = 0.0;
+    double spinSeconds = 0.0;
+    double lateSeconds = 0.0; // past the deadline of capped frames
+    double maxLateSeconds = 0.0;
+} FramePacer;
+
+void startFramePacer(Application &app);
+void requestRedraw(Application &app);
+void waitForFrame(Application &app);
+void printFramePacing(Application &app);
+#endif //VULKANDEMO_FRAMEPACER_H
@@ -0,0 +1,294 @@
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include "ParticleSystem.h"
+#include "../Application.h"
+#include "../buffers/Vertex.h"
+#include "../pipeline/Compute.h"
+#include "../pipeline/GraphicsPipeline.h"
+
+const uint32_t PARTICLE_GROUP_SIZE = 64; // local_size_x of particle_simulate.comp and particle_emit.comp
+
+static_assert(MAX_FRAMES_IN_FLIGHT % 2 == 0, "Frame slots must alternate between the two particle buffers");
+
+typedef struct StepConstants {
+    glm::vec2 emitter;
+    float deltaTime;
+    uint32_t source; // the buffer simulated, the other one is written
+    uint32_t emitCount;
+    uint32_t capacity;
+    uint32_t seed;
+    uint32_t padding;
+} StepConstants;
+
+// two triangles around the particle's position, scaled to its size by the push constants
+const Vertex particleQuad[6] = {
+    {{-1.0f, -1.0f}, {1.0f, 1.0f, 1.0f}},
+    {{1.0f, -1.0f}, {1.0f, 1.0f, 1.0f}},
+    {{1.0f, 1.0f}, {1.0f, 1.0f, 1.0f}},
+    {{1.0f, 1.0f}, {1.0f, 1.0f, 1.0f}},
+    {{-1.0f, 1.0f}, {1.0f, 1.0f, 1.0f}},
+    {{-1.0f, -1.0f}, {1.0f, 1.0f, 1.0f}}
+};
+
+static VkResult createParticleBuffers(Application &app, ParticleSystem &system) {
+  VkResult errorCode;
+  for (uint32_t i = 0; i < 2; ++i) {
+    errorCode = createBuffer(app, sizeof(Particle) * static_cast<VkDeviceSize>(system.capacity),
+                             VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+                             VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, MEMORY_GEOMETRY, system.particleBuffers[i],
+                             system.particleMemory[i]);
+    returnOnError(errorCode)
+  }
+  errorCode = createBuffer(app, sizeof(ParticleCounters), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+                                                          VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT |
+                                                          VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                           VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, MEMORY_GEOMETRY, system.counterBuffer, system.counterMemory);
+  returnOnError(errorCode)
+
+  errorCode = createBuffer(app, sizeof(particleQuad), VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+                           VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                           MEMORY_GEOMETRY, system.quadBuffer, system.quadMemory);
+  returnOnError(errorCode)
+  void *data;
+  errorCode = vkMapMemory(app.device, system.quadMemory, 0, sizeof(particleQuad), 0, &data);
+  returnOnError(errorCode)
+  memcpy(data, particleQuad, sizeof(particleQuad));
+  vkUnmapMemory(app.device, system.quadMemory);
+  return VK_SUCCESS;
+}
+
+static VkResult createParticleDescriptors(Application &app, ParticleSystem &system) {
+  VkDescriptorSetLayoutBinding bindings[3];
+  for (uint32_t i = 0; i < 3; ++i) {
+    bindings[i] = {i, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_COMPUTE_BIT, nullptr};
+  }
+  VkDescriptorSetLayoutCreateInfo setLayoutInfo{};
+  setLayoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+  setLayoutInfo.bindingCount = 3;
+  setLayoutInfo.pBindings = bindings;
+  VkResult errorCode = vkCreateDescriptorSetLayout(app.device, &setLayoutInfo, nullptr, &system.setLayout);
+  returnOnError(errorCode)
+
+  VkDescriptorPoolSize poolSize{VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 6};
+  VkDescriptorPoolCreateInfo poolInfo{};
+  poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+  poolInfo.maxSets = 2;
+  poolInfo.poolSizeCount = 1;
+  poolInfo.pPoolSizes = &poolSize;
+  errorCode = vkCreateDescriptorPool(app.device, &poolInfo, nullptr, &system.descriptorPool);
+  returnOnError(errorCode)
+  const VkDescriptorSetLayout setLayouts[2] = {system.setLayout, system.setLayout};
+  VkDescriptorSetAllocateInfo allocInfo{};
+  allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+  allocInfo.descriptorPool = system.descriptorPool;
+  allocInfo.descriptorSetCount = 2;
+  allocInfo.pSetLayouts = setLayouts;
+  errorCode = vkAllocateDescriptorSets(app.device, &allocInfo, system.sets);
+  returnOnError(errorCode)
+
+  VkDescriptorBufferInfo bufferInfos[6];
+  VkWriteDescriptorSet writes[6]{};
+  for (uint32_t source = 0; source < 2; ++source) {
+    bufferInfos[source * 3] = {system.particleBuffers[source], 0, VK_WHOLE_SIZE};
+    bufferInfos[source * 3 + 1] = {system.particleBuffers[1 - source], 0, VK_WHOLE_SIZE};
+    bufferInfos[source * 3 + 2] = {system.counterBuffer, 0, VK_WHOLE_SIZE};
+    for (uint32_t binding = 0; binding < 3; ++binding) {
+      VkWriteDescriptorSet &write = writes[source * 3 + binding];
+      write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+      write.dstSet = system.sets[source];
+      write.dstBinding = binding;
+      write.descriptorCount = 1;
+      write.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+      write.pBufferInfo = &bufferInfos[source * 3 + binding];
+    }
+  }
+  vkUpdateDescriptorSets(app.device, 6, writes, 0, nullptr);
+
+  VkPushConstantRange pushConstantRange{VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(StepConstants)};
+  VkPipelineLayoutCreateInfo layoutInfo{};
+  layoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+  layoutInfo.setLayoutCount = 1;
+  layoutInfo.pSetLayouts = &system.setLayout;
+  layoutInfo.pushConstantRangeCount = 1;
+  layoutInfo.pPushConstantRanges = &pushConstantRange;
+  return vkCreatePipelineLayout(app.device, &layoutInfo, nullptr, &system.layout);
+}
+
+/**
+ * Creates the two particle buffers of the given capacity, the counters and the compute pipelines.
+ * The capacity is lowered to what a single indirect dispatch and a storage buffer can hold. The draw pipeline is
+ * left to the caller. On failure the system must still be destroyed.
+ *
+ * @param app
+ * @param capacity
+ * @param system
+ * @return
+ */
+VkResult createParticleSystem(Application &app, uint32_t capacity, ParticleSystem &system) {
+  TRACE_ZONE("createParticleSystem");
+  VkPhysicalDeviceProperties properties;
+  vkGetPhysicalDeviceProperties(app.physicalDevice.device, &properties);
+  system.capacity = std::min({capacity, properties.limits.maxComputeWorkGroupCount[0] * PARTICLE_GROUP_SIZE,
+                              static_cast<uint32_t>(properties.limits.maxStorageBufferRange / sizeof(Particle))});
+  VkResult errorCode = createParticleBuffers(app, system);
+  returnOnError(errorCode)
+  errorCode = createParticleDescriptors(app, system);
+  returnOnError(errorCode)
+  errorCode = createComputePipeline(app, "../shaders/particle_simulate.spv", system.layout, system.simulatePipeline);
+  returnOnError(errorCode)
+  errorCode = createComputePipeline(app, "../shaders/particle_emit.spv", system.layout, system.emitPipeline);
+  returnOnError(errorCode)
+  errorCode = createComputePipeline(app, "../shaders/particle_finalize.spv", system.layout, system.finalizePipeline);
+  if (errorCode != VK_SUCCESS) {
+    std::cerr << "Unable to create particle pipelines" << std::endl;
+    return errorCode;
+  }
+  system.countersReset = false;
+  system.enabled = true;
+  return VK_SUCCESS;
+}
+
+/**
+ * Records a step of the system as set up in its destination, deltaTime, emitCount and emitter:
+ * simulates the other buffer into the destination, dropping the particles that died, emits new
+ * particles after them and writes the indirect arguments. Must be recorded outside of a render
+ * pass, the destination can be drawn once it is done.
+ *
+ * @param app
+ * @param system
+ * @param commandBuffer
+ */
+void recordParticleStep(Application &app, ParticleSystem &system, VkCommandBuffer commandBuffer) {
+  const uint32_t source = 1 - system.destination;
+  // the previous steps and the draws that read their results are done with what this one rewrites
+  memoryBarrier(commandBuffer, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT |
+                               VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT,
+                VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT);
+  if (!system.countersReset) {
+    ParticleCounters counters{};
+    for (auto &draw : counters.draws) {
+      draw = {6, 0, 0, 0};
+    }
+    for (auto &simulation : counters.simulations) {
+      simulation = {0, 1, 1};
+    }
+    vkCmdUpdateBuffer(commandBuffer, system.counterBuffer, 0, sizeof(counters), &counters);
+    system.countersReset = true;
+  } else {
+    const uint32_t noParticles = 0;
+    vkCmdUpdateBuffer(commandBuffer, system.counterBuffer,
+                      offsetof(ParticleCounters, draws) + sizeof(VkDrawIndirectCommand) * system.destination +
+                      offsetof(VkDrawIndirectCommand, instanceCount), sizeof(noParticles), &noParticles);
+  }
+  memoryBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT,
+                VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+
+  StepConstants constants{system.emitter, system.deltaTime, source, system.emitCount, system.capacity, system.steps++, 0};
+  vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, system.layout, 0, 1, &system.sets[source], 0, nullptr);
+  vkCmdPushConstants(commandBuffer, system.layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(constants), &constants);
+  vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, system.simulatePipeline);
+  vkCmdDispatchIndirect(commandBuffer, system.counterBuffer,
+                        offsetof(ParticleCounters, simulations) + sizeof(VkDispatchIndirectCommand) * source);
+  // emission appends to the same count with atomics, it doesn't have to wait for the simulation
+  if (system.emitCount > 0) {
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, system.emitPipeline);
+    vkCmdDispatch(commandBuffer, divideRoundingUp(system.emitCount, PARTICLE_GROUP_SIZE), 1, 1);
+  }
+  memoryBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT,
+                VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+  vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, system.finalizePipeline);
+  vkCmdDispatch(commandBuffer, 1, 1, 1);
+  memoryBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT,
+                VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_SHADER_READ_BIT);
+}
+
+/**
+ * Draws the particles of the destination buffer of the last step, as many as the step left
+ * alive, with one indirect draw. Runs inside a render pass compatible with the main one.
+ *
+ * @param app
+ * @param system
+ * @param commandBuffer
+ */
+void recordParticleDraw(Application &app, ParticleSystem &system, VkCommandBuffer commandBuffer) {
+  VkViewport viewport{0.0f, 0.0f, (float) app.swapChainExtent.width, (float) app.swapChainExtent.height, 0.0f, 1.0f};
+  VkRect2D scissor{{0, 0}, app.swapChainExtent};
+  vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+  vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+  vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, system.pipeline);
+  MeshTransform transform{glm::vec2(0.0f), glm::vec2(PARTICLE_HALF_SIZE * 2.0f / app.swapChainExtent.width,
+                                                     PARTICLE_HALF_SIZE * 2.0f / app.swapChainExtent.height)};
+  vkCmdPushConstants(commandBuffer, app.pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, sizeof(FragmentFeatures),
+                     sizeof(MeshTransform), &transform);
+  const VkBuffer buffers[2] = {system.quadBuffer, system.particleBuffers[system.destination]};
+  const VkDeviceSize offsets[2] = {0, 0};
+  vkCmdBindVertexBuffers(commandBuffer, 0, 2, buffers, offsets);
+  vkCmdDrawIndirect(commandBuffer, system.counterBuffer, sizeof(VkDrawIndirectCommand) * system.destination, 1,
+                    sizeof(VkDrawIndirectCommand));
+}
+
+/**
+ * Sets up this frame's step of the demo fountain: it writes the buffer of the frame slot and emits
+ * enough particles to keep the system about full, while the emitter sways from side to side.
+ * Runs every frame before recording.
+ *
+ * @param app
+ * @param time in seconds
+ */
+void updateDemoParticles(Application &app, double time) {
+  ParticleSystem &system = app.particles;
+  system.pipeline = requestPipeline(app, particlePipelineKey(app));
+  system.destination = static_cast<uint32_t>(app.currentFrame % 2);
+  // a stall, e.g. while the window was moved, would otherwise emit a burst
+  const double deltaTime = system.lastTime < 0.0 ? 0.0 : std::min(time - system.lastTime, 0.1);
+  system.lastTime = time;
+  system.deltaTime = static_cast<float>(deltaTime);
+  const double emitted = deltaTime * system.capacity / PARTICLE_MEAN_LIFE + system.emitRemainder;
+  system.emitCount = static_cast<uint32_t>(emitted);
+  system.emitRemainder = emitted - system.emitCount;
+  system.emitter = glm::vec2(0.6f * static_cast<float>(std::sin(time * 0.7)), 0.9f);
+}
+
+/**
+ * Identifies the commands recordDemoParticles records. The buffer it draws is the frame slot's,
+ * the same every time the slot records, so it isn't part of it.
+ *
+ * @param app
+ * @return
+ */
+uint64_t particleSignature(const Application &app) {
+  uint64_t hash = 14695981039346656037ull; // FNV-1a
+  auto mix = [&hash](uint64_t value) {
+    hash ^= value;
+    hash *= 1099511628211ull;
+  };
+  mix((uint64_t) app.particles.pipeline);
+  mix(static_cast<uint64_t>(app.swapChainExtent.width) << 32 | app.swapChainExtent.height);
+  return hash;
+}
+
+void recordDemoParticles(Application &app, VkCommandBuffer commandBuffer) {
+  recordParticleDraw(app, app.particles, commandBuffer);
+}
+
+void destroyParticleSystem(Application &app, ParticleSystem &system) {
+  vkDestroyPipeline(app.device, system.finalizePipeline, nullptr);
+  vkDestroyPipeline(app.device, system.emitPipeline, nullptr);
+  vkDestroyPipeline(app.device, system.simulatePipeline, nullptr);
+  vkDestroyPipelineLayout(app.device, system.layout, nullptr);
+  vkDestroyDescriptorPool(app.device, system.descriptorPool, nullptr); // frees the sets too
+  vkDestroyDescriptorSetLayout(app.device, system.setLayout, nullptr);
+  vkDestroyBuffer(app.device, system.quadBuffer, nullptr);
+  freeMemory(app, system.quadMemory);
+  vkDestroyBuffer(app.device, system.counterBuffer, nullptr);
+  freeMemory(app, system.counterMemory);
+  for (uint32_t i = 0; i < 2; ++i) {
+    vkDestroyBuffer(app.device, system.particleBuffers[i], nullptr);
+    freeMemory(app, system.particleMemory[i]);
+  }
+  system = ParticleSystem{};
+}
@@ -0,0 +1,72 @@
+#ifndef VULKANDEMO_PARTICLESYSTEM_H
+#define VULKANDEMO_PARTICLESYSTEM_H
+
+#include "glm/glm.hpp"
+#include "../dispatch/Dispatch.h"
+
+struct Application;
+
+const float PARTICLE_MEAN_LIFE = 3.0f; // seconds, particle_emit.comp picks between 2 and 4
+const float PARTICLE_HALF_SIZE = 1.5f; // in pixels
+
+/**
+ * The counters the compute passes keep on the GPU, one entry per particle buffer. The CPU only
+ * writes them once, to start with no particles.
+ */
+typedef struct ParticleCounters {
+    VkDrawIndirectCommand draws[2]; // a quad per particle, instanceCount is the particles alive in the buffer
+    VkDispatchIndirectCommand simulations[2]; // workgroups that simulate the buffer
+    uint32_t padding[2];
+} ParticleCounters;
+
+static_assert(sizeof(ParticleCounters) == 64, "ParticleCounters must match the std430 layout of the particle shaders");
+
+/**
+ * Particles that live entirely on the GPU. A step simulates the particles of one buffer and
+ * appends the survivors to the other one, which compacts away the dead, then emits new particles
+ * behind them and turns the count into the indirect arguments of the next step and of the draw.
+ * The CPU never learns how many particles there are, it only decides which buffer a step writes.
+ *
+ * In the demo a step runs every frame and writes the buffer of the frame slot, so the cached
+ * draw of a slot always reads the same buffer.
+ */
+typedef struct ParticleSystem {
+    bool enabled = false;
+    uint32_t capacity = 0; // particles per buffer
+    VkBuffer particleBuffers[2] = {VK_NULL_HANDLE, VK_NULL_HANDLE}; // Particle, storage and instance vertex buffers
+    VkDeviceMemory particleMemory[2] = {VK_NULL_HANDLE, VK_NULL_HANDLE};
+    VkBuffer counterBuffer = VK_NULL_HANDLE; // ParticleCounters
+    VkDeviceMemory counterMemory = VK_NULL_HANDLE;
+    VkBuffer quadBuffer = VK_NULL_HANDLE; // the two triangles every particle is drawn with
+    VkDeviceMemory quadMemory = VK_NULL_HANDLE;
+    bool countersReset = false;
+
+    VkDescriptorSetLayout setLayout = VK_NULL_HANDLE;
+    VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
+    VkDescriptorSet sets[2] = {VK_NULL_HANDLE, VK_NULL_HANDLE}; // set i simulates buffer i into the other one
+    VkPipelineLayout layout = VK_NULL_HANDLE;
+    VkPipeline simulatePipeline = VK_NULL_HANDLE;
+    VkPipeline emitPipeline = VK_NULL_HANDLE;
+    VkPipeline finalizePipeline = VK_NULL_HANDLE;
+    VkPipeline pipeline = VK_NULL_HANDLE; // draws the particles, owned by the pipeline library
+
+    // the next step
+    uint32_t destination = 0; // the buffer it writes, and the one drawn afterwards
+    float deltaTime = 0.0f;
+    uint32_t emitCount = 0;
+    glm::vec2 emitter{0.0f, 0.9f}; // in normalized device coordinates
+    uint32_t steps = 0; // seeds the emission
+
+    // demo
+    double lastTime = -1.0;
+    double emitRemainder = 0.0;
+} ParticleSystem;
+
+VkResult createParticleSystem(Application &app, uint32_t capacity, ParticleSystem &system);
+void recordParticleStep(Application &app, ParticleSystem &system, VkCommandBuffer commandBuffer);
+void recordParticleDraw(Application &app, ParticleSystem &system, VkCommandBuffer commandBuffer);
+void updateDemoParticles(Application &app, double time);
+uint64_t particleSignature(const Application &app);
+void recordDemoParticles(Application &app, VkCommandBuffer commandBuffer);
+void destroyParticleSystem(Application &app, ParticleSystem &system);
+#endif //VULKANDEMO_PARTICLESYSTEM_H
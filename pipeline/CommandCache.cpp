@@ -0,0 +1,158 @@
+#include <chrono>
+#include <iostream>
+#include <iomanip>
+#include "CommandCache.h"
+#include "../Application.h"
+
+static const char *segmentNames[SEGMENT_COUNT] = {"scene", "sprites", "particles"};
+
+/**
+ * Creates a command pool with a single secondary command buffer for each segment and frame in
+ * flight. Each segment gets its own pool so re-recording one doesn't reset the others.
+ *
+ * @param app
+ * @return
+ */
+VkResult createCommandCache(Application &app) {
+  TRACE_ZONE("createCommandCache");
+  CommandCache &cache = app.commandCache;
+  cache.frames.resize(MAX_FRAMES_IN_FLIGHT);
+  for (auto &version : cache.versions) {
+    version = 1;
+  }
+  VkResult errorCode = VK_SUCCESS;
+  for (auto &frame : cache.frames) {
+    for (auto &segment : frame) {
+      VkCommandPoolCreateInfo poolInfo{};
+      poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+      poolInfo.queueFamilyIndex = app.physicalDevice.graphicsQueueFamilyIdx;
+      poolInfo.flags = 0; // the command buffer is kept across frames, so the pool isn't transient
+      errorCode = vkCreateCommandPool(app.device, &poolInfo, nullptr, &segment.commandPool);
+      throwOnError(errorCode, "Unable to create command cache pool")
+
+      VkCommandBufferAllocateInfo allocInfo{};
+      allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+      allocInfo.commandPool = segment.commandPool;
+      allocInfo.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+      allocInfo.commandBufferCount = 1;
+      errorCode = vkAllocateCommandBuffers(app.device, &allocInfo, &segment.commandBuffer);
+      throwOnError(errorCode, "Unable to allocate command cache command buffer")
+    }
+  }
+  error:
+  return errorCode;
+}
+
+/**
+ * Makes every frame slot re-record the segment the next time it is acquired.
+ *
+ * @param app
+ * @param segment
+ */
+void markSegmentDirty(Application &app, CommandSegment segment) {
+  app.commandCache.versions[segment]++;
+}
+
+/**
+ * Marks the segment dirty if the signature of what it draws differs from the last one.
+ *
+ * @param app
+ * @param segment
+ * @param signature
+ */
+void updateSegmentSignature(Application &app, CommandSegment segment, uint64_t signature) {
+  CommandCache &cache = app.commandCache;
+  if (cache.signatures[segment] != signature) {
+    cache.signatures[segment] = signature;
+    cache.versions[segment]++;
+  }
+}
+
+/**
+ * Marks all segments dirty. Needed whenever objects the cached command buffers reference are
+ * recreated, e.g. the render passes and pipelines on swapchain recreation, since a new object
+ * may get the handle of the destroyed one and the signatures wouldn't notice.
+ *
+ * @param app
+ */
+void invalidateCommandCache(Application &app) {
+  for (uint32_t segment = 0; segment < SEGMENT_COUNT; ++segment) {
+    markSegmentDirty(app, static_cast<CommandSegment>(segment));
+  }
+}
+
+/**
+ * Returns the secondary command buffer of the segment for the current frame slot, re-recording
+ * it first if the segment changed. Must only be called after waiting for the frame's fence,
+ * which guarantees the GPU is done with the previous recording.
+ *
+ * @param app
+ * @param segment
+ * @param renderPass the render pass the command buffer will be executed in
+ * @param record records the segment's commands, minus beginning and ending the render pass
+ * @param commandBuffer
+ * @return
+ */
+VkResult acquireSegment(Application &app, CommandSegment segment, VkRenderPass renderPass, RecordSegmentFunction record,
+                        VkCommandBuffer &commandBuffer) {
+  CommandCache &cache = app.commandCache;
+  CachedSegment &cached = cache.frames[app.currentFrame][segment];
+  commandBuffer = cached.commandBuffer;
+  if (cached.recordedVersion == cache.versions[segment]) {
+    cache.stats[segment].reused++;
+    return VK_SUCCESS;
+  }
+
+  auto start = std::chrono::steady_clock::now();
+  VkResult errorCode = vkResetCommandPool(app.device, cached.commandPool, 0);
+  returnOnError(errorCode)
+  VkCommandBufferInheritanceInfo inheritanceInfo{};
+  inheritanceInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+  inheritanceInfo.renderPass = renderPass;
+  inheritanceInfo.subpass = 0;
+  inheritanceInfo.framebuffer = VK_NULL_HANDLE; // executed with the framebuffer of whatever image was acquired
+  VkCommandBufferBeginInfo beginInfo{};
+  beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+  beginInfo.flags = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+  beginInfo.pInheritanceInfo = &inheritanceInfo;
+  errorCode = vkBeginCommandBuffer(commandBuffer, &beginInfo);
+  returnOnError(errorCode)
+  record(app, commandBuffer);
+  errorCode = vkEndCommandBuffer(commandBuffer);
+  returnOnError(errorCode)
+  cached.recordedVersion = cache.versions[segment];
+
+  std::chrono::duration<double, std::micro> elapsed = std::chrono::steady_clock::now() - start;
+  cache.stats[segment].recorded++;
+  cache.stats[segment].recordMicros += static_cast<uint64_t>(elapsed.count());
+  return VK_SUCCESS;
+}
+
+/**
+ * Prints how often each segment was reused and the recording time that saved, estimated from
+ * the average time it took to record the segment.
+ *
+ * @param app
+ */
+void printCommandCacheStats(Application &app) {
+  CommandCache &cache = app.commandCache;
+  std::cout << "Command cache:" << std::endl << std::fixed << std::setprecision(2);
+  for (uint32_t segment = 0; segment < SEGMENT_COUNT; ++segment) {
+    const SegmentStats &stats = cache.stats[segment];
+    const uint64_t acquired = stats.reused + stats.recorded;
+    const double averageMicros = stats.recorded ? static_cast<double>(stats.recordMicros) / stats.recorded : 0.0;
+    std::cout << "  " << segmentNames[segment] << ": reused " << stats.reused << " of " << acquired << " ("
+              << (acquired ? 100.0 * stats.reused / acquired : 0.0) << "%), recorded in "
+              << stats.recordMicros / 1000.0 << " ms, saved ~" << stats.reused * averageMicros / 1000.0 << " ms"
+              << std::endl;
+  }
+}
+
+void destroyCommandCache(Application &app) {
+  for (auto &frame : app.commandCache.frames) {
+    for (auto &segment : frame) {
+      vkDestroyCommandPool(app.device, segment.commandPool, nullptr); // frees its command buffer too
+    }
+  }
+  app.commandCache.frames.clear();
+}
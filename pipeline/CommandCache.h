@@ -0,0 +1,55 @@
+#ifndef VULKANDEMO_COMMANDCACHE_H
+#define VULKANDEMO_COMMANDCACHE_H
+
+#include <array>
+#include <vector>
+#include "../dispatch/Dispatch.h"
+
+struct Application;
+
+/**
+ * The parts of a frame that are recorded separately, each executed inside one render pass.
+ */
+enum CommandSegment : uint32_t {
+    SEGMENT_SCENE = 0, // main render pass
+    SEGMENT_SPRITES = 1, // overlay render pass
+    SEGMENT_PARTICLES = 2, // overlay render pass, before the sprites
+    SEGMENT_COUNT
+};
+
+typedef void (*RecordSegmentFunction)(Application &app, VkCommandBuffer commandBuffer);
+
+typedef struct CachedSegment {
+    VkCommandPool commandPool = VK_NULL_HANDLE; // reset as a whole whenever the segment is re-recorded
+    VkCommandBuffer commandBuffer = VK_NULL_HANDLE; // secondary, executed inside the segment's render pass
+    uint64_t recordedVersion = 0; // version of the segment the command buffer holds, 0 if none
+} CachedSegment;
+
+typedef struct SegmentStats {
+    uint64_t reused = 0;
+    uint64_t recorded = 0;
+    uint64_t recordMicros = 0;
+} SegmentStats;
+
+/**
+ * Secondary command buffers for each segment and frame in flight, re-recorded only when the
+ * segment changed since the frame slot last recorded it. A segment changes when its version is
+ * bumped, either explicitly or because the signature of what it draws is different.
+ * The secondaries don't inherit a framebuffer, so they are valid for every swapchain image.
+ */
+typedef struct CommandCache {
+    std::vector<std::array<CachedSegment, SEGMENT_COUNT>> frames; // one set per frame in flight
+    uint64_t versions[SEGMENT_COUNT] = {};
+    uint64_t signatures[SEGMENT_COUNT] = {};
+    SegmentStats stats[SEGMENT_COUNT];
+} CommandCache;
+
+VkResult createCommandCache(Application &app);
+void markSegmentDirty(Application &app, CommandSegment segment);
+void updateSegmentSignature(Application &app, CommandSegment segment, uint64_t signature);
+void invalidateCommandCache(Application &app);
+VkResult acquireSegment(Application &app, CommandSegment segment, VkRenderPass renderPass, RecordSegmentFunction record,
+                        VkCommandBuffer &commandBuffer);
+void printCommandCacheStats(Application &app);
+void destroyCommandCache(Application &app);
+#endif //VULKANDEMO_COMMANDCACHE_H
@@ -7,6 +7,7 @@
 #include "../buffers/Vertex.h"
 
 VkResult createCommandPool(Application &app) {
+  TRACE_ZONE("createCommandPool");
   VkCommandPoolCreateInfo poolInfo{};
   poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
   poolInfo.queueFamilyIndex = app.physicalDevice.graphicsQueueFamilyIdx;
@@ -20,61 +21,202 @@ VkResult createCommandPool(Application &app) {
 }
 
 /**
- * Creates a commend buffer for each defined swapchain framebuffer, attaches
- * the proper renderpass and framebuffer attachments, binds the graphics pipeline
- * and finally initiates the draw command.
+ * Records the scene into a render pass over a framebuffer of the given size.
+ *
+ * @param app
+ * @param commandBuffer
+ * @param extent
+ */
+void recordSceneCommands(Application &app, VkCommandBuffer commandBuffer, VkExtent2D extent) {
+  if (app.lighting.enabled) {
+    bindLightSet(app, commandBuffer);
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, app.lighting.pipeline);
+  } else {
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, app.graphicsPipeline);
+  }
+
+  // viewport and scissor are dynamic pipeline state
+  VkViewport viewport{0.0f, 0.0f, (float) extent.width, (float) extent.height, 0.0f, 1.0f};
+  VkRect2D scissor{{0, 0}, extent};
+  vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+  vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+
+  VkBuffer vertexBuffers[] = {app.vertexBuffer};
+  VkDeviceSize offsets[] = {0};
+  vkCmdBindVertexBuffers(commandBuffer, 0, 1, vertexBuffers, offsets);
+
+  vkCmdDraw(commandBuffer, app.vertexCount, 1, 0, 0);
+
+  if (app.lodScene.enabled) {
+    recordLodScene(app, commandBuffer); // viewport and scissor carry over
+  }
+}
+
+/**
+ * Records the scene: binds the graphics pipeline and the vertex buffer and draws the vertices.
+ * Runs inside the main render pass as a segment of the command cache, so it is only re-recorded
+ * when the scene changes instead of every frame.
+ *
+ * @param app
+ * @param commandBuffer
+ */
+void recordSceneCommands(Application &app, VkCommandBuffer commandBuffer) {
+  recordSceneCommands(app, commandBuffer, app.sceneExtent);
+}
+
+/**
+ * Creates a transient command pool with a single primary command buffer for each frame in flight.
+ * They are recorded from scratch every frame, which is cheap since they mostly execute the
+ * secondary command buffers of the command cache.
  *
  * @param app
  * @return
  */
-VkResult createCommandBuffers(Application &app) {
-  app.commandBuffers.resize(app.swapChainFramebuffers.size());
+VkResult createFrameCommandBuffers(Application &app) {
+  TRACE_ZONE("createFrameCommandBuffers");
+  app.frameCommandPools.resize(MAX_FRAMES_IN_FLIGHT, VK_NULL_HANDLE);
+  app.frameCommandBuffers.resize(MAX_FRAMES_IN_FLIGHT, VK_NULL_HANDLE);
+  VkResult errorCode = VK_SUCCESS;
+  for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i) {
+    VkCommandPoolCreateInfo poolInfo{};
+    poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    poolInfo.queueFamilyIndex = app.physicalDevice.graphicsQueueFamilyIdx;
+    poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT; // reset as a whole, never per command buffer
+    errorCode = vkCreateCommandPool(app.device, &poolInfo, nullptr, &app.frameCommandPools[i]);
+    throwOnError(errorCode, "Unable to create frame command pool")
 
-  VkCommandBufferAllocateInfo allocInfo{};
-  allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-  allocInfo.commandPool = app.commandPool;
-  allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-  allocInfo.commandBufferCount = (uint32_t) app.commandBuffers.size();
+    VkCommandBufferAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    allocInfo.commandPool = app.frameCommandPools[i];
+    allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    allocInfo.commandBufferCount = 1;
+    errorCode = vkAllocateCommandBuffers(app.device, &allocInfo, &app.frameCommandBuffers[i]);
+    throwOnError(errorCode, "Unable to allocate frame command buffer")
+  }
+  error:
+  return errorCode;
+}
 
-  VkResult errorCode = vkAllocateCommandBuffers(app.device, &allocInfo, app.commandBuffers.data());
-  throwOnError(errorCode, "Unable to allocate command buffers")
+/**
+ * Records the command buffer of the current frame: the render passes of the acquired image with
+ * their cached segments, then the per frame work that reads the rendered image.
+ * Must only be called after waiting for the frame's fence.
+ *
+ * @param app
+ * @param imageIndex
+ * @return
+ */
+VkResult recordFrameCommandBuffer(Application &app, uint32_t imageIndex) {
+  TRACE_ZONE("recordFrameCommandBuffer");
+  VkCommandBuffer commandBuffer = app.frameCommandBuffers[app.currentFrame];
+  VkResult errorCode = vkResetCommandPool(app.device, app.frameCommandPools[app.currentFrame], 0);
+  throwOnError(errorCode, "Unable to reset frame command pool")
 
-  for (size_t i = 0; i < app.commandBuffers.size(); ++i) {
+  {
     VkCommandBufferBeginInfo beginInfo{};
     beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-    beginInfo.flags = 0; // optional
-    beginInfo.pInheritanceInfo = nullptr; // optional
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    errorCode = vkBeginCommandBuffer(commandBuffer, &beginInfo);
+    throwOnError(errorCode, "Failed to begin recording frame command buffer")
+  }
+  beginGpuFrame(app, commandBuffer);
+  beginDynamicResolutionFrame(app, commandBuffer);
+
+  if (app.lighting.enabled) {
+    TRACE_GPU_ZONE(app, commandBuffer, "light binning");
+    recordLightBinning(app, commandBuffer); // the scene of every window shades with the lists
+  }
 
-    errorCode = vkBeginCommandBuffer(app.commandBuffers[i], &beginInfo);
-    if(errorCode != VK_SUCCESS) {
-      break;
+  if (app.particles.enabled) {
+    TRACE_GPU_ZONE(app, commandBuffer, "particle simulation");
+    recordParticleStep(app, app.particles, commandBuffer); // long done by the time the overlay pass draws them
+  }
+
+  {
+    TRACE_GPU_ZONE(app, commandBuffer, "scene pass");
+    // the viewport is part of the recording, so is the scene resolution
+    uint64_t signature = static_cast<uint64_t>(app.sceneExtent.width) << 32 | app.sceneExtent.height;
+    if (app.lodScene.enabled) {
+      // a different LOD for any instance means different draws, the selection mixes in the resolution
+      signature = selectSceneLods(app);
+    }
+    if (app.lighting.enabled) {
+      // the lit pipeline replaces the placeholder once it compiled
+      signature = (signature ^ (uint64_t) app.lighting.pipeline) * 1099511628211ull;
     }
+    updateSegmentSignature(app, SEGMENT_SCENE, signature);
+    VkCommandBuffer scene;
+    errorCode = acquireSegment(app, SEGMENT_SCENE, app.renderPass, recordSceneCommands, scene);
+    throwOnError(errorCode, "Failed to record the scene")
+    // with dynamic resolution the scene goes into a corner of the offscreen image, which is upscaled below
+    const bool offscreen = app.resolution.enabled;
     VkRenderPassBeginInfo renderPassInfo{};
     renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-    renderPassInfo.renderPass = app.renderPass;
-    renderPassInfo.framebuffer = app.swapChainFramebuffers[i];
+    renderPassInfo.renderPass = offscreen ? app.resolution.renderPass : app.renderPass;
+    renderPassInfo.framebuffer = offscreen ? app.resolution.framebuffer : app.swapChainFramebuffers[imageIndex];
     renderPassInfo.renderArea.offset = {0, 0};
-    renderPassInfo.renderArea.extent = app.swapChainExtent;
-
+    renderPassInfo.renderArea.extent = app.sceneExtent;
     VkClearValue clearColor = {0.0f, 0.0f, 0.0f, 1.0f};
     renderPassInfo.clearValueCount = 1;
     renderPassInfo.pClearValues = &clearColor;
-    vkCmdBeginRenderPass(app.commandBuffers[i], &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
-
-    vkCmdBindPipeline(app.commandBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, app.graphicsPipeline);
+    vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+    vkCmdExecuteCommands(commandBuffer, 1, &scene);
+    vkCmdEndRenderPass(commandBuffer);
+  }
 
-    VkBuffer vertexBuffers[] = {app.vertexBuffer};
-    VkDeviceSize offsets[] = {0};
-    vkCmdBindVertexBuffers(app.commandBuffers[i], 0, 1, vertexBuffers, offsets);
+  if (app.resolution.enabled) {
+    TRACE_GPU_ZONE(app, commandBuffer, "upscale");
+    recordUpscale(app, commandBuffer, imageIndex);
+  }
 
-    vkCmdDraw(app.commandBuffers[i], static_cast<uint32_t>(vertices.size()), 1, 0, 0);
+  // particles and sprites are drawn at the window resolution on top of the upscaled scene
+  if (app.sprites.spriteCount > 0 || app.particles.enabled) {
+    TRACE_GPU_ZONE(app, commandBuffer, "overlay pass");
+    VkCommandBuffer overlays[2];
+    uint32_t overlayCount = 0;
+    if (app.particles.enabled) {
+      // the slot always draws the same particle buffer, with the count the simulation left in it
+      updateSegmentSignature(app, SEGMENT_PARTICLES, particleSignature(app));
+      errorCode = acquireSegment(app, SEGMENT_PARTICLES, app.overlayRenderPass, recordDemoParticles, overlays[overlayCount++]);
+      throwOnError(errorCode, "Failed to record particles")
+    }
+    if (app.sprites.spriteCount > 0) {
+      // the vertices live in the frame's partition of the ring, only the draws have to match
+      updateSegmentSignature(app, SEGMENT_SPRITES, spriteSignature(app));
+      errorCode = acquireSegment(app, SEGMENT_SPRITES, app.overlayRenderPass, recordSprites, overlays[overlayCount++]);
+      throwOnError(errorCode, "Failed to record sprites")
+    }
+    VkRenderPassBeginInfo renderPassInfo{};
+    renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+    renderPassInfo.renderPass = app.overlayRenderPass;
+    renderPassInfo.framebuffer = app.swapChainFramebuffers[imageIndex]; // compatible with the main render pass
+    renderPassInfo.renderArea = {{0, 0}, app.swapChainExtent};
+    vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+    vkCmdExecuteCommands(commandBuffer, overlayCount, overlays);
+    vkCmdEndRenderPass(commandBuffer);
+  }
 
-    vkCmdEndRenderPass(app.commandBuffers[i]);
+  if (app.windowViewCount > 0) {
+    TRACE_GPU_ZONE(app, commandBuffer, "window views");
+    recordWindowViews(app, commandBuffer);
+  }
 
-    errorCode = vkEndCommandBuffer(app.commandBuffers[i]);
-    throwOnError(errorCode, "Failed to end recording command buffer")
+  {
+    TRACE_GPU_ZONE(app, commandBuffer, "frame capture");
+    recordFrameCapture(app, commandBuffer, imageIndex); // after everything that draws into the image
   }
-  throwOnError(errorCode, "Failed to begin recording command buffer")
+  endDynamicResolutionFrame(app, commandBuffer);
+
+  errorCode = vkEndCommandBuffer(commandBuffer);
+  throwOnError(errorCode, "Failed to end recording frame command buffer")
   error:
   return errorCode;
 }
+
+void destroyFrameCommandBuffers(Application &app) {
+  for (auto commandPool : app.frameCommandPools) {
+    vkDestroyCommandPool(app.device, commandPool, nullptr); // frees its command buffer too
+  }
+  app.frameCommandPools.clear();
+  app.frameCommandBuffers.clear();
+}
@@ -9,5 +9,9 @@
 #include "../Application.h"
 
 VkResult createCommandPool(Application&);
-VkResult createCommandBuffers(Application&);
+void recordSceneCommands(Application&, VkCommandBuffer commandBuffer, VkExtent2D extent);
+void recordSceneCommands(Application&, VkCommandBuffer commandBuffer);
+VkResult createFrameCommandBuffers(Application&);
+VkResult recordFrameCommandBuffer(Application&, uint32_t imageIndex);
+void destroyFrameCommandBuffers(Application&);
 #endif //VULKANDEMO_COMMANDS_H
@@ -0,0 +1,53 @@
+#include <vector>
+#include "Compute.h"
+#include "GraphicsPipeline.h"
+#include "Shaders.h"
+
+/**
+ * A global memory barrier, all the compute passes need since they work on whole buffers.
+ *
+ * @param commandBuffer
+ * @param srcStages
+ * @param srcAccess
+ * @param dstStages
+ * @param dstAccess
+ */
+void memoryBarrier(VkCommandBuffer commandBuffer, VkPipelineStageFlags srcStages, VkAccessFlags srcAccess,
+                   VkPipelineStageFlags dstStages, VkAccessFlags dstAccess) {
+  VkMemoryBarrier barrier{};
+  barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+  barrier.srcAccessMask = srcAccess;
+  barrier.dstAccessMask = dstAccess;
+  vkCmdPipelineBarrier(commandBuffer, srcStages, dstStages, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+}
+
+/**
+ * Creates a compute pipeline from the SPIR-V file through the pipeline library's cache.
+ *
+ * @param app
+ * @param shaderFile
+ * @param layout
+ * @param pipeline
+ * @return
+ */
+VkResult createComputePipeline(Application &app, const std::string &shaderFile, VkPipelineLayout layout,
+                               VkPipeline &pipeline) {
+  std::vector<char> shaderCode;
+  if (!readShaderFile(shaderFile, shaderCode)) {
+    logError("Unable to read {}", shaderFile);
+    return VK_ERROR_INITIALIZATION_FAILED;
+  }
+  VkResult errorCode;
+  VkShaderModule shaderModule = createShaderModule(app.device, shaderCode, errorCode);
+  returnOnError(errorCode)
+  VkComputePipelineCreateInfo pipelineInfo{};
+  pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+  pipelineInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+  pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+  pipelineInfo.stage.module = shaderModule;
+  pipelineInfo.stage.pName = "main";
+  pipelineInfo.layout = layout;
+  errorCode = vkCreateComputePipelines(app.device, app.pipelineLibrary.cache, 1, &pipelineInfo, nullptr, &pipeline);
+  vkDestroyShaderModule(app.device, shaderModule, nullptr);
+  return errorCode;
+}
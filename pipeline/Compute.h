@@ -0,0 +1,26 @@
+#ifndef VULKANDEMO_COMPUTE_H
+#define VULKANDEMO_COMPUTE_H
+
+#include <string>
+#include "../Application.h"
+
+/**
+ * Work groups needed to cover value invocations, i.e. the dispatch size of a 1D grid.
+ */
+inline uint32_t divideRoundingUp(uint32_t value, uint32_t divisor) {
+  return (value + divisor - 1) / divisor;
+}
+
+/**
+ * Linear congruential generator for reproducible scenes, uniform in [0, 1).
+ */
+inline float randomUnit(uint32_t &state) {
+  state = state * 1664525u + 1013904223u;
+  return static_cast<float>(state >> 8) / 16777216.0f;
+}
+
+void memoryBarrier(VkCommandBuffer commandBuffer, VkPipelineStageFlags srcStages, VkAccessFlags srcAccess,
+                   VkPipelineStageFlags dstStages, VkAccessFlags dstAccess);
+VkResult createComputePipeline(Application &app, const std::string &shaderFile, VkPipelineLayout layout,
+                               VkPipeline &pipeline);
+#endif //VULKANDEMO_COMPUTE_H
@@ -7,6 +7,7 @@
 #include <vector>
 #include <array>
 #include <iostream>
+#include <cstddef>
 #include "GraphicsPipeline.h"
 #include "Shaders.h"
 #include "../buffers/Vertex.h"
@@ -35,21 +36,116 @@ VkShaderModule createShaderModule(VkDevice device, const std::vector<char> &shad
 }
 
 /**
- * Creates the graphics pipeline.
+ * Creates the pipeline layout shared by all graphics pipelines of the pipeline library.
+ * It does not depend on the swapchain so it lives for the whole application.
+ *
+ * @param app
+ * @return
+ */
+VkResult createPipelineLayout(Application &app) {
+  TRACE_ZONE("createPipelineLayout");
+  VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+  pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+  // the lights of clustered shading, only bound and read when the scene is lit
+  pipelineLayoutInfo.setLayoutCount = 1;
+  pipelineLayoutInfo.pSetLayouts = &app.lighting.setLayout;
+  VkPushConstantRange pushConstantRanges[2]{};
+  // only read by the uber-shader variant of the fragment shader, specialized variants ignore it
+  pushConstantRanges[0].stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+  pushConstantRanges[0].offset = 0;
+  pushConstantRanges[0].size = sizeof(FragmentFeatures);
+  // only read by vertex_mesh.vert
+  pushConstantRanges[1].stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+  pushConstantRanges[1].offset = sizeof(FragmentFeatures);
+  pushConstantRanges[1].size = sizeof(MeshTransform);
+  pipelineLayoutInfo.pushConstantRangeCount = 2;
+  pipelineLayoutInfo.pPushConstantRanges = pushConstantRanges;
+
+  VkResult errorCode = vkCreatePipelineLayout(app.device, &pipelineLayoutInfo, nullptr, &app.pipelineLayout);
+  if (errorCode != VK_SUCCESS) {
+    std::cerr << "Unable to create pipeline layout" << std::endl;
+  }
+  return errorCode;
+}
+
+/**
+ * The state of the pipeline that draws the scene into the swapchain images.
+ *
+ * @param app
+ * @return
+ */
+PipelineKey defaultPipelineKey(const Application &app) {
+  PipelineKey key{};
+  key.vertexShader = "../shaders/vert.spv";
+  key.fragmentShader = "../shaders/frag.spv";
+  key.colorFormat = app.imageFormat;
+  return key;
+}
+
+/**
+ * Creates a render pass with a color and a depth attachment of the key's formats. Pipelines can
+ * be used with any render pass compatible with the one they were created with, and compatibility
+ * only depends on the attachment formats and sample counts, so this one is only needed while
+ * building pipelines that draw into render passes with depth.
+ *
+ * @param app
+ * @param key
+ * @param renderPass
+ * @return
+ */
+static VkResult createCompatibleRenderPass(Application &app, const PipelineKey &key, VkRenderPass &renderPass) {
+  VkAttachmentDescription attachments[2]{};
+  attachments[0].format = key.colorFormat;
+  attachments[0].samples = key.samples;
+  attachments[0].loadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+  attachments[0].storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+  attachments[0].stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+  attachments[0].stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+  attachments[0].initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+  attachments[0].finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+  attachments[1] = attachments[0];
+  attachments[1].format = key.depthFormat;
+  attachments[1].finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+  VkAttachmentReference colorAttachmentRef{0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL};
+  VkAttachmentReference depthAttachmentRef{1, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL};
+  VkSubpassDescription subpass{};
+  subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+  subpass.colorAttachmentCount = 1;
+  subpass.pColorAttachments = &colorAttachmentRef;
+  subpass.pDepthStencilAttachment = &depthAttachmentRef;
+  VkRenderPassCreateInfo renderPassInfo{};
+  renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+  renderPassInfo.attachmentCount = 2;
+  renderPassInfo.pAttachments = attachments;
+  renderPassInfo.subpassCount = 1;
+  renderPassInfo.pSubpasses = &subpass;
+  return vkCreateRenderPass(app.device, &renderPassInfo, nullptr, &renderPass);
+}
+
+/**
+ * Builds a graphics pipeline out of the state described by the key.
  * 1. Load shader codes from .spv files
  * 2. Create shader modules for each shader
  * 3. Create shader stages for each shader module
  * 4. Create vertex input state and input assembly state
+ * Called from the pipeline library worker threads, so it must not write to the app.
  *
  * @param app
+ * @param key
+ * @param cache
+ * @param pipeline
  * @return
  */
-VkResult createGraphicsPipeline(Application &app) {
+VkResult buildGraphicsPipeline(Application &app, const PipelineKey &key, VkPipelineCache cache, VkPipeline &pipeline) {
+  TRACE_ZONE("buildGraphicsPipeline");
   std::vector<char> vertexShader{};
-  readShaderFile("../shaders/vert.spv", vertexShader);
+  readShaderFile(key.vertexShader, vertexShader);
 
   std::vector<char> fragmentShader{};
-  readShaderFile("../shaders/frag.spv", fragmentShader);
+  readShaderFile(key.fragmentShader, fragmentShader);
+
+  VertexInputDescription vertexInput = describeVertexLayout(key.vertexLayout);
+  VkRenderPass compatibleRenderPass = VK_NULL_HANDLE;
 
   VkResult errorCode = VK_SUCCESS;
   VkShaderModule vertShaderModule = createShaderModule(app.device, vertexShader, errorCode);
@@ -71,55 +167,55 @@ VkResult createGraphicsPipeline(Application &app) {
   fragShaderStageInfo.module = fragShaderModule;
   fragShaderStageInfo.pName = "main";
 
+  // constant_id N is the Nth member of FragmentFeatures
+  const VkSpecializationMapEntry specializationEntries[] = {
+      {0, offsetof(FragmentFeatures, useVertexColor), sizeof(VkBool32)},
+      {1, offsetof(FragmentFeatures, lightingModel), sizeof(uint32_t)},
+      {2, offsetof(FragmentFeatures, sampleCount), sizeof(uint32_t)},
+      {3, offsetof(FragmentFeatures, uberShader), sizeof(VkBool32)}
+  };
+  VkSpecializationInfo specializationInfo{};
+  specializationInfo.mapEntryCount = 4;
+  specializationInfo.pMapEntries = specializationEntries;
+  specializationInfo.dataSize = sizeof(FragmentFeatures);
+  specializationInfo.pData = &key.fragmentFeatures;
+  fragShaderStageInfo.pSpecializationInfo = &specializationInfo;
+
   VkPipelineShaderStageCreateInfo shaderStages[] = {vertShaderStageInfo, fragShaderStageInfo};
 
   // Describes the format of the vertex data that will be passed to the vertex shader
   VkPipelineVertexInputStateCreateInfo vertexInputInfo{};
   vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-  auto bindingDescription = getBindingDescription();
-  auto attributeDescriptions = getAttributeDescriptions();
-  vertexInputInfo.vertexBindingDescriptionCount = 1;
-  vertexInputInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(attributeDescriptions.size());
-  vertexInputInfo.pVertexBindingDescriptions = &bindingDescription; // Optional
-  vertexInputInfo.pVertexAttributeDescriptions = attributeDescriptions.data(); // Optional
+  vertexInputInfo.vertexBindingDescriptionCount = static_cast<uint32_t>(vertexInput.bindings.size());
+  vertexInputInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(vertexInput.attributes.size());
+  vertexInputInfo.pVertexBindingDescriptions = vertexInput.bindings.data(); // Optional
+  vertexInputInfo.pVertexAttributeDescriptions = vertexInput.attributes.data(); // Optional
 
   // Describes the geometry that will be drawn (the vertices). Also describes if primitive restart should be enabled
   VkPipelineInputAssemblyStateCreateInfo inputAssembly{};
   inputAssembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
-  inputAssembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+  inputAssembly.topology = key.topology;
   inputAssembly.primitiveRestartEnable = VK_FALSE;
 
-  // Viewport is the portion of the framebuffer that will be rendered as output
-  VkViewport viewport{};
-  viewport.x = 0.0f;
-  viewport.y = 0.0f;
-  viewport.width = (float) app.swapChainExtent.width;
-  viewport.height = (float) app.swapChainExtent.height;
-  viewport.minDepth = 0.0f;
-  viewport.maxDepth = 1.0f;
-
-  // Any pixels outside the scissor rectangles will be discarded by the rasterizer
-  VkRect2D scissor{};
-  scissor.offset = {0, 0};
-  scissor.extent = app.swapChainExtent;
-
-  // Create viewport state using the viewport and scissor rectangles
+  // Viewport is the portion of the framebuffer that will be rendered as output and any pixels outside
+  // the scissor rectangles will be discarded by the rasterizer. Both are dynamic state set while recording
+  // so that the pipeline does not depend on the swapchain extent and survives swapchain recreation.
   VkPipelineViewportStateCreateInfo viewportState{};
   viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
   viewportState.viewportCount = 1;
-  viewportState.pViewports = &viewport;
+  viewportState.pViewports = nullptr;
   viewportState.scissorCount = 1;
-  viewportState.pScissors = &scissor;
+  viewportState.pScissors = nullptr;
 
   // Configuration of the rasterizer
   VkPipelineRasterizationStateCreateInfo rasterizer{};
   rasterizer.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
   rasterizer.depthClampEnable = VK_FALSE; // if true clamps fragments outside of the near/far planes instead of discarding them
   rasterizer.rasterizerDiscardEnable = VK_FALSE; // disables the rasterizer. Use for when we just don't want to output fragments to framebuffer
-  rasterizer.polygonMode = VK_POLYGON_MODE_FILL;
+  rasterizer.polygonMode = key.polygonMode;
   rasterizer.lineWidth = 1.0f; // line thickness is terms of number of fragments
-  rasterizer.cullMode = VK_CULL_MODE_BACK_BIT; // specifies the type of face culling to use
-  rasterizer.frontFace = VK_FRONT_FACE_CLOCKWISE; // specifies which faces are consider front faces
+  rasterizer.cullMode = key.cullMode; // specifies the type of face culling to use
+  rasterizer.frontFace = key.frontFace; // specifies which faces are consider front faces
   rasterizer.depthBiasEnable = VK_FALSE; // might be used for shadow mapping
   rasterizer.depthBiasConstantFactor = 0.0f; // Optional
   rasterizer.depthBiasClamp = 0.0f; // Optional
@@ -129,25 +225,31 @@ VkResult createGraphicsPipeline(Application &app) {
   VkPipelineMultisampleStateCreateInfo multisampling{};
   multisampling.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
   multisampling.sampleShadingEnable = VK_FALSE;
-  multisampling.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+  multisampling.rasterizationSamples = key.samples;
   multisampling.minSampleShading = 1.0f; // Optional
   multisampling.pSampleMask = nullptr; // Optional
   multisampling.alphaToCoverageEnable = VK_FALSE; // Optional
   multisampling.alphaToOneEnable = VK_FALSE; // Optional
 
-  // Depth/stencil testing goes here
+  VkPipelineDepthStencilStateCreateInfo depthStencil{};
+  depthStencil.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+  depthStencil.depthTestEnable = key.depthTestEnable;
+  depthStencil.depthWriteEnable = key.depthWriteEnable;
+  depthStencil.depthCompareOp = VK_COMPARE_OP_LESS_OR_EQUAL;
+  depthStencil.depthBoundsTestEnable = VK_FALSE;
+  depthStencil.stencilTestEnable = VK_FALSE;
 
   // Color blending.
   // Combining the color the fragment shader returns with the color that is already in the framebuffer.
-  // At the moment we disable all blending and simply pass the color of the fragment shader
-  // directly as the new color of the framebuffer.
+  // Unless the key asks for blending, we simply pass the color of the fragment shader
+  // directly as the new color of the framebuffer. Otherwise we do standard alpha blending.
 
   // Color blending per framebuffer (we only have 1)
   VkPipelineColorBlendAttachmentState colorBlendAttachment{};
   colorBlendAttachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
-  colorBlendAttachment.blendEnable = VK_FALSE; // if blend -> false, the following is optional
-  colorBlendAttachment.srcColorBlendFactor = VK_BLEND_FACTOR_ONE; // Optional
-  colorBlendAttachment.dstColorBlendFactor = VK_BLEND_FACTOR_ZERO; // Optional
+  colorBlendAttachment.blendEnable = key.blendEnable; // if blend -> false, the following is optional
+  colorBlendAttachment.srcColorBlendFactor = key.blendEnable ? VK_BLEND_FACTOR_SRC_ALPHA : VK_BLEND_FACTOR_ONE;
+  colorBlendAttachment.dstColorBlendFactor = key.blendEnable ? VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA : VK_BLEND_FACTOR_ZERO;
   colorBlendAttachment.colorBlendOp = VK_BLEND_OP_ADD; // Optional
   colorBlendAttachment.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE; // Optional
   colorBlendAttachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO; // Optional
@@ -165,21 +267,11 @@ VkResult createGraphicsPipeline(Application &app) {
   colorBlending.blendConstants[2] = 0.0f; // Optional
   colorBlending.blendConstants[3] = 0.0f; // Optional
 
-  // Possibly add pipeline dynamic state
-
-  // Create pipeline layout
-  VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
-  pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-  pipelineLayoutInfo.setLayoutCount = 0; // Optional
-  pipelineLayoutInfo.pSetLayouts = nullptr; // Optional
-  pipelineLayoutInfo.pushConstantRangeCount = 0; // Optional
-  pipelineLayoutInfo.pPushConstantRanges = nullptr; // Optional
-
-  errorCode = vkCreatePipelineLayout(app.device, &pipelineLayoutInfo, nullptr, &app.pipelineLayout);
-  if (errorCode != VK_SUCCESS) {
-    std::cerr << "Unable to create pipeline layout" << std::endl;
-    goto throwError;
-  }
+  VkDynamicState dynamicStates[] = {VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR};
+  VkPipelineDynamicStateCreateInfo dynamicState{};
+  dynamicState.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+  dynamicState.dynamicStateCount = 2;
+  dynamicState.pDynamicStates = dynamicStates;
 
   VkGraphicsPipelineCreateInfo pipelineInfo{};
   pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
@@ -190,29 +282,143 @@ VkResult createGraphicsPipeline(Application &app) {
   pipelineInfo.pViewportState = &viewportState;
   pipelineInfo.pRasterizationState = &rasterizer;
   pipelineInfo.pMultisampleState = &multisampling;
-  pipelineInfo.pDepthStencilState = nullptr; // Optional
+  pipelineInfo.pDepthStencilState = &depthStencil;
   pipelineInfo.pColorBlendState = &colorBlending;
-  pipelineInfo.pDynamicState = nullptr; // Optional
+  pipelineInfo.pDynamicState = &dynamicState;
   pipelineInfo.layout = app.pipelineLayout;
   pipelineInfo.renderPass = app.renderPass;
+  if (key.depthFormat != VK_FORMAT_UNDEFINED) {
+    // the main render pass has no depth attachment
+    errorCode = createCompatibleRenderPass(app, key, compatibleRenderPass);
+    if (errorCode != VK_SUCCESS) {
+      std::cerr << "Unable to create render pass for a depth pipeline" << std::endl;
+      goto throwError;
+    }
+    pipelineInfo.renderPass = compatibleRenderPass;
+  }
   pipelineInfo.subpass = 0; // index of the supbass where the graphics pipeline will be used
   pipelineInfo.basePipelineHandle = VK_NULL_HANDLE; // Optional
   pipelineInfo.basePipelineIndex = -1; // Optional
 
   // the graphics pipeline creation is slow but can be drastically sped up by providing a pipeline cache
   // as the second argument which can even be serialized and stored for quick engine startup
-  errorCode = vkCreateGraphicsPipelines(app.device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &app.graphicsPipeline);
+  errorCode = vkCreateGraphicsPipelines(app.device, cache, 1, &pipelineInfo, nullptr, &pipeline);
   if(errorCode != VK_SUCCESS) {
     std::cerr << "Unable to create graphics pipeline" << std::endl;
     goto throwError;
   }
 
   throwError:
+  vkDestroyRenderPass(app.device, compatibleRenderPass, nullptr);
   vkDestroyShaderModule(app.device, fragShaderModule, nullptr);
   vkDestroyShaderModule(app.device, vertShaderModule, nullptr);
   return errorCode;
 }
 
+/**
+ * The state of the pipeline that draws sprites on top of the scene. Sprites overlap and are
+ * not wound consistently, so it blends and doesn't cull.
+ *
+ * @param app
+ * @return
+ */
+PipelineKey spritePipelineKey(const Application &app) {
+  PipelineKey key = defaultPipelineKey(app);
+  key.blendEnable = VK_TRUE;
+  key.cullMode = VK_CULL_MODE_NONE;
+  return key;
+}
+
+/**
+ * The state of the pipeline that draws LOD meshes. vertex_mesh.vert drops z, so the mesh is seen
+ * from -z, where its outward facing triangles are counter-clockwise in framebuffer coordinates.
+ * With lights the meshes are shaded like the rest of the scene.
+ *
+ * @param app
+ * @return
+ */
+PipelineKey lodPipelineKey(const Application &app) {
+  PipelineKey key = app.options.lightCount > 0 ? clusteredPipelineKey(app) : defaultPipelineKey(app);
+  key.vertexShader = "../shaders/vert_mesh.spv";
+  key.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+  return key;
+}
+
+/**
+ * The state of the pipeline that draws the scene lit by the lights of its cluster. Needs the light
+ * set of app.lighting bound.
+ *
+ * @param app
+ * @return
+ */
+PipelineKey clusteredPipelineKey(const Application &app) {
+  PipelineKey key = defaultPipelineKey(app);
+  key.fragmentShader = "../shaders/frag_clustered.spv";
+  key.fragmentFeatures = FragmentVariant<true, LIGHTING_CLUSTERED, 1>::features;
+  return key;
+}
+
+/**
+ * The state of the pipeline that draws GPU particles, a quad per particle instance. The quads
+ * are too small for their winding to matter, so it doesn't cull.
+ *
+ * @param app
+ * @return
+ */
+PipelineKey particlePipelineKey(const Application &app) {
+  PipelineKey key = defaultPipelineKey(app);
+  key.vertexShader = "../shaders/vert_particle.spv";
+  key.vertexLayout = VERTEX_LAYOUT_POS2_COLOR3_PARTICLES;
+  key.cullMode = VK_CULL_MODE_NONE;
+  return key;
+}
+
+/**
+ * Fetches the default pipeline from the pipeline library, compiling it right away if needed.
+ * It doubles as the placeholder for variants that are still being compiled. Since viewport
+ * and scissor are dynamic this is a cache hit on swapchain recreation unless the format changed.
+ *
+ * @param app
+ * @return
+ */
+VkResult createGraphicsPipeline(Application &app) {
+  TRACE_ZONE("createGraphicsPipeline");
+  VkResult errorCode = acquirePipeline(app, defaultPipelineKey(app), app.graphicsPipeline);
+  if (errorCode != VK_SUCCESS) {
+    std::cerr << "Unable to create graphics pipeline" << std::endl;
+    return errorCode;
+  }
+  app.pipelineLibrary.placeholder = app.graphicsPipeline;
+  return VK_SUCCESS;
+}
+
+/**
+ * Queues the pipeline variants we expect to need later so they are compiled
+ * in parallel while we finish initialization instead of on first use.
+ *
+ * @param app
+ */
+void precompileGraphicsPipelines(Application &app) {
+  std::vector<PipelineKey> variants;
+  PipelineKey blended = defaultPipelineKey(app);
+  blended.blendEnable = VK_TRUE;
+  variants.push_back(blended);
+  PipelineKey doubleSided = defaultPipelineKey(app);
+  doubleSided.cullMode = VK_CULL_MODE_NONE;
+  variants.push_back(doubleSided);
+  variants.push_back(spritePipelineKey(app));
+  if (app.options.lodDemo) {
+    variants.push_back(lodPipelineKey(app));
+  }
+  if (app.options.lightCount > 0) {
+    variants.push_back(clusteredPipelineKey(app));
+  }
+  if (app.options.particleCount > 0) {
+    variants.push_back(particlePipelineKey(app));
+  }
+  precompilePipelines(app, variants);
+}
+
 /**
  * Create the render pass which will work on the framebuffer.
  * The framebuffer can have attachments for color, depth and stencil.
@@ -226,6 +432,7 @@ VkResult createGraphicsPipeline(Application &app) {
  * @return
  */
 VkResult createRenderPass(Application &app) {
+  TRACE_ZONE("createRenderPass");
   // description of the attachments used in the framebuffer
   VkAttachmentDescription colorAttachment{};
   colorAttachment.format = app.imageFormat;
@@ -273,27 +480,87 @@ VkResult createRenderPass(Application &app) {
 }
 
 /**
- * Creates the framebuffers that are the frontend to our swapchain images.
- * Assigns the created renderpass to each one of them.
+ * Creates the render pass for the work drawn on top of the scene after the main render pass,
+ * e.g. sprites. It keeps the contents of the image instead of clearing them and is compatible
+ * with the main render pass, so it can use the same framebuffers and pipelines.
  *
  * @param app
  * @return
  */
-VkResult createFramebuffers(Application &app) {
-  VkResult errorCode;
-  app.swapChainFramebuffers.resize(app.swapChainImageViews.size());
-  for (size_t i = 0; i < app.swapChainImageViews.size(); i++) {
-    VkImageView attachments[] = {app.swapChainImageViews[i]};
+VkResult createOverlayRenderPass(Application &app) {
+  TRACE_ZONE("createOverlayRenderPass");
+  VkAttachmentDescription colorAttachment{};
+  colorAttachment.format = app.imageFormat;
+  colorAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
+  colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
+  colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+  colorAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+  colorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+  colorAttachment.initialLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR; // left there by the main render pass
+  colorAttachment.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+
+  VkAttachmentReference colorAttachmentRef{};
+  colorAttachmentRef.attachment = 0;
+  colorAttachmentRef.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+  VkSubpassDescription subpass{};
+  subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+  subpass.colorAttachmentCount = 1;
+  subpass.pColorAttachments = &colorAttachmentRef;
+
+  // the main render pass writes the image earlier in the same submission, blending reads it back
+  VkSubpassDependency dependency{};
+  dependency.srcSubpass = VK_SUBPASS_EXTERNAL;
+  dependency.dstSubpass = 0;
+  dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+  dependency.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+  dependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+  dependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+
+  VkRenderPassCreateInfo renderPassInfo{};
+  renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+  renderPassInfo.attachmentCount = 1;
+  renderPassInfo.pAttachments = &colorAttachment;
+  renderPassInfo.subpassCount = 1;
+  renderPassInfo.pSubpasses = &subpass;
+  renderPassInfo.dependencyCount = 1;
+  renderPassInfo.pDependencies = &dependency;
+
+  VkResult errorCode = vkCreateRenderPass(app.device, &renderPassInfo, nullptr, &app.overlayRenderPass);
+  throwOnError(errorCode, "Unable to create overlay render pass");
+
+  error:
+  return errorCode;
+}
+
+/**
+ * Creates the framebuffers that are the frontend to our swapchain images.
+ * Assigns the given renderpass to each one of them.
+ *
+ * @param device
+ * @param renderPass
+ * @param extent
+ * @param imageViews
+ * @param framebuffers
+ * @return
+ */
+VkResult createFramebuffers(VkDevice device, VkRenderPass renderPass, VkExtent2D extent,
+                            const std::vector<VkImageView> &imageViews, std::vector<VkFramebuffer> &framebuffers) {
+  TRACE_ZONE("createFramebuffers");
+  VkResult errorCode = VK_SUCCESS;
+  framebuffers.resize(imageViews.size());
+  for (size_t i = 0; i < imageViews.size(); i++) {
+    VkImageView attachments[] = {imageViews[i]};
     VkFramebufferCreateInfo framebufferInfo{};
     framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
-    framebufferInfo.renderPass = app.renderPass;
+    framebufferInfo.renderPass = renderPass;
     framebufferInfo.attachmentCount = 1;
     framebufferInfo.pAttachments = attachments;
-    framebufferInfo.width = app.swapChainExtent.width;
-    framebufferInfo.height = app.swapChainExtent.height;
+    framebufferInfo.width = extent.width;
+    framebufferInfo.height = extent.height;
     framebufferInfo.layers = 1;
 
-    errorCode = vkCreateFramebuffer(app.device, &framebufferInfo, nullptr, &app.swapChainFramebuffers[i]);
+    errorCode = vkCreateFramebuffer(device, &framebufferInfo, nullptr, &framebuffers[i]);
     if(errorCode != VK_SUCCESS) {
       std::cerr << "Unable to create framebuffer" << std::endl;
       break;
@@ -301,3 +568,7 @@ VkResult createFramebuffers(Application &app) {
   }
   return errorCode;
 }
+
+VkResult createFramebuffers(Application &app) {
+  return createFramebuffers(app.device, app.renderPass, app.swapChainExtent, app.swapChainImageViews, app.swapChainFramebuffers);
+}
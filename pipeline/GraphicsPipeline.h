@@ -6,8 +6,31 @@
 #define VULKANDEMO_GRAPHICSPIPELINE_H
 
 #include "../Application.h"
+#include "PipelineLibrary.h"
 
+VkShaderModule createShaderModule(VkDevice device, const std::vector<char> &shaderCode, VkResult &error);
+VkResult createPipelineLayout(Application &app);
+PipelineKey defaultPipelineKey(const Application &app);
+VkResult buildGraphicsPipeline(Application &app, const PipelineKey &key, VkPipelineCache cache, VkPipeline &pipeline);
+PipelineKey spritePipelineKey(const Application &app);
+PipelineKey lodPipelineKey(const Application &app);
+PipelineKey clusteredPipelineKey(const Application &app);
+PipelineKey particlePipelineKey(const Application &app);
 VkResult createGraphicsPipeline(Application &app);
+void precompileGraphicsPipelines(Application &app);
+
+/**
+ * The default pipeline state with the fragment shader specialized for the given variant.
+ */
+template<typename Variant>
+PipelineKey makePipelineKey(const Application &app) {
+  PipelineKey key = defaultPipelineKey(app);
+  key.fragmentFeatures = Variant::features;
+  return key;
+}
 VkResult createRenderPass(Application &app);
+VkResult createOverlayRenderPass(Application &app);
+VkResult createFramebuffers(VkDevice device, VkRenderPass renderPass, VkExtent2D extent,
+                            const std::vector<VkImageView> &imageViews, std::vector<VkFramebuffer> &framebuffers);
 VkResult createFramebuffers(Application &app);
 #endif //VULKANDEMO_GRAPHICSPIPELINE_H
@@ -0,0 +1,275 @@
+#include <iostream>
+#include <algorithm>
+#include <chrono>
+#include "PipelineLibrary.h"
+#include "GraphicsPipeline.h"
+#include "../Application.h"
+
+bool operator==(const PipelineKey &a, const PipelineKey &b) {
+  return a.vertexShader == b.vertexShader &&
+         a.fragmentShader == b.fragmentShader &&
+         a.fragmentFeatures == b.fragmentFeatures &&
+         a.vertexLayout == b.vertexLayout &&
+         a.topology == b.topology &&
+         a.polygonMode == b.polygonMode &&
+         a.cullMode == b.cullMode &&
+         a.frontFace == b.frontFace &&
+         a.blendEnable == b.blendEnable &&
+         a.depthTestEnable == b.depthTestEnable &&
+         a.depthWriteEnable == b.depthWriteEnable &&
+         a.colorFormat == b.colorFormat &&
+         a.depthFormat == b.depthFormat &&
+         a.samples == b.samples;
+}
+
+static void hashBytes(uint64_t &hash, const void *data, size_t size) {
+  // FNV-1a
+  auto bytes = static_cast<const uint8_t *>(data);
+  for (size_t i = 0; i < size; ++i) {
+    hash ^= bytes[i];
+    hash *= 1099511628211ull;
+  }
+}
+
+template<typename T>
+static void hashValue(uint64_t &hash, const T &value) {
+  hashBytes(hash, &value, sizeof(T));
+}
+
+size_t PipelineKeyHash::operator()(const PipelineKey &key) const {
+  uint64_t hash = 14695981039346656037ull;
+  hashBytes(hash, key.vertexShader.data(), key.vertexShader.size());
+  hashBytes(hash, key.fragmentShader.data(), key.fragmentShader.size());
+  hashValue(hash, hashFragmentFeatures(key.fragmentFeatures));
+  hashValue(hash, key.vertexLayout);
+  hashValue(hash, key.topology);
+  hashValue(hash, key.polygonMode);
+  hashValue(hash, key.cullMode);
+  hashValue(hash, key.frontFace);
+  hashValue(hash, key.blendEnable);
+  hashValue(hash, key.depthTestEnable);
+  hashValue(hash, key.depthWriteEnable);
+  hashValue(hash, key.colorFormat);
+  hashValue(hash, key.depthFormat);
+  hashValue(hash, key.samples);
+  return static_cast<size_t>(hash);
+}
+
+/**
+ * Compiles the pipeline of the entry and publishes it. Safe to call from any thread since
+ * vkCreateGraphicsPipelines only requires external synchronization of the pipeline cache
+ * which is internally synchronized unless created otherwise.
+ *
+ * @param app
+ * @param entry
+ */
+static void compileEntry(Application &app, PipelineEntry &entry) {
+  auto start = std::chrono::steady_clock::now();
+  VkPipeline pipeline = VK_NULL_HANDLE;
+  VkResult errorCode = buildGraphicsPipeline(app, entry.key, app.pipelineLibrary.cache, pipeline);
+  std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+  entry.compileMs = elapsed.count();
+  if (errorCode != VK_SUCCESS) {
+    std::cerr << "Failed to compile pipeline variant " << PipelineKeyHash{}(entry.key) << std::endl;
+    entry.failed = true;
+    return;
+  }
+  app.pipelineLibrary.compiled++;
+  app.pipelineLibrary.compileMicros += static_cast<uint64_t>(elapsed.count() * 1000.0);
+  entry.pipeline.store(pipeline, std::memory_order_release);
+  requestRedraw(app); // frames drawn on demand showed the placeholder
+}
+
+static void pipelineWorker(Application *app) {
+  PipelineLibrary &library = app->pipelineLibrary;
+  while (true) {
+    PipelineEntry *entry;
+    {
+      std::unique_lock<std::mutex> lock(library.mutex);
+      library.workAvailable.wait(lock, [&library] { return library.stopping || !library.pending.empty(); });
+      if (library.stopping) {
+        return;
+      }
+      entry = library.pending.front();
+      library.pending.pop_front();
+      library.busyWorkers++;
+    }
+    compileEntry(*app, *entry);
+    {
+      std::lock_guard<std::mutex> lock(library.mutex);
+      library.busyWorkers--;
+    }
+    library.workDone.notify_all();
+  }
+}
+
+/**
+ * Creates the pipeline cache shared by all pipelines and starts the compile workers.
+ *
+ * @param app
+ * @return
+ */
+VkResult createPipelineLibrary(Application &app) {
+  TRACE_ZONE("createPipelineLibrary");
+  PipelineLibrary &library = app.pipelineLibrary;
+  VkPipelineCacheCreateInfo cacheInfo{};
+  cacheInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+  VkResult errorCode = vkCreatePipelineCache(app.device, &cacheInfo, nullptr, &library.cache);
+  if (errorCode != VK_SUCCESS) {
+    std::cerr << "Unable to create pipeline cache" << std::endl;
+    return errorCode;
+  }
+
+  // leave one core for the render thread
+  uint32_t workerCount = std::max(1u, std::min(4u, std::thread::hardware_concurrency() - 1));
+  for (uint32_t i = 0; i < workerCount; ++i) {
+    library.workers.emplace_back(pipelineWorker, &app);
+  }
+  return VK_SUCCESS;
+}
+
+/**
+ * Returns the pipeline for the given key, compiling it on the calling thread if it is not
+ * in the library yet. Use this for pipelines that must exist before rendering can start.
+ *
+ * @param app
+ * @param key
+ * @param pipeline
+ * @return
+ */
+VkResult acquirePipeline(Application &app, const PipelineKey &key, VkPipeline &pipeline) {
+  PipelineLibrary &library = app.pipelineLibrary;
+  PipelineEntry *entry;
+  bool compileHere = false;
+  {
+    std::unique_lock<std::mutex> lock(library.mutex);
+    auto it = library.entries.find(key);
+    if (it == library.entries.end()) {
+      library.misses++;
+      auto created = std::make_unique<PipelineEntry>();
+      created->key = key;
+      entry = created.get();
+      library.entries.emplace(key, std::move(created));
+      compileHere = true;
+    } else {
+      library.hits++;
+      entry = it->second.get();
+      // a worker may be compiling it right now, wait for it instead of compiling it twice
+      auto queued = std::find(library.pending.begin(), library.pending.end(), entry);
+      if (queued != library.pending.end()) {
+        library.pending.erase(queued);
+        compileHere = true;
+      } else {
+        library.workDone.wait(lock, [entry] { return entry->pipeline.load() != VK_NULL_HANDLE || entry->failed.load(); });
+      }
+    }
+  }
+  if (compileHere) {
+    compileEntry(app, *entry);
+    {
+      std::lock_guard<std::mutex> lock(library.mutex); // don't let a waiter miss the wake up
+    }
+    library.workDone.notify_all();
+  }
+  if (entry->failed) {
+    return VK_ERROR_INITIALIZATION_FAILED;
+  }
+  pipeline = entry->pipeline.load(std::memory_order_acquire);
+  return VK_SUCCESS;
+}
+
+/**
+ * Non-blocking lookup. Queues the pipeline for compilation on first use and returns the
+ * placeholder pipeline until the real one is ready.
+ *
+ * @param app
+ * @param key
+ * @return
+ */
+VkPipeline requestPipeline(Application &app, const PipelineKey &key) {
+  PipelineLibrary &library = app.pipelineLibrary;
+  std::unique_lock<std::mutex> lock(library.mutex);
+  auto it = library.entries.find(key);
+  if (it != library.entries.end()) {
+    library.hits++;
+    VkPipeline pipeline = it->second->pipeline.load(std::memory_order_acquire);
+    return pipeline != VK_NULL_HANDLE ? pipeline : library.placeholder;
+  }
+  library.misses++;
+  auto created = std::make_unique<PipelineEntry>();
+  created->key = key;
+  library.pending.push_back(created.get());
+  library.entries.emplace(key, std::move(created));
+  lock.unlock();
+  library.workAvailable.notify_one();
+  return library.placeholder;
+}
+
+/**
+ * Queues all the given pipeline variants for compilation on the worker threads.
+ * Keys already in the library are skipped.
+ *
+ * @param app
+ * @param keys
+ */
+void precompilePipelines(Application &app, const std::vector<PipelineKey> &keys) {
+  PipelineLibrary &library = app.pipelineLibrary;
+  {
+    std::lock_guard<std::mutex> lock(library.mutex);
+    for (const auto &key : keys) {
+      if (library.entries.find(key) != library.entries.end()) {
+        continue;
+      }
+      auto created = std::make_unique<PipelineEntry>();
+      created->key = key;
+      library.pending.push_back(created.get());
+      library.entries.emplace(key, std::move(created));
+    }
+  }
+  library.workAvailable.notify_all();
+}
+
+/**
+ * Blocks until no compilation is queued or in progress. Must be called before destroying
+ * anything the workers read while compiling, e.g. the render pass on swapchain recreation.
+ *
+ * @param app
+ */
+void waitPipelineLibraryIdle(Application &app) {
+  PipelineLibrary &library = app.pipelineLibrary;
+  std::unique_lock<std::mutex> lock(library.mutex);
+  library.workDone.wait(lock, [&library] { return library.pending.empty() && library.busyWorkers == 0; });
+}
+
+void destroyPipelineLibrary(Application &app) {
+  PipelineLibrary &library = app.pipelineLibrary;
+  {
+    std::lock_guard<std::mutex> lock(library.mutex);
+    library.stopping = true;
+    library.pending.clear();
+  }
+  library.workAvailable.notify_all();
+  for (auto &worker : library.workers) {
+    worker.join();
+  }
+  library.workers.clear();
+  for (auto &entry : library.entries) {
+    vkDestroyPipeline(app.device, entry.second->pipeline.load(), nullptr);
+  }
+  library.entries.clear();
+  library.placeholder = VK_NULL_HANDLE;
+  vkDestroyPipelineCache(app.device, library.cache, nullptr);
+}
+
+void printPipelineLibraryStats(Application &app) {
+  PipelineLibrary &library = app.pipelineLibrary;
+  std::lock_guard<std::mutex> lock(library.mutex);
+  uint64_t lookups = library.hits + library.misses;
+  double maxMs = 0.0;
+  for (const auto &entry : library.entries) {
+    maxMs = std::max(maxMs, entry.second->compileMs);
+  }
+  std::cout << "Pipeline library: " << library.entries.size() << " variants, " << library.compiled << " compiled in "
+            << library.compileMicros / 1000.0 << " ms (max " << maxMs << " ms), cache hit rate "
+            << (lookups ? 100.0 * library.hits / lookups : 0.0) << "% of " << lookups << " lookups" << std::endl;
+}
@@ -0,0 +1,100 @@
+#ifndef VULKANDEMO_PIPELINELIBRARY_H
+#define VULKANDEMO_PIPELINELIBRARY_H
+
+#include <vulkan/vulkan.h>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include "ShaderVariants.h"
+
+struct Application;
+
+/**
+ * Identifies the vertex input layout a pipeline consumes. Each value maps to a
+ * binding/attribute description set in the pipeline builder.
+ */
+enum VertexLayout : uint32_t {
+    VERTEX_LAYOUT_POS2_COLOR3 = 0, // Vertex
+    VERTEX_LAYOUT_HALF2_UNORM4 = 1, // HalfVertex
+    VERTEX_LAYOUT_HALF2_UNORM4_OCT16 = 2, // OctahedralVertex, needs a vertex shader that reads location 2
+    VERTEX_LAYOUT_POS2_COLOR3_INSTANCED = 3, // Vertex, plus ObjectInstance per instance from binding 1 at location 2
+    VERTEX_LAYOUT_POS2_COLOR3_PARTICLES = 4 // Vertex, plus Particle per instance from binding 1 at locations 2 and 3
+};
+
+/**
+ * Everything that makes two graphics pipelines different. Two keys that compare equal
+ * always produce interchangeable pipelines, so the library never compiles the same state twice.
+ * Viewport and scissor are dynamic state and the render pass is described only by the
+ * properties relevant for render pass compatibility, so keys survive swapchain recreation.
+ */
+typedef struct PipelineKey {
+    std::string vertexShader;
+    std::string fragmentShader;
+    FragmentFeatures fragmentFeatures = DefaultFragmentVariant::features; // specialization constants
+    VertexLayout vertexLayout = VERTEX_LAYOUT_POS2_COLOR3;
+    VkPrimitiveTopology topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+    VkPolygonMode polygonMode = VK_POLYGON_MODE_FILL;
+    VkCullModeFlags cullMode = VK_CULL_MODE_BACK_BIT;
+    VkFrontFace frontFace = VK_FRONT_FACE_CLOCKWISE;
+    VkBool32 blendEnable = VK_FALSE;
+    VkBool32 depthTestEnable = VK_FALSE;
+    VkBool32 depthWriteEnable = VK_FALSE;
+    // render pass compatibility
+    VkFormat colorFormat = VK_FORMAT_UNDEFINED;
+    VkFormat depthFormat = VK_FORMAT_UNDEFINED; // no depth attachment
+    VkSampleCountFlagBits samples = VK_SAMPLE_COUNT_1_BIT;
+} PipelineKey;
+
+bool operator==(const PipelineKey &a, const PipelineKey &b);
+
+struct PipelineKeyHash {
+    size_t operator()(const PipelineKey &key) const;
+};
+
+typedef struct PipelineEntry {
+    PipelineKey key;
+    std::atomic<VkPipeline> pipeline{VK_NULL_HANDLE};
+    std::atomic<bool> failed{false};
+    double compileMs = 0.0;
+} PipelineEntry;
+
+/**
+ * Deduplicating cache of graphics pipelines keyed by the hash of their state.
+ * Pipelines that are not in the library yet are compiled on worker threads; until they are
+ * ready, lookups return the placeholder pipeline (the default pipeline, which is always built
+ * synchronously).
+ */
+typedef struct PipelineLibrary {
+    VkPipelineCache cache = VK_NULL_HANDLE;
+    VkPipeline placeholder = VK_NULL_HANDLE;
+
+    std::mutex mutex;
+    std::condition_variable workAvailable;
+    std::condition_variable workDone;
+    std::unordered_map<PipelineKey, std::unique_ptr<PipelineEntry>, PipelineKeyHash> entries;
+    std::deque<PipelineEntry *> pending;
+    std::vector<std::thread> workers;
+    uint32_t busyWorkers = 0;
+    bool stopping = false;
+
+    // statistics
+    std::atomic<uint64_t> hits{0};
+    std::atomic<uint64_t> misses{0};
+    std::atomic<uint64_t> compiled{0};
+    std::atomic<uint64_t> compileMicros{0};
+} PipelineLibrary;
+
+VkResult createPipelineLibrary(Application &app);
+VkResult acquirePipeline(Application &app, const PipelineKey &key, VkPipeline &pipeline);
+VkPipeline requestPipeline(Application &app, const PipelineKey &key);
+void precompilePipelines(Application &app, const std::vector<PipelineKey> &keys);
+void waitPipelineLibraryIdle(Application &app);
+void destroyPipelineLibrary(Application &app);
+void printPipelineLibraryStats(Application &app);
+#endif //VULKANDEMO_PIPELINELIBRARY_H
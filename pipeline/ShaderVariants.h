@@ -0,0 +1,74 @@
+#ifndef VULKANDEMO_SHADERVARIANTS_H
+#define VULKANDEMO_SHADERVARIANTS_H
+
+#include <vulkan/vulkan.h>
+#include <cstdint>
+
+enum LightingModel : uint32_t {
+    LIGHTING_UNLIT = 0,
+    LIGHTING_POINT_LIGHTS = 1,
+    // fragment_clustered.frag only, over the lights of lighting/ClusteredLighting.h
+    LIGHTING_CLUSTERED = 2, // the lights binned into the fragment's cluster
+    LIGHTING_ALL_LIGHTS = 3 // every light, for comparison
+};
+
+/**
+ * Feature switches of fragment_base.frag. Each member is a specialization constant whose
+ * constant_id is its index in the struct, and the struct doubles as the push constant block
+ * the uber-shader variant reads the same switches from at runtime. Keep the layout in sync with the shader.
+ */
+typedef struct FragmentFeatures {
+    VkBool32 useVertexColor;
+    uint32_t lightingModel;
+    uint32_t sampleCount; // lighting taps per fragment
+    VkBool32 uberShader; // ignore the constants above and branch on the push constants instead
+} FragmentFeatures;
+
+static_assert(sizeof(FragmentFeatures) == 4 * sizeof(uint32_t), "FragmentFeatures must match the shader's constant layout");
+
+constexpr uint64_t hashFragmentFeatures(const FragmentFeatures &features) {
+  const uint32_t values[] = {features.useVertexColor, features.lightingModel, features.sampleCount, features.uberShader};
+  uint64_t hash = 14695981039346656037ull; // FNV-1a
+  for (uint32_t value : values) {
+    for (int byte = 0; byte < 4; ++byte) {
+      hash ^= (value >> (byte * 8)) & 0xffu;
+      hash *= 1099511628211ull;
+    }
+  }
+  return hash;
+}
+
+constexpr bool operator==(const FragmentFeatures &a, const FragmentFeatures &b) {
+  return a.useVertexColor == b.useVertexColor && a.lightingModel == b.lightingModel &&
+         a.sampleCount == b.sampleCount && a.uberShader == b.uberShader;
+}
+
+/**
+ * Compile-time description of a specialized fragment shader variant.
+ * The features and their hash are constants so variant keys cost nothing to build at runtime.
+ *
+ * @tparam VertexColor
+ * @tparam Lighting
+ * @tparam Samples
+ */
+template<bool VertexColor, LightingModel Lighting, uint32_t Samples>
+struct FragmentVariant {
+    static_assert(Samples >= 1 && Samples <= 16, "Sample count must be between 1 and 16");
+    static constexpr FragmentFeatures features{VertexColor ? VK_TRUE : VK_FALSE, Lighting, Samples, VK_FALSE};
+    static constexpr uint64_t hash = hashFragmentFeatures(features);
+};
+
+/**
+ * The same features as the given variant but evaluated with runtime branches.
+ */
+template<typename Variant>
+struct UberVariant {
+    static constexpr FragmentFeatures features{Variant::features.useVertexColor, Variant::features.lightingModel,
+                                               Variant::features.sampleCount, VK_TRUE};
+    static constexpr uint64_t hash = hashFragmentFeatures(features);
+};
+
+using DefaultFragmentVariant = FragmentVariant<true, LIGHTING_UNLIT, 1>;
+
+static_assert(DefaultFragmentVariant::hash != UberVariant<DefaultFragmentVariant>::hash, "Variant hashes must differ");
+#endif //VULKANDEMO_SHADERVARIANTS_H
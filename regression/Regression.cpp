@@ -0,0 +1,272 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+#include "Regression.h"
+
+// stages that only run CPU work, the others mostly wait for the GPU or the presentation engine
+static const FrameStage COMPARED_STAGES[] = {FRAME_STAGE_UPDATE, FRAME_STAGE_RECORD, FRAME_STAGE_SUBMIT};
+static const char *STAGE_NAMES[FRAME_STAGE_COUNT] = {"wait_ms", "update_ms", "acquire_ms", "record_ms", "submit_ms", "present_ms"};
+
+typedef std::map<std::string, double> RegressionMetrics;
+
+typedef struct RgbImage {
+    uint32_t width = 0;
+    uint32_t height = 0;
+    std::vector<uint8_t> pixels; // tightly packed RGB
+} RgbImage;
+
+static bool writePpm(const std::string &filename, const RgbImage &image) {
+  std::ofstream file(filename, std::ios::binary);
+  if (!file.is_open()) {
+    return false;
+  }
+  file << "P6\n" << image.width << " " << image.height << "\n255\n";
+  file.write(reinterpret_cast<const char *>(image.pixels.data()), static_cast<std::streamsize>(image.pixels.size()));
+  return file.good();
+}
+
+/**
+ * Reads a binary PPM with 8 bit channels, the format the golden images are stored in since
+ * every image viewer and diff tool reads it and it needs no decoder here.
+ */
+static bool readPpm(const std::string &filename, RgbImage &image) {
+  std::ifstream file(filename, std::ios::binary);
+  if (!file.is_open()) {
+    return false;
+  }
+  std::string magic;
+  uint32_t maxValue = 0;
+  file >> magic >> image.width >> image.height >> maxValue;
+  if (magic != "P6" || maxValue != 255 || image.width == 0 || image.height == 0) {
+    return false;
+  }
+  file.get(); // the single whitespace after the header
+  image.pixels.resize(static_cast<size_t>(image.width) * image.height * 3);
+  file.read(reinterpret_cast<char *>(image.pixels.data()), static_cast<std::streamsize>(image.pixels.size()));
+  return file.good();
+}
+
+static bool writeMetrics(const std::string &filename, const RegressionMetrics &metrics) {
+  std::ofstream file(filename);
+  if (!file.is_open()) {
+    return false;
+  }
+  for (const auto &metric : metrics) {
+    file << metric.first << " " << metric.second << "\n";
+  }
+  return file.good();
+}
+
+static bool readMetrics(const std::string &filename, RegressionMetrics &metrics) {
+  std::ifstream file(filename);
+  if (!file.is_open()) {
+    return false;
+  }
+  std::string name;
+  double value;
+  while (file >> name >> value) {
+    metrics[name] = value;
+  }
+  return true;
+}
+
+/**
+ * Distance of two colors weighted by how sensitive the eye is to each channel depending on the
+ * amount of red ("redmean"), much closer to the perceived difference than the plain RGB distance.
+ */
+static double perceivedDifference(const uint8_t *a, const uint8_t *b) {
+  const double redMean = (a[0] + b[0]) * 0.5;
+  const double red = a[0] - b[0], green = a[1] - b[1], blue = a[2] - b[2];
+  return std::sqrt((2.0 + redMean / 256.0) * red * red + 4.0 * green * green + (2.0 + (255.0 - redMean) / 256.0) * blue * blue);
+}
+
+/**
+ * Compares the rendered image against the golden one and writes a difference image next to the
+ * results, differing pixels in red over a darkened copy of the golden image.
+ *
+ * @return percent of pixels that differ visibly
+ */
+static double compareImages(const RgbImage &rendered, const RgbImage &golden, RgbImage &difference, double &maxDifference) {
+  difference = golden;
+  maxDifference = 0.0;
+  size_t differing = 0;
+  const size_t pixelCount = static_cast<size_t>(golden.width) * golden.height;
+  for (size_t i = 0; i < pixelCount; ++i) {
+    const double distance = perceivedDifference(&rendered.pixels[i * 3], &golden.pixels[i * 3]);
+    maxDifference = std::max(maxDifference, distance);
+    uint8_t *pixel = &difference.pixels[i * 3];
+    if (distance > REGRESSION_VISIBLE_DIFFERENCE) {
+      differing++;
+      pixel[0] = 255;
+      pixel[1] = 0;
+      pixel[2] = 0;
+    } else {
+      pixel[0] /= 4;
+      pixel[1] /= 4;
+      pixel[2] /= 4;
+    }
+  }
+  return 100.0 * static_cast<double>(differing) / static_cast<double>(pixelCount);
+}
+
+static double median(std::vector<double> &values) {
+  std::nth_element(values.begin(), values.begin() + values.size() / 2, values.end());
+  return values[values.size() / 2];
+}
+
+/**
+ * Renders the frames of the scenario through drawFrame and collects the median time of every
+ * CPU stage. The GLFW clock is pinned to 0 before every frame, so animations render the same
+ * image every run.
+ *
+ * @param app
+ * @param renderFrame
+ * @param metrics
+ * @return
+ */
+static VkResult measureScenario(Application &app, VkResult (*renderFrame)(), RegressionMetrics &metrics) {
+  VkResult errorCode;
+  for (uint32_t i = 0; i < REGRESSION_WARMUP_FRAMES; ++i) {
+    glfwPollEvents();
+    glfwSetTime(0.0);
+    errorCode = renderFrame();
+    returnOnError(errorCode)
+  }
+  // pipeline variants requested during the warm up would otherwise be drawn with the placeholder
+  waitPipelineLibraryIdle(app);
+
+  std::vector<double> stages[FRAME_STAGE_COUNT];
+  std::vector<double> frames;
+  for (uint32_t i = 0; i < REGRESSION_MEASURED_FRAMES; ++i) {
+    glfwPollEvents();
+    glfwSetTime(0.0);
+    auto start = std::chrono::steady_clock::now();
+    errorCode = renderFrame();
+    returnOnError(errorCode)
+    frames.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+    for (uint32_t stage = 0; stage < FRAME_STAGE_COUNT; ++stage) {
+      stages[stage].push_back(app.frameStages.milliseconds[stage]);
+    }
+  }
+  errorCode = vkDeviceWaitIdle(app.device);
+  returnOnError(errorCode)
+
+  double cpu = 0.0;
+  for (uint32_t stage = 0; stage < FRAME_STAGE_COUNT; ++stage) {
+    metrics[STAGE_NAMES[stage]] = median(stages[stage]);
+  }
+  for (FrameStage stage : COMPARED_STAGES) {
+    cpu += metrics[STAGE_NAMES[stage]];
+  }
+  metrics["cpu_ms"] = cpu;
+  metrics["frame_ms"] = median(frames);
+  return VK_SUCCESS;
+}
+
+/**
+ * Checks the CPU stages against the baseline.
+ *
+ * @return false if one got slower than the threshold allows
+ */
+static bool compareMetrics(const Application &app, const RegressionMetrics &metrics, const RegressionMetrics &baseline) {
+  bool passed = true;
+  const double allowed = 1.0 + app.options.regressionThreshold / 100.0;
+  std::vector<std::string> compared = {"cpu_ms"};
+  for (FrameStage stage : COMPARED_STAGES) {
+    compared.emplace_back(STAGE_NAMES[stage]);
+  }
+  for (const auto &name : compared) {
+    auto expected = baseline.find(name);
+    if (expected == baseline.end()) {
+      continue;
+    }
+    const double measured = metrics.at(name);
+    const bool regressed = measured > expected->second * allowed + REGRESSION_NOISE_MS;
+    std::cout << "  " << name << ": " << measured << " ms, baseline " << expected->second << " ms"
+              << (regressed ? "  REGRESSION" : "") << std::endl;
+    passed &= !regressed;
+  }
+  return passed;
+}
+
+/**
+ * Renders the scenario set up by the other command line options, checks the last frame against
+ * the scenario's golden image and the CPU stage times against its baseline, and writes all
+ * metrics to regression_results/<scenario>.txt. Each scenario is one run of the application,
+ * so a test driver only has to look at the exit code.
+ *
+ * @param app
+ * @param renderFrame drawFrame
+ * @param passed false on a visible difference or a performance regression
+ * @return
+ */
+VkResult runRegressionScenario(Application &app, VkResult (*renderFrame)(), bool &passed) {
+  const std::string &scenario = app.options.regressionScenario;
+  const std::string goldenFile = app.options.regressionDirectory + "/golden/" + scenario + ".ppm";
+  const std::string baselineFile = app.options.regressionDirectory + "/baselines/" + scenario + ".txt";
+  const std::string resultPrefix = std::string(REGRESSION_RESULTS_DIRECTORY) + "/" + scenario;
+  passed = false;
+  std::cout << "Regression scenario " << scenario << std::endl;
+
+  RegressionMetrics metrics;
+  VkResult errorCode = measureScenario(app, renderFrame, metrics);
+  returnOnError(errorCode)
+
+  RgbImage rendered;
+  if (!readLatestCapture(app, rendered.pixels, rendered.width, rendered.height)) {
+    std::cerr << "No frame could be read back, the surface doesn't allow copying from swapchain images" << std::endl;
+    return VK_SUCCESS;
+  }
+  std::error_code error;
+  std::filesystem::create_directories(REGRESSION_RESULTS_DIRECTORY, error);
+  writePpm(resultPrefix + ".ppm", rendered);
+
+  if (app.options.regressionUpdate) {
+    std::filesystem::create_directories(app.options.regressionDirectory + "/golden", error);
+    std::filesystem::create_directories(app.options.regressionDirectory + "/baselines", error);
+    passed = writePpm(goldenFile, rendered) && writeMetrics(baselineFile, metrics);
+    writeMetrics(resultPrefix + ".txt", metrics);
+    std::cout << (passed ? "Updated " : "Unable to update ") << goldenFile << " and " << baselineFile << std::endl;
+    return VK_SUCCESS;
+  }
+
+  bool imagePassed = false;
+  RgbImage golden;
+  if (!readPpm(goldenFile, golden)) {
+    std::cerr << "No golden image " << goldenFile << ", create it with --regression-update" << std::endl;
+  } else if (golden.width != rendered.width || golden.height != rendered.height) {
+    std::cerr << "Rendered " << rendered.width << "x" << rendered.height << " but the golden image is "
+              << golden.width << "x" << golden.height << std::endl;
+  } else {
+    RgbImage difference;
+    double maxDifference;
+    const double differing = compareImages(rendered, golden, difference, maxDifference);
+    metrics["differing_pixels_percent"] = differing;
+    metrics["max_pixel_difference"] = maxDifference;
+    imagePassed = differing <= app.options.regressionTolerance;
+    std::cout << "  image: " << differing << "% of the pixels differ visibly, largest difference " << maxDifference
+              << (imagePassed ? "" : "  MISMATCH, see " + resultPrefix + ".diff.ppm") << std::endl;
+    if (!imagePassed) {
+      writePpm(resultPrefix + ".diff.ppm", difference);
+    }
+  }
+
+  bool metricsPassed = true;
+  RegressionMetrics baseline;
+  if (readMetrics(baselineFile, baseline)) {
+    metricsPassed = compareMetrics(app, metrics, baseline);
+  } else {
+    std::cout << "  no baseline " << baselineFile << ", timings are recorded but not checked" << std::endl;
+  }
+  writeMetrics(resultPrefix + ".txt", metrics);
+
+  passed = imagePassed && metricsPassed;
+  std::cout << "Regression scenario " << scenario << (passed ? " passed" : " FAILED") << std::endl;
+  return VK_SUCCESS;
+}
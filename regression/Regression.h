@@ -0,0 +1,13 @@
+#ifndef VULKANDEMO_REGRESSION_H
+#define VULKANDEMO_REGRESSION_H
+
+#include "../Application.h"
+
+const uint32_t REGRESSION_WARMUP_FRAMES = 30;
+const uint32_t REGRESSION_MEASURED_FRAMES = 240;
+const double REGRESSION_VISIBLE_DIFFERENCE = 12.0; // weighted RGB distance (0-765) a viewer starts to notice
+const double REGRESSION_NOISE_MS = 0.02; // stages faster than the baseline plus this never count as regressions
+const char *const REGRESSION_RESULTS_DIRECTORY = "regression_results";
+
+VkResult runRegressionScenario(Application &app, VkResult (*renderFrame)(), bool &passed);
+#endif //VULKANDEMO_REGRESSION_H
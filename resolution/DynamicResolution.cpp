@@ -0,0 +1,357 @@
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include "DynamicResolution.h"
+#include "../Application.h"
+#include "../buffers/Image.h"
+
+const double RESOLUTION_SMOOTHING = 0.1; // weight of the newest frame in the smoothed GPU time
+const double RESOLUTION_OVER_BUDGET = 0.95; // of the target, frames above count as over budget
+const double RESOLUTION_UNDER_BUDGET = 0.75; // frames below leave room for more pixels
+const uint32_t RESOLUTION_DROP_FRAMES = 6; // over budget in a row before the scale drops
+const uint32_t RESOLUTION_RAISE_FRAMES = 60; // under budget in a row before it rises
+const uint32_t RESOLUTION_COOLDOWN_FRAMES = 4 * MAX_FRAMES_IN_FLIGHT;
+const float RESOLUTION_STEP = 0.05f; // scales are multiples of this so small changes don't re-record the scene
+const float RESOLUTION_MAX_RAISE = 0.1f; // per change, raising too far would immediately drop again
+
+static VkExtent2D scaledExtent(const VkExtent2D &extent, float scale) {
+  return {std::max(1u, static_cast<uint32_t>(std::lround(extent.width * scale))),
+          std::max(1u, static_cast<uint32_t>(std::lround(extent.height * scale)))};
+}
+
+/**
+ * The main render pass, except that the image ends up as the source of the upscale blit. Stays
+ * compatible with app.renderPass, so the pipelines and the cached scene segment work with both.
+ */
+static VkResult createSceneRenderPass(Application &app, VkRenderPass &renderPass) {
+  VkAttachmentDescription colorAttachment{};
+  colorAttachment.format = app.imageFormat;
+  colorAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
+  colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+  colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+  colorAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+  colorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+  colorAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+  colorAttachment.finalLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+  VkAttachmentReference colorAttachmentRef{0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL};
+  VkSubpassDescription subpass{};
+  subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+  subpass.colorAttachmentCount = 1;
+  subpass.pColorAttachments = &colorAttachmentRef;
+
+  // the blit of the previous frame has to finish reading before the image is cleared,
+  // and the scene has to be written before this frame's blit reads it
+  VkSubpassDependency dependencies[2]{};
+  dependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
+  dependencies[0].dstSubpass = 0;
+  dependencies[0].srcStageMask = VK_PIPELINE_STAGE_TRANSFER_BIT;
+  dependencies[0].srcAccessMask = 0;
+  dependencies[0].dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+  dependencies[0].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+  dependencies[1].srcSubpass = 0;
+  dependencies[1].dstSubpass = VK_SUBPASS_EXTERNAL;
+  dependencies[1].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+  dependencies[1].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+  dependencies[1].dstStageMask = VK_PIPELINE_STAGE_TRANSFER_BIT;
+  dependencies[1].dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+
+  VkRenderPassCreateInfo renderPassInfo{};
+  renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+  renderPassInfo.attachmentCount = 1;
+  renderPassInfo.pAttachments = &colorAttachment;
+  renderPassInfo.subpassCount = 1;
+  renderPassInfo.pSubpasses = &subpass;
+  renderPassInfo.dependencyCount = 2;
+  renderPassInfo.pDependencies = dependencies;
+  return vkCreateRenderPass(app.device, &renderPassInfo, nullptr, &renderPass);
+}
+
+static void destroySceneTarget(Application &app) {
+  DynamicResolution &resolution = app.resolution;
+  vkDestroyFramebuffer(app.device, resolution.framebuffer, nullptr);
+  vkDestroyRenderPass(app.device, resolution.renderPass, nullptr);
+  vkDestroyImageView(app.device, resolution.imageView, nullptr);
+  vkDestroyImage(app.device, resolution.image, nullptr);
+  freeMemory(app, resolution.imageMemory);
+  resolution.framebuffer = VK_NULL_HANDLE;
+  resolution.renderPass = VK_NULL_HANDLE;
+  resolution.imageView = VK_NULL_HANDLE;
+  resolution.image = VK_NULL_HANDLE;
+  resolution.imageMemory = VK_NULL_HANDLE;
+}
+
+/**
+ * Checks that the swapchain can be blitted into and creates the timestamp queries. Dynamic
+ * resolution stays off, with a message, on devices that can't do either. Must be called after
+ * creating the swapchain, since it also sets the scene extent.
+ *
+ * @param app
+ * @return
+ */
+VkResult createDynamicResolution(Application &app) {
+  TRACE_ZONE("createDynamicResolution");
+  DynamicResolution &resolution = app.resolution;
+  resolution.pending.assign(MAX_FRAMES_IN_FLIGHT, 0);
+  if (app.options.dynamicResolutionMs <= 0.0f) {
+    return resizeDynamicResolution(app);
+  }
+  if (!(app.swapChainUsage & VK_IMAGE_USAGE_TRANSFER_DST_BIT)) {
+    logWarning("The swapchain images can't be blitted into, dynamic resolution is off");
+    return resizeDynamicResolution(app);
+  }
+  VkFormatProperties formatProperties;
+  vkGetPhysicalDeviceFormatProperties(app.physicalDevice.device, app.imageFormat, &formatProperties);
+  const VkFormatFeatureFlags needed = VK_FORMAT_FEATURE_COLOR_ATTACHMENT_BIT | VK_FORMAT_FEATURE_BLIT_SRC_BIT |
+                                      VK_FORMAT_FEATURE_BLIT_DST_BIT;
+  if ((formatProperties.optimalTilingFeatures & needed) != needed) {
+    logWarning("The swapchain format can't be blitted, dynamic resolution is off");
+    return resizeDynamicResolution(app);
+  }
+  resolution.filter = (formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT)
+                      ? VK_FILTER_LINEAR : VK_FILTER_NEAREST;
+
+  VkPhysicalDeviceProperties properties;
+  vkGetPhysicalDeviceProperties(app.physicalDevice.device, &properties);
+  uint32_t queueFamilyCount = 0;
+  vkGetPhysicalDeviceQueueFamilyProperties(app.physicalDevice.device, &queueFamilyCount, nullptr);
+  std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
+  vkGetPhysicalDeviceQueueFamilyProperties(app.physicalDevice.device, &queueFamilyCount, queueFamilies.data());
+  uint32_t validBits = queueFamilies[app.physicalDevice.graphicsQueueFamilyIdx].timestampValidBits;
+  if (validBits == 0) {
+    logWarning("The graphics queue has no timestamps, dynamic resolution is off");
+    return resizeDynamicResolution(app);
+  }
+  resolution.timestampMask = validBits >= 64 ? UINT64_MAX : (1ull << validBits) - 1;
+  resolution.millisPerTick = static_cast<double>(properties.limits.timestampPeriod) / 1.0e6;
+
+  VkQueryPoolCreateInfo poolInfo{};
+  poolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+  poolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+  poolInfo.queryCount = 2 * MAX_FRAMES_IN_FLIGHT;
+  VkResult errorCode = vkCreateQueryPool(app.device, &poolInfo, nullptr, &resolution.queryPool);
+  if (errorCode != VK_SUCCESS) {
+    logError("Unable to create the frame time query pool");
+    return errorCode;
+  }
+  resolution.enabled = true;
+  logInfo("Dynamic resolution with a GPU frame time target of {} ms, scaling down to {}%", app.options.dynamicResolutionMs,
+          100.0f * app.options.minResolutionScale);
+  return resizeDynamicResolution(app);
+}
+
+/**
+ * (Re)creates the offscreen image for the current swapchain extent and format and sets the
+ * scene extent, which is the swapchain extent when dynamic resolution is off. The device must
+ * be idle.
+ *
+ * @param app
+ * @return
+ */
+VkResult resizeDynamicResolution(Application &app) {
+  DynamicResolution &resolution = app.resolution;
+  app.sceneExtent = scaledExtent(app.swapChainExtent, resolution.scale);
+  if (!resolution.enabled) {
+    return VK_SUCCESS;
+  }
+  destroySceneTarget(app);
+  VkResult errorCode = createImage(app, app.swapChainExtent.width, app.swapChainExtent.height, app.imageFormat,
+                                   VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT,
+                                   MEMORY_ATTACHMENTS, resolution.image, resolution.imageMemory);
+  returnOnError(errorCode)
+  errorCode = createImageView(app, resolution.image, app.imageFormat, VK_IMAGE_ASPECT_COLOR_BIT, resolution.imageView);
+  returnOnError(errorCode)
+  errorCode = createSceneRenderPass(app, resolution.renderPass);
+  returnOnError(errorCode)
+
+  VkFramebufferCreateInfo framebufferInfo{};
+  framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+  framebufferInfo.renderPass = resolution.renderPass;
+  framebufferInfo.attachmentCount = 1;
+  framebufferInfo.pAttachments = &resolution.imageView;
+  framebufferInfo.width = app.swapChainExtent.width;
+  framebufferInfo.height = app.swapChainExtent.height;
+  framebufferInfo.layers = 1;
+  return vkCreateFramebuffer(app.device, &framebufferInfo, nullptr, &resolution.framebuffer);
+}
+
+/**
+ * Feeds the GPU time of the frame that used the current fence before into the controller and
+ * changes the scale when it has been over or under budget for long enough. The cost of the scene
+ * grows with its pixels, so the new scale aims for the middle of the band by the square root of
+ * the ratio. Must only be called after waiting for the frame's fence.
+ *
+ * @param app
+ */
+void updateDynamicResolution(Application &app) {
+  DynamicResolution &resolution = app.resolution;
+  if (!resolution.enabled || !resolution.pending[app.currentFrame]) {
+    return;
+  }
+  resolution.pending[app.currentFrame] = 0;
+  uint64_t timestamps[2];
+  VkResult errorCode = vkGetQueryPoolResults(app.device, resolution.queryPool, 2 * static_cast<uint32_t>(app.currentFrame), 2,
+                                             sizeof(timestamps), timestamps, sizeof(uint64_t), VK_QUERY_RESULT_64_BIT);
+  if (errorCode != VK_SUCCESS) {
+    return;
+  }
+  resolution.lastMs = static_cast<double>((timestamps[1] - timestamps[0]) & resolution.timestampMask) * resolution.millisPerTick;
+  resolution.smoothedMs = resolution.frames == 0 ? resolution.lastMs
+                                                 : resolution.smoothedMs + RESOLUTION_SMOOTHING * (resolution.lastMs - resolution.smoothedMs);
+  resolution.frames++;
+  resolution.scaleSum += resolution.scale;
+  if (resolution.cooldown > 0) {
+    resolution.cooldown--;
+    return;
+  }
+
+  const double target = app.options.dynamicResolutionMs;
+  if (resolution.smoothedMs > target * RESOLUTION_OVER_BUDGET) {
+    resolution.framesOver++;
+    resolution.framesUnder = 0;
+  } else if (resolution.smoothedMs < target * RESOLUTION_UNDER_BUDGET) {
+    resolution.framesUnder++;
+    resolution.framesOver = 0;
+  } else {
+    resolution.framesOver = 0;
+    resolution.framesUnder = 0;
+  }
+  if (resolution.framesOver < RESOLUTION_DROP_FRAMES && resolution.framesUnder < RESOLUTION_RAISE_FRAMES) {
+    return;
+  }
+  resolution.framesOver = 0;
+  resolution.framesUnder = 0;
+
+  const double middle = target * 0.5 * (RESOLUTION_OVER_BUDGET + RESOLUTION_UNDER_BUDGET);
+  float scale = resolution.scale * static_cast<float>(std::sqrt(middle / std::max(resolution.smoothedMs, 0.01)));
+  scale = std::min(scale, resolution.scale + RESOLUTION_MAX_RAISE);
+  scale = std::round(scale / RESOLUTION_STEP) * RESOLUTION_STEP;
+  scale = std::min(std::max(scale, app.options.minResolutionScale), 1.0f);
+  if (std::fabs(scale - resolution.scale) < 0.5f * RESOLUTION_STEP) {
+    return; // already at the limit
+  }
+  resolution.history.push_back({resolution.frames, scale, resolution.smoothedMs});
+  // expect the time of the new scale right away instead of smoothing it in from the old one
+  resolution.smoothedMs *= static_cast<double>(scale * scale) / (resolution.scale * resolution.scale);
+  resolution.scale = scale;
+  resolution.cooldown = RESOLUTION_COOLDOWN_FRAMES;
+  app.sceneExtent = scaledExtent(app.swapChainExtent, scale);
+  logInfo("Scene resolution {}x{} ({} of the window), GPU frame time was {} ms for a target of {} ms",
+          app.sceneExtent.width, app.sceneExtent.height, scale, resolution.history.back().gpuMs, target);
+}
+
+/**
+ * Resets the frame's queries and writes the start timestamp. The barrier in front makes the
+ * timestamp wait for the acquired image like the scene does, so time spent waiting for vsync is
+ * not counted as GPU time. Records outside of a render pass, before anything else.
+ *
+ * @param app
+ * @param commandBuffer
+ */
+void beginDynamicResolutionFrame(Application &app, VkCommandBuffer commandBuffer) {
+  DynamicResolution &resolution = app.resolution;
+  if (!resolution.enabled) {
+    return;
+  }
+  const auto query = 2 * static_cast<uint32_t>(app.currentFrame);
+  vkCmdResetQueryPool(commandBuffer, resolution.queryPool, query, 2);
+  vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+                       0, 0, nullptr, 0, nullptr, 0, nullptr);
+  vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, resolution.queryPool, query);
+}
+
+/**
+ * Blits the scene from the offscreen image to the whole swapchain image and leaves that in the
+ * layout the overlay render pass and the frame capture expect.
+ *
+ * @param app
+ * @param commandBuffer
+ * @param imageIndex
+ */
+void recordUpscale(Application &app, VkCommandBuffer commandBuffer, uint32_t imageIndex) {
+  DynamicResolution &resolution = app.resolution;
+  VkImageMemoryBarrier toTransfer{};
+  toTransfer.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+  toTransfer.srcAccessMask = 0;
+  toTransfer.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+  toTransfer.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED; // the blit covers the whole image
+  toTransfer.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+  toTransfer.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  toTransfer.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  toTransfer.image = app.swapChainImages[imageIndex];
+  toTransfer.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
+  // chains with the wait for the image available semaphore, which is on the color attachment output stage
+  vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+                       0, nullptr, 0, nullptr, 1, &toTransfer);
+
+  VkImageBlit region{};
+  region.srcSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1};
+  region.srcOffsets[1] = {static_cast<int32_t>(app.sceneExtent.width), static_cast<int32_t>(app.sceneExtent.height), 1};
+  region.dstSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1};
+  region.dstOffsets[1] = {static_cast<int32_t>(app.swapChainExtent.width), static_cast<int32_t>(app.swapChainExtent.height), 1};
+  vkCmdBlitImage(commandBuffer, resolution.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, app.swapChainImages[imageIndex],
+                 VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region, resolution.filter);
+
+  VkImageMemoryBarrier toPresent = toTransfer;
+  toPresent.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+  toPresent.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_TRANSFER_READ_BIT;
+  toPresent.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+  toPresent.newLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+  vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                       VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+                       0, nullptr, 0, nullptr, 1, &toPresent);
+}
+
+/**
+ * Writes the end timestamp, after everything else the frame command buffer records.
+ *
+ * @param app
+ * @param commandBuffer
+ */
+void endDynamicResolutionFrame(Application &app, VkCommandBuffer commandBuffer) {
+  DynamicResolution &resolution = app.resolution;
+  if (!resolution.enabled) {
+    return;
+  }
+  vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, resolution.queryPool,
+                      2 * static_cast<uint32_t>(app.currentFrame) + 1);
+  resolution.pending[app.currentFrame] = 1;
+}
+
+/**
+ * Prints the target, the average scale and every change, and writes the changes as CSV into
+ * Options::resolutionHistoryFile if one was given.
+ *
+ * @param app
+ */
+void printResolutionHistory(Application &app) {
+  DynamicResolution &resolution = app.resolution;
+  if (!resolution.enabled || resolution.frames == 0) {
+    return;
+  }
+  logInfo("Dynamic resolution: target {} ms, smoothed GPU frame time {} ms, average scale {}% over {} frames, {} changes",
+          app.options.dynamicResolutionMs, resolution.smoothedMs, 100.0 * resolution.scaleSum / resolution.frames,
+          resolution.frames, resolution.history.size());
+  for (const auto &change : resolution.history) {
+    logInfo("  frame {}: {}% after {} ms", change.frame, 100.0f * change.scale, change.gpuMs);
+  }
+  if (app.options.resolutionHistoryFile.empty()) {
+    return;
+  }
+  std::ofstream file(app.options.resolutionHistoryFile);
+  if (!file) {
+    logError("Unable to write {}", app.options.resolutionHistoryFile);
+    return;
+  }
+  file << "frame,scale,width,height,gpu_ms,target_ms" << std::endl;
+  for (const auto &change : resolution.history) {
+    const VkExtent2D extent = scaledExtent(app.swapChainExtent, change.scale);
+    file << change.frame << ',' << change.scale << ',' << extent.width << ',' << extent.height << ','
+         << change.gpuMs << ',' << app.options.dynamicResolutionMs << std::endl;
+  }
+}
+
+void destroyDynamicResolution(Application &app) {
+  destroySceneTarget(app);
+  vkDestroyQueryPool(app.device, app.resolution.queryPool, nullptr);
+  app.resolution.queryPool = VK_NULL_HANDLE;
+}
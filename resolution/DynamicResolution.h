@@ -0,0 +1,57 @@
+#ifndef VULKANDEMO_DYNAMICRESOLUTION_H
+#define VULKANDEMO_DYNAMICRESOLUTION_H
+
+#include <cstdint>
+#include <vector>
+#include "../dispatch/Dispatch.h"
+
+struct Application;
+
+typedef struct ResolutionChange {
+    uint64_t frame;
+    float scale;
+    double gpuMs; // smoothed GPU frame time that caused the change
+} ResolutionChange;
+
+/**
+ * Renders the scene into an offscreen image at a fraction of the swapchain resolution and blits
+ * it up to the swapchain image, where the overlay pass then draws the sprites at native resolution.
+ * The fraction follows the GPU time of the frame command buffers, measured with timestamps: it
+ * drops once frames stay over Options::dynamicResolutionMs for a few frames and rises again once
+ * they stay well below for a second. The image has the full swapchain size, a change of the
+ * scale only changes the render area.
+ */
+typedef struct DynamicResolution {
+    bool enabled = false;
+    VkImage image = VK_NULL_HANDLE;
+    VkDeviceMemory imageMemory = VK_NULL_HANDLE;
+    VkImageView imageView = VK_NULL_HANDLE;
+    VkRenderPass renderPass = VK_NULL_HANDLE; // compatible with the main one, leaves the image ready for the blit
+    VkFramebuffer framebuffer = VK_NULL_HANDLE;
+    VkFilter filter = VK_FILTER_LINEAR; // nearest if the format can't be filtered
+    VkQueryPool queryPool = VK_NULL_HANDLE; // start and end of the command buffer of every frame in flight
+    double millisPerTick = 0.0;
+    uint64_t timestampMask = 0;
+    std::vector<uint8_t> pending; // per frame in flight, timestamps written but not read back yet
+
+    // controller
+    float scale = 1.0f;
+    double lastMs = 0.0;
+    double smoothedMs = 0.0;
+    uint32_t framesOver = 0; // in a row
+    uint32_t framesUnder = 0;
+    uint32_t cooldown = 0; // frames to ignore after a change, they were recorded at the old scale
+    uint64_t frames = 0;
+    double scaleSum = 0.0;
+    std::vector<ResolutionChange> history;
+} DynamicResolution;
+
+VkResult createDynamicResolution(Application &app);
+VkResult resizeDynamicResolution(Application &app);
+void updateDynamicResolution(Application &app);
+void beginDynamicResolutionFrame(Application &app, VkCommandBuffer commandBuffer);
+void recordUpscale(Application &app, VkCommandBuffer commandBuffer, uint32_t imageIndex);
+void endDynamicResolutionFrame(Application &app, VkCommandBuffer commandBuffer);
+void printResolutionHistory(Application &app);
+void destroyDynamicResolution(Application &app);
+#endif //VULKANDEMO_DYNAMICRESOLUTION_H
@@ -0,0 +1,270 @@
+#include "SceneGraph.h"
+#include "glm/gtc/type_ptr.hpp"
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define SCENE_GRAPH_SSE
+#endif
+
+/**
+ * out = a * b for column major matrices. Each column of the result is the sum of the columns
+ * of a weighted by one column of b, which maps onto four multiplies and three adds of whole
+ * columns. out must not alias a or b.
+ */
+static inline void multiplyMatrices(const glm::mat4 &a, const glm::mat4 &b, glm::mat4 &out, bool simd) {
+#ifdef SCENE_GRAPH_SSE
+  if (simd) {
+    const float *left = glm::value_ptr(a);
+    const float *right = glm::value_ptr(b);
+    float *result = glm::value_ptr(out);
+    const __m128 a0 = _mm_loadu_ps(left);
+    const __m128 a1 = _mm_loadu_ps(left + 4);
+    const __m128 a2 = _mm_loadu_ps(left + 8);
+    const __m128 a3 = _mm_loadu_ps(left + 12);
+    for (int column = 0; column < 4; ++column) {
+      const float *weights = right + column * 4;
+      __m128 sum = _mm_mul_ps(a0, _mm_set1_ps(weights[0]));
+      sum = _mm_add_ps(sum, _mm_mul_ps(a1, _mm_set1_ps(weights[1])));
+      sum = _mm_add_ps(sum, _mm_mul_ps(a2, _mm_set1_ps(weights[2])));
+      sum = _mm_add_ps(sum, _mm_mul_ps(a3, _mm_set1_ps(weights[3])));
+      _mm_storeu_ps(result + column * 4, sum);
+    }
+    return;
+  }
+#endif
+  out = a * b;
+}
+
+/**
+ * Recomputes the world matrix of the node if its local transform or its parent's world matrix
+ * changed. The parent has always been handled before, either earlier in the same segment or
+ * among the top nodes.
+ *
+ * @return whether the world matrix was recomputed
+ */
+static inline bool updateNode(SceneGraph &graph, uint32_t node) {
+  const uint32_t parent = graph.parents[node];
+  const bool parentChanged = parent != SCENE_NO_PARENT && graph.changed[parent];
+  if (!graph.dirty[node] && !parentChanged) {
+    graph.changed[node] = 0;
+    return false;
+  }
+  glm::mat4 local = glm::mat4_cast(graph.rotations[node]);
+  local[0] *= graph.scales[node].x;
+  local[1] *= graph.scales[node].y;
+  local[2] *= graph.scales[node].z;
+  local[3] = glm::vec4(graph.translations[node], 1.0f);
+  if (parent == SCENE_NO_PARENT) {
+    graph.worlds[node] = local;
+  } else {
+    multiplyMatrices(graph.worlds[parent], local, graph.worlds[node], graph.simd);
+  }
+  graph.dirty[node] = 0;
+  graph.changed[node] = 1;
+  return true;
+}
+
+/**
+ * Takes segments of the current update until none are left. Runs on the calling thread and on
+ * every worker.
+ */
+static void processSegments(SceneGraph &graph) {
+  uint64_t updated = 0;
+  for (uint32_t job = graph.nextJob.fetch_add(1); job < graph.jobs.size(); job = graph.nextJob.fetch_add(1)) {
+    const uint32_t segment = graph.jobs[job];
+    for (uint32_t node = graph.segmentBegin[segment]; node < graph.segmentEnd[segment]; ++node) {
+      updated += updateNode(graph, node);
+    }
+  }
+  graph.updatedNodes.fetch_add(updated, std::memory_order_relaxed);
+}
+
+/**
+ * @param graph
+ * @param generation the last update before the worker was started
+ */
+static void sceneWorker(SceneGraph *graph, uint64_t generation) {
+  while (true) {
+    {
+      std::unique_lock<std::mutex> lock(graph->mutex);
+      graph->workAvailable.wait(lock, [graph, generation] { return graph->stopping || graph->generation != generation; });
+      if (graph->stopping) {
+        return;
+      }
+      generation = graph->generation;
+    }
+    processSegments(*graph);
+    {
+      std::lock_guard<std::mutex> lock(graph->mutex);
+      graph->busyWorkers--;
+    }
+    graph->workDone.notify_all();
+  }
+}
+
+/**
+ * Appends a node. Nodes have to be added depth first, i.e. the parent is the previously added
+ * node or one of its ancestors, which buildSceneSegments checks.
+ *
+ * @param graph
+ * @param parent SCENE_NO_PARENT for a root
+ * @param translation
+ * @param rotation
+ * @param scale
+ * @return the index of the node
+ */
+uint32_t addSceneNode(SceneGraph &graph, uint32_t parent, const glm::vec3 &translation, const glm::quat &rotation, const glm::vec3 &scale) {
+  const auto node = static_cast<uint32_t>(graph.parents.size());
+  graph.parents.push_back(parent);
+  graph.translations.push_back(translation);
+  graph.rotations.push_back(rotation);
+  graph.scales.push_back(scale);
+  graph.worlds.emplace_back(1.0f);
+  graph.dirty.push_back(1);
+  graph.changed.push_back(0);
+  graph.segmentOf.push_back(SCENE_NO_PARENT);
+  return node;
+}
+
+/**
+ * Splits the nodes into the top nodes and segments of whole subtrees. Subtrees that follow each
+ * other are grouped into one segment as long as it stays within SCENE_SEGMENT_NODES, since the
+ * leaves below a top node would otherwise become segments of their own. Must be called after
+ * adding nodes and before the next update.
+ *
+ * @param graph
+ * @return false if the nodes were not added depth first
+ */
+bool buildSceneSegments(SceneGraph &graph) {
+  const auto nodeCount = static_cast<uint32_t>(graph.parents.size());
+  std::vector<uint32_t> subtreeSizes(nodeCount, 1);
+  for (uint32_t node = nodeCount; node-- > 0;) {
+    const uint32_t parent = graph.parents[node];
+    if (parent != SCENE_NO_PARENT) {
+      if (parent >= node) {
+        return false;
+      }
+      subtreeSizes[parent] += subtreeSizes[node];
+    }
+  }
+  // depth first exactly when every node lies within the range of its parent's subtree
+  for (uint32_t node = 0; node < nodeCount; ++node) {
+    const uint32_t parent = graph.parents[node];
+    if (parent != SCENE_NO_PARENT && node >= parent + subtreeSizes[parent]) {
+      return false;
+    }
+  }
+
+  graph.topNodes.clear();
+  graph.segmentBegin.clear();
+  graph.segmentEnd.clear();
+  graph.segmentRoots.clear();
+  graph.segmentFirstRoot.clear();
+  for (uint32_t node = 0; node < nodeCount;) {
+    if (subtreeSizes[node] > SCENE_SEGMENT_NODES) {
+      graph.segmentOf[node] = SCENE_NO_PARENT;
+      graph.topNodes.push_back(node++);
+      continue;
+    }
+    const uint32_t end = node + subtreeSizes[node];
+    const bool extend = !graph.segmentEnd.empty() && graph.segmentEnd.back() == node &&
+                        end - graph.segmentBegin.back() <= SCENE_SEGMENT_NODES;
+    if (extend) {
+      graph.segmentEnd.back() = end;
+    } else {
+      graph.segmentFirstRoot.push_back(static_cast<uint32_t>(graph.segmentRoots.size()));
+      graph.segmentBegin.push_back(node);
+      graph.segmentEnd.push_back(end);
+    }
+    graph.segmentRoots.push_back(node);
+    const auto segment = static_cast<uint32_t>(graph.segmentBegin.size() - 1);
+    for (; node < end; ++node) {
+      graph.segmentOf[node] = segment;
+    }
+  }
+  graph.segmentFirstRoot.push_back(static_cast<uint32_t>(graph.segmentRoots.size()));
+  graph.segmentDirty.assign(graph.segmentBegin.size(), 1);
+  graph.jobs.reserve(graph.segmentBegin.size());
+  return true;
+}
+
+void setLocalTransform(SceneGraph &graph, uint32_t node, const glm::vec3 &translation, const glm::quat &rotation, const glm::vec3 &scale) {
+  graph.translations[node] = translation;
+  graph.rotations[node] = rotation;
+  graph.scales[node] = scale;
+  graph.dirty[node] = 1;
+  if (graph.segmentOf[node] != SCENE_NO_PARENT) {
+    graph.segmentDirty[graph.segmentOf[node]] = 1;
+  }
+}
+
+/**
+ * Starts the threads that update segments besides the calling thread.
+ *
+ * @param graph
+ * @param threadCount threads an update uses, including the calling one
+ */
+void startSceneWorkers(SceneGraph &graph, uint32_t threadCount) {
+  stopSceneWorkers(graph);
+  for (uint32_t i = 1; i < threadCount; ++i) {
+    graph.workers.emplace_back(sceneWorker, &graph, graph.generation);
+  }
+}
+
+/**
+ * Brings every world matrix up to date with the local transforms set since the last update.
+ *
+ * @param graph
+ * @return the number of world matrices recomputed
+ */
+uint64_t updateSceneGraph(SceneGraph &graph) {
+  uint64_t updated = 0;
+  for (uint32_t node : graph.topNodes) {
+    updated += updateNode(graph, node);
+  }
+
+  graph.jobs.clear();
+  for (uint32_t segment = 0; segment < graph.segmentBegin.size(); ++segment) {
+    bool needed = graph.segmentDirty[segment] != 0;
+    for (uint32_t root = graph.segmentFirstRoot[segment]; !needed && root < graph.segmentFirstRoot[segment + 1]; ++root) {
+      const uint32_t parent = graph.parents[graph.segmentRoots[root]];
+      needed = parent != SCENE_NO_PARENT && graph.changed[parent];
+    }
+    if (needed) {
+      graph.segmentDirty[segment] = 0;
+      graph.jobs.push_back(segment);
+    }
+  }
+  graph.nextJob = 0;
+  graph.updatedNodes = updated;
+
+  if (graph.workers.empty() || graph.jobs.size() < 2) {
+    processSegments(graph);
+    return graph.updatedNodes.load();
+  }
+  {
+    std::lock_guard<std::mutex> lock(graph.mutex);
+    graph.generation++;
+    graph.busyWorkers = static_cast<uint32_t>(graph.workers.size()); // every worker takes part in every generation
+  }
+  graph.workAvailable.notify_all();
+  processSegments(graph);
+  {
+    std::unique_lock<std::mutex> lock(graph.mutex);
+    graph.workDone.wait(lock, [&graph] { return graph.busyWorkers == 0; });
+  }
+  return graph.updatedNodes.load();
+}
+
+void stopSceneWorkers(SceneGraph &graph) {
+  {
+    std::lock_guard<std::mutex> lock(graph.mutex);
+    graph.stopping = true;
+  }
+  graph.workAvailable.notify_all();
+  for (auto &worker : graph.workers) {
+    worker.join();
+  }
+  graph.workers.clear();
+  graph.stopping = false;
+}
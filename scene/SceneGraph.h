@@ -0,0 +1,64 @@
+#ifndef VULKANDEMO_SCENEGRAPH_H
+#define VULKANDEMO_SCENEGRAPH_H
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "glm/glm.hpp"
+#include "glm/gtc/quaternion.hpp"
+
+const uint32_t SCENE_NO_PARENT = UINT32_MAX;
+const uint32_t SCENE_SEGMENT_NODES = 4096; // subtrees up to this size are updated by one worker as a whole
+
+/**
+ * Transform hierarchy stored as a structure of arrays in depth first order: every parent comes
+ * before its children and every subtree is one contiguous range of nodes. An update is then a
+ * single forward pass in which a node's parent world matrix is always final.
+ *
+ * Subtrees of at most SCENE_SEGMENT_NODES nodes are grouped into segments, the unit of work of
+ * the update threads. The few nodes above them, the top nodes, are updated first on the calling
+ * thread. Segments without a changed local transform whose parents kept their world matrices are
+ * skipped entirely, the others only recompute their nodes below a change.
+ */
+typedef struct SceneGraph {
+    // per node
+    std::vector<uint32_t> parents;
+    std::vector<glm::vec3> translations;
+    std::vector<glm::quat> rotations;
+    std::vector<glm::vec3> scales;
+    std::vector<glm::mat4> worlds;
+    std::vector<uint8_t> dirty; // local transform set since the last update
+    std::vector<uint8_t> changed; // world matrix recomputed by the last update
+    std::vector<uint32_t> segmentOf; // SCENE_NO_PARENT for top nodes
+
+    // built by buildSceneSegments
+    std::vector<uint32_t> topNodes; // ascending, so parents before children
+    std::vector<uint32_t> segmentBegin;
+    std::vector<uint32_t> segmentEnd;
+    std::vector<uint32_t> segmentRoots; // roots of the subtrees grouped into each segment
+    std::vector<uint32_t> segmentFirstRoot; // index into segmentRoots, one more entry than segments
+    std::vector<uint8_t> segmentDirty;
+    bool simd = true; // multiply with SSE where available, the scalar glm path is kept for comparison
+
+    // update threads, the calling thread works on the segments too
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable workAvailable;
+    std::condition_variable workDone;
+    std::vector<uint32_t> jobs; // segments of the current update
+    std::atomic<uint32_t> nextJob{0};
+    std::atomic<uint64_t> updatedNodes{0}; // by the current update
+    uint64_t generation = 0;
+    uint32_t busyWorkers = 0;
+    bool stopping = false;
+} SceneGraph;
+
+uint32_t addSceneNode(SceneGraph &graph, uint32_t parent, const glm::vec3 &translation, const glm::quat &rotation, const glm::vec3 &scale);
+bool buildSceneSegments(SceneGraph &graph);
+void setLocalTransform(SceneGraph &graph, uint32_t node, const glm::vec3 &translation, const glm::quat &rotation, const glm::vec3 &scale);
+void startSceneWorkers(SceneGraph &graph, uint32_t threadCount);
+uint64_t updateSceneGraph(SceneGraph &graph);
+void stopSceneWorkers(SceneGraph &graph);
+#endif //VULKANDEMO_SCENEGRAPH_H
@@ -1,3 +1,14 @@
 C:/VulkanSDK/1.2.154.1/Bin32/glslc.exe vertex_base.vert -o vert.spv
+C:/VulkanSDK/1.2.154.1/Bin32/glslc.exe vertex_octahedral.vert -o vert_octahedral.spv
+C:/VulkanSDK/1.2.154.1/Bin32/glslc.exe vertex_mesh.vert -o vert_mesh.spv
+C:/VulkanSDK/1.2.154.1/Bin32/glslc.exe vertex_instanced.vert -o vert_instanced.spv
 C:/VulkanSDK/1.2.154.1/Bin32/glslc.exe fragment_base.frag -o frag.spv
+C:/VulkanSDK/1.2.154.1/Bin32/glslc.exe fragment_clustered.frag -o frag_clustered.spv
+C:/VulkanSDK/1.2.154.1/Bin32/glslc.exe hzb_reduce.comp -o hzb_reduce.spv
+C:/VulkanSDK/1.2.154.1/Bin32/glslc.exe occlusion_cull.comp -o occlusion_cull.spv
+C:/VulkanSDK/1.2.154.1/Bin32/glslc.exe cluster_lights.comp -o cluster_lights.spv
+C:/VulkanSDK/1.2.154.1/Bin32/glslc.exe vertex_particle.vert -o vert_particle.spv
+C:/VulkanSDK/1.2.154.1/Bin32/glslc.exe particle_simulate.comp -o particle_simulate.spv
+C:/VulkanSDK/1.2.154.1/Bin32/glslc.exe particle_emit.comp -o particle_emit.spv
+C:/VulkanSDK/1.2.154.1/Bin32/glslc.exe particle_finalize.comp -o particle_finalize.spv
 pause
@@ -1,9 +1,48 @@
 #version 450
 #extension GL_ARB_separate_shader_objects : enable
 
+// Specialization constants, described on the C++ side by FragmentFeatures in pipeline/ShaderVariants.h.
+// They are folded when the pipeline is created so the driver strips the branches that depend on them.
+layout(constant_id = 0) const bool USE_VERTEX_COLOR = true;
+layout(constant_id = 1) const int LIGHTING_MODEL = 0; // 0 unlit, 1 procedural point lights
+layout(constant_id = 2) const int SAMPLE_COUNT = 1; // lighting taps per fragment
+layout(constant_id = 3) const bool UBER_SHADER = false; // branch on the push constants instead of the constants above
+
+layout(push_constant) uniform Features {
+    int useVertexColor;
+    int lightingModel;
+    int sampleCount;
+    int uberShader;
+} features;
+
 layout(location = 0) in vec3 fragColor; // input from vertex shader
 layout(location = 0) out vec4 outColor; // location specifies the index of the framebuffer
 
+const int LIGHT_COUNT = 4;
+
+vec3 pointLights(vec2 position) {
+    vec3 light = vec3(0.0);
+    for (int i = 0; i < LIGHT_COUNT; ++i) {
+        vec2 lightPosition = vec2(160.0 + 160.0 * float(i), 200.0 + 200.0 * float(i & 1));
+        float distance = length(position - lightPosition);
+        light += vec3(1.0, 0.9, 0.8) * (80.0 / (80.0 + distance));
+    }
+    return light;
+}
+
 void main() {
-    outColor = vec4(fragColor, 1.0);
+    bool useVertexColor = UBER_SHADER ? features.useVertexColor != 0 : USE_VERTEX_COLOR;
+    int lightingModel = UBER_SHADER ? features.lightingModel : LIGHTING_MODEL;
+    int sampleCount = UBER_SHADER ? features.sampleCount : SAMPLE_COUNT;
+
+    vec3 color = useVertexColor ? fragColor : vec3(1.0);
+    if (lightingModel == 1) {
+        vec3 light = vec3(0.0);
+        for (int s = 0; s < sampleCount; ++s) {
+            vec2 offset = vec2(float(s) + 0.5) / float(sampleCount) - 0.5;
+            light += pointLights(gl_FragCoord.xy + offset);
+        }
+        color *= light / float(sampleCount);
+    }
+    outColor = vec4(color, 1.0);
 }
@@ -0,0 +1,55 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+// Clustered forward shading. The fragment finds its cluster in the grid cluster_lights.comp
+// binned the lights into and only evaluates the lights listed there. The constant ids match
+// FragmentFeatures in pipeline/ShaderVariants.h, the sample count and uber-shader switch don't apply.
+layout(constant_id = 0) const bool USE_VERTEX_COLOR = true;
+layout(constant_id = 1) const int LIGHTING_MODEL = 2; // 2 the lights of the fragment's cluster, 3 every light
+
+const uvec3 GRID = uvec3(16, 9, 24);
+const uint MAX_LIGHTS_PER_CLUSTER = 256;
+const vec3 AMBIENT = vec3(0.08);
+
+struct PointLight {
+    vec4 positionRadius; // in pixels
+    vec4 color; // rgb and intensity
+};
+
+layout(std430, set = 0, binding = 0) readonly buffer Lights {
+    vec2 viewportSize;
+    float depth;
+    uint lightCount;
+    PointLight lights[];
+};
+layout(std430, set = 0, binding = 1) readonly buffer Counts { uint counts[]; };
+layout(std430, set = 0, binding = 2) readonly buffer Indices { uint indices[]; };
+
+layout(location = 0) in vec3 fragColor; // input from vertex shader
+layout(location = 0) out vec4 outColor;
+
+vec3 shade(PointLight light, vec3 position) {
+    float falloff = max(1.0 - length(light.positionRadius.xyz - position) / light.positionRadius.w, 0.0);
+    return light.color.rgb * (light.color.a * falloff * falloff);
+}
+
+void main() {
+    // the fragment's position in the lit box, whose depth spans the depth range
+    vec3 position = vec3(gl_FragCoord.xy, gl_FragCoord.z * depth);
+    vec3 light = AMBIENT;
+    if (LIGHTING_MODEL == 3) {
+        for (uint i = 0u; i < lightCount; ++i) {
+            light += shade(lights[i], position);
+        }
+    } else {
+        // window views and the edges of the viewport clamp into the grid
+        ivec3 cell = clamp(ivec3(position * vec3(GRID) / vec3(viewportSize, depth)), ivec3(0), ivec3(GRID) - 1);
+        uint cluster = (uint(cell.z) * GRID.y + uint(cell.y)) * GRID.x + uint(cell.x);
+        uint count = min(counts[cluster], MAX_LIGHTS_PER_CLUSTER);
+        for (uint i = 0u; i < count; ++i) {
+            light += shade(lights[indices[cluster * MAX_LIGHTS_PER_CLUSTER + i]], position);
+        }
+    }
+    vec3 color = USE_VERTEX_COLOR ? fragColor : vec3(1.0);
+    outColor = vec4(color * light, 1.0);
+}
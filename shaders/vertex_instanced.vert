@@ -0,0 +1,19 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+layout(location = 0) in vec2 inPosition;
+layout(location = 1) in vec3 inColor;
+// ObjectInstance in buffers/Vertex.h, once per instance: center, radius in half viewport heights, depth
+layout(location = 2) in vec4 inBounds;
+layout(location = 0) out vec3 fragColor;
+
+// MeshTransform in mesh/LodScene.h, the scale corrects the aspect ratio
+layout(push_constant) uniform MeshTransform {
+    layout(offset = 16) vec2 offset;
+    vec2 scale;
+} transform;
+
+void main() {
+    gl_Position = vec4(inBounds.xy + inPosition * inBounds.z * transform.scale + transform.offset, inBounds.w, 1.0);
+    fragColor = inColor;
+}
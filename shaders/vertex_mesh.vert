@@ -0,0 +1,17 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+layout(location = 0) in vec2 inPosition;
+layout(location = 1) in vec3 inColor;
+layout(location = 0) out vec3 fragColor;
+
+// MeshTransform in mesh/LodScene.h, after the fragment stage's FragmentFeatures
+layout(push_constant) uniform MeshTransform {
+    layout(offset = 16) vec2 offset;
+    vec2 scale;
+} transform;
+
+void main() {
+    gl_Position = vec4(inPosition * transform.scale + transform.offset, 0.0, 1.0);
+    fragColor = inColor;
+}
@@ -0,0 +1,23 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+layout(location = 0) in vec2 inPosition; // R16G16_SFLOAT
+layout(location = 1) in vec3 inColor; // R8G8B8A8_UNORM, alpha unused
+layout(location = 2) in vec2 inNormal; // R16G16_SNORM octahedral encoding
+layout(location = 0) out vec3 fragColor;
+
+const vec3 lightDirection = vec3(0.26726, -0.53452, 0.80178);
+
+// inverse of encodeOctahedral in buffers/VertexLayout.cpp
+vec3 decodeOctahedral(vec2 encoded) {
+    vec3 normal = vec3(encoded, 1.0 - abs(encoded.x) - abs(encoded.y));
+    float fold = max(-normal.z, 0.0);
+    normal.x += normal.x >= 0.0 ? -fold : fold;
+    normal.y += normal.y >= 0.0 ? -fold : fold;
+    return normalize(normal);
+}
+
+void main() {
+    gl_Position = vec4(inPosition, 0.0, 1.0);
+    fragColor = inColor * (0.2 + 0.8 * max(dot(decodeOctahedral(inNormal), lightDirection), 0.0));
+}
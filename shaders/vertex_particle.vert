@@ -0,0 +1,21 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+layout(location = 0) in vec2 inPosition;
+layout(location = 1) in vec3 inColor;
+// Particle in buffers/Vertex.h, once per instance
+layout(location = 2) in vec4 inPositionVelocity;
+layout(location = 3) in vec4 inColorLife; // rgb and seconds left
+layout(location = 0) out vec3 fragColor;
+
+// MeshTransform in mesh/LodScene.h, the scale is the half size of a particle
+layout(push_constant) uniform MeshTransform {
+    layout(offset = 16) vec2 offset;
+    vec2 scale;
+} transform;
+
+void main() {
+    gl_Position = vec4(inPositionVelocity.xy + inPosition * transform.scale + transform.offset, 0.0, 1.0);
+    // fades out over the last second
+    fragColor = inColor * inColorLife.rgb * clamp(inColorLife.w, 0.0, 1.0);
+}
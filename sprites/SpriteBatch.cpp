@@ -0,0 +1,186 @@
+#include <cmath>
+#include <cstring>
+#include "SpriteBatch.h"
+#include "../Application.h"
+#include "../buffers/Vertex.h"
+#include "../pipeline/GraphicsPipeline.h"
+
+static_assert(sizeof(SpriteVertex) == sizeof(Vertex), "Sprites are drawn with the Vertex input layout");
+
+const VkDeviceSize SPRITE_PARTITION_SIZE = sizeof(SpriteVertex) * 4 * MAX_SPRITES_PER_FRAME;
+
+/**
+ * Creates the vertex ring and the index buffer. The ring lives in host visible, coherent memory and
+ * stays mapped for the lifetime of the batcher, so writing a sprite is a plain memory write.
+ *
+ * @param app
+ * @return
+ */
+VkResult createSpriteBatcher(Application &app) {
+  TRACE_ZONE("createSpriteBatcher");
+  SpriteBatcher &batcher = app.sprites;
+  VkResult errorCode = createBuffer(app, SPRITE_PARTITION_SIZE * MAX_FRAMES_IN_FLIGHT, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+                                    VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                                    MEMORY_GEOMETRY, batcher.vertexBuffer, batcher.vertexBufferMemory);
+  throwOnError(errorCode, "Unable to create sprite vertex ring")
+  {
+    void *data;
+    errorCode = vkMapMemory(app.device, batcher.vertexBufferMemory, 0, VK_WHOLE_SIZE, 0, &data);
+    throwOnError(errorCode, "Unable to map sprite vertex ring")
+    batcher.vertices = static_cast<SpriteVertex *>(data);
+  }
+
+  {
+    const VkDeviceSize indexSize = sizeof(uint32_t) * 6 * MAX_SPRITES_PER_FRAME;
+    errorCode = createBuffer(app, indexSize, VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
+                             VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                             MEMORY_GEOMETRY, batcher.indexBuffer, batcher.indexBufferMemory);
+    throwOnError(errorCode, "Unable to create sprite index buffer")
+    void *data;
+    errorCode = vkMapMemory(app.device, batcher.indexBufferMemory, 0, indexSize, 0, &data);
+    throwOnError(errorCode, "Unable to map sprite index buffer")
+    auto indices = static_cast<uint32_t *>(data);
+    for (uint32_t quad = 0; quad < MAX_SPRITES_PER_FRAME; ++quad) {
+      const uint32_t base = quad * 4;
+      const uint32_t quadIndices[6] = {base, base + 1, base + 2, base + 2, base + 3, base};
+      memcpy(indices + quad * 6, quadIndices, sizeof(quadIndices));
+    }
+    vkUnmapMemory(app.device, batcher.indexBufferMemory);
+  }
+
+  error:
+  return errorCode;
+}
+
+/**
+ * Starts a new batch in the partition of the current frame. Must be called on the render thread
+ * after waiting for the frame's fence, which guarantees the GPU is done reading the partition.
+ *
+ * @param app
+ */
+void beginSprites(Application &app) {
+  SpriteBatcher &batcher = app.sprites;
+  batcher.partition = static_cast<uint32_t>(app.currentFrame);
+  batcher.spriteCount = 0;
+  batcher.draws.clear();
+  batcher.pixelToNdc = glm::vec2(2.0f / app.swapChainExtent.width, 2.0f / app.swapChainExtent.height);
+}
+
+/**
+ * Appends a sprite to the current batch. Sprites beyond MAX_SPRITES_PER_FRAME are dropped.
+ *
+ * @param app
+ * @param pipeline
+ * @param sprite
+ */
+void drawSprite(Application &app, VkPipeline pipeline, const Sprite &sprite) {
+  SpriteBatcher &batcher = app.sprites;
+  if (batcher.spriteCount == MAX_SPRITES_PER_FRAME) {
+    batcher.droppedSprites++;
+    return;
+  }
+  if (batcher.draws.empty() || batcher.draws.back().pipeline != pipeline) {
+    batcher.draws.push_back({pipeline, batcher.spriteCount, 0});
+  }
+  batcher.draws.back().spriteCount++;
+
+  const glm::vec2 halfSize = sprite.size * 0.5f;
+  const glm::vec2 min = (sprite.position - halfSize) * batcher.pixelToNdc - glm::vec2(1.0f);
+  const glm::vec2 max = (sprite.position + halfSize) * batcher.pixelToNdc - glm::vec2(1.0f);
+  // the ring is write combined memory, so write each vertex once and in order
+  SpriteVertex *vertex = batcher.vertices + (static_cast<size_t>(batcher.partition) * MAX_SPRITES_PER_FRAME + batcher.spriteCount) * 4;
+  vertex[0] = {{min.x, min.y}, sprite.color};
+  vertex[1] = {{max.x, min.y}, sprite.color};
+  vertex[2] = {{max.x, max.y}, sprite.color};
+  vertex[3] = {{min.x, max.y}, sprite.color};
+  batcher.spriteCount++;
+}
+
+/**
+ * Identifies the commands recordSprites would record for the current batch. The vertices are not
+ * part of it, a batch with the same draws in the same partition records identical commands.
+ *
+ * @param app
+ * @return
+ */
+uint64_t spriteSignature(const Application &app) {
+  const SpriteBatcher &batcher = app.sprites;
+  uint64_t hash = 14695981039346656037ull; // FNV-1a
+  auto mix = [&hash](uint64_t value) {
+    hash ^= value;
+    hash *= 1099511628211ull;
+  };
+  mix(batcher.partition);
+  mix(static_cast<uint64_t>(app.swapChainExtent.width) << 32 | app.swapChainExtent.height);
+  for (const auto &draw : batcher.draws) {
+    mix((uint64_t) draw.pipeline);
+    mix(static_cast<uint64_t>(draw.firstSprite) << 32 | draw.spriteCount);
+  }
+  return hash;
+}
+
+/**
+ * Records the draws of the batch. Runs inside the overlay render pass, which loads the color
+ * attachment instead of clearing it, so sprites end up on top of the scene.
+ *
+ * @param app
+ * @param commandBuffer
+ */
+void recordSprites(Application &app, VkCommandBuffer commandBuffer) {
+  SpriteBatcher &batcher = app.sprites;
+  VkViewport viewport{0.0f, 0.0f, (float) app.swapChainExtent.width, (float) app.swapChainExtent.height, 0.0f, 1.0f};
+  VkRect2D scissor{{0, 0}, app.swapChainExtent};
+  vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+  vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+  VkDeviceSize offset = 0;
+  vkCmdBindVertexBuffers(commandBuffer, 0, 1, &batcher.vertexBuffer, &offset);
+  vkCmdBindIndexBuffer(commandBuffer, batcher.indexBuffer, 0, VK_INDEX_TYPE_UINT32);
+
+  const int32_t partitionBase = static_cast<int32_t>(batcher.partition * MAX_SPRITES_PER_FRAME * 4);
+  VkPipeline boundPipeline = VK_NULL_HANDLE;
+  for (const auto &draw : batcher.draws) {
+    if (draw.pipeline != boundPipeline) {
+      vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, draw.pipeline);
+      boundPipeline = draw.pipeline;
+    }
+    // every quad uses indices 0-5 shifted by its first vertex, so the vertex offset selects the sprites
+    vkCmdDrawIndexed(commandBuffer, draw.spriteCount * 6, 1, 0, partitionBase + static_cast<int32_t>(draw.firstSprite * 4), 0);
+  }
+}
+
+void destroySpriteBatcher(Application &app) {
+  SpriteBatcher &batcher = app.sprites;
+  if (batcher.vertices != nullptr) {
+    vkUnmapMemory(app.device, batcher.vertexBufferMemory);
+    batcher.vertices = nullptr;
+  }
+  vkDestroyBuffer(app.device, batcher.vertexBuffer, nullptr);
+  freeMemory(app, batcher.vertexBufferMemory);
+  vkDestroyBuffer(app.device, batcher.indexBuffer, nullptr);
+  freeMemory(app, batcher.indexBufferMemory);
+  if (batcher.droppedSprites > 0) {
+    logWarning("Sprite batcher dropped {} sprites over the per frame limit of {}", batcher.droppedSprites, MAX_SPRITES_PER_FRAME);
+  }
+}
+
+/**
+ * Stand-in for the UI and annotation layers: a field of sprites drifting across the window.
+ *
+ * @param app
+ * @param count
+ * @param time seconds
+ */
+void drawDemoSprites(Application &app, uint32_t count, float time) {
+  VkPipeline pipeline = requestPipeline(app, spritePipelineKey(app));
+  const float width = static_cast<float>(app.swapChainExtent.width);
+  const float height = static_cast<float>(app.swapChainExtent.height);
+  for (uint32_t i = 0; i < count; ++i) {
+    const float seed = static_cast<float>(i) * 0.618034f;
+    Sprite sprite;
+    sprite.position = glm::vec2(std::fmod(seed * 97.0f + time * (20.0f + std::fmod(seed * 13.0f, 40.0f)), width),
+                                std::fmod(seed * 61.0f + 30.0f * std::sin(time + seed), height));
+    sprite.size = glm::vec2(4.0f + std::fmod(seed * 7.0f, 8.0f));
+    sprite.color = glm::vec3(std::fmod(seed, 1.0f), std::fmod(seed * 3.0f, 1.0f), 1.0f);
+    drawSprite(app, pipeline, sprite);
+  }
+}
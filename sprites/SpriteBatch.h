@@ -0,0 +1,56 @@
+#ifndef VULKANDEMO_SPRITEBATCH_H
+#define VULKANDEMO_SPRITEBATCH_H
+
+#include <vector>
+#include "glm/glm.hpp"
+#include "../dispatch/Dispatch.h"
+
+struct Application;
+
+const uint32_t MAX_SPRITES_PER_FRAME = 65536;
+
+typedef struct Sprite {
+    glm::vec2 position; // center, in pixels from the top left corner
+    glm::vec2 size; // in pixels
+    glm::vec3 color;
+} Sprite;
+
+typedef struct SpriteVertex {
+    glm::vec2 pos;
+    glm::vec3 color;
+} SpriteVertex; // same layout as Vertex, so sprites can use the scene pipelines
+
+typedef struct SpriteDraw {
+    VkPipeline pipeline;
+    uint32_t firstSprite;
+    uint32_t spriteCount;
+} SpriteDraw;
+
+/**
+ * Immediate mode sprite batching. Sprites are written straight into a persistently mapped vertex
+ * buffer that is split into one partition per frame in flight. A partition is only written after
+ * the fence of its frame has been waited on, so the CPU never has to synchronize with the GPU
+ * reading the other partitions. Consecutive sprites with the same pipeline share a draw.
+ */
+typedef struct SpriteBatcher {
+    VkBuffer vertexBuffer = VK_NULL_HANDLE;
+    VkDeviceMemory vertexBufferMemory = VK_NULL_HANDLE;
+    SpriteVertex *vertices = nullptr; // persistently mapped, MAX_FRAMES_IN_FLIGHT partitions
+    VkBuffer indexBuffer = VK_NULL_HANDLE; // the same two triangles per quad, shared by all partitions
+    VkDeviceMemory indexBufferMemory = VK_NULL_HANDLE;
+
+    uint32_t partition = 0;
+    uint32_t spriteCount = 0;
+    std::vector<SpriteDraw> draws;
+    glm::vec2 pixelToNdc{0.0f};
+    uint64_t droppedSprites = 0;
+} SpriteBatcher;
+
+VkResult createSpriteBatcher(Application &app);
+void beginSprites(Application &app);
+void drawSprite(Application &app, VkPipeline pipeline, const Sprite &sprite);
+uint64_t spriteSignature(const Application &app);
+void recordSprites(Application &app, VkCommandBuffer commandBuffer);
+void destroySpriteBatcher(Application &app);
+void drawDemoSprites(Application &app, uint32_t count, float time);
+#endif //VULKANDEMO_SPRITEBATCH_H
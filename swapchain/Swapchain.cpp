@@ -45,13 +45,20 @@ VkPresentModeKHR chooseSwapPresentMode(const std::vector<VkPresentModeKHR> &avai
   return VK_PRESENT_MODE_FIFO_KHR;
 }
 
-VkExtent2D chooseSwapExtent(GLFWwindow *window, const VkSurfaceCapabilitiesKHR &capabilities) {
+/**
+ * Picks the swapchain extent. The framebuffer size is passed in from the values published by the
+ * GLFW resize callback since glfwGetFramebufferSize may only be called from the main thread
+ * and the swapchain is recreated on the render thread.
+ *
+ * @param width
+ * @param height
+ * @param capabilities
+ * @return
+ */
+VkExtent2D chooseSwapExtent(int width, int height, const VkSurfaceCapabilitiesKHR &capabilities) {
   if (capabilities.currentExtent.width != UINT32_MAX) {
     return capabilities.currentExtent;
   } else {
-    int width, height;
-    glfwGetFramebufferSize(window, &width, &height);
-
     VkExtent2D actualExtent = {
         static_cast<uint32_t>(width),
         static_cast<uint32_t>(height)
@@ -111,21 +118,42 @@ bool checkSwapChainSupport(VkPhysicalDevice device, VkSurfaceKHR surface) {
 }
 
 /**
- * Creates the swapchain with our preferred format and presentation mode as well as
- * the VkExtent2D size that best matches the window.
- * 
+ * The format createSwapChain will pick for the surface. Everything that only depends on the
+ * format, i.e. render passes and pipelines, can be created from it before the swapchain exists.
+ *
  * @param app
+ * @return
  */
-VkResult createSwapChain(Application &app) {
+VkFormat querySwapChainFormat(const Application &app) {
+  return chooseSwapSurfaceFormat(getFormatsAndPresentationModes(app.physicalDevice.device, app.surface).first).format;
+}
+
+/**
+ * Creates a swapchain for the surface with our preferred format and presentation mode as well as
+ * the VkExtent2D size that best matches the framebuffer.
+ *
+ * @param app
+ * @param surface
+ * @param width framebuffer size reported by GLFW
+ * @param height
+ * @param captured allow copying from the images for the frame capture
+ * @param swapChain
+ * @param images
+ * @param createInfo the parameters the swapchain was created with
+ * @return
+ */
+VkResult createSurfaceSwapChain(const Application &app, VkSurfaceKHR surface, int width, int height, bool captured,
+                                VkSwapchainKHR &swapChain, std::vector<VkImage> &images, VkSwapchainCreateInfoKHR &createInfo) {
+  TRACE_ZONE("createSwapChain");
   VkSurfaceCapabilitiesKHR capabilities;
-  vkGetPhysicalDeviceSurfaceCapabilitiesKHR(app.physicalDevice.device, app.surface, &capabilities);
+  vkGetPhysicalDeviceSurfaceCapabilitiesKHR(app.physicalDevice.device, surface, &capabilities);
 
   const std::pair<std::vector<VkSurfaceFormatKHR>, std::vector<VkPresentModeKHR>> &pair =
-      getFormatsAndPresentationModes(app.physicalDevice.device, app.surface);
+      getFormatsAndPresentationModes(app.physicalDevice.device, surface);
 
   VkSurfaceFormatKHR surfaceFormat = chooseSwapSurfaceFormat(pair.first);
   VkPresentModeKHR presentMode = chooseSwapPresentMode(pair.second);
-  VkExtent2D extent = chooseSwapExtent(app.window, capabilities);
+  VkExtent2D extent = chooseSwapExtent(width, height, capabilities);
 
   // Minimum count of image handles we want to have in our swapchain.
   // Add one more than the minimum in case the driver does work and we
@@ -138,9 +166,9 @@ VkResult createSwapChain(Application &app) {
   }
 
   // begin filling in the creation info struct
-  VkSwapchainCreateInfoKHR createInfo{};
+  createInfo = {};
   createInfo.sType = VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR;
-  createInfo.surface = app.surface;
+  createInfo.surface = surface;
   createInfo.minImageCount = imageCount;
   createInfo.imageFormat = surfaceFormat.format;
   createInfo.imageColorSpace = surfaceFormat.colorSpace;
@@ -149,6 +177,14 @@ VkResult createSwapChain(Application &app) {
   // this means that we're rendering directly to the swapchain image. It is possible to render somewhere else, do post-processing and then transfer
   // that image into the swapchain image
   createInfo.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+  // frame capture copies the presented images into host visible buffers
+  if (captured && app.options.captureFormat != CAPTURE_NONE && (capabilities.supportedUsageFlags & VK_IMAGE_USAGE_TRANSFER_SRC_BIT)) {
+    createInfo.imageUsage |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+  }
+  // dynamic resolution blits the scene up to the main window's images
+  if (captured && app.options.dynamicResolutionMs > 0.0f && (capabilities.supportedUsageFlags & VK_IMAGE_USAGE_TRANSFER_DST_BIT)) {
+    createInfo.imageUsage |= VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+  }
 
   // we know that our graphics and presentation queue are the same so we explicitly use EXCLUSIVE sharing mode of queue images
   // if the queues were different we would be drawing into the graphics queue and submitting them to the presentation queue
@@ -162,20 +198,38 @@ VkResult createSwapChain(Application &app) {
   createInfo.clipped = VK_TRUE;
   createInfo.oldSwapchain = VK_NULL_HANDLE; // pointer to the old swapchain in case it changes. Swapchain changes happen on window resize
 
-  VkResult result = vkCreateSwapchainKHR(app.device, &createInfo, nullptr, &app.swapChain);
+  VkResult result = vkCreateSwapchainKHR(app.device, &createInfo, nullptr, &swapChain);
   if(result != VK_SUCCESS) {
-    std::cerr << "Unable to create swap chain" << std::endl;
+    logError("Unable to create swap chain");
     return result;
   }
-  std::cout << "Successfully created swap chain" << std::endl;
+  logInfo("Successfully created swap chain");
 
   // retrieve swapchain image handles that have been created
-  vkGetSwapchainImagesKHR(app.device, app.swapChain, &imageCount, nullptr);
-  app.swapChainImages.resize(imageCount);
-  vkGetSwapchainImagesKHR(app.device, app.swapChain, &imageCount, app.swapChainImages.data());
+  vkGetSwapchainImagesKHR(app.device, swapChain, &imageCount, nullptr);
+  images.resize(imageCount);
+  vkGetSwapchainImagesKHR(app.device, swapChain, &imageCount, images.data());
+  return VK_SUCCESS;
+}
 
-  app.imageFormat = createInfo.imageFormat;
+/**
+ * Creates the swapchain of the main window.
+ * 
+ * @param app
+ */
+VkResult createSwapChain(Application &app) {
+  VkSwapchainCreateInfoKHR createInfo;
+  VkResult result = createSurfaceSwapChain(app, app.surface, app.framebufferWidth.load(std::memory_order_relaxed),
+                                           app.framebufferHeight.load(std::memory_order_relaxed), true,
+                                           app.swapChain, app.swapChainImages, createInfo);
+  returnOnError(result)
+
+  // pipelines compiled during initialization read the format queried up front, don't write it if it is the same
+  if (app.imageFormat != createInfo.imageFormat) {
+    app.imageFormat = createInfo.imageFormat;
+  }
   app.swapChainExtent = createInfo.imageExtent;
+  app.swapChainUsage = createInfo.imageUsage;
 
   return VK_SUCCESS;
 }
@@ -8,5 +8,8 @@
 #include "../Application.h"
 
 bool checkSwapChainSupport(VkPhysicalDevice device, VkSurfaceKHR surface);
+VkFormat querySwapChainFormat(const Application &app);
+VkResult createSurfaceSwapChain(const Application &app, VkSurfaceKHR surface, int width, int height, bool captured,
+                                VkSwapchainKHR &swapChain, std::vector<VkImage> &images, VkSwapchainCreateInfoKHR &createInfo);
 VkResult createSwapChain(Application &app);
 #endif //VULKANDEMO_SWAPCHAIN_H
@@ -11,18 +11,22 @@
  * The image view is akin to an SQL table view. It allows viewing
  * a portion of the image and dictates how to access it.
  *
- * @param app
+ * @param device
+ * @param format
+ * @param images
+ * @param imageViews
  * @return
  */
-VkResult createImageViews(Application &app) {
+VkResult createImageViews(VkDevice device, VkFormat format, const std::vector<VkImage> &images, std::vector<VkImageView> &imageViews) {
+  TRACE_ZONE("createImageViews");
   VkResult errorCode;
-  app.swapChainImageViews.resize(app.swapChainImages.size());
-  for (size_t i = 0; i < app.swapChainImages.size(); ++i) {
+  imageViews.resize(images.size());
+  for (size_t i = 0; i < images.size(); ++i) {
     VkImageViewCreateInfo createInfo{};
     createInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
-    createInfo.image = app.swapChainImages[i];
+    createInfo.image = images[i];
     createInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
-    createInfo.format = app.imageFormat;
+    createInfo.format = format;
     createInfo.components.r = VK_COMPONENT_SWIZZLE_IDENTITY;
     createInfo.components.g = VK_COMPONENT_SWIZZLE_IDENTITY;
     createInfo.components.b = VK_COMPONENT_SWIZZLE_IDENTITY;
@@ -36,7 +40,7 @@ VkResult createImageViews(Application &app) {
     createInfo.subresourceRange.baseArrayLayer = 0;
     createInfo.subresourceRange.layerCount = 1;
 
-    errorCode = vkCreateImageView(app.device, &createInfo, nullptr, &app.swapChainImageViews[i]);
+    errorCode = vkCreateImageView(device, &createInfo, nullptr, &imageViews[i]);
     if(errorCode != VK_SUCCESS) {
       std::cerr << "Unable to create image views" << std::endl;
       goto error;
@@ -47,3 +51,7 @@ VkResult createImageViews(Application &app) {
   error:
   return errorCode;
 }
+
+VkResult createImageViews(Application &app) {
+  return createImageViews(app.device, app.imageFormat, app.swapChainImages, app.swapChainImageViews);
+}
@@ -8,5 +8,6 @@
 #include <vulkan/vulkan.h>
 #include "../../Application.h"
 
+VkResult createImageViews(VkDevice device, VkFormat format, const std::vector<VkImage> &images, std::vector<VkImageView> &imageViews);
 VkResult createImageViews(Application &app);
 #endif //VULKANDEMO_IMAGEVIEWS_H
@@ -0,0 +1,58 @@
+#ifndef VULKANDEMO_SPSCQUEUE_H
+#define VULKANDEMO_SPSCQUEUE_H
+
+#include <atomic>
+#include <cstddef>
+
+/**
+ * Bounded lock-free queue for exactly one producer thread and one consumer thread.
+ * The producer only ever writes the head index and the consumer only ever writes the tail index,
+ * so a push or pop is a couple of relaxed loads and a single release store. Capacity must be a
+ * power of two so that the indices can wrap with a mask instead of a division.
+ *
+ * @tparam T
+ * @tparam Capacity
+ */
+template<typename T, size_t Capacity>
+struct SpscQueue {
+    static_assert(Capacity > 0 && (Capacity & (Capacity - 1)) == 0, "SpscQueue capacity must be a power of two");
+
+    /**
+     * Called only from the producer thread. Returns false if the queue is full, in which case
+     * the item is not enqueued.
+     */
+    bool push(const T &item) {
+      const size_t head = headIdx.load(std::memory_order_relaxed);
+      if (head - tailIdx.load(std::memory_order_acquire) == Capacity) {
+        return false;
+      }
+      items[head & (Capacity - 1)] = item;
+      headIdx.store(head + 1, std::memory_order_release); // publishes the item to the consumer
+      return true;
+    }
+
+    /**
+     * Called only from the consumer thread. Returns false if the queue is empty.
+     */
+    bool pop(T &item) {
+      const size_t tail = tailIdx.load(std::memory_order_relaxed);
+      if (tail == headIdx.load(std::memory_order_acquire)) {
+        return false;
+      }
+      item = items[tail & (Capacity - 1)];
+      tailIdx.store(tail + 1, std::memory_order_release); // hands the slot back to the producer
+      return true;
+    }
+
+    bool empty() const {
+      return tailIdx.load(std::memory_order_acquire) == headIdx.load(std::memory_order_acquire);
+    }
+
+private:
+    // head and tail live on separate cache lines so the two threads don't false share
+    alignas(64) std::atomic<size_t> headIdx{0};
+    alignas(64) std::atomic<size_t> tailIdx{0};
+    T items[Capacity];
+};
+
+#endif //VULKANDEMO_SPSCQUEUE_H
@@ -0,0 +1,176 @@
+#include <iostream>
+#include "GpuTrace.h"
+#include "../Application.h"
+
+/**
+ * Finds the offset between the timestamp clock and the trace clock by writing one timestamp
+ * and taking the middle of the CPU time around its submission. Good to the submission latency,
+ * which is well below the length of the zones worth looking at.
+ *
+ * @param app
+ * @return
+ */
+static VkResult calibrateGpuClock(Application &app) {
+  GpuTracer &tracer = app.gpuTracer;
+  VkCommandBuffer commandBuffer;
+  VkCommandBufferAllocateInfo allocInfo{};
+  allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+  allocInfo.commandPool = app.commandPool;
+  allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+  allocInfo.commandBufferCount = 1;
+  VkResult errorCode = vkAllocateCommandBuffers(app.device, &allocInfo, &commandBuffer);
+  returnOnError(errorCode)
+
+  uint64_t timestamp = 0;
+  uint64_t submitted, completed;
+  VkCommandBufferBeginInfo beginInfo{};
+  beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+  beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+  VkSubmitInfo submitInfo{};
+  submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+  submitInfo.commandBufferCount = 1;
+  submitInfo.pCommandBuffers = &commandBuffer;
+  errorCode = vkBeginCommandBuffer(commandBuffer, &beginInfo);
+  throwOnError(errorCode, "Unable to begin the timestamp calibration")
+  vkCmdResetQueryPool(commandBuffer, tracer.queryPool, 0, 1);
+  vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, tracer.queryPool, 0);
+  errorCode = vkEndCommandBuffer(commandBuffer);
+  throwOnError(errorCode, "Unable to end the timestamp calibration")
+
+  submitted = traceMicros();
+  errorCode = vkQueueSubmit(app.graphicsQueue, 1, &submitInfo, VK_NULL_HANDLE);
+  throwOnError(errorCode, "Unable to submit the timestamp calibration")
+  errorCode = vkQueueWaitIdle(app.graphicsQueue);
+  throwOnError(errorCode, "Unable to wait for the timestamp calibration")
+  completed = traceMicros();
+  errorCode = vkGetQueryPoolResults(app.device, tracer.queryPool, 0, 1, sizeof(timestamp), &timestamp, sizeof(timestamp),
+                                    VK_QUERY_RESULT_64_BIT);
+  throwOnError(errorCode, "Unable to read the calibration timestamp")
+  tracer.offsetMicros = static_cast<double>(submitted + completed) * 0.5 -
+                        static_cast<double>(timestamp & tracer.timestampMask) * tracer.microsPerTick;
+
+  error:
+  vkFreeCommandBuffers(app.device, app.commandPool, 1, &commandBuffer);
+  return errorCode;
+}
+
+/**
+ * Creates the timestamp query pool when tracing is on. Needs the command pool for the clock
+ * calibration. Without timestamp support the GPU track just stays empty.
+ *
+ * @param app
+ * @return
+ */
+VkResult createGpuTracer(Application &app) {
+  TRACE_ZONE("createGpuTracer");
+  GpuTracer &tracer = app.gpuTracer;
+  tracer.frames.resize(MAX_FRAMES_IN_FLIGHT);
+  if (!traceEnabled.load()) {
+    return VK_SUCCESS;
+  }
+  VkPhysicalDeviceProperties properties;
+  vkGetPhysicalDeviceProperties(app.physicalDevice.device, &properties);
+  uint32_t queueFamilyCount = 0;
+  vkGetPhysicalDeviceQueueFamilyProperties(app.physicalDevice.device, &queueFamilyCount, nullptr);
+  std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
+  vkGetPhysicalDeviceQueueFamilyProperties(app.physicalDevice.device, &queueFamilyCount, queueFamilies.data());
+  uint32_t validBits = queueFamilies[app.physicalDevice.graphicsQueueFamilyIdx].timestampValidBits;
+  if (validBits == 0) {
+    std::cout << "The graphics queue has no timestamps, the trace has no GPU zones" << std::endl;
+    return VK_SUCCESS;
+  }
+  tracer.timestampMask = validBits >= 64 ? UINT64_MAX : (1ull << validBits) - 1;
+  tracer.microsPerTick = static_cast<double>(properties.limits.timestampPeriod) / 1000.0;
+
+  VkQueryPoolCreateInfo poolInfo{};
+  poolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+  poolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+  poolInfo.queryCount = 2 * GPU_TRACE_MAX_ZONES * MAX_FRAMES_IN_FLIGHT;
+  VkResult errorCode = vkCreateQueryPool(app.device, &poolInfo, nullptr, &tracer.queryPool);
+  if (errorCode != VK_SUCCESS) {
+    std::cerr << "Unable to create the timestamp query pool" << std::endl;
+    return errorCode;
+  }
+  return calibrateGpuClock(app);
+}
+
+/**
+ * Resets the queries of the current frame. Records outside of a render pass, before any zone.
+ *
+ * @param app
+ * @param commandBuffer
+ */
+void beginGpuFrame(Application &app, VkCommandBuffer commandBuffer) {
+  GpuTracer &tracer = app.gpuTracer;
+  if (tracer.queryPool == VK_NULL_HANDLE) {
+    return;
+  }
+  tracer.frames[app.currentFrame].zoneCount = 0;
+  vkCmdResetQueryPool(commandBuffer, tracer.queryPool, 2 * GPU_TRACE_MAX_ZONES * static_cast<uint32_t>(app.currentFrame),
+                      2 * GPU_TRACE_MAX_ZONES);
+}
+
+/**
+ * @return the zone to end, UINT32_MAX if it is not measured
+ */
+uint32_t beginGpuZone(Application &app, VkCommandBuffer commandBuffer, const char *name) {
+  GpuTracer &tracer = app.gpuTracer;
+  if (tracer.queryPool == VK_NULL_HANDLE) {
+    return UINT32_MAX;
+  }
+  GpuTraceFrame &frame = tracer.frames[app.currentFrame];
+  if (frame.zoneCount == GPU_TRACE_MAX_ZONES) {
+    return UINT32_MAX;
+  }
+  uint32_t zone = frame.zoneCount++;
+  frame.names[zone] = name;
+  uint32_t query = 2 * (GPU_TRACE_MAX_ZONES * static_cast<uint32_t>(app.currentFrame) + zone);
+  vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, tracer.queryPool, query);
+  return zone;
+}
+
+void endGpuZone(Application &app, VkCommandBuffer commandBuffer, uint32_t zone) {
+  GpuTracer &tracer = app.gpuTracer;
+  if (zone == UINT32_MAX) {
+    return;
+  }
+  uint32_t query = 2 * (GPU_TRACE_MAX_ZONES * static_cast<uint32_t>(app.currentFrame) + zone) + 1;
+  vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, tracer.queryPool, query);
+}
+
+/**
+ * Puts the zones the current frame recorded last time on the timeline. Must only be called
+ * after waiting for the frame's fence, so the results are available without waiting.
+ *
+ * @param app
+ */
+void collectGpuZones(Application &app) {
+  GpuTracer &tracer = app.gpuTracer;
+  if (tracer.queryPool == VK_NULL_HANDLE) {
+    return;
+  }
+  GpuTraceFrame &frame = tracer.frames[app.currentFrame];
+  if (frame.zoneCount == 0) {
+    return;
+  }
+  uint64_t timestamps[2 * GPU_TRACE_MAX_ZONES];
+  VkResult errorCode = vkGetQueryPoolResults(app.device, tracer.queryPool,
+                                             2 * GPU_TRACE_MAX_ZONES * static_cast<uint32_t>(app.currentFrame),
+                                             2 * frame.zoneCount, sizeof(timestamps), timestamps, sizeof(uint64_t),
+                                             VK_QUERY_RESULT_64_BIT);
+  if (errorCode == VK_SUCCESS) {
+    for (uint32_t zone = 0; zone < frame.zoneCount; ++zone) {
+      double start = static_cast<double>(timestamps[2 * zone] & tracer.timestampMask) * tracer.microsPerTick + tracer.offsetMicros;
+      double end = static_cast<double>(timestamps[2 * zone + 1] & tracer.timestampMask) * tracer.microsPerTick + tracer.offsetMicros;
+      if (start >= 0.0 && end >= start) {
+        traceGpuSpan(frame.names[zone], static_cast<uint64_t>(start), static_cast<uint64_t>(end - start));
+      }
+    }
+  }
+  frame.zoneCount = 0;
+}
+
+void destroyGpuTracer(Application &app) {
+  vkDestroyQueryPool(app.device, app.gpuTracer.queryPool, nullptr);
+  app.gpuTracer.queryPool = VK_NULL_HANDLE;
+}
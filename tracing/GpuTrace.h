@@ -0,0 +1,57 @@
+#ifndef VULKANDEMO_GPUTRACE_H
+#define VULKANDEMO_GPUTRACE_H
+
+#include <vulkan/vulkan.h>
+#include <cstdint>
+#include <vector>
+#include "Trace.h"
+
+struct Application;
+
+const uint32_t GPU_TRACE_MAX_ZONES = 8; // per frame
+
+typedef struct GpuTraceFrame {
+    uint32_t zoneCount = 0;
+    const char *names[GPU_TRACE_MAX_ZONES];
+} GpuTraceFrame;
+
+/**
+ * GPU zones of the frame command buffers, measured with timestamp queries and put on the CPU
+ * timeline. Every frame in flight owns a range of the query pool, read back after its fence.
+ */
+typedef struct GpuTracer {
+    VkQueryPool queryPool = VK_NULL_HANDLE; // null when tracing is off or the queue has no timestamps
+    double microsPerTick = 0.0;
+    uint64_t timestampMask = 0; // timestampValidBits of the graphics queue
+    double offsetMicros = 0.0; // a timestamp in microseconds plus this is the trace clock
+    std::vector<GpuTraceFrame> frames;
+} GpuTracer;
+
+VkResult createGpuTracer(Application &app);
+void beginGpuFrame(Application &app, VkCommandBuffer commandBuffer);
+uint32_t beginGpuZone(Application &app, VkCommandBuffer commandBuffer, const char *name);
+void endGpuZone(Application &app, VkCommandBuffer commandBuffer, uint32_t zone);
+void collectGpuZones(Application &app);
+void destroyGpuTracer(Application &app);
+
+/**
+ * Measures the commands recorded into the command buffer during the lifetime of the scope.
+ */
+typedef struct GpuTraceScope {
+    Application &app;
+    VkCommandBuffer commandBuffer;
+    uint32_t zone;
+
+    GpuTraceScope(Application &app, VkCommandBuffer commandBuffer, const char *name)
+        : app(app), commandBuffer(commandBuffer), zone(beginGpuZone(app, commandBuffer, name)) {}
+    ~GpuTraceScope() { endGpuZone(app, commandBuffer, zone); }
+    GpuTraceScope(const GpuTraceScope &) = delete;
+    GpuTraceScope &operator=(const GpuTraceScope &) = delete;
+} GpuTraceScope;
+
+#ifdef VULKANDEMO_TRACING
+#define TRACE_GPU_ZONE(app, commandBuffer, name) GpuTraceScope TRACE_CONCAT(gpuTraceZone, __LINE__)(app, commandBuffer, name)
+#else
+#define TRACE_GPU_ZONE(app, commandBuffer, name)
+#endif
+#endif //VULKANDEMO_GPUTRACE_H
@@ -0,0 +1,176 @@
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <vector>
+#include "Trace.h"
+
+/**
+ * Events of one thread. Only that thread appends and it never overwrites an event, so the
+ * exporter can read everything below the published count at any time without a lock.
+ */
+typedef struct TraceBuffer {
+    uint32_t thread;
+    std::atomic<const char *> name{nullptr};
+    std::atomic<uint32_t> count{0};
+    std::atomic<uint32_t> dropped{0};
+    TraceEvent events[TRACE_EVENTS_PER_THREAD];
+} TraceBuffer;
+
+std::atomic<bool> traceEnabled{false};
+
+static const auto traceStart = std::chrono::steady_clock::now();
+
+// one buffer per thread that traced something while tracing was on, freed at exit
+static std::atomic<TraceBuffer *> buffers[TRACE_MAX_THREADS];
+static std::atomic<uint32_t> bufferCount{0};
+static thread_local TraceBuffer *threadBuffer = nullptr;
+static thread_local const char *threadName = nullptr;
+
+static struct TraceBufferRelease {
+    ~TraceBufferRelease() {
+      for (uint32_t i = 0; i < std::min(bufferCount.load(), TRACE_MAX_THREADS); ++i) {
+        delete buffers[i].load();
+      }
+    }
+} bufferRelease;
+
+/**
+ * Enables the zones. Call before the threads to trace start, buffers are allocated on the
+ * first event of every thread so threads that never trace don't cost memory.
+ */
+void startTracing() {
+#ifndef VULKANDEMO_TRACING
+  std::cerr << "Trace zones are compiled out of Release builds, the trace only marks the first frame" << std::endl;
+#endif
+  traceEnabled = true;
+}
+
+uint64_t traceMicros() {
+  return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(
+      std::chrono::steady_clock::now() - traceStart).count());
+}
+
+static TraceBuffer *acquireThreadBuffer() {
+  if (threadBuffer == nullptr) {
+    uint32_t index = bufferCount++;
+    if (index >= TRACE_MAX_THREADS) {
+      return nullptr;
+    }
+    threadBuffer = new TraceBuffer();
+    threadBuffer->thread = index;
+    threadBuffer->name = threadName;
+    buffers[index].store(threadBuffer, std::memory_order_release);
+  }
+  return threadBuffer;
+}
+
+static void recordEvent(const char *name, uint32_t thread, uint64_t startMicros, uint64_t durationMicros, char phase) {
+  TraceBuffer *buffer = acquireThreadBuffer();
+  if (buffer == nullptr) {
+    return;
+  }
+  uint32_t count = buffer->count.load(std::memory_order_relaxed);
+  if (count == TRACE_EVENTS_PER_THREAD) {
+    buffer->dropped.fetch_add(1, std::memory_order_relaxed);
+    return;
+  }
+  buffer->events[count] = {name, thread == UINT32_MAX ? buffer->thread : thread, startMicros, durationMicros, phase};
+  buffer->count.store(count + 1, std::memory_order_release);
+}
+
+/**
+ * Records a span of the calling thread from the given start until now.
+ *
+ * @param name
+ * @param startMicros
+ */
+void traceSpan(const char *name, uint64_t startMicros) {
+  if (!traceEnabled.load(std::memory_order_relaxed)) {
+    return;
+  }
+  recordEvent(name, UINT32_MAX, startMicros, traceMicros() - startMicros, 'X');
+}
+
+/**
+ * Records a span of GPU work, already converted to the CPU clock, on the GPU track.
+ *
+ * @param name
+ * @param startMicros
+ * @param durationMicros
+ */
+void traceGpuSpan(const char *name, uint64_t startMicros, uint64_t durationMicros) {
+  if (!traceEnabled.load(std::memory_order_relaxed)) {
+    return;
+  }
+  recordEvent(name, TRACE_GPU_THREAD, startMicros, durationMicros, 'X');
+}
+
+void traceInstant(const char *name) {
+  if (!traceEnabled.load(std::memory_order_relaxed)) {
+    return;
+  }
+  recordEvent(name, UINT32_MAX, traceMicros(), 0, 'i');
+}
+
+/**
+ * Names the calling thread's track on the timeline. Can be called before tracing starts.
+ *
+ * @param name string literal
+ */
+void nameTraceThread(const char *name) {
+  threadName = name;
+  if (threadBuffer != nullptr) {
+    threadBuffer->name = name;
+  }
+}
+
+/**
+ * Writes the recorded events in the Trace Event Format that chrome://tracing and
+ * ui.perfetto.dev load: spans are complete ("X") events, instants global "i" events.
+ * Safe to call while other threads still trace, their later events are just not included.
+ *
+ * @param filename
+ * @return
+ */
+bool writeChromeTrace(const std::string &filename) {
+  std::ofstream file(filename);
+  if (!file.is_open()) {
+    std::cerr << "Unable to write trace " << filename << std::endl;
+    return false;
+  }
+  std::vector<TraceEvent> events;
+  uint64_t dropped = 0;
+  file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+  file << "\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << TRACE_GPU_THREAD
+       << ",\"args\":{\"name\":\"GPU\"}}";
+  for (uint32_t i = 0; i < std::min(bufferCount.load(), TRACE_MAX_THREADS); ++i) {
+    TraceBuffer *buffer = buffers[i].load(std::memory_order_acquire);
+    if (buffer == nullptr) {
+      continue; // registered but not published yet
+    }
+    uint32_t count = buffer->count.load(std::memory_order_acquire);
+    events.insert(events.end(), buffer->events, buffer->events + count);
+    dropped += buffer->dropped.load(std::memory_order_relaxed);
+    const char *name = buffer->name.load();
+    file << ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << buffer->thread
+         << ",\"args\":{\"name\":\"" << (name ? name : "worker") << "\"}}";
+  }
+  std::sort(events.begin(), events.end(), [](const TraceEvent &a, const TraceEvent &b) { return a.startMicros < b.startMicros; });
+  for (const auto &event : events) {
+    file << ",\n{\"name\":\"" << event.name << "\",\"pid\":1,\"tid\":" << event.thread
+         << ",\"ts\":" << event.startMicros;
+    if (event.phase == 'X') {
+      file << ",\"ph\":\"X\",\"dur\":" << event.durationMicros << "}";
+    } else {
+      file << ",\"ph\":\"i\",\"s\":\"g\"}";
+    }
+  }
+  file << "\n]}" << std::endl;
+  std::cout << "Wrote " << events.size() << " trace events to " << filename;
+  if (dropped > 0) {
+    std::cout << ", " << dropped << " were dropped because a thread's buffer was full";
+  }
+  std::cout << std::endl;
+  return true;
+}
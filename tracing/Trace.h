@@ -0,0 +1,84 @@
+#ifndef VULKANDEMO_TRACE_H
+#define VULKANDEMO_TRACE_H
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+const uint32_t TRACE_MAX_THREADS = 64;
+const uint32_t TRACE_EVENTS_PER_THREAD = 1 << 17; // ~4 MiB per traced thread, later events are dropped
+const uint32_t TRACE_GPU_THREAD = 1000; // track of the GPU zones on the timeline
+
+/**
+ * A span of work on one thread, in microseconds since the process started.
+ * The name must outlive the trace, i.e. be a string literal.
+ */
+typedef struct TraceEvent {
+    const char *name;
+    uint32_t thread; // small index in the order threads first traced something, or TRACE_GPU_THREAD
+    uint64_t startMicros;
+    uint64_t durationMicros;
+    char phase; // 'X' for a span, 'i' for an instant, as in the Trace Event Format
+} TraceEvent;
+
+/**
+ * CPU stages of drawFrame. Their times are measured every frame, in every build, since the
+ * regression suite compares them against a baseline.
+ */
+enum FrameStage : uint32_t {
+    FRAME_STAGE_WAIT = 0, // for the frame's fence
+    FRAME_STAGE_UPDATE, // capture readback, sprites
+    FRAME_STAGE_ACQUIRE,
+    FRAME_STAGE_RECORD,
+    FRAME_STAGE_SUBMIT,
+    FRAME_STAGE_PRESENT,
+    FRAME_STAGE_COUNT
+};
+
+typedef struct FrameStageTimes {
+    double milliseconds[FRAME_STAGE_COUNT];
+} FrameStageTimes;
+
+extern std::atomic<bool> traceEnabled;
+
+void startTracing();
+uint64_t traceMicros();
+void traceSpan(const char *name, uint64_t startMicros);
+void traceGpuSpan(const char *name, uint64_t startMicros, uint64_t durationMicros);
+void traceInstant(const char *name);
+void nameTraceThread(const char *name);
+bool writeChromeTrace(const std::string &filename);
+
+/**
+ * Records the lifetime of the scope as a span, including early returns. Costs a relaxed load
+ * while tracing is off and two clock reads plus a store into the thread's buffer while it is on.
+ */
+typedef struct TraceScope {
+    const char *name;
+    uint64_t startMicros;
+
+    explicit TraceScope(const char *name) : name(name), startMicros(0) {
+      if (traceEnabled.load(std::memory_order_relaxed)) {
+        startMicros = traceMicros();
+      } else {
+        this->name = nullptr;
+      }
+    }
+    ~TraceScope() {
+      if (name != nullptr) {
+        traceSpan(name, startMicros);
+      }
+    }
+    TraceScope(const TraceScope &) = delete;
+    TraceScope &operator=(const TraceScope &) = delete;
+} TraceScope;
+
+// zones are compiled out of Release builds, CMakeLists.txt defines VULKANDEMO_TRACING for the others
+#define TRACE_CONCAT_(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_(a, b)
+#ifdef VULKANDEMO_TRACING
+#define TRACE_ZONE(name) TraceScope TRACE_CONCAT(traceZone, __LINE__)(name)
+#else
+#define TRACE_ZONE(name)
+#endif
+#endif //VULKANDEMO_TRACE_H
@@ -1,6 +1,7 @@
 #include <vector>
-#include <vulkan/vulkan.h>
+#include "../dispatch/Dispatch.h"
 #include <iostream>
+#include "../logging/Logger.h"
 
 const std::vector<const char *> validationLayers = {
     "VK_LAYER_KHRONOS_validation"
@@ -12,8 +13,10 @@ static VKAPI_ATTR VkBool32 VKAPI_CALL debugCallback(
     const VkDebugUtilsMessengerCallbackDataEXT *pCallbackData,
     void *pUserData
 ) {
-  if (messageSeverity >= VK_DEBUG_UTILS_MESSAGE_SEVERITY_WARNING_BIT_EXT) {
-    std::cerr << "validation layer: " << pCallbackData->pMessage << std::endl;
+  // the same message tends to repeat every frame, so each message id gets a small budget per second
+  if (messageSeverity >= VK_DEBUG_UTILS_MESSAGE_SEVERITY_WARNING_BIT_EXT && logRateLimit(pCallbackData->messageIdNumber)) {
+    LogLevel level = messageSeverity >= VK_DEBUG_UTILS_MESSAGE_SEVERITY_ERROR_BIT_EXT ? LogLevel::Error : LogLevel::Warning;
+    logMessage(level, "validation layer: {}", pCallbackData->pMessage);
   }
 
   return VK_FALSE;
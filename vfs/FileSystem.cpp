@@ -0,0 +1,586 @@
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include "FileSystem.h"
+#include "../assets/AssetArchive.h"
+
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#define VULKANDEMO_IO_URING
+#endif
+#endif
+
+const uint32_t IO_URING_ENTRIES = 256; // reads in flight at most
+const uint32_t IO_URING_SUBMIT_RETRIES = 1000; // a millisecond apart, while the kernel is busy with completions
+
+typedef struct PendingRead {
+    FileRead request;
+    FileReadResult result;
+#ifdef VULKANDEMO_IO_URING
+    int fd = -1;
+    iovec target{};
+#endif
+} PendingRead;
+
+#ifdef VULKANDEMO_IO_URING
+/**
+ * The rings shared with the kernel, mapped once at setup. Only the submitting thread writes the
+ * submission queue and only the completing thread reads the completion queue, so neither needs
+ * a lock, the kernel is the other side of both.
+ */
+typedef struct IoUring {
+    int fd = -1;
+    uint32_t entries = 0;
+    unsigned *submissionHead = nullptr;
+    unsigned *submissionTail = nullptr;
+    unsigned *submissionMask = nullptr;
+    unsigned *submissionArray = nullptr;
+    io_uring_sqe *submissions = nullptr;
+    unsigned *completionHead = nullptr;
+    unsigned *completionTail = nullptr;
+    unsigned *completionMask = nullptr;
+    io_uring_cqe *completions = nullptr;
+    void *submissionRing = MAP_FAILED;
+    size_t submissionRingSize = 0;
+    void *completionRing = MAP_FAILED;
+    size_t completionRingSize = 0;
+    size_t submissionsSize = 0;
+} IoUring;
+#endif
+
+/**
+ * The process wide file system, like the logger. Reads are queued as batches under the mutex and
+ * taken by the worker threads, or by the submitting thread of io_uring which hands them to the
+ * kernel and a completing thread that finishes them.
+ */
+typedef struct FileSystem {
+    FileBackend backend = FILE_BACKEND_NONE;
+    std::mutex mutex;
+    std::condition_variable workAvailable;
+    std::condition_variable idle;
+    std::deque<PendingRead *> queue;
+    uint64_t outstanding = 0; // submitted and not completed
+    bool stopping = false;
+    std::vector<std::thread> workers;
+#ifdef VULKANDEMO_IO_URING
+    IoUring ring;
+    uint32_t inFlight = 0; // in the rings
+    bool ringBroken = false; // the completer couldn't be woken up to stop
+    std::condition_variable ringSpace;
+    std::thread completer;
+#endif
+} FileSystem;
+
+static FileSystem fileSystem;
+
+static struct FileSystemShutdown {
+    ~FileSystemShutdown() {
+      stopFileSystem(); // joins the threads before the statics go away
+    }
+} fileSystemShutdown;
+
+/**
+ * Checks the file fits the destination of the read, or makes room for it in the result.
+ *
+ * @param target where to read to
+ * @return false if it doesn't fit
+ */
+static bool prepareTarget(PendingRead &read, size_t size, char *&target) {
+  read.result.size = size;
+  if (read.request.destination == nullptr) {
+    read.result.data.resize(size);
+    target = read.result.data.data();
+    return true;
+  }
+  if (size > read.request.capacity) {
+    std::cerr << read.request.path << " has " << size << " bytes, more than the " << read.request.capacity
+              << " bytes it is read into" << std::endl;
+    return false;
+  }
+  target = static_cast<char *>(read.request.destination);
+  return true;
+}
+
+/**
+ * @return whether the mounted archive holds the file, in which case the read is done
+ */
+static bool readFromArchive(PendingRead &read) {
+  const AssetEntry *entry = findMountedAsset(read.request.path);
+  if (entry == nullptr) {
+    return false;
+  }
+  char *target = nullptr;
+  read.result.succeeded = prepareTarget(read, entry->size, target) && unpackMountedAsset(*entry, target);
+  return true;
+}
+
+static void readBlocking(PendingRead &read) {
+  if (readFromArchive(read)) {
+    return;
+  }
+  std::ifstream file(read.request.path, std::ios::ate | std::ios::binary);
+  if (!file.is_open()) {
+    std::cerr << "Failed to open file " << read.request.path << std::endl;
+    return;
+  }
+  const auto size = static_cast<size_t>(file.tellg());
+  char *target = nullptr;
+  if (!prepareTarget(read, size, target)) {
+    return;
+  }
+  file.seekg(0);
+  file.read(target, static_cast<std::streamsize>(size));
+  read.result.succeeded = file.good();
+}
+
+/**
+ * Hands the result to the callback on the current I/O thread and retires the read.
+ */
+static void completeRead(PendingRead *read) {
+  if (read->request.callback) {
+    read->request.callback(read->result);
+  }
+  delete read;
+  std::lock_guard<std::mutex> lock(fileSystem.mutex);
+  if (--fileSystem.outstanding == 0) {
+    fileSystem.idle.notify_all();
+  }
+}
+
+static void fileWorker() {
+  while (true) {
+    PendingRead *read;
+    {
+      std::unique_lock<std::mutex> lock(fileSystem.mutex);
+      fileSystem.workAvailable.wait(lock, [] { return fileSystem.stopping || !fileSystem.queue.empty(); });
+      if (fileSystem.queue.empty()) {
+        return; // stopping
+      }
+      read = fileSystem.queue.front();
+      fileSystem.queue.pop_front();
+    }
+    readBlocking(*read);
+    completeRead(read);
+  }
+}
+
+#ifdef VULKANDEMO_IO_URING
+static int enterRing(IoUring &ring, uint32_t submitted, uint32_t waitFor) {
+  int result;
+  do {
+    result = static_cast<int>(syscall(__NR_io_uring_enter, ring.fd, submitted, waitFor,
+                                      waitFor > 0 ? IORING_ENTER_GETEVENTS : 0, nullptr, 0));
+  } while (result < 0 && errno == EINTR);
+  return result;
+}
+
+static void destroyRing(IoUring &ring) {
+  if (ring.submissions != nullptr) {
+    munmap(ring.submissions, ring.submissionsSize);
+  }
+  if (ring.completionRing != MAP_FAILED && ring.completionRing != ring.submissionRing) {
+    munmap(ring.completionRing, ring.completionRingSize);
+  }
+  if (ring.submissionRing != MAP_FAILED) {
+    munmap(ring.submissionRing, ring.submissionRingSize);
+  }
+  if (ring.fd >= 0) {
+    close(ring.fd);
+  }
+  ring = IoUring{};
+}
+
+/**
+ * Sets up a ring without liburing, through the raw system calls.
+ *
+ * @return false if the kernel doesn't support io_uring or it is not allowed, e.g. in a container
+ */
+static bool createRing(IoUring &ring) {
+  io_uring_params params{};
+  ring.fd = static_cast<int>(syscall(__NR_io_uring_setup, IO_URING_ENTRIES, &params));
+  if (ring.fd < 0) {
+    return false;
+  }
+  ring.entries = params.sq_entries;
+  ring.submissionRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+  ring.completionRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+  const bool singleMap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+  if (singleMap) {
+    ring.submissionRingSize = ring.completionRingSize = std::max(ring.submissionRingSize, ring.completionRingSize);
+  }
+  ring.submissionRing = mmap(nullptr, ring.submissionRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                             ring.fd, IORING_OFF_SQ_RING);
+  ring.completionRing = singleMap ? ring.submissionRing
+                                  : mmap(nullptr, ring.completionRingSize, PROT_READ | PROT_WRITE,
+                                         MAP_SHARED | MAP_POPULATE, ring.fd, IORING_OFF_CQ_RING);
+  ring.submissionsSize = params.sq_entries * sizeof(io_uring_sqe);
+  void *submissions = mmap(nullptr, ring.submissionsSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                           ring.fd, IORING_OFF_SQES);
+  ring.submissions = submissions != MAP_FAILED ? static_cast<io_uring_sqe *>(submissions) : nullptr;
+  if (ring.submissionRing == MAP_FAILED || ring.completionRing == MAP_FAILED || ring.submissions == nullptr) {
+    destroyRing(ring);
+    return false;
+  }
+  auto *submissionBase = static_cast<uint8_t *>(ring.submissionRing);
+  auto *completionBase = static_cast<uint8_t *>(ring.completionRing);
+  ring.submissionHead = reinterpret_cast<unsigned *>(submissionBase + params.sq_off.head);
+  ring.submissionTail = reinterpret_cast<unsigned *>(submissionBase + params.sq_off.tail);
+  ring.submissionMask = reinterpret_cast<unsigned *>(submissionBase + params.sq_off.ring_mask);
+  ring.submissionArray = reinterpret_cast<unsigned *>(submissionBase + params.sq_off.array);
+  ring.completionHead = reinterpret_cast<unsigned *>(completionBase + params.cq_off.head);
+  ring.completionTail = reinterpret_cast<unsigned *>(completionBase + params.cq_off.tail);
+  ring.completionMask = reinterpret_cast<unsigned *>(completionBase + params.cq_off.ring_mask);
+  ring.completions = reinterpret_cast<io_uring_cqe *>(completionBase + params.cq_off.cqes);
+  return true;
+}
+
+/**
+ * Queues a submission, which the kernel only sees once the tail is published by the next enter.
+ */
+static void queueSubmission(IoUring &ring, uint8_t opcode, int fd, const iovec *target, uint64_t userData) {
+  const unsigned tail = *ring.submissionTail;
+  const unsigned index = tail & *ring.submissionMask;
+  io_uring_sqe &submission = ring.submissions[index];
+  memset(&submission, 0, sizeof(submission));
+  submission.opcode = opcode;
+  submission.fd = fd;
+  submission.addr = reinterpret_cast<uint64_t>(target);
+  submission.len = target != nullptr ? 1 : 0;
+  submission.off = 0;
+  submission.user_data = userData;
+  ring.submissionArray[index] = index;
+  __atomic_store_n(ring.submissionTail, tail + 1, __ATOMIC_RELEASE);
+}
+
+/**
+ * Takes back what the kernel hasn't consumed from the submission queue and finishes those reads as
+ * failed. Without SQPOLL the kernel only consumes submissions during our own enter, so the tail
+ * can be rewound safely.
+ */
+static void failQueuedSubmissions(IoUring &ring) {
+  const unsigned head = __atomic_load_n(ring.submissionHead, __ATOMIC_ACQUIRE);
+  const unsigned tail = *ring.submissionTail;
+  uint32_t failed = 0;
+  for (unsigned i = head; i != tail; ++i) {
+    auto *read = reinterpret_cast<PendingRead *>(ring.submissions[i & *ring.submissionMask].user_data);
+    if (read == nullptr) {
+      continue; // the wake up of the completer
+    }
+    std::cerr << "Failed to read " << read->request.path << ": it could not be submitted" << std::endl;
+    read->result.succeeded = false;
+    close(read->fd);
+    completeRead(read);
+    failed++;
+  }
+  __atomic_store_n(ring.submissionTail, head, __ATOMIC_RELEASE);
+  if (failed > 0) {
+    std::lock_guard<std::mutex> lock(fileSystem.mutex);
+    fileSystem.inFlight -= failed;
+    fileSystem.ringSpace.notify_one();
+  }
+}
+
+/**
+ * Submits the queued submissions. The kernel may take fewer than asked for, or refuse with EAGAIN
+ * or EBUSY until the completer made room, so the rest is retried for a while. Whatever still
+ * isn't submitted then, or after any other error, is finished as failed so nobody waits for it.
+ *
+ * @return false if not everything was submitted
+ */
+static bool submitQueued(IoUring &ring, uint32_t queued) {
+  uint32_t retries = 0;
+  while (queued > 0) {
+    const int submitted = enterRing(ring, queued, 0);
+    if (submitted > 0) {
+      queued -= std::min(static_cast<uint32_t>(submitted), queued);
+      retries = 0;
+      continue;
+    }
+    if ((submitted == 0 || errno == EAGAIN || errno == EBUSY) && ++retries < IO_URING_SUBMIT_RETRIES) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+      continue;
+    }
+    std::cerr << "io_uring_enter failed to submit " << queued << " entries: "
+              << (submitted < 0 ? strerror(errno) : "no progress") << std::endl;
+    failQueuedSubmissions(ring);
+    return false;
+  }
+  return true;
+}
+
+/**
+ * Takes whole batches off the queue, opens their files and queues a read of each whole file into
+ * its target, then submits them with one system call. Waits for the completer when the rings
+ * are full.
+ */
+static void ringSubmitter() {
+  IoUring &ring = fileSystem.ring;
+  std::deque<PendingRead *> batch;
+  while (true) {
+    {
+      std::unique_lock<std::mutex> lock(fileSystem.mutex);
+      fileSystem.workAvailable.wait(lock, [] { return fileSystem.stopping || !fileSystem.queue.empty(); });
+      if (fileSystem.queue.empty()) {
+        break; // stopping
+      }
+      batch.swap(fileSystem.queue);
+    }
+    uint32_t queued = 0;
+    for (PendingRead *read : batch) {
+      if (readFromArchive(*read)) {
+        completeRead(read);
+        continue;
+      }
+      read->fd = open(read->request.path.c_str(), O_RDONLY | O_CLOEXEC);
+      struct stat status{};
+      char *target = nullptr;
+      bool prepared = false;
+      if (read->fd < 0 || fstat(read->fd, &status) != 0) {
+        std::cerr << "Failed to open file " << read->request.path << std::endl;
+      } else {
+        prepared = prepareTarget(*read, static_cast<size_t>(status.st_size), target);
+      }
+      if (!prepared || read->result.size == 0) {
+        read->result.succeeded = prepared;
+        if (read->fd >= 0) {
+          close(read->fd);
+        }
+        completeRead(read);
+        continue;
+      }
+      read->target = {target, read->result.size};
+      {
+        std::unique_lock<std::mutex> lock(fileSystem.mutex);
+        if (fileSystem.inFlight == ring.entries) {
+          lock.unlock();
+          submitQueued(ring, queued); // what is queued has to be submitted to ever complete
+          queued = 0;
+          lock.lock();
+          fileSystem.ringSpace.wait(lock, [&ring] { return fileSystem.inFlight < ring.entries; });
+        }
+        fileSystem.inFlight++;
+      }
+      queueSubmission(ring, IORING_OP_READV, read->fd, &read->target, reinterpret_cast<uint64_t>(read));
+      queued++;
+    }
+    batch.clear();
+    if (queued > 0) {
+      submitQueued(ring, queued);
+    }
+  }
+  // wakes the completer up after everything else, outstanding reads were waited for
+  {
+    std::unique_lock<std::mutex> lock(fileSystem.mutex);
+    fileSystem.ringSpace.wait(lock, [&ring] { return fileSystem.inFlight < ring.entries; });
+  }
+  queueSubmission(ring, IORING_OP_NOP, -1, nullptr, 0);
+  if (!submitQueued(ring, 1)) {
+    fileSystem.ringBroken = true; // the completer will never wake up
+  }
+}
+
+/**
+ * Waits for completions and finishes their reads. A regular file only comes back short if it
+ * shrank or on an interrupted read, the rest is then read right here.
+ */
+static void ringCompleter() {
+  IoUring &ring = fileSystem.ring;
+  bool stopping = false;
+  while (!stopping) {
+    if (enterRing(ring, 0, 1) < 0) {
+      std::cerr << "io_uring_enter failed: " << strerror(errno) << std::endl;
+      return;
+    }
+    unsigned head = *ring.completionHead;
+    uint32_t completed = 0;
+    while (head != __atomic_load_n(ring.completionTail, __ATOMIC_ACQUIRE)) {
+      const io_uring_cqe &completion = ring.completions[head & *ring.completionMask];
+      auto *read = reinterpret_cast<PendingRead *>(completion.user_data);
+      const int result = completion.res;
+      head++;
+      __atomic_store_n(ring.completionHead, head, __ATOMIC_RELEASE);
+      if (read == nullptr) {
+        stopping = true;
+        continue;
+      }
+      completed++;
+      size_t done = result > 0 ? static_cast<size_t>(result) : 0;
+      while (result >= 0 && done < read->result.size) {
+        const ssize_t more = pread(read->fd, static_cast<char *>(read->target.iov_base) + done, read->result.size - done,
+                                   static_cast<off_t>(done));
+        if (more < 0 && errno == EINTR) {
+          continue;
+        }
+        if (more <= 0) {
+          break;
+        }
+        done += static_cast<size_t>(more);
+      }
+      read->result.succeeded = result >= 0 && done == read->result.size;
+      if (!read->result.succeeded) {
+        std::cerr << "Failed to read " << read->request.path << ": " << strerror(result < 0 ? -result : EIO) << std::endl;
+      }
+      close(read->fd);
+      completeRead(read);
+    }
+    if (completed > 0) {
+      std::lock_guard<std::mutex> lock(fileSystem.mutex);
+      fileSystem.inFlight -= completed;
+      fileSystem.ringSpace.notify_one();
+    }
+  }
+}
+#endif
+
+/**
+ * Starts the threads reads are done on. io_uring falls back to the thread pool where the kernel
+ * doesn't offer it or it isn't allowed.
+ *
+ * @param backend
+ * @param threadCount workers of the thread pool
+ * @return false if already started
+ */
+bool startFileSystem(FileBackend backend, uint32_t threadCount) {
+  if (fileSystem.backend != FILE_BACKEND_NONE) {
+    return false;
+  }
+  fileSystem.stopping = false;
+#ifdef VULKANDEMO_IO_URING
+  if (backend == FILE_BACKEND_IO_URING && !fileSystem.ringBroken) {
+    if (createRing(fileSystem.ring)) {
+      fileSystem.backend = FILE_BACKEND_IO_URING;
+      fileSystem.inFlight = 0;
+      fileSystem.workers.emplace_back(ringSubmitter);
+      fileSystem.completer = std::thread(ringCompleter);
+      return true;
+    }
+    std::cerr << "io_uring is not available (" << strerror(errno) << "), reading on a thread pool" << std::endl;
+  }
+#else
+  if (backend == FILE_BACKEND_IO_URING) {
+    std::cerr << "io_uring is only available on Linux, reading on a thread pool" << std::endl;
+  }
+#endif
+  fileSystem.backend = FILE_BACKEND_THREAD_POOL;
+  for (uint32_t i = 0; i < std::max(threadCount, 1u); ++i) {
+    fileSystem.workers.emplace_back(fileWorker);
+  }
+  return true;
+}
+
+FileBackend fileSystemBackend() {
+  return fileSystem.backend;
+}
+
+/**
+ * Queues the reads as one batch, which io_uring submits with a single system call. Each read
+ * completes through its callback. Without a started file system the reads happen right away on
+ * the calling thread.
+ *
+ * @param reads moved from
+ */
+void submitFileReads(std::vector<FileRead> &reads) {
+  if (fileSystem.backend == FILE_BACKEND_NONE) {
+    for (auto &request : reads) {
+      PendingRead read{std::move(request), {}};
+      read.result.path = read.request.path;
+      readBlocking(read);
+      if (read.request.callback) {
+        read.request.callback(read.result);
+      }
+    }
+    reads.clear();
+    return;
+  }
+  {
+    std::lock_guard<std::mutex> lock(fileSystem.mutex);
+    for (auto &request : reads) {
+      auto *read = new PendingRead{std::move(request), {}};
+      read->result.path = read->request.path;
+      fileSystem.queue.push_back(read);
+    }
+    fileSystem.outstanding += reads.size();
+  }
+  reads.clear();
+  fileSystem.workAvailable.notify_all();
+}
+
+std::future<FileReadResult> readFileAsync(const std::string &path, void *destination, size_t capacity) {
+  auto promise = std::make_shared<std::promise<FileReadResult>>();
+  std::future<FileReadResult> future = promise->get_future();
+  std::vector<FileRead> reads(1);
+  reads[0].path = path;
+  reads[0].destination = destination;
+  reads[0].capacity = capacity;
+  reads[0].callback = [promise](FileReadResult &result) { promise->set_value(std::move(result)); };
+  submitFileReads(reads);
+  return future;
+}
+
+/**
+ * Blocks until every read submitted so far completed and ran its callback.
+ */
+void waitFileReads() {
+  std::unique_lock<std::mutex> lock(fileSystem.mutex);
+  fileSystem.idle.wait(lock, [] { return fileSystem.outstanding == 0; });
+}
+
+/**
+ * Reads a whole file on the calling thread, from the mounted asset archive if it holds it. For
+ * callers that can't go on without the bytes anyway.
+ *
+ * @param path
+ * @param content
+ * @return
+ */
+bool readFile(const std::string &path, std::vector<char> &content) {
+  PendingRead read;
+  read.request.path = path;
+  readBlocking(read);
+  content = std::move(read.result.data);
+  return read.result.succeeded;
+}
+
+void stopFileSystem() {
+  if (fileSystem.backend == FILE_BACKEND_NONE) {
+    return;
+  }
+  waitFileReads();
+  {
+    std::lock_guard<std::mutex> lock(fileSystem.mutex);
+    fileSystem.stopping = true;
+  }
+  fileSystem.workAvailable.notify_all();
+  for (auto &worker : fileSystem.workers) {
+    worker.join();
+  }
+  fileSystem.workers.clear();
+#ifdef VULKANDEMO_IO_URING
+  if (fileSystem.ringBroken) {
+    fileSystem.completer.detach(); // still waits in the ring, so it stays mapped and isn't used again
+  } else {
+    if (fileSystem.completer.joinable()) {
+      fileSystem.completer.join();
+    }
+    if (fileSystem.ring.fd >= 0) {
+      destroyRing(fileSystem.ring);
+    }
+  }
+#endif
+  fileSystem.backend = FILE_BACKEND_NONE;
+}
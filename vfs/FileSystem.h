@@ -0,0 +1,42 @@
+#ifndef VULKANDEMO_FILESYSTEM_H
+#define VULKANDEMO_FILESYSTEM_H
+
+#include <cstdint>
+#include <functional>
+#include <future>
+#include <string>
+#include <vector>
+
+enum FileBackend {
+    FILE_BACKEND_NONE, // not started
+    FILE_BACKEND_THREAD_POOL, // blocking reads on worker threads, available everywhere
+    FILE_BACKEND_IO_URING // Linux, reads queued to the kernel in batches and completed by one thread
+};
+
+typedef struct FileReadResult {
+    std::string path;
+    bool succeeded = false;
+    size_t size = 0; // bytes read
+    std::vector<char> data; // the bytes, if the request had no destination
+} FileReadResult;
+
+typedef std::function<void(FileReadResult &result)> FileReadCallback;
+
+/**
+ * A file to read, from the mounted asset archive if it holds it and from disk otherwise.
+ */
+typedef struct FileRead {
+    std::string path;
+    void *destination = nullptr; // e.g. mapped staging memory, nullptr to read into FileReadResult::data
+    size_t capacity = 0; // of the destination, larger files fail
+    FileReadCallback callback; // runs on an I/O thread, must not wait for other reads
+} FileRead;
+
+bool startFileSystem(FileBackend backend, uint32_t threadCount);
+FileBackend fileSystemBackend();
+void submitFileReads(std::vector<FileRead> &reads);
+std::future<FileReadResult> readFileAsync(const std::string &path, void *destination = nullptr, size_t capacity = 0);
+void waitFileReads();
+bool readFile(const std::string &path, std::vector<char> &content);
+void stopFileSystem();
+#endif //VULKANDEMO_FILESYSTEM_H
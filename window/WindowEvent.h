@@ -0,0 +1,38 @@
+#ifndef VULKANDEMO_WINDOWEVENT_H
+#define VULKANDEMO_WINDOWEVENT_H
+
+#include <chrono>
+#include <cstdint>
+
+enum class WindowEventType : uint8_t {
+    Key,
+    MouseButton,
+    CursorMove,
+    Scroll
+};
+
+/**
+ * An input event captured by a GLFW callback on the main thread and forwarded to the render thread.
+ * The timestamp is taken when the callback fires so the render thread can measure input-to-present latency.
+ */
+typedef struct WindowEvent {
+    WindowEventType type;
+    int32_t code; // key, mouse button or 0
+    int32_t action; // GLFW_PRESS/GLFW_RELEASE/GLFW_REPEAT or 0
+    double x; // cursor position or scroll offset
+    double y;
+    std::chrono::steady_clock::time_point timestamp;
+} WindowEvent;
+
+/**
+ * Running statistics of the time between an input event reaching the main thread
+ * and the first present that could have reflected it.
+ */
+typedef struct InputLatencyStats {
+    uint64_t samples = 0;
+    double totalMs = 0.0;
+    double maxMs = 0.0;
+    uint64_t droppedEvents = 0; // events lost because the queue was full
+} InputLatencyStats;
+
+#endif //VULKANDEMO_WINDOWEVENT_H
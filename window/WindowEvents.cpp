@@ -0,0 +1,125 @@
+#include <GLFW/glfw3.h>
+#include <iostream>
+#include "WindowEvents.h"
+
+static void forwardEvent(GLFWwindow *window, const WindowEvent &event) {
+  auto app = reinterpret_cast<Application *>(glfwGetWindowUserPointer(window));
+  if (!app->windowEvents.push(event)) {
+    ++app->inputLatency.droppedEvents; // only ever written by the main thread
+  }
+  requestRedraw(*app);
+}
+
+/**
+ * Runs on the main thread. The size is published through atomics instead of the queue
+ * so that a resize can never be lost to a full queue.
+ */
+static void framebufferResizeCallback(GLFWwindow *window, int width, int height) {
+  auto app = reinterpret_cast<Application *>(glfwGetWindowUserPointer(window));
+  app->framebufferWidth.store(width, std::memory_order_relaxed);
+  app->framebufferHeight.store(height, std::memory_order_relaxed);
+  app->framebufferResized.store(true, std::memory_order_release);
+  requestRedraw(*app);
+}
+
+/**
+ * The window was uncovered or needs its contents again for another reason.
+ */
+static void windowRefreshCallback(GLFWwindow *window) {
+  requestRedraw(*reinterpret_cast<Application *>(glfwGetWindowUserPointer(window)));
+}
+
+static void keyCallback(GLFWwindow *window, int key, int scancode, int action, int mods) {
+  forwardEvent(window, {WindowEventType::Key, key, action, 0.0, 0.0, std::chrono::steady_clock::now()});
+}
+
+static void mouseButtonCallback(GLFWwindow *window, int button, int action, int mods) {
+  forwardEvent(window, {WindowEventType::MouseButton, button, action, 0.0, 0.0, std::chrono::steady_clock::now()});
+}
+
+static void cursorPositionCallback(GLFWwindow *window, double x, double y) {
+  forwardEvent(window, {WindowEventType::CursorMove, 0, 0, x, y, std::chrono::steady_clock::now()});
+}
+
+static void scrollCallback(GLFWwindow *window, double x, double y) {
+  forwardEvent(window, {WindowEventType::Scroll, 0, 0, x, y, std::chrono::steady_clock::now()});
+}
+
+/**
+ * Installs the GLFW callbacks that forward window events to the render thread.
+ * Must be called from the main thread after the window has been created.
+ *
+ * @param app
+ */
+void registerWindowCallbacks(Application &app) {
+  int width = 0, height = 0;
+  glfwGetFramebufferSize(app.window, &width, &height);
+  app.framebufferWidth = width;
+  app.framebufferHeight = height;
+
+  glfwSetWindowUserPointer(app.window, &app);
+  glfwSetFramebufferSizeCallback(app.window, framebufferResizeCallback);
+  glfwSetWindowRefreshCallback(app.window, windowRefreshCallback);
+  glfwSetKeyCallback(app.window, keyCallback);
+  glfwSetMouseButtonCallback(app.window, mouseButtonCallback);
+  glfwSetCursorPosCallback(app.window, cursorPositionCallback);
+  glfwSetScrollCallback(app.window, scrollCallback);
+}
+
+/**
+ * Drains the window event queue on the render thread. F9, F8 and F7 log the memory, command
+ * cache and LOD reports and scrolling zooms the LOD demo. We also remember the oldest event that
+ * has not been presented, which is what the input-to-present latency is measured against.
+ *
+ * @param app
+ */
+void processWindowEvents(Application &app) {
+  WindowEvent event{};
+  while (app.windowEvents.pop(event)) {
+    if (event.type == WindowEventType::Key && event.code == GLFW_KEY_F9 && event.action == GLFW_PRESS) {
+      printMemoryReport(app);
+    }
+    if (event.type == WindowEventType::Key && event.code == GLFW_KEY_F8 && event.action == GLFW_PRESS) {
+      printCommandCacheStats(app);
+    }
+    if (event.type == WindowEventType::Key && event.code == GLFW_KEY_F7 && event.action == GLFW_PRESS) {
+      printLodSceneStats(app);
+    }
+    if (event.type == WindowEventType::Scroll && app.lodScene.enabled) {
+      zoomLodScene(app, event.y);
+    }
+    if (!app.hasPendingInput) {
+      app.hasPendingInput = true;
+      app.pendingInputTimestamp = event.timestamp;
+    }
+  }
+}
+
+/**
+ * Called on the render thread right after a successful present, or on the main thread with
+ * --single-thread.
+ *
+ * @param app
+ */
+void recordPresentLatency(Application &app) {
+  if (!app.hasPendingInput) {
+    return;
+  }
+  const std::chrono::duration<double, std::milli> latency = std::chrono::steady_clock::now() - app.pendingInputTimestamp;
+  app.inputLatency.samples++;
+  app.inputLatency.totalMs += latency.count();
+  if (latency.count() > app.inputLatency.maxMs) {
+    app.inputLatency.maxMs = latency.count();
+  }
+  app.hasPendingInput = false;
+}
+
+void printInputLatency(const Application &app) {
+  const InputLatencyStats &stats = app.inputLatency;
+  if (stats.samples == 0) {
+    std::cout << "Input-to-present latency: no input received" << std::endl;
+    return;
+  }
+  std::cout << "Input-to-present latency (" << (app.options.singleThread ? "single thread" : "render thread") << "): avg "
+            << stats.totalMs / stats.samples << " ms, max " << stats.maxMs << " ms over " << stats.samples << " samples (" << stats.droppedEvents << " events dropped)" << std::endl;
+}
@@ -0,0 +1,10 @@
+#ifndef VULKANDEMO_WINDOWEVENTS_H
+#define VULKANDEMO_WINDOWEVENTS_H
+
+#include "../Application.h"
+
+void registerWindowCallbacks(Application &app);
+void processWindowEvents(Application &app);
+void recordPresentLatency(Application &app);
+void printInputLatency(const Application &app);
+#endif //VULKANDEMO_WINDOWEVENTS_H
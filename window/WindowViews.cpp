@@ -0,0 +1,334 @@
+#include <algorithm>
+#include <iostream>
+#include <string>
+#include "WindowViews.h"
+#include "../Application.h"
+#include "../swapchain/Swapchain.h"
+#include "../swapchain/images/ImageViews.h"
+#include "../pipeline/GraphicsPipeline.h"
+#include "../pipeline/Commands.h"
+
+/**
+ * Runs on the main thread, like the resize callback of the main window.
+ */
+static void viewFramebufferResizeCallback(GLFWwindow *window, int width, int height) {
+  auto app = reinterpret_cast<Application *>(glfwGetWindowUserPointer(window));
+  for (uint32_t i = 0; i < app->windowViewCount; ++i) {
+    WindowView &view = app->windowViews[i];
+    if (view.window == window) {
+      view.framebufferWidth.store(width, std::memory_order_relaxed);
+      view.framebufferHeight.store(height, std::memory_order_relaxed);
+      view.resized.store(true, std::memory_order_release);
+    }
+  }
+  requestRedraw(*app);
+}
+
+/**
+ * Creates the windows of the views beyond the main window. GLFW requires this on the main thread.
+ *
+ * @param app
+ * @param width
+ * @param height
+ */
+void createViewWindows(Application &app, int width, int height) {
+  app.windowViewCount = std::min(app.options.windowCount - 1, MAX_WINDOW_VIEWS);
+  if (app.options.windowCount - 1 > MAX_WINDOW_VIEWS) {
+    std::cerr << "Only " << MAX_WINDOW_VIEWS + 1 << " windows are supported" << std::endl;
+  }
+  for (uint32_t i = 0; i < app.windowViewCount; ++i) {
+    WindowView &view = app.windowViews[i];
+    const std::string title = "JK! view " + std::to_string(i + 2);
+    view.window = glfwCreateWindow(width, height, title.c_str(), nullptr, nullptr);
+    int framebufferWidth = 0, framebufferHeight = 0;
+    glfwGetFramebufferSize(view.window, &framebufferWidth, &framebufferHeight);
+    view.framebufferWidth = framebufferWidth;
+    view.framebufferHeight = framebufferHeight;
+    glfwSetWindowUserPointer(view.window, &app);
+    glfwSetFramebufferSizeCallback(view.window, viewFramebufferResizeCallback);
+  }
+}
+
+bool viewWindowsShouldClose(const Application &app) {
+  for (uint32_t i = 0; i < app.windowViewCount; ++i) {
+    if (glfwWindowShouldClose(app.windowViews[i].window)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+/**
+ * Creates the swapchain, image views and framebuffers of a view. The views are drawn with the
+ * render passes and pipelines of the main window, so their swapchain has to have its format.
+ *
+ * @param app
+ * @param view
+ * @return
+ */
+static VkResult createViewSwapChain(Application &app, WindowView &view) {
+  VkSwapchainCreateInfoKHR createInfo;
+  VkResult errorCode = createSurfaceSwapChain(app, view.surface, view.framebufferWidth.load(std::memory_order_relaxed),
+                                              view.framebufferHeight.load(std::memory_order_relaxed), false,
+                                              view.swapChain, view.images, createInfo);
+  returnOnError(errorCode)
+  if (createInfo.imageFormat != app.imageFormat) {
+    logError("The swapchain of a window view has a different format than the main window");
+    return VK_ERROR_FORMAT_NOT_SUPPORTED;
+  }
+  view.extent = createInfo.imageExtent;
+  view.imagesInFlight.assign(view.images.size(), VK_NULL_HANDLE);
+  errorCode = createImageViews(app.device, app.imageFormat, view.images, view.imageViews);
+  returnOnError(errorCode)
+  return createFramebuffers(app.device, app.renderPass, view.extent, view.imageViews, view.framebuffers);
+}
+
+static void destroyViewSwapChain(Application &app, WindowView &view) {
+  for (auto framebuffer : view.framebuffers) {
+    vkDestroyFramebuffer(app.device, framebuffer, nullptr);
+  }
+  for (auto imageView : view.imageViews) {
+    vkDestroyImageView(app.device, imageView, nullptr);
+  }
+  vkDestroySwapchainKHR(app.device, view.swapChain, nullptr);
+  view.framebuffers.clear();
+  view.imageViews.clear();
+  view.images.clear();
+  view.swapChain = VK_NULL_HANDLE;
+}
+
+/**
+ * Creates the surfaces and swapchains of the view windows. Needs the device and the render pass.
+ *
+ * @param app
+ * @return
+ */
+VkResult createWindowViews(Application &app) {
+  TRACE_ZONE("createWindowViews");
+  VkResult errorCode = VK_SUCCESS;
+  VkSemaphoreCreateInfo semaphoreInfo{};
+  semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+  for (uint32_t i = 0; i < app.windowViewCount; ++i) {
+    WindowView &view = app.windowViews[i];
+    errorCode = glfwCreateWindowSurface(app.instance, view.window, nullptr, &view.surface);
+    if (errorCode != VK_SUCCESS) {
+      std::cerr << "Failed to create the surface of a window view" << std::endl;
+      return errorCode;
+    }
+    // every swapchain is presented from the one queue
+    VkBool32 presentationSupport = VK_FALSE;
+    vkGetPhysicalDeviceSurfaceSupportKHR(app.physicalDevice.device, app.physicalDevice.presentationQueueFamilyIdx,
+                                         view.surface, &presentationSupport);
+    if (!presentationSupport) {
+      std::cerr << "The presentation queue can't present to a window view" << std::endl;
+      return VK_ERROR_INITIALIZATION_FAILED;
+    }
+    errorCode = createViewSwapChain(app, view);
+    returnOnError(errorCode)
+    view.imageAvailableSemaphores.resize(MAX_FRAMES_IN_FLIGHT, VK_NULL_HANDLE);
+    for (auto &semaphore : view.imageAvailableSemaphores) {
+      errorCode = vkCreateSemaphore(app.device, &semaphoreInfo, nullptr, &semaphore);
+      returnOnError(errorCode)
+    }
+  }
+  if (app.windowViewCount > 0) {
+    std::cout << "Created " << app.windowViewCount << " additional window views" << std::endl;
+  }
+  return errorCode;
+}
+
+/**
+ * Rebuilds the swapchains of all views, after the main window recreated the render passes they
+ * use. The device must be idle.
+ *
+ * @param app
+ * @return
+ */
+VkResult recreateWindowViews(Application &app) {
+  for (uint32_t i = 0; i < app.windowViewCount; ++i) {
+    WindowView &view = app.windowViews[i];
+    destroyViewSwapChain(app, view);
+    VkResult errorCode = createViewSwapChain(app, view);
+    returnOnError(errorCode)
+    view.resized = false;
+  }
+  return VK_SUCCESS;
+}
+
+/**
+ * Acquires an image of every view for the current frame, after the main window acquired its own.
+ * A view never holds up the frame: if it has no image ready, or is minimized, it is skipped and
+ * keeps showing its previous image.
+ *
+ * @param app
+ * @return
+ */
+VkResult acquireWindowViews(Application &app) {
+  TRACE_ZONE("acquireWindowViews");
+  for (uint32_t i = 0; i < app.windowViewCount; ++i) {
+    WindowView &view = app.windowViews[i];
+    view.acquired = false;
+    if (view.framebufferWidth.load(std::memory_order_relaxed) == 0 || view.framebufferHeight.load(std::memory_order_relaxed) == 0) {
+      view.timing.skippedFrames++;
+      continue;
+    }
+    VkResult errorCode;
+    if (view.resized.exchange(false, std::memory_order_acquire)) {
+      logInfo("Window view {} resized, recreating its swapchain", i + 2);
+      vkDeviceWaitIdle(app.device); // earlier frames may still render into its framebuffers
+      destroyViewSwapChain(app, view);
+      errorCode = createViewSwapChain(app, view);
+      returnOnError(errorCode)
+    }
+    errorCode = vkAcquireNextImageKHR(app.device, view.swapChain, 0, view.imageAvailableSemaphores[app.currentFrame],
+                                      VK_NULL_HANDLE, &view.imageIndex);
+    if (errorCode == VK_ERROR_OUT_OF_DATE_KHR) {
+      view.resized = true; // recreated next frame
+      view.timing.skippedFrames++;
+      continue;
+    } else if (errorCode == VK_NOT_READY || errorCode == VK_TIMEOUT) {
+      view.timing.skippedFrames++;
+      continue;
+    } else if (errorCode != VK_SUCCESS && errorCode != VK_SUBOPTIMAL_KHR) {
+      logError("Failed to acquire the next image of window view {}", i + 2);
+      return errorCode;
+    }
+    if (view.imagesInFlight[view.imageIndex] != VK_NULL_HANDLE) {
+      vkWaitForFences(app.device, 1, &view.imagesInFlight[view.imageIndex], VK_TRUE, UINT64_MAX);
+    }
+    view.imagesInFlight[view.imageIndex] = app.inFlightFences[app.currentFrame];
+    view.acquired = true;
+  }
+  return VK_SUCCESS;
+}
+
+/**
+ * Draws the scene into the acquired image of every view, with the view's own viewport. The scene
+ * is recorded inline since the cached segment has the viewport of the main window baked in.
+ *
+ * @param app
+ * @param commandBuffer
+ */
+void recordWindowViews(Application &app, VkCommandBuffer commandBuffer) {
+  for (uint32_t i = 0; i < app.windowViewCount; ++i) {
+    WindowView &view = app.windowViews[i];
+    if (!view.acquired) {
+      continue;
+    }
+    VkRenderPassBeginInfo renderPassInfo{};
+    renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+    renderPassInfo.renderPass = app.renderPass;
+    renderPassInfo.framebuffer = view.framebuffers[view.imageIndex];
+    renderPassInfo.renderArea = {{0, 0}, view.extent};
+    VkClearValue clearColor = {0.0f, 0.0f, 0.0f, 1.0f};
+    renderPassInfo.clearValueCount = 1;
+    renderPassInfo.pClearValues = &clearColor;
+    vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+    recordSceneCommands(app, commandBuffer, view.extent);
+    vkCmdEndRenderPass(commandBuffer);
+  }
+}
+
+/**
+ * Appends the acquired views to the arrays of the frame's submission and present.
+ *
+ * @param app
+ * @param waitSemaphores the semaphores signaled by the acquisitions
+ * @param swapChains
+ * @param imageIndices
+ * @return the number of views written
+ */
+uint32_t gatherWindowViewPresents(Application &app, VkSemaphore *waitSemaphores, VkSwapchainKHR *swapChains, uint32_t *imageIndices) {
+  uint32_t count = 0;
+  for (uint32_t i = 0; i < app.windowViewCount; ++i) {
+    WindowView &view = app.windowViews[i];
+    if (view.acquired) {
+      waitSemaphores[count] = view.imageAvailableSemaphores[app.currentFrame];
+      swapChains[count] = view.swapChain;
+      imageIndices[count] = view.imageIndex;
+      count++;
+    }
+  }
+  return count;
+}
+
+/**
+ * Handles the per swapchain results of the frame's present for the views, in the order
+ * gatherWindowViewPresents wrote them.
+ *
+ * @param app
+ * @param results
+ */
+void finishWindowViewPresents(Application &app, const VkResult *results) {
+  uint32_t count = 0;
+  for (uint32_t i = 0; i < app.windowViewCount; ++i) {
+    WindowView &view = app.windowViews[i];
+    if (!view.acquired) {
+      continue;
+    }
+    const VkResult result = results[count++];
+    if (result == VK_SUCCESS || result == VK_SUBOPTIMAL_KHR) {
+      recordPresentTiming(view.timing);
+    }
+    if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR) {
+      view.resized = true;
+    }
+    view.acquired = false;
+  }
+}
+
+/**
+ * Called right after a successful present of the window.
+ *
+ * @param timing
+ */
+void recordPresentTiming(PresentTimingStats &timing) {
+  const auto now = std::chrono::steady_clock::now();
+  if (timing.presents > 0) {
+    const double milliseconds = std::chrono::duration<double, std::milli>(now - timing.lastPresent).count();
+    timing.totalMs += milliseconds;
+    timing.maxMs = std::max(timing.maxMs, milliseconds);
+  }
+  timing.presents++;
+  timing.lastPresent = now;
+}
+
+static void printWindowTiming(uint32_t window, const PresentTimingStats &timing) {
+  std::cout << "Window " << window << ": ";
+  if (timing.presents < 2) {
+    std::cout << "fewer than two presents" << std::endl;
+    return;
+  }
+  std::cout << "avg " << timing.totalMs / static_cast<double>(timing.presents - 1) << " ms between presents, max "
+            << timing.maxMs << " ms over " << timing.presents << " presents (" << timing.skippedFrames
+            << " frames skipped)" << std::endl;
+}
+
+void printPresentTiming(const Application &app) {
+  if (app.windowViewCount == 0) {
+    return;
+  }
+  printWindowTiming(1, app.presentTiming);
+  for (uint32_t i = 0; i < app.windowViewCount; ++i) {
+    printWindowTiming(i + 2, app.windowViews[i].timing);
+  }
+}
+
+/**
+ * Destroys the swapchains, surfaces and windows of the views. Needs the device and the instance.
+ *
+ * @param app
+ */
+void destroyWindowViews(Application &app) {
+  for (uint32_t i = 0; i < app.windowViewCount; ++i) {
+    WindowView &view = app.windowViews[i];
+    destroyViewSwapChain(app, view);
+    for (auto semaphore : view.imageAvailableSemaphores) {
+      vkDestroySemaphore(app.device, semaphore, nullptr);
+    }
+    view.imageAvailableSemaphores.clear();
+    vkDestroySurfaceKHR(app.instance, view.surface, nullptr);
+    glfwDestroyWindow(view.window);
+  }
+  app.windowViewCount = 0;
+}
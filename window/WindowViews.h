@@ -0,0 +1,61 @@
+#ifndef VULKANDEMO_WINDOWVIEWS_H
+#define VULKANDEMO_WINDOWVIEWS_H
+
+#include <atomic>
+#include <chrono>
+#include <vector>
+#include "../dispatch/Dispatch.h"
+#include <GLFW/glfw3.h> // after the Vulkan headers, for glfwCreateWindowSurface
+
+struct Application;
+
+const uint32_t MAX_WINDOW_VIEWS = 7; // besides the main window
+
+/**
+ * Time between the presents of one window.
+ */
+typedef struct PresentTimingStats {
+    uint64_t presents = 0;
+    uint64_t skippedFrames = 0; // no image could be acquired without waiting, or the window was minimized
+    double totalMs = 0.0;
+    double maxMs = 0.0;
+    std::chrono::steady_clock::time_point lastPresent;
+} PresentTimingStats;
+
+/**
+ * An additional window showing the scene. It has its own surface, swapchain and framebuffers
+ * but shares the device, render passes, pipelines and buffers with the main window. Its image
+ * is rendered by the frame's command buffer and presented by the frame's single present.
+ */
+typedef struct WindowView {
+    GLFWwindow *window = nullptr;
+    VkSurfaceKHR surface = VK_NULL_HANDLE;
+    VkSwapchainKHR swapChain = VK_NULL_HANDLE;
+    std::vector<VkImage> images;
+    std::vector<VkImageView> imageViews;
+    std::vector<VkFramebuffer> framebuffers;
+    VkExtent2D extent{};
+    std::vector<VkSemaphore> imageAvailableSemaphores; // one per frame in flight
+    std::vector<VkFence> imagesInFlight;
+    bool acquired = false; // during the current frame
+    uint32_t imageIndex = 0;
+    PresentTimingStats timing;
+
+    // written by the GLFW callback on the main thread
+    std::atomic<bool> resized{false};
+    std::atomic<int> framebufferWidth{0};
+    std::atomic<int> framebufferHeight{0};
+} WindowView;
+
+void createViewWindows(Application &app, int width, int height);
+bool viewWindowsShouldClose(const Application &app);
+VkResult createWindowViews(Application &app);
+VkResult recreateWindowViews(Application &app);
+VkResult acquireWindowViews(Application &app);
+void recordWindowViews(Application &app, VkCommandBuffer commandBuffer);
+uint32_t gatherWindowViewPresents(Application &app, VkSemaphore *waitSemaphores, VkSwapchainKHR *swapChains, uint32_t *imageIndices);
+void finishWindowViewPresents(Application &app, const VkResult *results);
+void recordPresentTiming(PresentTimingStats &timing);
+void printPresentTiming(const Application &app);
+void destroyWindowViews(Application &app);
+#endif //VULKANDEMO_WINDOWVIEWS_H